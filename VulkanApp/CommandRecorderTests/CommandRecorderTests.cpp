@@ -0,0 +1,281 @@
+// CPU tests of the command recorder: the Vulkan commands it records go to fake functions of the dynamic dispatcher,
+// which count them, so no device is needed
+#include "../VulkanApp/CommandRecorder.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// The project defines VULKAN_HPP_DISPATCH_LOADER_DYNAMIC=1: vk::CommandBuffer calls go through this dispatcher
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { ++failures; std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK(" #condition ") failed" << std::endl; } } while (0)
+
+/// Commands that reached the command buffer, and the arguments of the last ones worth checking
+static struct RecordedCommands
+{
+	uint32_t bindPipeline;
+	uint32_t bindDescriptorSets;
+	uint32_t bindVertexBuffers;
+	uint32_t bindIndexBuffer;
+	uint32_t setViewport;
+	uint32_t setScissor;
+	uint32_t pushConstants;
+	uint32_t draws;
+
+	uint32_t lastFirstSet;
+	uint32_t lastDynamicOffsetCount;
+	uint32_t lastPushOffset;
+	uint32_t lastPushSize;
+} recorded;
+
+// -- FAKE COMMANDS --
+static VKAPI_ATTR void VKAPI_CALL cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline)
+{
+	++recorded.bindPipeline;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t firstSet,
+	uint32_t, const VkDescriptorSet*, uint32_t dynamicOffsetCount, const uint32_t*)
+{
+	++recorded.bindDescriptorSets;
+	recorded.lastFirstSet = firstSet;
+	recorded.lastDynamicOffsetCount = dynamicOffsetCount;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdBindVertexBuffers(VkCommandBuffer, uint32_t, uint32_t, const VkBuffer*, const VkDeviceSize*)
+{
+	++recorded.bindVertexBuffers;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdBindIndexBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkIndexType)
+{
+	++recorded.bindIndexBuffer;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdSetViewport(VkCommandBuffer, uint32_t, uint32_t, const VkViewport*)
+{
+	++recorded.setViewport;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdSetScissor(VkCommandBuffer, uint32_t, uint32_t, const VkRect2D*)
+{
+	++recorded.setScissor;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdPushConstants(VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, uint32_t offset, uint32_t size,
+	const void*)
+{
+	++recorded.pushConstants;
+	recorded.lastPushOffset = offset;
+	recorded.lastPushSize = size;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdDraw(VkCommandBuffer, uint32_t, uint32_t, uint32_t, uint32_t)
+{
+	++recorded.draws;
+}
+
+static VKAPI_ATTR void VKAPI_CALL cmdDrawIndexed(VkCommandBuffer, uint32_t, uint32_t, uint32_t, int32_t, uint32_t)
+{
+	++recorded.draws;
+}
+
+static void installFakeCommands()
+{
+	vk::DispatchLoaderDynamic& dispatcher = vk::defaultDispatchLoaderDynamic;
+	dispatcher.vkCmdBindPipeline = cmdBindPipeline;
+	dispatcher.vkCmdBindDescriptorSets = cmdBindDescriptorSets;
+	dispatcher.vkCmdBindVertexBuffers = cmdBindVertexBuffers;
+	dispatcher.vkCmdBindIndexBuffer = cmdBindIndexBuffer;
+	dispatcher.vkCmdSetViewport = cmdSetViewport;
+	dispatcher.vkCmdSetScissor = cmdSetScissor;
+	dispatcher.vkCmdPushConstants = cmdPushConstants;
+	dispatcher.vkCmdDraw = cmdDraw;
+	dispatcher.vkCmdDrawIndexed = cmdDrawIndexed;
+}
+
+/// Distinct handles that are never created: they are only compared and passed to the fake commands
+template<typename Handle>
+static Handle fakeHandle(uint64_t value)
+{
+	typename Handle::CType handle;
+	static_assert(sizeof(handle) == sizeof(value), "Non-dispatchable handles are 64-bit");
+	std::memcpy(&handle, &value, sizeof(handle));
+	return Handle(handle);
+}
+
+static vk::CommandBuffer fakeCommandBuffer()
+{
+	return vk::CommandBuffer(reinterpret_cast<VkCommandBuffer>(static_cast<uintptr_t>(1)));
+}
+
+/// Same values again: only the first call of each is recorded, draws always are
+static void testRedundantBindsDropped()
+{
+	const vk::Pipeline pipeline = fakeHandle<vk::Pipeline>(1);
+	const vk::PipelineLayout layout = fakeHandle<vk::PipelineLayout>(2);
+	const vk::DescriptorSet descriptorSet = fakeHandle<vk::DescriptorSet>(3);
+	const vk::Buffer vertexBuffer = fakeHandle<vk::Buffer>(4);
+	const vk::Buffer indexBuffer = fakeHandle<vk::Buffer>(5);
+	const vk::Viewport viewport{ 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	const vk::Rect2D scissor{ { 0, 0 }, { 1280, 720 } };
+	const uint32_t dynamicOffset = 256;
+	const uint32_t materialId = 7;
+
+	recorded = RecordedCommands{};
+	CommandRecorder recorder;
+	recorder.begin(fakeCommandBuffer());
+	for (int i = 0; i < 3; ++i)
+	{
+		recorder.bindPipeline(pipeline);
+		recorder.bindDescriptorSet(layout, 0, descriptorSet, dynamicOffset);
+		recorder.bindVertexBuffer(0, vertexBuffer, 0);
+		recorder.bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint32);
+		recorder.setViewport(viewport);
+		recorder.setScissor(scissor);
+		recorder.pushConstants(layout, vk::ShaderStageFlagBits::eFragment, 64, sizeof(materialId), &materialId);
+		recorder.drawIndexed(36, 1, 0, 0, 0);
+	}
+
+	CHECK(recorded.bindPipeline == 1);
+	CHECK(recorded.bindDescriptorSets == 1);
+	CHECK(recorded.bindVertexBuffers == 1);
+	CHECK(recorded.bindIndexBuffer == 1);
+	CHECK(recorded.setViewport == 1);
+	CHECK(recorded.setScissor == 1);
+	CHECK(recorded.pushConstants == 1);
+	CHECK(recorded.draws == 3);
+
+	const CommandRecorder::Statistics& statistics = recorder.getStatistics();
+	CHECK(statistics.issuedCommands == 10);
+	CHECK(statistics.elidedCommands == 14);
+	CHECK(statistics.pipelineBinds == 1);
+	CHECK(statistics.pushConstants == 1);
+	CHECK(statistics.draws == 3);
+
+	// Bytes inside the pushed range, unchanged: dropped too
+	recorder.pushConstants(layout, vk::ShaderStageFlagBits::eFragment, 66, 2, reinterpret_cast<const char*>(&materialId) + 2);
+	CHECK(recorded.pushConstants == 1);
+}
+
+/// State that differs in any way is recorded again
+static void testChangedStateIssued()
+{
+	const vk::Pipeline pipeline = fakeHandle<vk::Pipeline>(1);
+	const vk::Pipeline otherPipeline = fakeHandle<vk::Pipeline>(11);
+	const vk::PipelineLayout layout = fakeHandle<vk::PipelineLayout>(2);
+	const vk::PipelineLayout otherLayout = fakeHandle<vk::PipelineLayout>(12);
+	const vk::DescriptorSet descriptorSet = fakeHandle<vk::DescriptorSet>(3);
+	const vk::Viewport viewport{ 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	const uint32_t values[4] = { 1, 2, 3, 4 };
+
+	recorded = RecordedCommands{};
+	CommandRecorder recorder;
+	recorder.begin(fakeCommandBuffer());
+
+	// Push constants: a range reaching past the known bytes, even with the bytes left there by another block
+	const vk::ShaderStageFlags allStages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+	recorder.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, 16, values);
+	recorder.pushConstants(layout, allStages, 0, 4, values);
+	recorder.pushConstants(layout, allStages, 0, 16, values);
+	CHECK(recorded.pushConstants == 3);
+	CHECK(recorded.lastPushOffset == 0 && recorded.lastPushSize == 16);
+	recorder.pushConstants(layout, allStages, 4, 4, values + 1);
+	CHECK(recorded.pushConstants == 3);
+	recorder.pushConstants(otherLayout, allStages, 0, 16, values);
+	CHECK(recorded.pushConstants == 4);
+	recorder.pushConstants(otherLayout, allStages, 4, 4, values + 2);
+	CHECK(recorded.pushConstants == 5);
+
+	// The same descriptor set at another index, then other dynamic offsets
+	recorder.bindDescriptorSet(layout, 0, descriptorSet);
+	recorder.bindDescriptorSet(layout, 1, descriptorSet);
+	CHECK(recorded.bindDescriptorSets == 2);
+	CHECK(recorded.lastFirstSet == 1);
+	recorder.bindDescriptorSet(layout, 0, descriptorSet);
+	CHECK(recorded.bindDescriptorSets == 2);
+	recorder.bindDescriptorSet(layout, 1, descriptorSet, values[0]);
+	CHECK(recorded.bindDescriptorSets == 3);
+	CHECK(recorded.lastDynamicOffsetCount == 1);
+	recorder.bindDescriptorSet(layout, 1, descriptorSet, values[1]);
+	CHECK(recorded.bindDescriptorSets == 4);
+
+	// A set bound with another layout makes the others unknown
+	recorder.bindDescriptorSet(otherLayout, 2, descriptorSet);
+	recorder.bindDescriptorSet(layout, 0, descriptorSet);
+	CHECK(recorded.bindDescriptorSets == 6);
+	CHECK(recorded.lastFirstSet == 0);
+
+	// A new pipeline replaces the viewport
+	recorder.bindPipeline(pipeline);
+	recorder.setViewport(viewport);
+	recorder.bindPipeline(otherPipeline);
+	recorder.setViewport(viewport);
+	CHECK(recorded.bindPipeline == 2);
+	CHECK(recorded.setViewport == 2);
+
+	// After commands recorded around the recorder, nothing is assumed
+	recorder.invalidate();
+	recorder.bindPipeline(otherPipeline);
+	recorder.bindDescriptorSet(layout, 0, descriptorSet);
+	CHECK(recorded.bindPipeline == 3);
+	CHECK(recorded.bindDescriptorSets == 7);
+}
+
+/// begin starts a frame: counts from zero, and nothing is known to be bound in the new command buffer
+static void testStatisticsResetEachFrame()
+{
+	const vk::Pipeline pipeline = fakeHandle<vk::Pipeline>(1);
+
+	recorded = RecordedCommands{};
+	CommandRecorder recorder;
+	recorder.begin(fakeCommandBuffer());
+	recorder.bindPipeline(pipeline);
+	recorder.bindPipeline(pipeline);
+	recorder.draw(3, 1, 0, 0);
+	CHECK(recorder.getStatistics().issuedCommands == 2);
+	CHECK(recorder.getStatistics().elidedCommands == 1);
+
+	recorder.begin(fakeCommandBuffer());
+	const CommandRecorder::Statistics& statistics = recorder.getStatistics();
+	CHECK(statistics.issuedCommands == 0);
+	CHECK(statistics.elidedCommands == 0);
+	CHECK(statistics.pipelineBinds == 0);
+	CHECK(statistics.pushConstants == 0);
+	CHECK(statistics.draws == 0);
+
+	recorder.bindPipeline(pipeline);
+	CHECK(recorded.bindPipeline == 2);
+	CHECK(statistics.issuedCommands == 1);
+	CHECK(statistics.elidedCommands == 0);
+	CHECK(statistics.pipelineBinds == 1);
+}
+
+int main()
+{
+	installFakeCommands();
+	try
+	{
+		testRedundantBindsDropped();
+		testChangedStateIssued();
+		testStatisticsResetEachFrame();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (failures)
+	{
+		std::cerr << failures << " command recorder checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Command recorder tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
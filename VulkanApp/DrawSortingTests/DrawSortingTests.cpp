@@ -0,0 +1,156 @@
+// CPU tests of the draw sorting: key packing, and both radix sorts checked against std::stable_sort
+#include "../VulkanApp/DrawSorting.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { ++failures; std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK(" #condition ") failed" << std::endl; } } while (0)
+
+static const uint64_t DEPTH_MAX = (1ull << DRAW_KEY_DEPTH_BITS) - 1;
+
+/// Random keys over every field, with many duplicates so that stability matters
+static vector<SortedDraw> makeRandomDraws(size_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	vector<SortedDraw> draws(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float depth = static_cast<float>(random() % 64) / 64.0f;
+		draws[i].key = makeDrawKey(random() % 3, random() % 4, random() % 300, random() % 50, depth);
+		draws[i].draw = static_cast<uint32_t>(i);
+	}
+	return draws;
+}
+
+static vector<SortedDraw> stableSorted(vector<SortedDraw> draws)
+{
+	std::stable_sort(draws.begin(), draws.end(), [](const SortedDraw& a, const SortedDraw& b) { return a.key < b.key; });
+	return draws;
+}
+
+static bool sameOrder(const vector<SortedDraw>& a, const vector<SortedDraw>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (a[i].key != b[i].key || a[i].draw != b[i].draw) return false;
+	}
+	return true;
+}
+
+/// Each field in its bits, and any difference in a field outweighs every less significant one
+static void testKeyPacking()
+{
+	CHECK(makeDrawKey(1, 0, 0, 0, 0.0f) == 1ull << DRAW_KEY_PASS_SHIFT);
+	CHECK(makeDrawKey(0, 1, 0, 0, 0.0f) == 1ull << DRAW_KEY_PIPELINE_SHIFT);
+	CHECK(makeDrawKey(0, 0, 1, 0, 0.0f) == 1ull << DRAW_KEY_MATERIAL_SHIFT);
+	CHECK(makeDrawKey(0, 0, 0, 1, 0.0f) == 1ull << DRAW_KEY_MESH_SHIFT);
+	CHECK(makeDrawKey(0, 0, 0, 0, 1.0f) == DEPTH_MAX);
+
+	// pass > pipeline > material > mesh > depth
+	CHECK(makeDrawKey(1, 0, 0, 0, 0.0f) > makeDrawKey(0, 0xFF, 0xFFFF, 0xFFFF, 1.0f));
+	CHECK(makeDrawKey(0, 1, 0, 0, 0.0f) > makeDrawKey(0, 0, 0xFFFF, 0xFFFF, 1.0f));
+	CHECK(makeDrawKey(0, 0, 1, 0, 0.0f) > makeDrawKey(0, 0, 0, 0xFFFF, 1.0f));
+	CHECK(makeDrawKey(0, 0, 0, 1, 0.0f) > makeDrawKey(0, 0, 0, 0, 1.0f));
+	// Front to back inside a mesh
+	CHECK(makeDrawKey(0, 0, 0, 0, 0.25f) < makeDrawKey(0, 0, 0, 0, 0.5f));
+
+	// Depth clamped, wide fields truncated instead of spilling into the next one
+	CHECK(makeDrawKey(0, 0, 0, 0, -1.0f) == 0);
+	CHECK(makeDrawKey(0, 0, 0, 0, 2.0f) == DEPTH_MAX);
+	CHECK(makeDrawKey(0, 0, 0, 0x10001, 0.0f) == makeDrawKey(0, 0, 0, 1, 0.0f));
+	CHECK(makeDrawKey(0, 0x100, 0, 0, 0.0f) == 0);
+}
+
+static void testSequentialSort()
+{
+	vector<SortedDraw> draws = makeRandomDraws(5000, 1);
+	const vector<SortedDraw> expected = stableSorted(draws);
+	vector<SortedDraw> scratch;
+	radixSortDraws(draws, scratch);
+	CHECK(sameOrder(draws, expected));
+}
+
+/// Equal keys keep the order they were added in, whichever radix passes are skipped
+static void testEqualKeys()
+{
+	const uint64_t key = makeDrawKey(2, 3, 40, 5, 0.5f);
+	vector<SortedDraw> draws(1000);
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		draws[i] = SortedDraw{ key, static_cast<uint32_t>(i) };
+	}
+	vector<SortedDraw> scratch;
+	radixSortDraws(draws, scratch);
+	bool inOrder = true;
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		inOrder = inOrder && draws[i].key == key && draws[i].draw == i;
+	}
+	CHECK(inOrder);
+
+	// Two keys interleaved: each keeps its draws in order
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		draws[i] = SortedDraw{ i % 2 ? key : key - 1, static_cast<uint32_t>(i) };
+	}
+	const vector<SortedDraw> expected = stableSorted(draws);
+	radixSortDraws(draws, scratch);
+	CHECK(sameOrder(draws, expected));
+
+	// Nothing to sort
+	vector<SortedDraw> single(1, SortedDraw{ key, 7 });
+	radixSortDraws(single, scratch);
+	CHECK(single.size() == 1 && single[0].draw == 7);
+}
+
+/// As many draws as make the renderer sort on the job system, split in several chunks
+static void testParallelSort()
+{
+	JobSystem jobSystem;
+	jobSystem.init(3);
+
+	vector<SortedDraw> draws = makeRandomDraws(DRAW_SORT_PARALLEL_THRESHOLD * 2, 2);
+	const vector<SortedDraw> expected = stableSorted(draws);
+	vector<SortedDraw> scratch;
+	radixSortDraws(draws, scratch, jobSystem);
+	CHECK(sameOrder(draws, expected));
+
+	// Scratch kept from the previous sort, as from one frame to the next
+	vector<SortedDraw> again = makeRandomDraws(DRAW_SORT_PARALLEL_THRESHOLD + 1, 3);
+	const vector<SortedDraw> expectedAgain = stableSorted(again);
+	radixSortDraws(again, scratch, jobSystem);
+	CHECK(sameOrder(again, expectedAgain));
+
+	jobSystem.clean();
+}
+
+int main()
+{
+	try
+	{
+		testKeyPacking();
+		testSequentialSort();
+		testEqualKeys();
+		testParallelSort();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (failures)
+	{
+		std::cerr << failures << " draw sorting checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Draw sorting tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,341 @@
+// CPU tests of the render graph compilation: no device is created, only the compiled
+// barriers, render pass descriptions and alias slots are checked
+#include "../VulkanApp/RenderGraph.h"
+
+#include <cstdlib>
+#include <iostream>
+
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { ++failures; std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK(" #condition ") failed" << std::endl; } } while (0)
+
+using Stage = vk::PipelineStageFlagBits;
+using Access = vk::AccessFlagBits;
+using Layout = vk::ImageLayout;
+
+static const vk::Extent2D EXTENT{ 1280, 720 };
+
+static void noRecord(vk::CommandBuffer) {}
+
+/// Swapchain image as imported by VulkanRenderer: acquired at color attachment output, presented after the frame
+static uint32_t importSwapchain(RenderGraph& graph)
+{
+	const uint32_t swapchain = graph.importImage("Swapchain", vk::Format::eB8G8R8A8Unorm, EXTENT,
+		RenderGraphAccess{ Stage::eColorAttachmentOutput, vk::AccessFlags(), Layout::eUndefined });
+	graph.markOutput(swapchain, RenderGraphAccess{ Stage::eBottomOfPipe, vk::AccessFlags(), Layout::ePresentSrcKHR });
+	return swapchain;
+}
+
+static const RenderGraphBarrier* findBarrier(const RenderGraphCompiledPass& compiledPass, uint32_t resource)
+{
+	for (const RenderGraphBarrier& barrier : compiledPass.barriers)
+	{
+		if (barrier.resource == resource) return &barrier;
+	}
+	return nullptr;
+}
+
+/// Culling writes the indirect commands that the draws read
+static void testComputeWriteIndirectRead()
+{
+	RenderGraph graph;
+	const uint32_t swapchain = importSwapchain(graph);
+	const uint32_t commands = graph.importBuffer("Draw commands", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+
+	const uint32_t cull = graph.addPass("Cull", RenderGraphPassType::Compute, noRecord);
+	graph.write(cull, commands, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t draw = graph.addPass("Draw", RenderGraphPassType::Graphics, noRecord);
+	graph.read(draw, commands, RenderGraphUsage::IndirectBuffer);
+	graph.clear(draw, swapchain, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+	graph.compile();
+
+	const vector<RenderGraphCompiledPass>& compiledPasses = graph.getCompiledPasses();
+	CHECK(compiledPasses.size() == 2);
+	if (compiledPasses.size() != 2) return;
+
+	// Write after the reads of the previous frame: execution dependency only
+	const RenderGraphBarrier* warBarrier = findBarrier(compiledPasses[0], commands);
+	CHECK(warBarrier);
+	if (warBarrier)
+	{
+		CHECK(warBarrier->srcStages == Stage::eDrawIndirect);
+		CHECK(!warBarrier->srcAccess);
+		CHECK(warBarrier->dstStages == Stage::eComputeShader);
+		CHECK(warBarrier->dstAccess == (Access::eShaderRead | Access::eShaderWrite));
+	}
+
+	// Read after write: the compute shader writes made visible to the indirect command reads
+	CHECK(compiledPasses[1].barriers.size() == 1);
+	const RenderGraphBarrier* rawBarrier = findBarrier(compiledPasses[1], commands);
+	CHECK(rawBarrier);
+	if (rawBarrier)
+	{
+		CHECK(rawBarrier->srcStages == Stage::eComputeShader);
+		CHECK(rawBarrier->srcAccess == Access::eShaderWrite);
+		CHECK(rawBarrier->dstStages == Stage::eDrawIndirect);
+		CHECK(rawBarrier->dstAccess == Access::eIndirectCommandRead);
+		CHECK(rawBarrier->oldLayout == Layout::eUndefined && rawBarrier->newLayout == Layout::eUndefined);
+	}
+
+	// The swapchain image waits for the acquire in the render pass external dependency, not in a barrier
+	CHECK(compiledPasses[1].entrySrcStages == Stage::eColorAttachmentOutput);
+	CHECK(compiledPasses[1].entryDstAccess == (Access::eColorAttachmentRead | Access::eColorAttachmentWrite));
+}
+
+/// Reads of the same stages after the first one do not wait again
+static void testReadAfterRead()
+{
+	RenderGraph graph;
+	const uint32_t particles = graph.importBuffer("Particles", getUsageAccess(RenderGraphUsage::StorageReadVertex));
+
+	const uint32_t simulate = graph.addPass("Simulate", RenderGraphPassType::Compute, noRecord);
+	graph.write(simulate, particles, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t sortA = graph.addPass("Sort A", RenderGraphPassType::Compute, noRecord);
+	graph.read(sortA, particles, RenderGraphUsage::StorageReadCompute);
+	graph.setSideEffects(sortA);
+	const uint32_t sortB = graph.addPass("Sort B", RenderGraphPassType::Compute, noRecord);
+	graph.read(sortB, particles, RenderGraphUsage::StorageReadCompute);
+	graph.setSideEffects(sortB);
+	const uint32_t draw = graph.addPass("Draw", RenderGraphPassType::Graphics, noRecord);
+	graph.read(draw, particles, RenderGraphUsage::StorageReadVertex);
+	graph.setSideEffects(draw);
+	graph.compile();
+
+	const vector<RenderGraphCompiledPass>& compiledPasses = graph.getCompiledPasses();
+	CHECK(compiledPasses.size() == 4);
+	if (compiledPasses.size() != 4) return;
+
+	CHECK(compiledPasses[1].barriers.size() == 1);
+	CHECK(compiledPasses[2].barriers.empty());
+
+	// The write is not visible to the vertex shader yet
+	const RenderGraphBarrier* vertexBarrier = findBarrier(compiledPasses[3], particles);
+	CHECK(vertexBarrier);
+	if (vertexBarrier)
+	{
+		CHECK(vertexBarrier->srcStages == Stage::eComputeShader);
+		CHECK(vertexBarrier->srcAccess == Access::eShaderWrite);
+		CHECK(vertexBarrier->dstStages == Stage::eVertexShader);
+		CHECK(vertexBarrier->dstAccess == Access::eShaderRead);
+	}
+}
+
+/// Depth attachment then sampled: a barrier transitions it, the render passes transition the swapchain image
+static void testLayoutTransitions()
+{
+	RenderGraph graph;
+	const uint32_t swapchain = importSwapchain(graph);
+	const uint32_t shadowMap = graph.createImage("Shadow map", vk::Format::eD32Sfloat, EXTENT);
+
+	const uint32_t shadow = graph.addPass("Shadow", RenderGraphPassType::Graphics, noRecord);
+	graph.clear(shadow, shadowMap, RenderGraphUsage::DepthStencilAttachment, vk::ClearValue{});
+	const uint32_t lighting = graph.addPass("Lighting", RenderGraphPassType::Graphics, noRecord);
+	graph.read(lighting, shadowMap, RenderGraphUsage::SampledFragment);
+	graph.clear(lighting, swapchain, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+	graph.compile();
+
+	const vector<RenderGraphCompiledPass>& compiledPasses = graph.getCompiledPasses();
+	CHECK(compiledPasses.size() == 2);
+	if (compiledPasses.size() != 2) return;
+
+	const RenderGraphCompiledPass& shadowPass = compiledPasses[0];
+	CHECK(shadowPass.hasDepthAttachment);
+	CHECK(shadowPass.depthAttachment.loadOp == vk::AttachmentLoadOp::eClear);
+	CHECK(shadowPass.depthAttachment.storeOp == vk::AttachmentStoreOp::eStore);
+	CHECK(shadowPass.depthAttachment.initialLayout == Layout::eUndefined);
+	CHECK(shadowPass.depthAttachment.layout == Layout::eDepthStencilAttachmentOptimal);
+	CHECK(shadowPass.depthAttachment.finalLayout == Layout::eDepthStencilAttachmentOptimal);
+
+	const RenderGraphBarrier* sampleBarrier = findBarrier(compiledPasses[1], shadowMap);
+	CHECK(sampleBarrier);
+	if (sampleBarrier)
+	{
+		CHECK(sampleBarrier->srcStages == (Stage::eEarlyFragmentTests | Stage::eLateFragmentTests));
+		CHECK(sampleBarrier->srcAccess == Access::eDepthStencilAttachmentWrite);
+		CHECK(sampleBarrier->dstStages == Stage::eFragmentShader);
+		CHECK(sampleBarrier->dstAccess == Access::eShaderRead);
+		CHECK(sampleBarrier->oldLayout == Layout::eDepthStencilAttachmentOptimal);
+		CHECK(sampleBarrier->newLayout == Layout::eShaderReadOnlyOptimal);
+	}
+
+	// Presented: the render pass does the final transition, no barrier after the frame
+	const RenderGraphCompiledPass& lightingPass = compiledPasses[1];
+	CHECK(lightingPass.colorAttachments.size() == 1);
+	if (lightingPass.colorAttachments.size() == 1)
+	{
+		CHECK(lightingPass.colorAttachments[0].initialLayout == Layout::eUndefined);
+		CHECK(lightingPass.colorAttachments[0].layout == Layout::eColorAttachmentOptimal);
+		CHECK(lightingPass.colorAttachments[0].finalLayout == Layout::ePresentSrcKHR);
+		CHECK(lightingPass.colorAttachments[0].storeOp == vk::AttachmentStoreOp::eStore);
+	}
+	CHECK(lightingPass.exitDstStages == Stage::eBottomOfPipe);
+	CHECK(graph.getFinalBarriers().empty());
+}
+
+/// Passes whose results are never used are culled, with the passes only they depend on
+static void testCulledPass()
+{
+	RenderGraph graph;
+	const uint32_t swapchain = importSwapchain(graph);
+	const uint32_t histogram = graph.importBuffer("Histogram", getUsageAccess(RenderGraphUsage::StorageReadCompute));
+	const uint32_t debugImage = graph.createImage("Debug view", vk::Format::eR8G8B8A8Unorm, EXTENT);
+
+	const uint32_t clearHistogram = graph.addPass("Clear histogram", RenderGraphPassType::Compute, noRecord);
+	graph.write(clearHistogram, histogram, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t debugView = graph.addPass("Debug view", RenderGraphPassType::Compute, noRecord);
+	graph.read(debugView, histogram, RenderGraphUsage::StorageReadCompute);
+	graph.write(debugView, debugImage, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t draw = graph.addPass("Draw", RenderGraphPassType::Graphics, noRecord);
+	graph.clear(draw, swapchain, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+	graph.compile();
+
+	CHECK(graph.isCulled(debugView));
+	CHECK(graph.isCulled(clearHistogram));
+	CHECK(!graph.isCulled(draw));
+	CHECK(graph.getCompiledPasses().size() == 1);
+	if (graph.getCompiledPasses().size() == 1)
+	{
+		CHECK(graph.getCompiledPasses()[0].pass == draw);
+	}
+
+	// Never used: no memory for it
+	CHECK(graph.getAliasSlot(debugImage) == RenderGraph::NO_ALIAS_SLOT);
+	CHECK(graph.getAliasSlotCount() == 0);
+}
+
+/// A G-buffer read as input attachments: one render pass of two subpasses and a by region dependency
+static void testInputAttachmentSubpasses()
+{
+	RenderGraph graph;
+	const uint32_t swapchain = importSwapchain(graph);
+	const uint32_t albedo = graph.createImage("Albedo", vk::Format::eR8G8B8A8Unorm, EXTENT);
+	const uint32_t depth = graph.createImage("Depth", vk::Format::eD32Sfloat, EXTENT);
+
+	const uint32_t gbuffer = graph.addPass("G-buffer", RenderGraphPassType::Graphics, noRecord);
+	graph.clear(gbuffer, albedo, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+	graph.clear(gbuffer, depth, RenderGraphUsage::DepthStencilAttachment, vk::ClearValue{});
+	const uint32_t lighting = graph.addPass("Lighting", RenderGraphPassType::Graphics, noRecord);
+	graph.read(lighting, albedo, RenderGraphUsage::InputAttachment);
+	graph.read(lighting, depth, RenderGraphUsage::InputAttachment);
+	graph.clear(lighting, swapchain, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+	graph.compile();
+
+	const vector<RenderGraphCompiledPass>& compiledPasses = graph.getCompiledPasses();
+	CHECK(compiledPasses.size() == 2);
+	if (compiledPasses.size() != 2) return;
+
+	const RenderGraphCompiledPass& lightingPass = compiledPasses[1];
+	CHECK(lightingPass.renderPassBegin == 0);
+	CHECK(lightingPass.subpass == 1);
+
+	// Synchronised inside the render pass, no pipeline barrier between the subpasses
+	CHECK(compiledPasses[0].barriers.empty());
+	CHECK(lightingPass.barriers.empty());
+
+	// Both attachments merged in one dependency on subpass 0, local to each pixel
+	CHECK(lightingPass.subpassDependencies.size() == 1);
+	if (lightingPass.subpassDependencies.size() == 1)
+	{
+		const RenderGraphSubpassDependency& dependency = lightingPass.subpassDependencies[0];
+		CHECK(dependency.srcSubpass == 0);
+		CHECK(dependency.srcStages == (Stage::eColorAttachmentOutput | Stage::eEarlyFragmentTests | Stage::eLateFragmentTests));
+		CHECK(dependency.srcAccess == (Access::eColorAttachmentWrite | Access::eDepthStencilAttachmentWrite));
+		CHECK(dependency.dstStages == Stage::eFragmentShader);
+		CHECK(dependency.dstAccess == Access::eInputAttachmentRead);
+		CHECK(dependency.dependencyFlags == vk::DependencyFlagBits::eByRegion);
+	}
+
+	// Read in the subpass, transitioned by the render pass, and never stored
+	CHECK(lightingPass.inputAttachments.size() == 2);
+	for (const RenderGraphAttachment& inputAttachment : lightingPass.inputAttachments)
+	{
+		CHECK(inputAttachment.loadOp == vk::AttachmentLoadOp::eLoad);
+		CHECK(inputAttachment.storeOp == vk::AttachmentStoreOp::eDontCare);
+		CHECK(inputAttachment.layout == Layout::eShaderReadOnlyOptimal);
+	}
+
+	// Alive at the same time
+	CHECK(graph.getAliasSlot(albedo) != graph.getAliasSlot(depth));
+	CHECK(graph.getAliasSlotCount() == 2);
+}
+
+/// Transient images with disjoint lifetimes share a slot, the next tenant waits for the previous one
+static void testTransientAliasSlots()
+{
+	RenderGraph graph;
+	const uint32_t bloomA = graph.createImage("Bloom A", vk::Format::eR16G16B16A16Sfloat, EXTENT);
+	const uint32_t bloomB = graph.createImage("Bloom B", vk::Format::eR16G16B16A16Sfloat, EXTENT);
+	const uint32_t bloomC = graph.createImage("Bloom C", vk::Format::eR16G16B16A16Sfloat, EXTENT);
+
+	const uint32_t pass0 = graph.addPass("Threshold", RenderGraphPassType::Compute, noRecord);
+	graph.write(pass0, bloomA, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t pass1 = graph.addPass("Blur X", RenderGraphPassType::Compute, noRecord);
+	graph.read(pass1, bloomA, RenderGraphUsage::SampledCompute);
+	graph.write(pass1, bloomC, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t pass2 = graph.addPass("Blur Y", RenderGraphPassType::Compute, noRecord);
+	graph.read(pass2, bloomC, RenderGraphUsage::SampledCompute);
+	graph.write(pass2, bloomB, RenderGraphUsage::StorageWriteCompute);
+	const uint32_t pass3 = graph.addPass("Composite", RenderGraphPassType::Compute, noRecord);
+	graph.read(pass3, bloomB, RenderGraphUsage::SampledCompute);
+	graph.setSideEffects(pass3);
+	graph.compile();
+
+	CHECK(graph.getAliasSlotCount() == 2);
+	CHECK(graph.getAliasSlot(bloomA) == graph.getAliasSlot(bloomB));
+	CHECK(graph.getAliasSlot(bloomA) != graph.getAliasSlot(bloomC));
+
+	const vector<RenderGraphCompiledPass>& compiledPasses = graph.getCompiledPasses();
+	CHECK(compiledPasses.size() == 4);
+	if (compiledPasses.size() != 4) return;
+
+	// First tenant: waits for the uses of the slot by the previous frame
+	const RenderGraphBarrier* firstTenant = findBarrier(compiledPasses[0], bloomA);
+	CHECK(firstTenant);
+	if (firstTenant)
+	{
+		CHECK(firstTenant->srcStages == Stage::eComputeShader);
+		CHECK(firstTenant->srcAccess == Access::eShaderWrite);
+		CHECK(firstTenant->oldLayout == Layout::eUndefined);
+		CHECK(firstTenant->newLayout == Layout::eGeneral);
+	}
+
+	// Next tenant: waits for the last read of Bloom A, its garbage content is discarded
+	const RenderGraphBarrier* nextTenant = findBarrier(compiledPasses[2], bloomB);
+	CHECK(nextTenant);
+	if (nextTenant)
+	{
+		CHECK(nextTenant->srcStages == Stage::eComputeShader);
+		CHECK(!nextTenant->srcAccess);
+		CHECK(nextTenant->dstAccess == (Access::eShaderRead | Access::eShaderWrite));
+		CHECK(nextTenant->oldLayout == Layout::eUndefined);
+		CHECK(nextTenant->newLayout == Layout::eGeneral);
+	}
+}
+
+int main()
+{
+	try
+	{
+		testComputeWriteIndirectRead();
+		testReadAfterRead();
+		testLayoutTransitions();
+		testCulledPass();
+		testInputAttachmentSubpasses();
+		testTransientAliasSlots();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (failures)
+	{
+		std::cerr << failures << " render graph checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Render graph tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
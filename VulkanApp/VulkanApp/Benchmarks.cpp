@@ -0,0 +1,319 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+#include "FrustumCulling.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "SceneGraph.h"
+#include "DrawSorting.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+
+/// Average duration of a call to func over the given number of runs, in milliseconds
+template<typename Func>
+static double measureMilliseconds(int runs, Func func)
+{
+	// Warm caches and branch predictors before measuring
+	func();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < runs; ++i)
+	{
+		func();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count() / runs;
+}
+
+void runBenchmarks()
+{
+	benchmarkFrustumCulling();
+	benchmarkMeshSimplification();
+	benchmarkMeshOptimization();
+	benchmarkMeshlets();
+	benchmarkSceneGraph();
+	benchmarkDrawSorting();
+}
+
+void benchmarkFrustumCulling()
+{
+	const size_t objectCount = 1000000;
+	const int runs = 50;
+
+	// Objects scattered in a 2 km cube around the camera, radius from 0.5 to 5 m
+	std::mt19937 generator{ 42 };
+	std::uniform_real_distribution<float> position{ -1000.0f, 1000.0f };
+	std::uniform_real_distribution<float> size{ 0.5f, 5.0f };
+
+	BoundingSpheres spheres;
+	spheres.reserve(objectCount);
+	for (size_t i = 0; i < objectCount; ++i)
+	{
+		spheres.add(glm::vec3{ position(generator), position(generator), position(generator) }, size(generator));
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	Frustum frustum = Frustum::fromMatrix(projection * view);
+
+	printf("Frustum culling, %zu spheres, average of %d runs\n", objectCount, runs);
+
+	vector<uint32_t> visibleIndices;
+	const CullingPath paths[]{ CullingPath::Scalar, CullingPath::SSE, CullingPath::AVX };
+	for (CullingPath path : paths)
+	{
+		if (path > getBestCullingPath())
+		{
+			printf("  %-8s not supported by this CPU\n", getCullingPathName(path));
+			continue;
+		}
+
+		size_t visibleCount = 0;
+		double milliseconds = measureMilliseconds(runs, [&]() {
+			visibleCount = cullSpheres(frustum, spheres, visibleIndices, path);
+		});
+		printf("  %-8s %8.3f ms  (%zu visible)\n", getCullingPathName(path), milliseconds, visibleCount);
+	}
+}
+
+void benchmarkMeshSimplification()
+{
+	// The dense sphere of the scene
+	const MeshData sphere = createSphereMesh(glm::vec3(1.0f), 64, 128);
+	const int runs = 5;
+
+	MeshData cooked;
+	double milliseconds = measureMilliseconds(runs, [&]() {
+		cooked = sphere;
+		buildMeshLods(cooked);
+	});
+
+	printf("Mesh LOD cooking, sphere of %zu triangles, average of %d runs: %.1f ms\n", sphere.indices.size() / 3, runs, milliseconds);
+	for (size_t lod = 0; lod < cooked.lods.size(); ++lod)
+	{
+		// Error in object space, the sphere has a radius of 0.5
+		printf("  LOD %zu  %6zu triangles  error %.5f\n", lod + 1, cooked.lods[lod].indices.size() / 3, cooked.lods[lod].error);
+	}
+}
+
+void benchmarkMeshOptimization()
+{
+	// The dense sphere of the scene, with its triangles shuffled like an imported mesh can be
+	MeshData sphere = createSphereMesh(glm::vec3(1.0f), 64, 128);
+	std::mt19937 generator{ 42 };
+	vector<uint32_t> triangleOrder(sphere.indices.size() / 3);
+	for (uint32_t t = 0; t < triangleOrder.size(); ++t) triangleOrder[t] = t;
+	std::shuffle(triangleOrder.begin(), triangleOrder.end(), generator);
+	vector<uint32_t> shuffled;
+	shuffled.reserve(sphere.indices.size());
+	for (uint32_t t : triangleOrder)
+	{
+		shuffled.insert(shuffled.end(), sphere.indices.begin() + t * 3, sphere.indices.begin() + t * 3 + 3);
+	}
+	sphere.indices = std::move(shuffled);
+	const int runs = 5;
+
+	printf("Mesh optimization, sphere of %zu triangles in random order, FIFO cache of 16, average of %d runs\n",
+		sphere.indices.size() / 3, runs);
+	auto printStatistics = [](const char* step, const MeshData& mesh, double milliseconds)
+	{
+		VertexCacheStatistics statistics = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+		printf("  %-14s ACMR %.3f  ATVR %.3f  %8.3f ms\n", step, statistics.acmr, statistics.atvr, milliseconds);
+	};
+	printStatistics("Imported", sphere, 0.0);
+
+	MeshData optimized;
+	double milliseconds = measureMilliseconds(runs, [&]() {
+		optimized = sphere;
+		optimizeVertexCache(optimized.indices, optimized.vertices.size());
+	});
+	printStatistics("Vertex cache", optimized, milliseconds);
+
+	MeshData overdrawOptimized;
+	milliseconds = measureMilliseconds(runs, [&]() {
+		overdrawOptimized = optimized;
+		optimizeOverdraw(overdrawOptimized.indices, overdrawOptimized.vertices);
+	});
+	printStatistics("Overdraw", overdrawOptimized, milliseconds);
+
+	milliseconds = measureMilliseconds(runs, [&]() {
+		optimized = overdrawOptimized;
+		optimizeVertexFetch(optimized);
+	});
+	printStatistics("Vertex fetch", optimized, milliseconds);
+}
+
+void benchmarkMeshlets()
+{
+	// The dense sphere of the scene, cooked like in the scene
+	MeshData sphere = createSphereMesh(glm::vec3(1.0f), 64, 128);
+	optimizeMesh(sphere);
+	const int runs = 5;
+
+	MeshData cooked;
+	double milliseconds = measureMilliseconds(runs, [&]() {
+		cooked = sphere;
+		buildMeshlets(cooked);
+	});
+
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	for (const MeshletData& meshlet : cooked.meshlets)
+	{
+		vector<uint32_t> vertices = meshlet.indices;
+		std::sort(vertices.begin(), vertices.end());
+		vertexCount += std::unique(vertices.begin(), vertices.end()) - vertices.begin();
+		triangleCount += meshlet.indices.size() / 3;
+	}
+	size_t meshletCount = cooked.meshlets.size();
+	printf("Meshlets, sphere of %zu triangles, average of %d runs: %.2f ms\n", sphere.indices.size() / 3, runs, milliseconds);
+	printf("  %zu meshlets, %.1f vertices and %.1f triangles each\n", meshletCount,
+		static_cast<double>(vertexCount) / meshletCount, static_cast<double>(triangleCount) / meshletCount);
+
+	// Normal cone test from viewpoints around the sphere, same test as meshletcull.comp
+	std::mt19937 generator{ 42 };
+	std::uniform_real_distribution<float> coordinate{ -1.0f, 1.0f };
+	const int viewpointCount = 100;
+	size_t culledTriangles = 0;
+	for (int i = 0; i < viewpointCount; ++i)
+	{
+		glm::vec3 direction{ coordinate(generator), coordinate(generator), coordinate(generator) };
+		glm::vec3 viewpoint = glm::normalize(direction + glm::vec3(0.0f, 0.0f, 0.001f)) * 1.5f;
+		for (const MeshletData& meshlet : cooked.meshlets)
+		{
+			glm::vec3 toCenter = glm::vec3(meshlet.boundingSphere) - viewpoint;
+			if (glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.boundingSphere.w)
+			{
+				culledTriangles += meshlet.indices.size() / 3;
+			}
+		}
+	}
+	printf("  Back facing from 3 radii away, culled by their cone: %.1f%% of the triangles\n",
+		100.0 * culledTriangles / (static_cast<double>(triangleCount) * viewpointCount));
+}
+
+void benchmarkSceneGraph()
+{
+	// A million nodes: a thousand roots, then four children per node, six levels deep
+	const uint32_t nodeCount = 1000000;
+	const uint32_t rootCount = 1000;
+	const int runs = 20;
+
+	SceneGraph sceneGraph;
+	sceneGraph.reserve(nodeCount);
+	vector<uint32_t> roots;
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		float angle = static_cast<float>(i % 360);
+		glm::mat4 localTransform = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		localTransform = glm::rotate(localTransform, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+		uint32_t node = sceneGraph.addNode(localTransform, i < rootCount ? SceneGraph::NO_PARENT : (i - rootCount) / 4);
+		if (i < rootCount) roots.push_back(node);
+	}
+	sceneGraph.updateWorldTransforms();
+
+	JobSystem jobSystem;
+	jobSystem.init();
+
+	printf("Scene graph, %u nodes over %u levels, %u worker threads, average of %d runs\n",
+		nodeCount, sceneGraph.getDepthCount(), jobSystem.getWorkerCount(), runs);
+	// Every root moves: the whole hierarchy, one root in a hundred: a hundredth of it, none: only the flags are read
+	const uint32_t movedRootSteps[]{ 1, 100, 0 };
+	const char* movedRootNames[]{ "All moving", "1% moving", "Static" };
+	for (int i = 0; i < 3; ++i)
+	{
+		auto moveRoots = [&]()
+		{
+			if (movedRootSteps[i] == 0) return;
+			for (uint32_t root = 0; root < rootCount; root += movedRootSteps[i])
+			{
+				sceneGraph.setLocalTransform(roots[root], sceneGraph.getLocalTransform(roots[root]));
+			}
+		};
+		double sequential = measureMilliseconds(runs, [&]() {
+			moveRoots();
+			sceneGraph.updateWorldTransforms();
+		});
+		double parallel = measureMilliseconds(runs, [&]() {
+			moveRoots();
+			sceneGraph.updateWorldTransforms(jobSystem);
+		});
+		printf("  %-11s sequential %8.3f ms  parallel %8.3f ms\n", movedRootNames[i], sequential, parallel);
+	}
+
+	jobSystem.clean();
+}
+
+void benchmarkDrawSorting()
+{
+	// A million draws over 8 pipelines, 256 materials and 64 meshes, anywhere in the depth range
+	const size_t drawCount = 1000000;
+	const int runs = 20;
+
+	std::mt19937 generator{ 42 };
+	std::uniform_int_distribution<uint32_t> pipeline{ 0, 7 };
+	std::uniform_int_distribution<uint32_t> material{ 0, 255 };
+	std::uniform_int_distribution<uint32_t> mesh{ 0, 63 };
+	std::uniform_real_distribution<float> depth{ 0.0f, 1.0f };
+
+	vector<SortedDraw> draws(drawCount);
+	for (size_t i = 0; i < drawCount; ++i)
+	{
+		draws[i].key = makeDrawKey(0, pipeline(generator), material(generator), mesh(generator), depth(generator));
+		draws[i].draw = static_cast<uint32_t>(i);
+	}
+
+	JobSystem jobSystem;
+	jobSystem.init();
+
+	// Each run sorts a fresh copy of the unsorted draws: the copy is part of every measure
+	vector<SortedDraw> sorted;
+	vector<SortedDraw> scratch;
+	double standardSort = measureMilliseconds(runs, [&]() {
+		sorted = draws;
+		std::sort(sorted.begin(), sorted.end(), [](const SortedDraw& a, const SortedDraw& b) { return a.key < b.key; });
+	});
+	double radixSequential = measureMilliseconds(runs, [&]() {
+		sorted = draws;
+		radixSortDraws(sorted, scratch);
+	});
+	double radixParallel = measureMilliseconds(runs, [&]() {
+		sorted = draws;
+		radixSortDraws(sorted, scratch, jobSystem);
+	});
+
+	printf("Draw sorting, %zu draws, %u worker threads, average of %d runs\n", drawCount, jobSystem.getWorkerCount(), runs);
+	printf("  std::sort %8.3f ms  radix sequential %8.3f ms  radix parallel %8.3f ms\n",
+		standardSort, radixSequential, radixParallel);
+
+	// State changes when recording the draws in submission order, then sorted
+	auto countChanges = [](const vector<SortedDraw>& order, uint32_t shift, uint64_t mask)
+	{
+		size_t changes = 0;
+		uint64_t current = UINT64_MAX;
+		for (const SortedDraw& draw : order)
+		{
+			uint64_t state = (draw.key >> shift) & mask;
+			if (state != current) ++changes;
+			current = state;
+		}
+		return changes;
+	};
+	const vector<SortedDraw>* orders[]{ &draws, &sorted };
+	const char* orderNames[]{ "Unsorted:", "Sorted:" };
+	for (int i = 0; i < 2; ++i)
+	{
+		printf("  %-9s %7zu pipeline binds  %7zu material binds  %7zu mesh binds\n", orderNames[i],
+			countChanges(*orders[i], DRAW_KEY_PIPELINE_SHIFT, 0xFF), countChanges(*orders[i], DRAW_KEY_MATERIAL_SHIFT, 0xFFFF),
+			countChanges(*orders[i], DRAW_KEY_MESH_SHIFT, 0xFFFF));
+	}
+
+	jobSystem.clean();
+}
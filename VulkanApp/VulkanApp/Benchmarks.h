@@ -0,0 +1,12 @@
+#pragma once
+
+/// CPU benchmarks for the engine systems that do not need a GPU.
+/// Run them by starting the application with the --benchmark argument.
+void runBenchmarks();
+
+void benchmarkFrustumCulling();
+void benchmarkMeshSimplification();
+void benchmarkMeshOptimization();
+void benchmarkMeshlets();
+void benchmarkSceneGraph();
+void benchmarkDrawSorting();
@@ -0,0 +1,140 @@
+#include "BindlessDescriptors.h"
+
+#include <array>
+#include <algorithm>
+
+
+void BindlessDescriptors::init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t maxTextures, uint32_t maxStorageBuffers)
+{
+	// Update-after-bind descriptors have their own, separate limits. The per-stage ones count every set of a
+	// pipeline layout: the other sets (lighting, shadows, G-buffer...) keep their share.
+	auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+	const vk::PhysicalDeviceDescriptorIndexingProperties& indexingProperties = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+	auto perStageBudget = [](uint32_t limit) { return limit > RESERVED_PER_STAGE_DESCRIPTORS ? limit - RESERVED_PER_STAGE_DESCRIPTORS : 0; };
+	textureSlots.capacity = std::min({ maxTextures,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+		perStageBudget(indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages) });
+	storageBufferSlots.capacity = std::min({ maxStorageBuffers,
+		indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		perStageBudget(indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers) });
+	// Both arrays are visible to every stage: together they must also fit the per-stage resource limit
+	uint32_t resourceBudget = perStageBudget(indexingProperties.maxPerStageUpdateAfterBindResources);
+	if (textureSlots.capacity + storageBufferSlots.capacity > resourceBudget)
+	{
+		storageBufferSlots.capacity = std::min(storageBufferSlots.capacity, resourceBudget / 4);
+		textureSlots.capacity = std::min(textureSlots.capacity, resourceBudget - storageBufferSlots.capacity);
+	}
+	if (textureSlots.capacity == 0 || storageBufferSlots.capacity == 0)
+	{
+		throw std::runtime_error("The device descriptor limits are too low for the bindless set");
+	}
+
+	//v Layout =======================================================
+	std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = TEXTURE_BINDING;
+	bindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	bindings[0].descriptorCount = textureSlots.capacity;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eAll;
+	bindings[1].binding = STORAGE_BUFFER_BINDING;
+	bindings[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+	bindings[1].descriptorCount = storageBufferSlots.capacity;
+	bindings[1].stageFlags = vk::ShaderStageFlagBits::eAll;
+
+	// Partially bound: slots nobody registered yet are never read, they do not need to be valid.
+	// Update after bind + unused while pending: registering a resource does not have to wait
+	// for the frames in flight, which do not use the new slot.
+	vk::DescriptorBindingFlags bindingFlag = vk::DescriptorBindingFlagBits::ePartiallyBound
+		| vk::DescriptorBindingFlagBits::eUpdateAfterBind
+		| vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+	std::array<vk::DescriptorBindingFlags, 2> bindingFlags{ bindingFlag, bindingFlag };
+
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+	bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+	vk::DescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	layoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+	descriptorSetLayout = device.createDescriptorSetLayout(layoutCreateInfo);
+	//^ Layout =======================================================
+	//v Pool and set =================================================
+	std::array<vk::DescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+	poolSizes[0].descriptorCount = textureSlots.capacity;
+	poolSizes[1].type = vk::DescriptorType::eStorageBuffer;
+	poolSizes[1].descriptorCount = storageBufferSlots.capacity;
+
+	vk::DescriptorPoolCreateInfo poolCreateInfo{};
+	poolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	descriptorPool = device.createDescriptorPool(poolCreateInfo);
+
+	vk::DescriptorSetAllocateInfo setAllocInfo{};
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &descriptorSetLayout;
+	descriptorSet = device.allocateDescriptorSets(setAllocInfo)[0];
+	//^ Pool and set =================================================
+}
+
+void BindlessDescriptors::clean(vk::Device device)
+{
+	device.destroyDescriptorPool(descriptorPool);
+	device.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+uint32_t BindlessDescriptors::registerTexture(vk::Device device, vk::ImageView imageView, vk::Sampler sampler, vk::ImageLayout imageLayout)
+{
+	uint32_t index = textureSlots.allocate();
+
+	vk::DescriptorImageInfo imageInfo{ sampler, imageView, imageLayout };
+
+	vk::WriteDescriptorSet write{};
+	write.dstSet = descriptorSet;
+	write.dstBinding = TEXTURE_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+	device.updateDescriptorSets(write, nullptr);
+
+	return index;
+}
+
+uint32_t BindlessDescriptors::registerStorageBuffer(vk::Device device, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+	uint32_t index = storageBufferSlots.allocate();
+
+	vk::DescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+	vk::WriteDescriptorSet write{};
+	write.dstSet = descriptorSet;
+	write.dstBinding = STORAGE_BUFFER_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorType = vk::DescriptorType::eStorageBuffer;
+	write.descriptorCount = 1;
+	write.pBufferInfo = &bufferInfo;
+	device.updateDescriptorSets(write, nullptr);
+
+	return index;
+}
+
+uint32_t BindlessDescriptors::SlotAllocator::allocate()
+{
+	if (!freeSlots.empty())
+	{
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	if (nextUnused >= capacity)
+	{
+		throw std::runtime_error("Bindless descriptor array is full");
+	}
+	return nextUnused++;
+}
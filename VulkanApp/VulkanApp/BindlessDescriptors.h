@@ -0,0 +1,60 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+
+
+/// One descriptor set holding every texture and storage buffer of the scene in two large
+/// arrays (descriptor indexing, core in Vulkan 1.2). Resources are registered once and get
+/// a stable index, which shaders use to pick them: the set is bound once for the whole frame
+/// instead of once per draw.
+/// Layout: binding 0 = sampler2D textures[], binding 1 = storage buffers[], both update-after-bind
+/// and partially bound, so slots can be filled while the set is bound and unused ones stay empty.
+class BindlessDescriptors
+{
+public:
+	/// Capacities are clamped to the device update-after-bind limits, minus RESERVED_PER_STAGE_DESCRIPTORS
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t maxTextures, uint32_t maxStorageBuffers);
+	void clean(vk::Device device);
+
+	/// Returns the index of the texture in the textures array. It never moves until released.
+	uint32_t registerTexture(vk::Device device, vk::ImageView imageView, vk::Sampler sampler,
+							 vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	/// Returns the index of the buffer in the storage buffers array. It never moves until released.
+	uint32_t registerStorageBuffer(vk::Device device, vk::Buffer buffer,
+								   vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+
+	/// Give the index back, to be reused by the next registration.
+	/// No frame in flight may still be reading the resource.
+	void releaseTexture(uint32_t index) { textureSlots.release(index); }
+	void releaseStorageBuffer(uint32_t index) { storageBufferSlots.release(index); }
+
+	vk::DescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+	vk::DescriptorSet getDescriptorSet() const { return descriptorSet; }
+
+	// Must match the bindless set declared in the shaders
+	static const uint32_t TEXTURE_BINDING{ 0 };
+	static const uint32_t STORAGE_BUFFER_BINDING{ 1 };
+	static const uint32_t INVALID_INDEX{ 0xFFFFFFFF };
+	/// Per-stage descriptors left to the other sets of the pipeline layouts using the bindless set
+	static const uint32_t RESERVED_PER_STAGE_DESCRIPTORS{ 64 };
+
+private:
+	/// Hands out array indices: released ones first, then never used ones
+	struct SlotAllocator
+	{
+		uint32_t capacity{ 0 };
+		uint32_t nextUnused{ 0 };
+		vector<uint32_t> freeSlots;
+
+		uint32_t allocate();
+		void release(uint32_t slot) { freeSlots.push_back(slot); }
+	};
+
+	SlotAllocator textureSlots;
+	SlotAllocator storageBufferSlots;
+
+	vk::DescriptorSetLayout descriptorSetLayout;
+	// Update-after-bind sets need a pool created with the matching flag, hence a dedicated pool
+	vk::DescriptorPool descriptorPool;
+	vk::DescriptorSet descriptorSet;
+};
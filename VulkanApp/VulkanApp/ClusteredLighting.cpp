@@ -0,0 +1,149 @@
+#include "ClusteredLighting.h"
+
+#include <array>
+
+
+void ClusteredLighting::init(vk::PhysicalDevice physicalDevice, vk::Device device, DescriptorLayoutCache& layoutCache)
+{
+	createBuffers(physicalDevice, device);
+	createDescriptorSetLayout(device, layoutCache);
+	createPipeline(device);
+}
+
+void ClusteredLighting::clean(vk::Device device)
+{
+	device.destroyPipeline(binningPipeline);
+	device.destroyPipelineLayout(pipelineLayout);
+	device.destroyBuffer(clusterLightBuffer);
+	device.freeMemory(clusterLightBufferMemory);
+	device.destroyBuffer(clusterCountBuffer);
+	device.freeMemory(clusterCountBufferMemory);
+}
+
+void ClusteredLighting::update(FrameRingBuffer& frameRingBuffer, const vector<GpuPointLight>& lights,
+							   const vector<GpuSpotLight>& spotLights, const glm::mat4& view, const glm::mat4& projection,
+							   vk::Extent2D extent, float zNear, float zFar, const glm::vec3& ambient)
+{
+	ClusterUbo clusterUbo{};
+	clusterUbo.view = view;
+	clusterUbo.inverseProjection = glm::inverse(projection);
+	clusterUbo.ambient = glm::vec4(ambient, 0.0f);
+	clusterUbo.screenSize = glm::vec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+	// Whole pixels, rounded up so that the tiles cover the screen
+	clusterUbo.clusterSize = glm::vec2(static_cast<float>((extent.width + CLUSTER_X - 1) / CLUSTER_X),
+		static_cast<float>((extent.height + CLUSTER_Y - 1) / CLUSTER_Y));
+	clusterUbo.zNear = zNear;
+	clusterUbo.zFar = zFar;
+	clusterUbo.lightCount = lights.size() < MAX_LIGHTS ? static_cast<uint32_t>(lights.size()) : MAX_LIGHTS;
+	clusterUbo.spotLightCount = spotLights.size() < MAX_SPOT_LIGHTS ? static_cast<uint32_t>(spotLights.size()) : MAX_SPOT_LIGHTS;
+	clusterUniformOffset = frameRingBuffer.pushUniform(clusterUbo);
+
+	// The descriptor ranges are MAX_LIGHTS and MAX_SPOT_LIGHTS lights: always allocate that much, only write the used ones
+	RingAllocation allocation = frameRingBuffer.allocateStorage(sizeof(GpuPointLight) * MAX_LIGHTS);
+	memcpy(allocation.data, lights.data(), sizeof(GpuPointLight) * clusterUbo.lightCount);
+	lightsOffset = allocation.offset;
+	RingAllocation spotAllocation = frameRingBuffer.allocateStorage(sizeof(GpuSpotLight) * MAX_SPOT_LIGHTS);
+	memcpy(spotAllocation.data, spotLights.data(), sizeof(GpuSpotLight) * clusterUbo.spotLightCount);
+	spotLightsOffset = spotAllocation.offset;
+}
+
+void ClusteredLighting::recordBinning(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, binningPipeline);
+	std::array<uint32_t, 3> dynamicOffsets{ clusterUniformOffset, lightsOffset, spotLightsOffset };
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, dynamicOffsets);
+	// One workgroup per cluster, every cluster count is written: no reset needed
+	commandBuffer.dispatch(CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+}
+
+void ClusteredLighting::bindLighting(vk::CommandBuffer commandBuffer, vk::PipelineLayout forwardPipelineLayout, uint32_t setIndex)
+{
+	std::array<uint32_t, 3> dynamicOffsets{ clusterUniformOffset, lightsOffset, spotLightsOffset };
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, forwardPipelineLayout, setIndex, descriptorSet, dynamicOffsets);
+}
+
+void ClusteredLighting::createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device)
+{
+	// Light lists: written by the binning, read by the fragment shader. Never touched by the CPU.
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * CLUSTER_COUNT, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &clusterCountBuffer, &clusterCountBufferMemory);
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &clusterLightBuffer, &clusterLightBufferMemory);
+}
+
+void ClusteredLighting::createDescriptorSetLayout(vk::Device device, DescriptorLayoutCache& layoutCache)
+{
+	vector<vk::DescriptorSetLayoutBinding> bindings(5);
+	// Binding 0: camera and light counts, 1: point lights, 4: spot lights, all in the frame ring buffer
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+	// Binding 2: light count per cluster, 3: light indices per cluster
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = vk::DescriptorType::eStorageBuffer;
+	bindings[3].binding = 3;
+	bindings[3].descriptorType = vk::DescriptorType::eStorageBuffer;
+	bindings[4].binding = 4;
+	bindings[4].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+	for (vk::DescriptorSetLayoutBinding& binding : bindings)
+	{
+		binding.descriptorCount = 1;
+		binding.stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment;
+	}
+
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+}
+
+void ClusteredLighting::createDescriptorSet(vk::Device device, const FrameRingBuffer& frameRingBuffer,
+											DescriptorAllocator& descriptorAllocator)
+{
+	descriptorSet = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+	std::array<vk::DescriptorBufferInfo, 5> bufferInfos{};
+	// Offset 0 here, the dynamic offsets given when binding select the frame's data
+	bufferInfos[0] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(ClusterUbo) };
+	bufferInfos[1] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(GpuPointLight) * MAX_LIGHTS };
+	bufferInfos[2] = vk::DescriptorBufferInfo{ clusterCountBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[3] = vk::DescriptorBufferInfo{ clusterLightBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[4] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(GpuSpotLight) * MAX_SPOT_LIGHTS };
+	std::array<vk::DescriptorType, 5> types{ vk::DescriptorType::eUniformBufferDynamic, vk::DescriptorType::eStorageBufferDynamic,
+		vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBufferDynamic };
+
+	std::array<vk::WriteDescriptorSet, 5> writes{};
+	for (uint32_t binding = 0; binding < writes.size(); ++binding)
+	{
+		writes[binding].dstSet = descriptorSet;
+		writes[binding].dstBinding = binding;
+		writes[binding].dstArrayElement = 0;
+		writes[binding].descriptorType = types[binding];
+		writes[binding].descriptorCount = 1;
+		writes[binding].pBufferInfo = &bufferInfos[binding];
+	}
+	device.updateDescriptorSets(writes, nullptr);
+}
+
+void ClusteredLighting::createPipeline(vk::Device device)
+{
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+	vk::ShaderModule computeShaderModule = createShaderModule(device, readShaderFile("shaders/cluster.spv"));
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+	pipelineCreateInfo.stage.module = computeShaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = pipelineLayout;
+
+	auto result = device.createComputePipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Could not create the light binning compute pipeline");
+	}
+	binningPipeline = result.value;
+
+	device.destroyShaderModule(computeShaderModule);
+}
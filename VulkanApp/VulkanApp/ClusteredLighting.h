@@ -0,0 +1,89 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+#include "Lights.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+
+
+/// Clustered forward lighting: the view frustum is cut in CLUSTER_X x CLUSTER_Y screen tiles and
+/// CLUSTER_Z exponential depth slices. Each frame a compute pass tests every light against every cluster
+/// and writes the list of lights reaching it. The forward fragment shader (clustered.frag) then only
+/// loops over the lights of its own cluster, so thousands of lights cost what the few nearby ones do.
+/// Point lights are binned by their sphere, spot lights by their cone. Light lists hold point light
+/// indices, then spot light indices offset by the point light count.
+/// The light lists are shared by frames in flight: the render graph orders the binning after the
+/// previous frame's draws.
+class ClusteredLighting
+{
+public:
+	/// Buffers, set layout and binning pipeline. The set layout is needed by the forward pipeline layout,
+	/// before the descriptor allocators exist: the set itself is created by createDescriptorSet.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, DescriptorLayoutCache& layoutCache);
+	void createDescriptorSet(vk::Device device, const FrameRingBuffer& frameRingBuffer, DescriptorAllocator& descriptorAllocator);
+	void clean(vk::Device device);
+
+	/// Write the frame's lights and camera in the current frame's ring region.
+	/// zNear and zFar must be those of the projection.
+	void update(FrameRingBuffer& frameRingBuffer, const vector<GpuPointLight>& lights, const vector<GpuSpotLight>& spotLights,
+				const glm::mat4& view, const glm::mat4& projection, vk::Extent2D extent, float zNear, float zFar,
+				const glm::vec3& ambient);
+	/// Fill the light lists. Must be recorded outside of a render pass.
+	void recordBinning(vk::CommandBuffer commandBuffer);
+	/// Bind the light lists for the forward pipelines, at setIndex of their layout
+	void bindLighting(vk::CommandBuffer commandBuffer, vk::PipelineLayout forwardPipelineLayout, uint32_t setIndex);
+
+	/// Read by the binning compute shader and the forward fragment shader
+	vk::DescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+	/// Written by the binning, read by the forward draws
+	vk::Buffer getClusterCountBuffer() const { return clusterCountBuffer; }
+	vk::Buffer getClusterLightBuffer() const { return clusterLightBuffer; }
+
+	// Must match cluster.comp and clustered.frag
+	static const uint32_t CLUSTER_X{ 16 };
+	static const uint32_t CLUSTER_Y{ 9 };
+	static const uint32_t CLUSTER_Z{ 24 };
+	static const uint32_t CLUSTER_COUNT{ CLUSTER_X * CLUSTER_Y * CLUSTER_Z };
+	/// Lights past it in a cluster are dropped
+	static const uint32_t MAX_LIGHTS_PER_CLUSTER{ 256 };
+	/// More lights are ignored
+	static const uint32_t MAX_LIGHTS{ 16384 };
+	static const uint32_t MAX_SPOT_LIGHTS{ 1024 };
+
+private:
+	// Matches the Clusters uniform block of cluster.comp and clustered.frag
+	struct ClusterUbo
+	{
+		glm::mat4 view;
+		glm::mat4 inverseProjection;
+		glm::vec4 ambient;
+		glm::vec2 screenSize;
+		glm::vec2 clusterSize;
+		float zNear;
+		float zFar;
+		uint32_t lightCount;
+		uint32_t spotLightCount;
+	};
+	uint32_t clusterUniformOffset{ 0 }; // Dynamic offsets of this frame's data
+	uint32_t lightsOffset{ 0 };
+	uint32_t spotLightsOffset{ 0 };
+
+	// -- BUFFERS --
+	vk::Buffer clusterCountBuffer; // One uint32_t per cluster
+	vk::DeviceMemory clusterCountBufferMemory;
+	vk::Buffer clusterLightBuffer; // MAX_LIGHTS_PER_CLUSTER light indices per cluster
+	vk::DeviceMemory clusterLightBufferMemory;
+
+	// -- DESCRIPTORS --
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	// Per-frame data is selected by dynamic offsets: one long-lived set, for compute and graphics alike
+	vk::DescriptorSet descriptorSet;
+
+	// -- PIPELINE --
+	vk::PipelineLayout pipelineLayout;
+	vk::Pipeline binningPipeline;
+
+	void createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device);
+	void createDescriptorSetLayout(vk::Device device, DescriptorLayoutCache& layoutCache);
+	void createPipeline(vk::Device device);
+};
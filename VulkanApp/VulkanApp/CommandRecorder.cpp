@@ -0,0 +1,175 @@
+#include "CommandRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+void CommandRecorder::begin(vk::CommandBuffer commandBufferP)
+{
+	commandBuffer = commandBufferP;
+	statistics = Statistics{};
+	invalidate();
+}
+
+void CommandRecorder::invalidate()
+{
+	pipeline = nullptr;
+	descriptorSets.fill(BoundDescriptorSet{});
+	vertexBuffers.fill(BoundVertexBuffer{});
+	indexBuffer = nullptr;
+	viewportKnown = false;
+	scissorKnown = false;
+	invalidatePushConstants();
+}
+
+void CommandRecorder::invalidatePushConstants()
+{
+	pushLayout = nullptr;
+	pushStages = vk::ShaderStageFlags{};
+	pushedBegin = 0;
+	pushedEnd = 0;
+}
+
+void CommandRecorder::bindPipeline(vk::Pipeline pipelineP)
+{
+	if (!issue(pipelineP != pipeline)) return;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineP);
+	pipeline = pipelineP;
+	viewportKnown = false;
+	scissorKnown = false;
+	++statistics.pipelineBinds;
+}
+
+void CommandRecorder::bindDescriptorSet(vk::PipelineLayout layout, uint32_t setIndex, vk::DescriptorSet descriptorSet,
+										vk::ArrayProxy<const uint32_t> dynamicOffsets)
+{
+	bool tracked = setIndex < MAX_DESCRIPTOR_SETS && dynamicOffsets.size() <= MAX_DYNAMIC_OFFSETS;
+	bool changed = true;
+	if (tracked)
+	{
+		const BoundDescriptorSet& bound = descriptorSets[setIndex];
+		changed = bound.layout != layout || bound.descriptorSet != descriptorSet
+			|| bound.dynamicOffsetCount != dynamicOffsets.size()
+			|| !std::equal(dynamicOffsets.begin(), dynamicOffsets.end(), bound.dynamicOffsets.begin());
+	}
+	if (!issue(changed)) return;
+
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, setIndex, descriptorSet, dynamicOffsets);
+
+	// Sets bound with another layout may have been disturbed, only the ones of the same layout are kept
+	for (BoundDescriptorSet& bound : descriptorSets)
+	{
+		if (bound.layout != layout) bound = BoundDescriptorSet{};
+	}
+	if (tracked)
+	{
+		BoundDescriptorSet& bound = descriptorSets[setIndex];
+		bound.layout = layout;
+		bound.descriptorSet = descriptorSet;
+		bound.dynamicOffsetCount = dynamicOffsets.size();
+		std::copy(dynamicOffsets.begin(), dynamicOffsets.end(), bound.dynamicOffsets.begin());
+	}
+}
+
+void CommandRecorder::bindVertexBuffer(uint32_t binding, vk::Buffer buffer, vk::DeviceSize offset)
+{
+	bool tracked = binding < MAX_VERTEX_BINDINGS;
+	if (!issue(!tracked || vertexBuffers[binding].buffer != buffer || vertexBuffers[binding].offset != offset)) return;
+
+	commandBuffer.bindVertexBuffers(binding, buffer, offset);
+	if (tracked)
+	{
+		vertexBuffers[binding] = BoundVertexBuffer{ buffer, offset };
+	}
+}
+
+void CommandRecorder::bindIndexBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::IndexType indexTypeP)
+{
+	if (!issue(buffer != indexBuffer || offset != indexOffset || indexTypeP != indexType)) return;
+
+	commandBuffer.bindIndexBuffer(buffer, offset, indexTypeP);
+	indexBuffer = buffer;
+	indexOffset = offset;
+	indexType = indexTypeP;
+}
+
+void CommandRecorder::setViewport(const vk::Viewport& viewportP)
+{
+	if (!issue(!viewportKnown || viewportP != viewport)) return;
+
+	commandBuffer.setViewport(0, viewportP);
+	viewport = viewportP;
+	viewportKnown = true;
+}
+
+void CommandRecorder::setScissor(const vk::Rect2D& scissorP)
+{
+	if (!issue(!scissorKnown || scissorP != scissor)) return;
+
+	commandBuffer.setScissor(0, scissorP);
+	scissor = scissorP;
+	scissorKnown = true;
+}
+
+void CommandRecorder::pushConstants(vk::PipelineLayout layout, vk::ShaderStageFlags stages, uint32_t offset, uint32_t size,
+									const void* data)
+{
+	const uint32_t end = offset + size;
+	bool tracked = end <= MAX_PUSH_CONSTANTS_SIZE;
+	bool sameBlock = layout == pushLayout && stages == pushStages;
+	bool changed = !tracked || !sameBlock || offset < pushedBegin || end > pushedEnd
+		|| std::memcmp(pushedData.data() + offset, data, size) != 0;
+	if (!issue(changed)) return;
+
+	commandBuffer.pushConstants(layout, stages, offset, size, data);
+	++statistics.pushConstants;
+
+	if (!tracked)
+	{
+		invalidatePushConstants();
+		return;
+	}
+	// Known bytes grow while pushes of a block touch them, they start again otherwise
+	if (sameBlock && offset <= pushedEnd && end >= pushedBegin)
+	{
+		pushedBegin = offset < pushedBegin ? offset : pushedBegin;
+		pushedEnd = end > pushedEnd ? end : pushedEnd;
+	}
+	else
+	{
+		pushLayout = layout;
+		pushStages = stages;
+		pushedBegin = offset;
+		pushedEnd = end;
+	}
+	std::memcpy(pushedData.data() + offset, data, size);
+}
+
+void CommandRecorder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	issue(true);
+	commandBuffer.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+	++statistics.draws;
+}
+
+void CommandRecorder::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+								  uint32_t firstInstance)
+{
+	issue(true);
+	commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	++statistics.draws;
+}
+
+bool CommandRecorder::issue(bool changed)
+{
+	if (changed)
+	{
+		++statistics.issuedCommands;
+	}
+	else
+	{
+		++statistics.elidedCommands;
+	}
+	return changed;
+}
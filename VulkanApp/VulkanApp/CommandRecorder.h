@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+
+#include "VulkanUtilities.h"
+
+
+/// Thin wrapper recording graphics commands in a command buffer. It remembers the pipeline, descriptor sets,
+/// vertex and index buffers, viewport, scissor and push constants it has set, and drops the calls that would
+/// set them again to the same values: the driver encodes fewer commands.
+/// State set around the recorder, directly on the command buffer, is not seen: see invalidate.
+class CommandRecorder
+{
+public:
+	/// Record in a begun command buffer. Nothing is known to be bound, the statistics restart: once per frame.
+	void begin(vk::CommandBuffer commandBufferP);
+	/// Forget every state, after commands recorded directly may have changed any of them
+	void invalidate();
+	/// Forget the push constants: pushes of other layouts, e.g. by compute passes, may have disturbed them
+	void invalidatePushConstants();
+
+	/// For the commands the recorder does not filter (indirect draws, clears...)
+	vk::CommandBuffer getCommandBuffer() const { return commandBuffer; }
+
+	/// Graphics pipeline. The viewport and scissor are forgotten on a change: the static state of a pipeline replaces them.
+	void bindPipeline(vk::Pipeline pipeline);
+	/// One graphics descriptor set. A set bound with another layout than the others makes them forgotten.
+	void bindDescriptorSet(vk::PipelineLayout layout, uint32_t setIndex, vk::DescriptorSet descriptorSet,
+						   vk::ArrayProxy<const uint32_t> dynamicOffsets = nullptr);
+	void bindVertexBuffer(uint32_t binding, vk::Buffer buffer, vk::DeviceSize offset);
+	void bindIndexBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::IndexType indexType);
+	void setViewport(const vk::Viewport& viewport);
+	void setScissor(const vk::Rect2D& scissor);
+	/// Dropped when every byte pushed is already there, pushed with the same layout and stages
+	void pushConstants(vk::PipelineLayout layout, vk::ShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+	// Never filtered, counted
+	void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+	/// Commands given to the recorder since begin
+	struct Statistics
+	{
+		uint32_t issuedCommands; // Recorded in the command buffer
+		uint32_t elidedCommands; // Dropped, they changed nothing
+		// Part of the issued commands
+		uint32_t pipelineBinds;
+		uint32_t pushConstants;
+		uint32_t draws;
+	};
+	const Statistics& getStatistics() const { return statistics; }
+
+	// Larger indices, offset counts and push constants are always issued
+	static const uint32_t MAX_DESCRIPTOR_SETS{ 4 };
+	static const uint32_t MAX_DYNAMIC_OFFSETS{ 4 };
+	static const uint32_t MAX_VERTEX_BINDINGS{ 4 };
+	static const uint32_t MAX_PUSH_CONSTANTS_SIZE{ 256 };
+
+private:
+	vk::CommandBuffer commandBuffer;
+	Statistics statistics{};
+
+	// -- BOUND STATE --
+	// Null handles and unset flags: unknown, the next call is issued
+	vk::Pipeline pipeline;
+	struct BoundDescriptorSet
+	{
+		vk::PipelineLayout layout;
+		vk::DescriptorSet descriptorSet;
+		uint32_t dynamicOffsetCount;
+		std::array<uint32_t, MAX_DYNAMIC_OFFSETS> dynamicOffsets;
+	};
+	std::array<BoundDescriptorSet, MAX_DESCRIPTOR_SETS> descriptorSets{};
+	struct BoundVertexBuffer
+	{
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+	};
+	std::array<BoundVertexBuffer, MAX_VERTEX_BINDINGS> vertexBuffers{};
+	vk::Buffer indexBuffer;
+	vk::DeviceSize indexOffset{ 0 };
+	vk::IndexType indexType{ vk::IndexType::eUint32 };
+	bool viewportKnown{ false };
+	vk::Viewport viewport;
+	bool scissorKnown{ false };
+	vk::Rect2D scissor;
+	// Push constants: bytes [pushedBegin, pushedEnd) of pushedData are known, pushed with pushLayout and pushStages
+	vk::PipelineLayout pushLayout;
+	vk::ShaderStageFlags pushStages;
+	uint32_t pushedBegin{ 0 };
+	uint32_t pushedEnd{ 0 };
+	std::array<char, MAX_PUSH_CONSTANTS_SIZE> pushedData{};
+
+	/// Count a command as issued or elided, return whether it must be recorded
+	bool issue(bool changed);
+};
@@ -0,0 +1,173 @@
+#include "DeferredLighting.h"
+
+
+void DeferredLighting::init(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent,
+							const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+							DescriptorAllocator& descriptorAllocator, vk::ImageView albedoView, vk::ImageView normalView,
+							vk::ImageView depthView)
+{
+	createDescriptors(device, frameRingBuffer, layoutCache, descriptorAllocator, { albedoView, normalView, depthView });
+	createPipeline(device, renderPass, subpass, extent);
+}
+
+void DeferredLighting::clean(vk::Device device)
+{
+	device.destroyPipeline(lightingPipeline);
+	device.destroyPipelineLayout(pipelineLayout);
+}
+
+void DeferredLighting::update(FrameRingBuffer& frameRingBuffer, const vector<GpuPointLight>& lights,
+							  const glm::mat4& viewProjection, const glm::vec3& ambient)
+{
+	LightingUbo lightingUbo{};
+	lightingUbo.inverseViewProjection = glm::inverse(viewProjection);
+	lightingUbo.ambient = glm::vec4(ambient, 0.0f);
+	lightingUbo.lightCount = lights.size() < MAX_LIGHTS ? static_cast<uint32_t>(lights.size()) : MAX_LIGHTS;
+	lightingUniformOffset = frameRingBuffer.pushUniform(lightingUbo);
+
+	// The descriptor range is MAX_LIGHTS lights: always allocate that much, only write the used ones
+	RingAllocation allocation = frameRingBuffer.allocateStorage(sizeof(GpuPointLight) * MAX_LIGHTS);
+	memcpy(allocation.data, lights.data(), sizeof(GpuPointLight) * lightingUbo.lightCount);
+	lightsOffset = allocation.offset;
+}
+
+void DeferredLighting::recordLighting(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, lightingPipeline);
+	std::array<uint32_t, 2> dynamicOffsets{ lightingUniformOffset, lightsOffset };
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, dynamicOffsets);
+	// Full screen triangle, generated in fullscreen.vert
+	commandBuffer.draw(3, 1, 0, 0);
+}
+
+void DeferredLighting::createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer,
+										 DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+										 const std::array<vk::ImageView, 3>& gbufferViews)
+{
+	//v Layout =======================================================
+	vector<vk::DescriptorSetLayoutBinding> bindings(5);
+	// Bindings 0 to 2: albedo, normal and depth input attachments
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = vk::DescriptorType::eInputAttachment;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = vk::ShaderStageFlagBits::eFragment;
+	}
+	// Binding 3: camera and light count, 4: lights, both in the frame ring buffer
+	bindings[3].binding = 3;
+	bindings[3].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	bindings[3].descriptorCount = 1;
+	bindings[3].stageFlags = vk::ShaderStageFlagBits::eFragment;
+	bindings[4].binding = 4;
+	bindings[4].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+	bindings[4].descriptorCount = 1;
+	bindings[4].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+	//^ Layout =======================================================
+	//v Set ==========================================================
+	// The G-buffer images never change, the per-frame data is selected by dynamic offsets: one set is enough
+	descriptorSet = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+	std::array<vk::DescriptorImageInfo, 3> imageInfos{};
+	for (uint32_t i = 0; i < imageInfos.size(); ++i)
+	{
+		imageInfos[i] = vk::DescriptorImageInfo{ vk::Sampler(), gbufferViews[i], vk::ImageLayout::eShaderReadOnlyOptimal };
+	}
+	std::array<vk::DescriptorBufferInfo, 2> bufferInfos{};
+	bufferInfos[0] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(LightingUbo) };
+	bufferInfos[1] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(GpuPointLight) * MAX_LIGHTS };
+
+	std::array<vk::WriteDescriptorSet, 5> writes{};
+	for (uint32_t binding = 0; binding < writes.size(); ++binding)
+	{
+		writes[binding].dstSet = descriptorSet;
+		writes[binding].dstBinding = binding;
+		writes[binding].dstArrayElement = 0;
+		writes[binding].descriptorType = bindings[binding].descriptorType;
+		writes[binding].descriptorCount = 1;
+		if (binding < 3)
+		{
+			writes[binding].pImageInfo = &imageInfos[binding];
+		}
+		else
+		{
+			writes[binding].pBufferInfo = &bufferInfos[binding - 3];
+		}
+	}
+	device.updateDescriptorSets(writes, nullptr);
+	//^ Set ==========================================================
+}
+
+void DeferredLighting::createPipeline(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent)
+{
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+	vk::ShaderModule vertexShaderModule = createShaderModule(device, readShaderFile("shaders/fullscreen.spv"));
+	vk::ShaderModule fragmentShaderModule = createShaderModule(device, readShaderFile("shaders/lighting.spv"));
+	std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{};
+	shaderStages[0].stage = vk::ShaderStageFlagBits::eVertex;
+	shaderStages[0].module = vertexShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].stage = vk::ShaderStageFlagBits::eFragment;
+	shaderStages[1].module = fragmentShaderModule;
+	shaderStages[1].pName = "main";
+
+	// No vertex buffer, the triangle comes from gl_VertexIndex
+	vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
+	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo{};
+	inputAssemblyCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
+
+	vk::Viewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+	vk::Rect2D scissor{ vk::Offset2D{ 0, 0 }, extent };
+	vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = &viewport;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = &scissor;
+
+	vk::PipelineRasterizationStateCreateInfo rasterizerCreateInfo{};
+	rasterizerCreateInfo.polygonMode = vk::PolygonMode::eFill;
+	rasterizerCreateInfo.lineWidth = 1.0f;
+	rasterizerCreateInfo.cullMode = vk::CullModeFlagBits::eNone;
+
+	// The G-buffer is single sampled, see VulkanRenderer::createRenderGraph
+	vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo{};
+	multisamplingCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+	// Every pixel written once, no depth attachment in this subpass
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+		| vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+	vk::PipelineColorBlendStateCreateInfo colorBlendingCreateInfo{};
+	colorBlendingCreateInfo.attachmentCount = 1;
+	colorBlendingCreateInfo.pAttachments = &colorBlendAttachment;
+
+	vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineCreateInfo.pStages = shaderStages.data();
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.renderPass = renderPass;
+	pipelineCreateInfo.subpass = subpass;
+
+	auto result = device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Could not create the deferred lighting pipeline");
+	}
+	lightingPipeline = result.value;
+
+	device.destroyShaderModule(fragmentShaderModule);
+	device.destroyShaderModule(vertexShaderModule);
+}
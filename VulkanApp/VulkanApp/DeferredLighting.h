@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+
+#include "VulkanUtilities.h"
+#include "Lights.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+
+
+/// Lighting subpass of the deferred path: a full screen triangle reads the G-buffer of the previous
+/// subpass as input attachments, rebuilds the world position from the depth, and adds every point light
+/// reaching the pixel. Its cost depends on the pixels and the lights, not on the objects drawn.
+class DeferredLighting
+{
+public:
+	/// The views are the G-buffer attachments, renderPass and subpass those of the lighting pass
+	void init(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent, const FrameRingBuffer& frameRingBuffer,
+			  DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+			  vk::ImageView albedoView, vk::ImageView normalView, vk::ImageView depthView);
+	void clean(vk::Device device);
+
+	/// Write the frame's lights and camera in the current frame's ring region
+	void update(FrameRingBuffer& frameRingBuffer, const vector<GpuPointLight>& lights,
+				const glm::mat4& viewProjection, const glm::vec3& ambient);
+	/// Inside the lighting subpass
+	void recordLighting(vk::CommandBuffer commandBuffer);
+
+	/// More lights are ignored
+	static const uint32_t MAX_LIGHTS{ 4096 };
+
+private:
+	// Matches the Lighting uniform block of lighting.frag
+	struct LightingUbo
+	{
+		glm::mat4 inverseViewProjection;
+		glm::vec4 ambient;
+		uint32_t lightCount;
+	};
+	uint32_t lightingUniformOffset{ 0 }; // Dynamic offsets of this frame's data
+	uint32_t lightsOffset{ 0 };
+
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	vk::DescriptorSet descriptorSet;
+	vk::PipelineLayout pipelineLayout;
+	vk::Pipeline lightingPipeline;
+
+	void createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+						   DescriptorAllocator& descriptorAllocator, const std::array<vk::ImageView, 3>& gbufferViews);
+	void createPipeline(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent);
+};
@@ -0,0 +1,231 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+
+
+/// Largest power of two not above value
+static uint32_t getPreviousPowerOfTwo(uint32_t value)
+{
+	uint32_t power = 1;
+	while (power * 2 <= value) power *= 2;
+	return power;
+}
+
+void DepthPyramid::init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+						vk::CommandPool transferCommandPool, vk::Extent2D depthExtentP)
+{
+	depthExtent = depthExtentP;
+	extent = vk::Extent2D{ getPreviousPowerOfTwo(depthExtent.width), getPreviousPowerOfTwo(depthExtent.height) };
+	levelCount = 1;
+	while ((extent.width >> levelCount) > 0 || (extent.height >> levelCount) > 0) ++levelCount;
+
+	createImage(physicalDevice, device, transferQueue, transferCommandPool);
+	createSamplers(device);
+}
+
+void DepthPyramid::clean(vk::Device device)
+{
+	device.destroyPipeline(reductionPipeline);
+	device.destroyPipelineLayout(pipelineLayout);
+	device.destroySampler(depthSampler);
+	device.destroyImageView(depthView);
+	device.destroySampler(pyramidSampler);
+	for (vk::ImageView levelView : levelViews)
+	{
+		device.destroyImageView(levelView);
+	}
+	device.destroyImageView(pyramidView);
+	device.destroyImage(pyramidImage);
+	device.freeMemory(pyramidImageMemory);
+}
+
+void DepthPyramid::recordBuild(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, reductionPipeline);
+
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		ReductionPushConstants pushConstants{};
+		vk::Extent2D destination{ std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+		vk::Extent2D source = level == 0 ? depthExtent
+			: vk::Extent2D{ std::max(extent.width >> (level - 1), 1u), std::max(extent.height >> (level - 1), 1u) };
+		pushConstants.sourceSize = glm::ivec2(source.width, source.height);
+		pushConstants.destinationSize = glm::ivec2(destination.width, destination.height);
+		pushConstants.fromDepth = level == 0 ? 1 : 0;
+		pushConstants.sampleCount = depthSampleCount;
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, levelDescriptorSets[level], nullptr);
+		commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(ReductionPushConstants), &pushConstants);
+		commandBuffer.dispatch((destination.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+			(destination.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+		// The next level reads this one. Levels of the same image: inside the pass, not a render graph barrier.
+		if (level + 1 == levelCount) break;
+		vk::ImageMemoryBarrier barrier{};
+		barrier.oldLayout = vk::ImageLayout::eGeneral;
+		barrier.newLayout = vk::ImageLayout::eGeneral;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramidImage;
+		barrier.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 };
+		barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+}
+
+void DepthPyramid::createImage(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+							   vk::CommandPool transferCommandPool)
+{
+	vk::ImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.imageType = vk::ImageType::e2D;
+	imageCreateInfo.extent = vk::Extent3D{ extent.width, extent.height, 1 };
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = PYRAMID_FORMAT;
+	imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+	imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+	// Written by the reduction, sampled by the culling, cleared once
+	imageCreateInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+	imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+	pyramidImage = device.createImage(imageCreateInfo);
+
+	vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(pyramidImage);
+	vk::MemoryAllocateInfo memoryAllocInfo{};
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,
+		vk::MemoryPropertyFlagBits::eDeviceLocal);
+	pyramidImageMemory = device.allocateMemory(memoryAllocInfo);
+	device.bindImageMemory(pyramidImage, pyramidImageMemory, 0);
+
+	pyramidView = createImageView(device, pyramidImage, PYRAMID_FORMAT, vk::ImageAspectFlagBits::eColor, levelCount);
+	vk::ImageViewCreateInfo viewCreateInfo{};
+	viewCreateInfo.image = pyramidImage;
+	viewCreateInfo.viewType = vk::ImageViewType::e2D;
+	viewCreateInfo.format = PYRAMID_FORMAT;
+	levelViews.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		viewCreateInfo.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 };
+		levelViews[level] = device.createImageView(viewCreateInfo);
+	}
+
+	// Far plane everywhere: the first frame's culling occludes nothing
+	vk::CommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+	vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	vk::ImageMemoryBarrier barrier{};
+	barrier.oldLayout = vk::ImageLayout::eUndefined;
+	barrier.newLayout = vk::ImageLayout::eGeneral;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramidImage;
+	barrier.subresourceRange = range;
+	barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(), nullptr, nullptr, barrier);
+	commandBuffer.clearColorImage(pyramidImage, vk::ImageLayout::eGeneral, vk::ClearColorValue{ std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f } }, range);
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, commandBuffer);
+}
+
+void DepthPyramid::createSamplers(vk::Device device)
+{
+	// Exact texels of a level, no blending with the closer depths around them
+	vk::SamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.magFilter = vk::Filter::eNearest;
+	samplerCreateInfo.minFilter = vk::Filter::eNearest;
+	samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = static_cast<float>(levelCount - 1);
+	pyramidSampler = device.createSampler(samplerCreateInfo);
+
+	// The depth buffer is only read with texelFetch
+	samplerCreateInfo.maxLod = 0.0f;
+	depthSampler = device.createSampler(samplerCreateInfo);
+}
+
+void DepthPyramid::createDescriptors(vk::Device device, DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+									 vk::Image depthImage, vk::Format depthFormat, vk::SampleCountFlagBits depthSamples)
+{
+	depthSampleCount = static_cast<uint32_t>(depthSamples);
+	// The depth buffer may have a stencil aspect, which cannot be sampled with it
+	depthView = createImageView(device, depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
+
+	//v Layout =======================================================
+	vector<vk::DescriptorSetLayoutBinding> bindings(3);
+	// Binding 0: depth buffer, 1: previous level, 2: level written
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = vk::DescriptorType::eStorageImage;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = vk::DescriptorType::eStorageImage;
+	for (vk::DescriptorSetLayoutBinding& binding : bindings)
+	{
+		binding.descriptorCount = 1;
+		binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+	}
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+	//^ Layout =======================================================
+	//v Sets =========================================================
+	levelDescriptorSets.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		levelDescriptorSets[level] = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+		// Level 0 does not read a previous level: any valid view will do
+		vk::DescriptorImageInfo depthInfo{ depthSampler, depthView, vk::ImageLayout::eShaderReadOnlyOptimal };
+		vk::DescriptorImageInfo sourceInfo{ vk::Sampler(), levelViews[level == 0 ? 0 : level - 1], vk::ImageLayout::eGeneral };
+		vk::DescriptorImageInfo destinationInfo{ vk::Sampler(), levelViews[level], vk::ImageLayout::eGeneral };
+		std::array<vk::DescriptorImageInfo*, 3> imageInfos{ &depthInfo, &sourceInfo, &destinationInfo };
+
+		std::array<vk::WriteDescriptorSet, 3> writes{};
+		for (uint32_t binding = 0; binding < writes.size(); ++binding)
+		{
+			writes[binding].dstSet = levelDescriptorSets[level];
+			writes[binding].dstBinding = binding;
+			writes[binding].dstArrayElement = 0;
+			writes[binding].descriptorType = bindings[binding].descriptorType;
+			writes[binding].descriptorCount = 1;
+			writes[binding].pImageInfo = imageInfos[binding];
+		}
+		device.updateDescriptorSets(writes, nullptr);
+	}
+	//^ Sets =========================================================
+
+	createPipeline(device, depthSamples);
+}
+
+void DepthPyramid::createPipeline(vk::Device device, vk::SampleCountFlagBits depthSamples)
+{
+	vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(ReductionPushConstants) };
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+	// Multisampled depth is a different sampler type in GLSL: same shader, compiled twice
+	const char* shaderFile = depthSamples == vk::SampleCountFlagBits::e1 ? "shaders/depthpyramid.spv" : "shaders/depthpyramid_ms.spv";
+	vk::ShaderModule computeShaderModule = createShaderModule(device, readShaderFile(shaderFile));
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+	pipelineCreateInfo.stage.module = computeShaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = pipelineLayout;
+
+	auto result = device.createComputePipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Could not create the depth pyramid compute pipeline");
+	}
+	reductionPipeline = result.value;
+
+	device.destroyShaderModule(computeShaderModule);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+
+#include "VulkanUtilities.h"
+#include "DescriptorAllocator.h"
+
+
+/// Hierarchical depth (Hi-Z): a mip chain of the depth buffer where each texel holds the farthest depth
+/// of the texels it covers. A bounding rectangle of a few texels at the right level tells whether
+/// everything under it is closer than an object: the object is then occluded.
+/// Level 0 is the largest power of two size fitting in the depth buffer, so each level is exactly half of
+/// the previous one. Each level is reduced by a compute dispatch from the previous one.
+/// The image outlives frames: culling reads what the previous frame built.
+class DepthPyramid
+{
+public:
+	/// Image, views and samplers, in the state the render graph expects at the start of a frame:
+	/// general layout, every texel at the far plane (nothing occluded before the first build).
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+			  vk::Extent2D depthExtent);
+	/// Reduction pipeline and one set per level, reading depthImage, a depth buffer of the given sample count
+	void createDescriptors(vk::Device device, DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+						   vk::Image depthImage, vk::Format depthFormat, vk::SampleCountFlagBits depthSamples);
+	void clean(vk::Device device);
+
+	/// Reduce the depth buffer into every level. Depth sampled by compute, pyramid in general layout.
+	void recordBuild(vk::CommandBuffer commandBuffer);
+
+	vk::Image getImage() const { return pyramidImage; }
+	/// Every level, sampled with getSampler (nearest, clamped) in general layout
+	vk::ImageView getView() const { return pyramidView; }
+	vk::Sampler getSampler() const { return pyramidSampler; }
+	vk::Extent2D getExtent() const { return extent; }
+
+	static const vk::Format PYRAMID_FORMAT{ vk::Format::eR32Sfloat };
+	static const uint32_t WORKGROUP_SIZE{ 8 }; // Must match local_size_x and y in depthpyramid.comp
+
+private:
+	vk::Extent2D extent; // Of level 0
+	vk::Extent2D depthExtent;
+	uint32_t levelCount{ 0 };
+
+	// Matches the Reduction push constant block of depthpyramid.comp
+	struct ReductionPushConstants
+	{
+		glm::ivec2 sourceSize;
+		glm::ivec2 destinationSize;
+		uint32_t fromDepth; // Level 0 reads the depth buffer, the others the previous level
+		uint32_t sampleCount;
+	};
+	uint32_t depthSampleCount{ 1 };
+
+	// -- IMAGES --
+	vk::Image pyramidImage;
+	vk::DeviceMemory pyramidImageMemory;
+	vk::ImageView pyramidView;
+	vector<vk::ImageView> levelViews; // Storage views, one per level
+	vk::Sampler pyramidSampler;
+	vk::ImageView depthView; // Depth aspect only, to sample the depth buffer
+	vk::Sampler depthSampler;
+
+	// -- DESCRIPTORS --
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	vector<vk::DescriptorSet> levelDescriptorSets; // Source and destination of each level
+
+	// -- PIPELINE --
+	vk::PipelineLayout pipelineLayout;
+	vk::Pipeline reductionPipeline;
+
+	void createImage(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool);
+	void createSamplers(vk::Device device);
+	void createPipeline(vk::Device device, vk::SampleCountFlagBits depthSamples);
+};
@@ -0,0 +1,177 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+
+//v Descriptor allocator =========================================
+void DescriptorAllocator::init(vk::Device device, uint32_t initialSetsPerPool, const vector<PoolSizeRatio>& poolRatios)
+{
+	ratios = poolRatios;
+	setsPerPool = initialSetsPerPool;
+
+	readyPools.push_back(createPool(device, setsPerPool));
+}
+
+void DescriptorAllocator::clean(vk::Device device)
+{
+	for (vk::DescriptorPool pool : readyPools)
+	{
+		device.destroyDescriptorPool(pool);
+	}
+	for (vk::DescriptorPool pool : fullPools)
+	{
+		device.destroyDescriptorPool(pool);
+	}
+	readyPools.clear();
+	fullPools.clear();
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(vk::Device device, vk::DescriptorSetLayout layout)
+{
+	vk::DescriptorSetAllocateInfo setAllocInfo{};
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	vk::DescriptorSet descriptorSet;
+	while (true)
+	{
+		bool freshPool = readyPools.empty();
+		setAllocInfo.descriptorPool = getPool(device);
+
+		// Pointer version of allocateDescriptorSets: returns the result instead of throwing,
+		// running out of pool memory is expected here
+		vk::Result result = device.allocateDescriptorSets(&setAllocInfo, &descriptorSet);
+		if (result == vk::Result::eSuccess) break;
+
+		// A brand new pool that cannot hold the set never will: the ratios are wrong for this layout
+		if (freshPool || (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool))
+		{
+			throw std::runtime_error("Failed to allocate a descriptor set");
+		}
+
+		// This pool is done until the next reset, try the next one
+		fullPools.push_back(readyPools.back());
+		readyPools.pop_back();
+	}
+
+	++allocatedSetCount;
+	return descriptorSet;
+}
+
+void DescriptorAllocator::reset(vk::Device device)
+{
+	// Resetting a pool frees all of its sets at once, way cheaper than freeing them one by one
+	for (vk::DescriptorPool pool : readyPools)
+	{
+		device.resetDescriptorPool(pool);
+	}
+	for (vk::DescriptorPool pool : fullPools)
+	{
+		device.resetDescriptorPool(pool);
+		readyPools.push_back(pool);
+	}
+	fullPools.clear();
+	allocatedSetCount = 0;
+}
+
+vk::DescriptorPool DescriptorAllocator::getPool(vk::Device device)
+{
+	if (!readyPools.empty())
+	{
+		return readyPools.back();
+	}
+
+	// Every pool is full: grow, so that a busy allocator ends up needing few pools
+	uint32_t grownSetsPerPool = static_cast<uint32_t>(setsPerPool * GROWTH_FACTOR);
+	setsPerPool = grownSetsPerPool < MAX_SETS_PER_POOL ? grownSetsPerPool : MAX_SETS_PER_POOL;
+	readyPools.push_back(createPool(device, setsPerPool));
+	return readyPools.back();
+}
+
+vk::DescriptorPool DescriptorAllocator::createPool(vk::Device device, uint32_t setCount)
+{
+	vector<vk::DescriptorPoolSize> poolSizes;
+	for (const PoolSizeRatio& ratio : ratios)
+	{
+		vk::DescriptorPoolSize poolSize{};
+		poolSize.type = ratio.type;
+		poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount));
+		poolSizes.push_back(poolSize);
+	}
+
+	vk::DescriptorPoolCreateInfo poolCreateInfo{};
+	poolCreateInfo.maxSets = setCount;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	return device.createDescriptorPool(poolCreateInfo);
+}
+//^ Descriptor allocator =========================================
+//v Layout cache =================================================
+vk::DescriptorSetLayout DescriptorLayoutCache::createLayout(vk::Device device, const vector<vk::DescriptorSetLayoutBinding>& bindings,
+															vk::DescriptorSetLayoutCreateFlags flags)
+{
+	LayoutKey key{ bindings, flags };
+	// Same bindings declared in a different order are the same layout
+	std::sort(key.bindings.begin(), key.bindings.end(),
+		[](const vk::DescriptorSetLayoutBinding& a, const vk::DescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+	auto cachedLayout = layouts.find(key);
+	if (cachedLayout != layouts.end())
+	{
+		return cachedLayout->second;
+	}
+
+	vk::DescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.flags = flags;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+	layoutCreateInfo.pBindings = key.bindings.data();
+
+	vk::DescriptorSetLayout layout = device.createDescriptorSetLayout(layoutCreateInfo);
+	layouts[key] = layout;
+	return layout;
+}
+
+void DescriptorLayoutCache::clean(vk::Device device)
+{
+	for (auto& layout : layouts)
+	{
+		device.destroyDescriptorSetLayout(layout.second);
+	}
+	layouts.clear();
+}
+
+bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+{
+	if (flags != other.flags || bindings.size() != other.bindings.size()) return false;
+
+	for (size_t i = 0; i < bindings.size(); ++i)
+	{
+		if (bindings[i].binding != other.bindings[i].binding
+			|| bindings[i].descriptorType != other.bindings[i].descriptorType
+			|| bindings[i].descriptorCount != other.bindings[i].descriptorCount
+			|| bindings[i].stageFlags != other.bindings[i].stageFlags
+			|| bindings[i].pImmutableSamplers != other.bindings[i].pImmutableSamplers)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+{
+	size_t hash = std::hash<uint32_t>()(static_cast<uint32_t>(key.flags));
+	for (const vk::DescriptorSetLayoutBinding& binding : key.bindings)
+	{
+		// Pack the binding in 64 bits, then mix it in (boost::hash_combine)
+		uint64_t packed = static_cast<uint64_t>(binding.binding)
+			| static_cast<uint64_t>(binding.descriptorType) << 8
+			| static_cast<uint64_t>(binding.descriptorCount) << 16
+			| static_cast<uint64_t>(static_cast<uint32_t>(binding.stageFlags)) << 40;
+		hash ^= std::hash<uint64_t>()(packed) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+	return hash;
+}
+//^ Layout cache =================================================
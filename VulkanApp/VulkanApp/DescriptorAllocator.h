@@ -0,0 +1,74 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "VulkanUtilities.h"
+
+
+/// How many descriptors of a type a pool holds, per set it can allocate
+struct PoolSizeRatio
+{
+	vk::DescriptorType type;
+	float ratio;
+};
+
+/// Allocates descriptor sets from a list of pools that grows on demand.
+/// When the current pool is out of memory, a new one is created, bigger by GROWTH_FACTOR.
+/// reset() gives every set back at once and keeps the pools for the next use,
+/// which makes it suited to per-frame sets: one allocator per frame in flight.
+class DescriptorAllocator
+{
+public:
+	void init(vk::Device device, uint32_t initialSetsPerPool, const vector<PoolSizeRatio>& poolRatios);
+	void clean(vk::Device device);
+
+	vk::DescriptorSet allocate(vk::Device device, vk::DescriptorSetLayout layout);
+	/// Free every set allocated so far. The GPU must be done with them.
+	void reset(vk::Device device);
+
+	uint32_t getPoolCount() const { return static_cast<uint32_t>(readyPools.size() + fullPools.size()); }
+	uint32_t getAllocatedSetCount() const { return allocatedSetCount; }
+
+	static constexpr float GROWTH_FACTOR{ 1.5f };
+	static const uint32_t MAX_SETS_PER_POOL{ 4096 };
+
+private:
+	vector<PoolSizeRatio> ratios;
+	uint32_t setsPerPool{ 0 }; // Size of the next pool to create
+	uint32_t allocatedSetCount{ 0 };
+
+	vector<vk::DescriptorPool> readyPools; // May still have room
+	vector<vk::DescriptorPool> fullPools; // Failed an allocation, skipped until the next reset
+
+	vk::DescriptorPool getPool(vk::Device device);
+	vk::DescriptorPool createPool(vk::Device device, uint32_t setCount);
+};
+
+/// Deduplicates descriptor set layouts: asking twice for the same bindings returns the same
+/// layout. Sets are compatible when their layouts are identical, so sharing them also lets
+/// long-lived sets be reused by every pipeline declaring the same bindings.
+class DescriptorLayoutCache
+{
+public:
+	vk::DescriptorSetLayout createLayout(vk::Device device, const vector<vk::DescriptorSetLayoutBinding>& bindings,
+										 vk::DescriptorSetLayoutCreateFlags flags = vk::DescriptorSetLayoutCreateFlags());
+	void clean(vk::Device device);
+
+	uint32_t getLayoutCount() const { return static_cast<uint32_t>(layouts.size()); }
+
+private:
+	struct LayoutKey
+	{
+		vector<vk::DescriptorSetLayoutBinding> bindings; // Sorted by binding number
+		vk::DescriptorSetLayoutCreateFlags flags;
+
+		bool operator==(const LayoutKey& other) const;
+	};
+
+	struct LayoutKeyHash
+	{
+		size_t operator()(const LayoutKey& key) const;
+	};
+
+	std::unordered_map<LayoutKey, vk::DescriptorSetLayout, LayoutKeyHash> layouts;
+};
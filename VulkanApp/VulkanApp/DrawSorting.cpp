@@ -0,0 +1,136 @@
+#include "DrawSorting.h"
+
+#include <algorithm>
+#include <array>
+
+
+// Digits of 8 bits: 8 passes for a 64-bit key, a count table of 256 that stays in the L1 cache
+static const uint32_t RADIX_BITS = 8;
+static const uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+static const uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+// Fewer draws are not worth a job
+static const size_t MIN_CHUNK_SIZE = 16384;
+
+uint64_t makeDrawKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+	const uint64_t depthMax = (1ull << DRAW_KEY_DEPTH_BITS) - 1;
+	float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+	uint64_t quantizedDepth = static_cast<uint64_t>(clampedDepth * static_cast<float>(depthMax));
+
+	// Each field masked to its width
+	return static_cast<uint64_t>(pass & 0xF) << DRAW_KEY_PASS_SHIFT
+		| static_cast<uint64_t>(pipeline & 0xFF) << DRAW_KEY_PIPELINE_SHIFT
+		| static_cast<uint64_t>(material & 0xFFFF) << DRAW_KEY_MATERIAL_SHIFT
+		| static_cast<uint64_t>(mesh & 0xFFFF) << DRAW_KEY_MESH_SHIFT
+		| quantizedDepth;
+}
+
+/// forEachChunk(body) calls body(chunk) for every chunk, possibly in parallel, and returns once all are done
+template<typename ForEachChunk>
+static void radixSort(vector<SortedDraw>& draws, vector<SortedDraw>& scratch, size_t chunkCount, ForEachChunk forEachChunk)
+{
+	typedef std::array<size_t, RADIX_SIZE> DigitCounts;
+
+	const size_t drawCount = draws.size();
+	scratch.resize(drawCount);
+	const size_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+	// Count of each digit in each chunk for every pass, then where the chunk writes its first draw of each digit
+	vector<std::array<DigitCounts, RADIX_PASSES>> chunkCounts(chunkCount);
+
+	auto countDigits = [&](size_t chunk, uint32_t firstPass, uint32_t lastPass)
+	{
+		for (uint32_t pass = firstPass; pass <= lastPass; ++pass)
+		{
+			chunkCounts[chunk][pass].fill(0);
+		}
+		size_t end = std::min(drawCount, (chunk + 1) * chunkSize);
+		for (size_t i = chunk * chunkSize; i < end; ++i)
+		{
+			uint64_t key = draws[i].key;
+			for (uint32_t pass = firstPass; pass <= lastPass; ++pass)
+			{
+				++chunkCounts[chunk][pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+			}
+		}
+	};
+
+	// -- COUNT --
+	// Every pass in one read. Passes where all the keys share a digit would not move anything.
+	forEachChunk([&](size_t chunk) { countDigits(chunk, 0, RADIX_PASSES - 1); });
+	bool passNeeded[RADIX_PASSES];
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		passNeeded[pass] = true;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			size_t digitCount = 0;
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				digitCount += chunkCounts[chunk][pass][digit];
+			}
+			if (digitCount == drawCount) passNeeded[pass] = false;
+		}
+	}
+
+	// Scattering moves draws from one chunk to another: chunk counts of the later passes no longer hold.
+	// A single chunk covers every draw, its counts always hold.
+	bool countsHold = true;
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		if (!passNeeded[pass]) continue;
+
+		if (!countsHold)
+		{
+			forEachChunk([&](size_t chunk) { countDigits(chunk, pass, pass); });
+		}
+
+		// -- OFFSETS --
+		// Digit by digit, chunk by chunk: chunks keep their order inside a digit, the sort stays stable
+		size_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				size_t count = chunkCounts[chunk][pass][digit];
+				chunkCounts[chunk][pass][digit] = offset;
+				offset += count;
+			}
+		}
+
+		// -- SCATTER --
+		const uint32_t shift = pass * RADIX_BITS;
+		forEachChunk([&](size_t chunk)
+		{
+			DigitCounts& offsets = chunkCounts[chunk][pass];
+			size_t end = std::min(drawCount, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; ++i)
+			{
+				scratch[offsets[(draws[i].key >> shift) & (RADIX_SIZE - 1)]++] = draws[i];
+			}
+		});
+		draws.swap(scratch);
+		countsHold = chunkCount == 1;
+	}
+}
+
+void radixSortDraws(vector<SortedDraw>& draws, vector<SortedDraw>& scratch)
+{
+	if (draws.size() < 2) return;
+
+	radixSort(draws, scratch, 1, [](const std::function<void(size_t)>& body) { body(0); });
+}
+
+void radixSortDraws(vector<SortedDraw>& draws, vector<SortedDraw>& scratch, JobSystem& jobSystem)
+{
+	if (draws.size() < 2) return;
+
+	// One chunk per thread, the calling one included, unless that makes them too small
+	size_t chunkCount = std::min<size_t>(jobSystem.getWorkerCount() + 1, (draws.size() + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE);
+	radixSort(draws, scratch, chunkCount, [&](const std::function<void(size_t)>& body)
+	{
+		jobSystem.parallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t chunk = begin; chunk < end; ++chunk) body(chunk);
+		});
+	});
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "JobSystem.h"
+
+using std::vector;
+
+
+// Draw keys, most significant bits first: sorted keys group draws by pass, then pipeline, then material,
+// then mesh, each group front to back.
+// 63..60 pass | 59..52 pipeline | 51..36 material | 35..20 mesh | 19..0 depth
+const uint32_t DRAW_KEY_DEPTH_BITS = 20;
+const uint32_t DRAW_KEY_MESH_SHIFT = 20;
+const uint32_t DRAW_KEY_MATERIAL_SHIFT = 36;
+const uint32_t DRAW_KEY_PIPELINE_SHIFT = 52;
+const uint32_t DRAW_KEY_PASS_SHIFT = 60;
+
+/// depth: from 0 at the camera to 1 at the far plane, farther is clamped.
+/// Values wider than their field are truncated: draws then sort less well, they still draw right.
+uint64_t makeDrawKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+/// Key of a draw, and where the draw is in the caller's lists
+struct SortedDraw
+{
+	uint64_t key;
+	uint32_t draw;
+};
+
+/// Least significant digit radix sort of the keys, 8 bits per pass, stable: equal keys keep their order.
+/// The digits of every pass are counted in one read, passes where every key has the same digit (e.g. a single
+/// pass or pipeline) are skipped.
+/// scratch is resized to the draws, and kept from one frame to the next to reuse its capacity.
+void radixSortDraws(vector<SortedDraw>& draws, vector<SortedDraw>& scratch);
+/// Same, each pass counting and scattering chunks of draws on the job system
+void radixSortDraws(vector<SortedDraw>& draws, vector<SortedDraw>& scratch, JobSystem& jobSystem);
+
+// Under this many draws, the sequential sort is done before the jobs would be handed out
+const size_t DRAW_SORT_PARALLEL_THRESHOLD = 32768;
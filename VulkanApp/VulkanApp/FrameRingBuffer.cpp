@@ -0,0 +1,56 @@
+#include "FrameRingBuffer.h"
+
+
+/// Round value up to a multiple of alignment, which must be a power of two (always true for Vulkan limits)
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void FrameRingBuffer::init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize frameRegionSizeP, uint32_t framesInFlight)
+{
+	vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+	uniformAlignment = limits.minUniformBufferOffsetAlignment;
+	storageAlignment = limits.minStorageBufferOffsetAlignment;
+
+	// Each region starts aligned for any kind of allocation
+	frameRegionSize = alignUp(frameRegionSizeP, std::max(uniformAlignment, storageAlignment));
+	vk::DeviceSize bufferSize = frameRegionSize * framesInFlight;
+
+	createBuffer(physicalDevice, device, bufferSize,
+		vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		&buffer, &bufferMemory);
+
+	// Mapped for the whole lifetime of the buffer: no map/unmap per frame, and coherent
+	// memory means writes are visible to the GPU at the next submission without flushes
+	mappedData = static_cast<uint8_t*>(device.mapMemory(bufferMemory, 0, bufferSize));
+}
+
+void FrameRingBuffer::clean(vk::Device device)
+{
+	device.unmapMemory(bufferMemory);
+	device.destroyBuffer(buffer);
+	device.freeMemory(bufferMemory);
+}
+
+void FrameRingBuffer::beginFrame(uint32_t frame)
+{
+	regionBegin = frameRegionSize * frame;
+	head = regionBegin;
+}
+
+RingAllocation FrameRingBuffer::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	vk::DeviceSize offset = alignUp(head, alignment);
+	if (offset + size > regionBegin + frameRegionSize)
+	{
+		throw std::runtime_error("Frame ring buffer region is full, increase its size");
+	}
+	head = offset + size;
+
+	RingAllocation allocation{};
+	allocation.data = mappedData + offset;
+	allocation.offset = static_cast<uint32_t>(offset);
+	return allocation;
+}
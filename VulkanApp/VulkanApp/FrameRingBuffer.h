@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+
+
+/// Sub-allocation of a FrameRingBuffer, valid until the same frame comes around again
+struct RingAllocation
+{
+	void* data; // Where to write, in the persistently mapped memory
+	uint32_t offset; // From the start of the ring buffer, usable as a dynamic offset
+};
+
+/// Linear allocator for data rewritten every frame (uniforms, instances...).
+/// One persistently mapped, host coherent buffer is split into one region per frame
+/// in flight. Allocating is a pointer bump inside the current frame's region, and the
+/// region is reset when its frame starts again, once its fence has been waited on.
+/// Uniforms are bound as dynamic uniform buffers, with the allocation offset as dynamic offset.
+class FrameRingBuffer
+{
+public:
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize frameRegionSize, uint32_t framesInFlight);
+	void clean(vk::Device device);
+
+	/// Start allocating from the frame's region, forgetting what it held.
+	/// The GPU must be done with that frame.
+	void beginFrame(uint32_t frame);
+
+	RingAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+	/// Aligned to minUniformBufferOffsetAlignment, so the offset can be used as a dynamic offset
+	RingAllocation allocateUniform(vk::DeviceSize size) { return allocate(size, uniformAlignment); }
+	RingAllocation allocateStorage(vk::DeviceSize size) { return allocate(size, storageAlignment); }
+
+	/// Copy a uniform block in the ring and return its dynamic offset
+	template<typename T>
+	uint32_t pushUniform(const T& uniform)
+	{
+		RingAllocation allocation = allocateUniform(sizeof(T));
+		memcpy(allocation.data, &uniform, sizeof(T));
+		return allocation.offset;
+	}
+
+	vk::Buffer getBuffer() const { return buffer; }
+	/// Bytes allocated so far in the current frame
+	vk::DeviceSize getFrameUsedSize() const { return head - regionBegin; }
+
+private:
+	vk::Buffer buffer;
+	vk::DeviceMemory bufferMemory;
+	uint8_t* mappedData{ nullptr };
+
+	vk::DeviceSize frameRegionSize{ 0 };
+	vk::DeviceSize regionBegin{ 0 };
+	vk::DeviceSize head{ 0 }; // Next free byte, from the start of the buffer
+
+	vk::DeviceSize uniformAlignment{ 1 };
+	vk::DeviceSize storageAlignment{ 1 };
+};
@@ -0,0 +1,239 @@
+#include "FrustumCulling.h"
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC accepts AVX intrinsics in any function, whatever the /arch flag
+#define CULLING_TARGET_AVX
+#else
+// GCC and Clang need to be told that this function alone may use AVX
+#define CULLING_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+
+//v Frustum ======================================================
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+{
+	// GLM is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row0{ viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0] };
+	glm::vec4 row1{ viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1] };
+	glm::vec4 row2{ viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2] };
+	glm::vec4 row3{ viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3] };
+
+	Frustum frustum{};
+	frustum.planes[0] = row3 + row0; // Left
+	frustum.planes[1] = row3 - row0; // Right
+	frustum.planes[2] = row3 + row1; // Bottom
+	frustum.planes[3] = row3 - row1; // Top
+	frustum.planes[4] = row2;        // Near, depth goes from 0 to 1 in Vulkan
+	frustum.planes[5] = row3 - row2; // Far
+
+	// Normalize so that plane distances are in world units, comparable to radii
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+//^ Frustum ======================================================
+//v Bounding spheres =============================================
+uint32_t BoundingSpheres::add(const glm::vec3& center, float sphereRadius)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	radius.push_back(sphereRadius);
+
+	return static_cast<uint32_t>(radius.size() - 1);
+}
+
+void BoundingSpheres::set(uint32_t index, const glm::vec3& center, float sphereRadius)
+{
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	radius[index] = sphereRadius;
+}
+
+void BoundingSpheres::reserve(size_t count)
+{
+	centerX.reserve(count);
+	centerY.reserve(count);
+	centerZ.reserve(count);
+	radius.reserve(count);
+}
+
+void BoundingSpheres::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+}
+//^ Bounding spheres =============================================
+//v Culling implementations ======================================
+// Each implementation writes into a buffer already sized for every sphere,
+// so that the hot loops never reallocate. Visible indices are appended without
+// branches: the index is always written, the count only moves when visible.
+
+static size_t cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres,
+								uint32_t* visibleIndices, size_t begin, size_t end)
+{
+	size_t visibleCount = 0;
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			float distance = plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i]
+				+ plane.z * spheres.centerZ[i] + plane.w;
+			inside &= distance >= -spheres.radius[i];
+		}
+
+		visibleIndices[visibleCount] = static_cast<uint32_t>(i);
+		visibleCount += inside ? 1 : 0;
+	}
+
+	return visibleCount;
+}
+
+static size_t cullSpheresSSE(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices)
+{
+	// SSE2 is always available on x64, no need for a target attribute
+	const size_t count = spheres.size();
+	const size_t simdCount = count & ~size_t(3);
+	size_t visibleCount = 0;
+
+	for (size_t i = 0; i < simdCount; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres.centerX[i]);
+		__m128 y = _mm_loadu_ps(&spheres.centerY[i]);
+		__m128 z = _mm_loadu_ps(&spheres.centerZ[i]);
+		__m128 r = _mm_loadu_ps(&spheres.radius[i]);
+
+		// All lanes start visible, each plane can only clear lanes
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			// distance >= -radius <=> distance + radius >= 0
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			visibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	// Remaining spheres that do not fill a register
+	return visibleCount + cullSpheresScalar(frustum, spheres, visibleIndices + visibleCount, simdCount, count);
+}
+
+CULLING_TARGET_AVX
+static size_t cullSpheresAVX(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices)
+{
+	const size_t count = spheres.size();
+	const size_t simdCount = count & ~size_t(7);
+	size_t visibleCount = 0;
+
+	for (size_t i = 0; i < simdCount; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&spheres.centerX[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.centerY[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.centerZ[i]);
+		__m256 r = _mm256_loadu_ps(&spheres.radius[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			visibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	return visibleCount + cullSpheresScalar(frustum, spheres, visibleIndices + visibleCount, simdCount, count);
+}
+//^ Culling implementations ======================================
+//v CPU feature detection ========================================
+static bool cpuSupportsAVX()
+{
+#if defined(_MSC_VER)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	bool osUsesXSave = (cpuInfo[2] & (1 << 27)) != 0;
+	bool hasAVX = (cpuInfo[2] & (1 << 28)) != 0;
+	if (!osUsesXSave || !hasAVX) return false;
+
+	// The OS must also save the YMM registers on context switches
+	unsigned long long xcrFeatureMask = _xgetbv(0);
+	return (xcrFeatureMask & 0x6) == 0x6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+
+CullingPath getBestCullingPath()
+{
+	static const CullingPath bestPath = cpuSupportsAVX() ? CullingPath::AVX : CullingPath::SSE;
+	return bestPath;
+}
+
+const char* getCullingPathName(CullingPath path)
+{
+	switch (path)
+	{
+	case CullingPath::Scalar: return "Scalar";
+	case CullingPath::SSE: return "SSE";
+	case CullingPath::AVX: return "AVX";
+	}
+	return "Unknown";
+}
+//^ CPU feature detection ========================================
+
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, vector<uint32_t>& visibleIndices)
+{
+	return cullSpheres(frustum, spheres, visibleIndices, getBestCullingPath());
+}
+
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, vector<uint32_t>& visibleIndices, CullingPath path)
+{
+	// Worst case: everything is visible. Never shrink, so that culling every
+	// frame with the same output vector does not clear or reallocate it.
+	if (visibleIndices.size() < spheres.size())
+	{
+		visibleIndices.resize(spheres.size());
+	}
+
+	size_t visibleCount = 0;
+	switch (path)
+	{
+	case CullingPath::Scalar:
+		visibleCount = cullSpheresScalar(frustum, spheres, visibleIndices.data(), 0, spheres.size());
+		break;
+	case CullingPath::SSE:
+		visibleCount = cullSpheresSSE(frustum, spheres, visibleIndices.data());
+		break;
+	case CullingPath::AVX:
+		visibleCount = cullSpheresAVX(frustum, spheres, visibleIndices.data());
+		break;
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+using std::vector;
+
+
+/// Six planes (xyz: normal pointing inside, w: distance) extracted from a view-projection matrix
+struct Frustum
+{
+	glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+
+	/// Gribb-Hartmann plane extraction, for a projection with a [0, 1] depth range (Vulkan convention)
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+/// Bounding spheres of the cullable objects, stored structure-of-arrays.
+/// Each component lives in its own contiguous array so the SIMD paths load
+/// 4 or 8 objects with a single instruction per component.
+struct BoundingSpheres
+{
+	vector<float> centerX;
+	vector<float> centerY;
+	vector<float> centerZ;
+	vector<float> radius;
+
+	/// Returns the index of the new sphere, which is also the index reported by the culling functions
+	uint32_t add(const glm::vec3& center, float sphereRadius);
+	void set(uint32_t index, const glm::vec3& center, float sphereRadius);
+
+	void reserve(size_t count);
+	void clear();
+	size_t size() const { return radius.size(); }
+};
+
+// Which implementation cullSpheres() dispatches to
+enum class CullingPath
+{
+	Scalar,
+	SSE, // 4 objects per iteration
+	AVX  // 8 objects per iteration
+};
+
+/// Widest path supported by the running CPU (checked once, then cached)
+CullingPath getBestCullingPath();
+const char* getCullingPathName(CullingPath path);
+
+/// Write the indices of the spheres intersecting the frustum at the front of visibleIndices
+/// and return how many there are. visibleIndices is grown to hold every sphere but never
+/// shrunk: only the first returned count entries are meaningful.
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, vector<uint32_t>& visibleIndices);
+size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, vector<uint32_t>& visibleIndices, CullingPath path);
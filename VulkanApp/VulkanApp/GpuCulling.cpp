@@ -0,0 +1,412 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+void GpuCulling::init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t maxObjectsP, uint32_t viewCountP,
+					  const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+					  DescriptorAllocator& descriptorAllocator, bool drawCountSupportedP, const DepthPyramid& depthPyramid)
+{
+	if (viewCountP == 0 || viewCountP > MAX_VIEWS)
+	{
+		throw std::runtime_error("Unsupported number of GPU culling views");
+	}
+	maxObjects = maxObjectsP;
+	viewCount = viewCountP;
+	drawCountSupported = drawCountSupportedP;
+	pyramidExtent = depthPyramid.getExtent();
+
+	createBuffers(physicalDevice, device);
+	createDescriptors(device, frameRingBuffer, layoutCache, descriptorAllocator, depthPyramid);
+	createPipelines(device);
+}
+
+void GpuCulling::clean(vk::Device device)
+{
+	device.destroyPipeline(meshletCullingPipeline);
+	device.destroyPipeline(cullingPipeline);
+	device.destroyPipelineLayout(pipelineLayout);
+	device.destroyBuffer(meshletDrawCommandBuffer);
+	device.freeMemory(meshletDrawCommandBufferMemory);
+	device.destroyBuffer(meshletObjectBuffer);
+	device.freeMemory(meshletObjectBufferMemory);
+	device.destroyBuffer(meshletDispatchBuffer);
+	device.freeMemory(meshletDispatchBufferMemory);
+	device.destroyBuffer(meshletBuffer);
+	device.freeMemory(meshletBufferMemory);
+	device.destroyBuffer(meshBuffer);
+	device.freeMemory(meshBufferMemory);
+	device.destroyBuffer(lodStateBuffer);
+	device.freeMemory(lodStateBufferMemory);
+	device.destroyBuffer(occlusionCandidateBuffer);
+	device.freeMemory(occlusionCandidateBufferMemory);
+	device.destroyBuffer(drawCountBuffer);
+	device.freeMemory(drawCountBufferMemory);
+	device.destroyBuffer(drawCommandBuffer);
+	device.freeMemory(drawCommandBufferMemory);
+	device.destroyBuffer(objectBuffer);
+	device.freeMemory(objectBufferMemory);
+}
+
+void GpuCulling::setMeshes(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+						   vk::CommandPool transferCommandPool, const MeshPool& meshPool)
+{
+	if (meshBuffer)
+	{
+		throw std::runtime_error("GPU culling meshes can only be set once");
+	}
+
+	vector<GpuMesh> meshes(meshPool.getMeshCount());
+	meshletCounts.resize(meshes.size());
+	for (uint32_t meshId = 0; meshId < meshes.size(); ++meshId)
+	{
+		const MeshRange& mesh = meshPool.getMesh(meshId);
+		GpuMesh& gpuMesh = meshes[meshId];
+		// Inverse of the dequantization, a scale and a translation
+		glm::vec3 dequantizationScale{ mesh.dequantization[0][0], mesh.dequantization[1][1], mesh.dequantization[2][2] };
+		gpuMesh.quantizationScale = glm::vec4(1.0f / dequantizationScale, 0.0f);
+		gpuMesh.quantizationOffset = glm::vec4(-glm::vec3(mesh.dequantization[3]) / dequantizationScale, 0.0f);
+		gpuMesh.lodCount = mesh.lodCount;
+		gpuMesh.firstMeshlet = mesh.firstMeshlet;
+		gpuMesh.meshletCount = mesh.meshletCount;
+		meshletCounts[meshId] = mesh.meshletCount;
+		for (uint32_t lod = 0; lod < mesh.lodCount; ++lod)
+		{
+			// Objects only know their world bounding sphere: errors are given relative to its radius
+			float radius = mesh.boundingSphere.w > 0.0f ? mesh.boundingSphere.w : 1.0f;
+			gpuMesh.lods[lod] = GpuMesh::Lod{ mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount, mesh.vertexOffset,
+				mesh.lods[lod].error / radius };
+		}
+	}
+	if (meshes.empty()) meshes.emplace_back();
+
+	vector<GpuMeshlet> meshlets(meshPool.getMeshletCount());
+	for (uint32_t meshletId = 0; meshletId < meshlets.size(); ++meshletId)
+	{
+		const MeshletRange& meshlet = meshPool.getMeshlet(meshletId);
+		meshlets[meshletId] = GpuMeshlet{ meshlet.boundingSphere, meshlet.cone, meshlet.firstIndex, meshlet.indexCount, { 0, 0 } };
+	}
+	if (meshlets.empty()) meshlets.emplace_back();
+
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		meshes.data(), sizeof(GpuMesh) * meshes.size(), vk::BufferUsageFlagBits::eStorageBuffer,
+		&meshBuffer, &meshBufferMemory);
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		meshlets.data(), sizeof(GpuMeshlet) * meshlets.size(), vk::BufferUsageFlagBits::eStorageBuffer,
+		&meshletBuffer, &meshletBufferMemory);
+
+	writeStorageBuffer(device, 6, meshBuffer);
+	writeStorageBuffer(device, 8, meshletBuffer);
+}
+
+void GpuCulling::setObjects(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+							vk::CommandPool transferCommandPool, const vector<GpuObject>& objects)
+{
+	if (objects.size() > maxObjects)
+	{
+		throw std::runtime_error("Too many objects for the GPU culling buffers");
+	}
+	if (!meshBuffer || meshletDrawCommandBuffer)
+	{
+		throw std::runtime_error("GPU culling objects can only be set once, after the meshes");
+	}
+	objectCount = static_cast<uint32_t>(objects.size());
+
+	// Room for every meshlet of every object: each object is listed at most once per frame, by one of the phases
+	maxMeshletDraws = 0;
+	for (const GpuObject& object : objects)
+	{
+		maxMeshletDraws += meshletCounts[object.meshId];
+	}
+	createBuffer(physicalDevice, device, sizeof(vk::DrawIndexedIndirectCommand) * std::max(maxMeshletDraws, 1u),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &meshletDrawCommandBuffer, &meshletDrawCommandBufferMemory);
+	writeStorageBuffer(device, 11, meshletDrawCommandBuffer);
+	if (objects.empty()) return;
+
+	// Fill the existing object buffer through a staging buffer
+	vk::DeviceSize dataSize = sizeof(GpuObject) * objects.size();
+	vk::Buffer stagingBuffer;
+	vk::DeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, dataSize, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* data = device.mapMemory(stagingBufferMemory, 0, dataSize);
+	memcpy(data, objects.data(), static_cast<size_t>(dataSize));
+	device.unmapMemory(stagingBufferMemory);
+
+	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, objectBuffer, dataSize);
+
+	device.destroyBuffer(stagingBuffer);
+	device.freeMemory(stagingBufferMemory);
+}
+
+void GpuCulling::updateViews(FrameRingBuffer& frameRingBuffer, const vector<Frustum>& frustums, const glm::mat4& view,
+							 const glm::mat4& projection, float viewportHeight)
+{
+	if (frustums.size() != viewCount)
+	{
+		throw std::runtime_error("One frustum per GPU culling view is needed");
+	}
+
+	CullingUbo cullingUbo{};
+	for (uint32_t view = 0; view < viewCount; ++view)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			cullingUbo.frustumPlanes[view * 6 + i] = frustums[view].planes[i];
+		}
+	}
+	const glm::mat4 viewProjection = projection * view;
+	cullingUbo.viewProjection = viewProjection;
+	cullingUbo.previousViewProjection = previousViewProjection;
+	cullingUbo.cameraPosition = glm::inverse(view)[3];
+	cullingUbo.pyramidSize = glm::vec2(pyramidExtent.width, pyramidExtent.height);
+	// Half the viewport spans tan(fov / 2) at a distance of 1, projection[1][1] is its inverse (negated for Vulkan)
+	cullingUbo.lodScale = 0.5f * viewportHeight * std::abs(projection[1][1]);
+	cullingUbo.lodErrorThreshold = lodErrorThreshold;
+	cullingUbo.objectCount = objectCount;
+	cullingUbo.commandsPerView = maxObjects;
+	cullingUbo.occlusionEnabled = occlusionEnabled ? 1 : 0;
+	cullingUbo.meshletsEnabled = meshletsEnabled ? 1 : 0;
+
+	cullingUniformOffset = frameRingBuffer.pushUniform(cullingUbo);
+	// This frame builds the pyramid the next frame reprojects
+	previousViewProjection = viewProjection;
+}
+
+void GpuCulling::recordReset(vk::CommandBuffer commandBuffer)
+{
+	// Draw counts start at 0, visible objects increment them
+	commandBuffer.fillBuffer(drawCountBuffer, 0, VK_WHOLE_SIZE, 0);
+	// No object drawn by meshlets yet: each one listed adds a workgroup
+	const vk::DispatchIndirectCommand noWorkgroup{ 0, 1, 1 };
+	commandBuffer.updateBuffer(meshletDispatchBuffer, 0, sizeof(noWorkgroup), &noWorkgroup);
+	if (!drawCountSupported)
+	{
+		// Without a GPU side count, every command is drawn: culled ones must have 0 indices
+		commandBuffer.fillBuffer(drawCommandBuffer, 0, VK_WHOLE_SIZE, 0);
+		if (meshletDrawCommandBuffer)
+		{
+			commandBuffer.fillBuffer(meshletDrawCommandBuffer, 0, VK_WHOLE_SIZE, 0);
+		}
+	}
+}
+
+void GpuCulling::recordCulling(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullingPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, cullingUniformOffset);
+	uint32_t late = 0;
+	commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &late);
+	// One invocation per object, rounded up to whole workgroups, one row of workgroups per view
+	uint32_t groupCount = (objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+	if (groupCount > 0)
+	{
+		commandBuffer.dispatch(groupCount, viewCount, 1);
+	}
+}
+
+void GpuCulling::recordLateCulling(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullingPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, cullingUniformOffset);
+	uint32_t late = 1;
+	commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &late);
+	// Camera only: a single row of workgroups
+	uint32_t groupCount = (objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+	if (groupCount > 0)
+	{
+		commandBuffer.dispatch(groupCount, 1, 1);
+	}
+}
+
+void GpuCulling::recordMeshletCulling(vk::CommandBuffer commandBuffer)
+{
+	// Objects not set: the meshlet commands do not exist
+	if (!meshletDrawCommandBuffer) return;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, meshletCullingPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, cullingUniformOffset);
+	// As many workgroups as objects listed by the culling, a count the CPU never reads
+	commandBuffer.dispatchIndirect(meshletDispatchBuffer, 0);
+}
+
+void GpuCulling::recordDraws(vk::CommandBuffer commandBuffer, uint32_t view)
+{
+	if (objectCount == 0) return;
+
+	const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+	const vk::DeviceSize commandOffset = static_cast<vk::DeviceSize>(view) * maxObjects * stride;
+	if (drawCountSupported)
+	{
+		// The GPU reads how many commands to execute from the count buffer
+		commandBuffer.drawIndexedIndirectCount(drawCommandBuffer, commandOffset, drawCountBuffer, sizeof(uint32_t) * view,
+			objectCount, stride);
+	}
+	else
+	{
+		commandBuffer.drawIndexedIndirect(drawCommandBuffer, commandOffset, objectCount, stride);
+	}
+}
+
+void GpuCulling::recordMeshletDraws(vk::CommandBuffer commandBuffer)
+{
+	if (maxMeshletDraws == 0) return;
+
+	const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+	if (drawCountSupported)
+	{
+		commandBuffer.drawIndexedIndirectCount(meshletDrawCommandBuffer, 0, drawCountBuffer, sizeof(uint32_t) * MAX_VIEWS,
+			maxMeshletDraws, stride);
+	}
+	else
+	{
+		commandBuffer.drawIndexedIndirect(meshletDrawCommandBuffer, 0, maxMeshletDraws, stride);
+	}
+}
+
+void GpuCulling::createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device)
+{
+	// Objects: written once by a transfer, read by compute and vertex shaders
+	createBuffer(physicalDevice, device, sizeof(GpuObject) * maxObjects,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &objectBuffer, &objectBufferMemory);
+
+	// Draw commands and count: written by compute, read as indirect parameters
+	createBuffer(physicalDevice, device, sizeof(vk::DrawIndexedIndirectCommand) * maxObjects * viewCount,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &drawCommandBuffer, &drawCommandBufferMemory);
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * (MAX_VIEWS + 1),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &drawCountBuffer, &drawCountBufferMemory);
+
+	// Objects drawn by meshlets: listed by the culling, the workgroup count is read as indirect parameters
+	createBuffer(physicalDevice, device, sizeof(vk::DispatchIndirectCommand),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &meshletDispatchBuffer, &meshletDispatchBufferMemory);
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * maxObjects, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &meshletObjectBuffer, &meshletObjectBufferMemory);
+
+	// Occlusion candidates: only ever touched by the culling shader
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * maxObjects, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &occlusionCandidateBuffer, &occlusionCandidateBufferMemory);
+	// Levels of detail: only ever touched by the culling shader. Any initial value is a valid level after a frame.
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * maxObjects, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &lodStateBuffer, &lodStateBufferMemory);
+}
+
+void GpuCulling::createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer,
+								   DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+								   const DepthPyramid& depthPyramid)
+{
+	//v Layout =======================================================
+	vector<vk::DescriptorSetLayoutBinding> bindings(12);
+	// Binding 0: frustum and object count, in the frame ring buffer
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
+	// Binding 1: objects, 2: draw commands, 3: draw count, 4: depth pyramid, 5: occlusion candidates,
+	// 6: meshes (written by setMeshes), 7: levels of detail, 8: meshlets (written by setMeshes),
+	// 9: meshlet dispatch, 10: meshlet objects, 11: meshlet draw commands (written by setObjects)
+	for (uint32_t i = 1; i < bindings.size(); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 4 ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eStorageBuffer;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+	}
+
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+	//^ Layout =======================================================
+	//v Set ==========================================================
+	descriptorSet = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+	std::array<vk::DescriptorBufferInfo, 12> bufferInfos{};
+	// Offset 0 here, the dynamic offset given when binding selects the frame's CullingUbo
+	bufferInfos[0] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(CullingUbo) };
+	bufferInfos[1] = vk::DescriptorBufferInfo{ objectBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[2] = vk::DescriptorBufferInfo{ drawCommandBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[3] = vk::DescriptorBufferInfo{ drawCountBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[5] = vk::DescriptorBufferInfo{ occlusionCandidateBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[7] = vk::DescriptorBufferInfo{ lodStateBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[9] = vk::DescriptorBufferInfo{ meshletDispatchBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[10] = vk::DescriptorBufferInfo{ meshletObjectBuffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorImageInfo pyramidInfo{ depthPyramid.getSampler(), depthPyramid.getView(), vk::ImageLayout::eGeneral };
+
+	vector<vk::WriteDescriptorSet> writes;
+	for (uint32_t binding = 0; binding < bindings.size(); ++binding)
+	{
+		// The meshes and meshlet commands do not exist yet
+		if (binding == 6 || binding == 8 || binding == 11) continue;
+
+		vk::WriteDescriptorSet write{};
+		write.dstSet = descriptorSet;
+		write.dstBinding = binding;
+		write.dstArrayElement = 0;
+		write.descriptorType = bindings[binding].descriptorType;
+		write.descriptorCount = 1;
+		if (binding == 4)
+		{
+			write.pImageInfo = &pyramidInfo;
+		}
+		else
+		{
+			write.pBufferInfo = &bufferInfos[binding];
+		}
+		writes.push_back(write);
+	}
+	device.updateDescriptorSets(writes, nullptr);
+	//^ Set ==========================================================
+}
+
+void GpuCulling::createPipelines(vk::Device device)
+{
+	// Phase: early or late, unused by the meshlet culling
+	vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t) };
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+	auto createComputePipeline = [&](const string& fileName)
+	{
+		vk::ShaderModule computeShaderModule = createShaderModule(device, readShaderFile(fileName));
+
+		vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+		pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+		pipelineCreateInfo.stage.module = computeShaderModule;
+		pipelineCreateInfo.stage.pName = "main";
+		pipelineCreateInfo.layout = pipelineLayout;
+
+		auto result = device.createComputePipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+		if (result.result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("Could not create the culling compute pipeline");
+		}
+
+		device.destroyShaderModule(computeShaderModule);
+		return result.value;
+	};
+	cullingPipeline = createComputePipeline("shaders/cull.spv");
+	meshletCullingPipeline = createComputePipeline("shaders/meshletcull.spv");
+}
+
+void GpuCulling::writeStorageBuffer(vk::Device device, uint32_t binding, vk::Buffer buffer)
+{
+	vk::DescriptorBufferInfo bufferInfo{ buffer, 0, VK_WHOLE_SIZE };
+	vk::WriteDescriptorSet write{};
+	write.dstSet = descriptorSet;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorType = vk::DescriptorType::eStorageBuffer;
+	write.descriptorCount = 1;
+	write.pBufferInfo = &bufferInfo;
+	device.updateDescriptorSets(write, nullptr);
+}
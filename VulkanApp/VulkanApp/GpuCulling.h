@@ -0,0 +1,202 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+#include "FrustumCulling.h"
+#include "Mesh.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+#include "DepthPyramid.h"
+
+
+/// Per-object data read by the culling compute shader and by the vertex shader.
+/// Layout matches the std430 Object struct in cull.comp and shader.vert.
+struct GpuObject
+{
+	glm::mat4 model;
+	glm::vec4 boundingSphere; // World space: xyz center, w radius
+	uint32_t meshId; // In the mesh pool given to setMeshes, the culling picks one of its levels of detail
+	uint32_t materialId; // Read by the fragment shader from the material buffer
+	uint32_t padding[2];
+};
+
+/// Levels of detail and meshlets of a mesh, read by the culling compute shaders.
+/// Layout matches the std430 Mesh struct in cull.comp and meshletcull.comp.
+struct GpuMesh
+{
+	struct Lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+		float error; // Relative to the bounding sphere radius: scales with the object
+	};
+	Lod lods[MAX_MESH_LODS];
+	// Local space to the quantized positions object models take: p * scale + offset. w unused.
+	glm::vec4 quantizationScale;
+	glm::vec4 quantizationOffset;
+	uint32_t lodCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount; // 0: always drawn whole
+	uint32_t padding;
+};
+
+/// Meshlet bounds, read by the meshlet culling compute shader.
+/// Layout matches the std430 Meshlet struct in meshletcull.comp.
+struct GpuMeshlet
+{
+	glm::vec4 boundingSphere; // Local space
+	glm::vec4 cone; // Local space axis, cutoff
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t padding[2];
+};
+
+/// GPU-driven rendering: every object lives in a storage buffer, a compute shader
+/// tests them against the frustum and writes one vk::DrawIndexedIndirectCommand per
+/// visible object plus a draw count. The render pass then issues a single
+/// drawIndexedIndirectCount, so CPU cost does not depend on the number of objects.
+/// Several views (camera, shadow cascades) are culled by the same dispatch, each into
+/// its own range of commands and its own count.
+/// The camera view is also occlusion culled, in two phases: the early phase tests against the
+/// depth pyramid of the previous frame and keeps the rejected objects aside; once the objects
+/// drawn so far have built a new depth pyramid, the late phase appends those still visible.
+/// Each drawn object gets the coarsest level of detail whose error, projected on the screen, stays under
+/// a threshold in pixels. Seen from the camera, an object only goes coarser once well under it (hysteresis):
+/// objects at the limit do not switch back and forth every frame.
+/// Camera objects at full detail whose mesh has meshlets are not drawn whole: both phases list them, then
+/// the meshlet culling tests each of their meshlets against the frustum, its normal cone and the current
+/// depth pyramid, and writes one command per meshlet left. Those draws come after the depth prepass: they do
+/// not occlude anything in the pyramid.
+class GpuCulling
+{
+public:
+	/// drawCountSupported: whether drawIndirectCount (Vulkan 1.2) is enabled. If not, culled
+	/// commands are zeroed and drawIndexedIndirect goes through the whole command buffer.
+	/// The frustums are read from the frame ring buffer, through a dynamic uniform buffer.
+	/// viewCount: views culled each frame, at most MAX_VIEWS.
+	/// depthPyramid: built from the camera depth, sampled in general layout by both phases.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t maxObjects, uint32_t viewCount,
+			  const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+			  DescriptorAllocator& descriptorAllocator, bool drawCountSupported, const DepthPyramid& depthPyramid);
+	void clean(vk::Device device);
+
+	/// Upload the levels of detail and meshlets of every mesh of the pool to device local memory.
+	/// Call once, outside of a frame.
+	void setMeshes(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+				   vk::CommandPool transferCommandPool, const MeshPool& meshPool);
+	/// Upload the objects to device local memory, and size the meshlet commands after their meshes.
+	/// Call once, after setMeshes, outside of a frame.
+	void setObjects(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+					vk::CommandPool transferCommandPool, const vector<GpuObject>& objects);
+
+	/// Views the next culling dispatch will test against, written in the current frame's ring region:
+	/// one frustum per view, then the camera (view 0). Its view projection is remembered to reproject the
+	/// depth pyramid next frame, its position and projection give the screen size of the levels of detail.
+	void updateViews(FrameRingBuffer& frameRingBuffer, const vector<Frustum>& frustums, const glm::mat4& view,
+					 const glm::mat4& projection, float viewportHeight);
+	/// Without it, every camera object in the frustum is drawn by the early phase
+	void setOcclusionCulling(bool enabled) { occlusionEnabled = enabled; }
+	/// Largest error on screen, in pixels, of the level of detail drawn. 0 always draws the full meshes.
+	void setLodErrorThreshold(float pixels) { lodErrorThreshold = pixels; }
+	/// Without it, meshes with meshlets are drawn whole
+	void setMeshletCulling(bool enabled) { meshletsEnabled = enabled; }
+
+	/// Reset the draw counts (and the commands without drawIndirectCount), with transfers.
+	/// Commands and count are shared by frames in flight: the caller synchronises them
+	/// with the previous draws, the reset and the culling (the render graph does).
+	void recordReset(vk::CommandBuffer commandBuffer);
+	/// Dispatch the culling shader, for every view. Must be recorded outside of a render pass.
+	void recordCulling(vk::CommandBuffer commandBuffer);
+	/// Append the camera objects the early phase occluded but the current depth pyramid does not.
+	/// Reads what recordCulling wrote: the caller synchronises them (the render graph does).
+	void recordLateCulling(vk::CommandBuffer commandBuffer);
+	/// Test the meshlets of the objects both phases listed, against this frame's depth pyramid.
+	/// Reads what the late culling wrote: the caller synchronises them (the render graph does).
+	void recordMeshletCulling(vk::CommandBuffer commandBuffer);
+	/// Draw every object visible in a view. The mesh pool buffers must be bound.
+	/// Camera objects drawn by meshlets are not part of view 0: see recordMeshletDraws.
+	void recordDraws(vk::CommandBuffer commandBuffer, uint32_t view = 0);
+	/// Draw the meshlets left by the meshlet culling, with the same pipelines as recordDraws
+	void recordMeshletDraws(vk::CommandBuffer commandBuffer);
+
+	/// Object buffer, to read model matrices in the vertex shader with gl_InstanceIndex
+	vk::Buffer getObjectBuffer() const { return objectBuffer; }
+	vk::DeviceSize getObjectBufferSize() const { return sizeof(GpuObject) * maxObjects; }
+	/// Written by the reset and the culling, read by the draws as indirect parameters
+	vk::Buffer getDrawCommandBuffer() const { return drawCommandBuffer; }
+	vk::Buffer getDrawCountBuffer() const { return drawCountBuffer; }
+	/// Written by the early phase, read by the late phase
+	vk::Buffer getOcclusionCandidateBuffer() const { return occlusionCandidateBuffer; }
+
+	static const uint32_t WORKGROUP_SIZE{ 64 }; // Must match local_size_x in cull.comp
+	static const uint32_t MAX_VIEWS{ 5 }; // Must match cull.comp and meshletcull.comp
+
+private:
+	uint32_t maxObjects{ 0 };
+	uint32_t objectCount{ 0 };
+	uint32_t viewCount{ 1 };
+	bool drawCountSupported{ false };
+	bool occlusionEnabled{ true };
+	bool meshletsEnabled{ true };
+	uint32_t maxMeshletDraws{ 0 }; // Meshlets of every object, set by setObjects
+	vector<uint32_t> meshletCounts; // Per mesh, set by setMeshes
+	glm::mat4 previousViewProjection{ 1.0f }; // Any value works the first frame: the pyramid is empty
+	float lodErrorThreshold{ 1.0f };
+	uint32_t cullingUniformOffset{ 0 }; // Dynamic offset of this frame's CullingUbo
+
+	// Matches the Culling uniform block of cull.comp
+	struct CullingUbo
+	{
+		glm::vec4 frustumPlanes[MAX_VIEWS * 6];
+		glm::mat4 viewProjection;
+		glm::mat4 previousViewProjection;
+		glm::vec4 cameraPosition;
+		glm::vec2 pyramidSize;
+		float lodScale; // Pixels per world unit at a distance of 1
+		float lodErrorThreshold;
+		uint32_t objectCount;
+		uint32_t commandsPerView;
+		uint32_t occlusionEnabled;
+		uint32_t meshletsEnabled;
+	};
+
+	// -- BUFFERS --
+	vk::Buffer objectBuffer;
+	vk::DeviceMemory objectBufferMemory;
+	vk::Buffer drawCommandBuffer; // Compacted vk::DrawIndexedIndirectCommand of visible objects, maxObjects per view
+	vk::DeviceMemory drawCommandBufferMemory;
+	vk::Buffer drawCountBuffer; // One uint32_t per view, the meshlet draw count at MAX_VIEWS
+	vk::DeviceMemory drawCountBufferMemory;
+	vk::Buffer occlusionCandidateBuffer; // One uint32_t per object, 1 if the late phase must test it
+	vk::DeviceMemory occlusionCandidateBufferMemory;
+	vk::Buffer lodStateBuffer; // One uint32_t per object, level of detail it was last drawn with by the camera
+	vk::DeviceMemory lodStateBufferMemory;
+	vk::Buffer meshBuffer; // GpuMesh, created by setMeshes
+	vk::DeviceMemory meshBufferMemory;
+	vk::Buffer meshletBuffer; // GpuMeshlet, created by setMeshes
+	vk::DeviceMemory meshletBufferMemory;
+	vk::Buffer meshletDispatchBuffer; // vk::DispatchIndirectCommand, one workgroup per object drawn by meshlets
+	vk::DeviceMemory meshletDispatchBufferMemory;
+	vk::Buffer meshletObjectBuffer; // One uint32_t per object drawn by meshlets, its index
+	vk::DeviceMemory meshletObjectBufferMemory;
+	vk::Buffer meshletDrawCommandBuffer; // vk::DrawIndexedIndirectCommand of visible meshlets, created by setObjects
+	vk::DeviceMemory meshletDrawCommandBufferMemory;
+	vk::Extent2D pyramidExtent;
+
+	// -- DESCRIPTORS --
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	// The only per-frame data is the uniform, selected by dynamic offset: one long-lived set is enough
+	vk::DescriptorSet descriptorSet;
+
+	// -- PIPELINE --
+	vk::PipelineLayout pipelineLayout; // Shared by both culling shaders
+	vk::Pipeline cullingPipeline;
+	vk::Pipeline meshletCullingPipeline;
+
+	void createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device);
+	void createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer,
+						   DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator,
+						   const DepthPyramid& depthPyramid);
+	void createPipelines(vk::Device device);
+	void writeStorageBuffer(vk::Device device, uint32_t binding, vk::Buffer buffer);
+};
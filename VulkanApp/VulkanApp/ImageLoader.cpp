@@ -0,0 +1,280 @@
+#include "ImageLoader.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+
+
+vector<uint8_t> readBinaryFile(const string& filename)
+{
+	std::ifstream file{ filename, std::ios::binary | std::ios::ate };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + filename);
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	vector<uint8_t> fileBuffer(fileSize);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(fileBuffer.data()), fileSize);
+
+	return fileBuffer;
+}
+
+//v PPM ==========================================================
+// Header: magic (P3 ASCII, P6 binary), width, height, max value, separated by
+// whitespace, with # comments. Binary samples follow a single whitespace.
+static bool readPpmHeaderValue(const vector<uint8_t>& file, size_t& position, uint32_t& value)
+{
+	while (position < file.size())
+	{
+		if (file[position] == '#')
+		{
+			while (position < file.size() && file[position] != '\n') ++position;
+		}
+		else if (isspace(file[position]))
+		{
+			++position;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (position >= file.size() || !isdigit(file[position])) return false;
+
+	value = 0;
+	while (position < file.size() && isdigit(file[position]))
+	{
+		value = value * 10 + (file[position] - '0');
+		++position;
+	}
+	return true;
+}
+
+static ImageData decodePpm(const vector<uint8_t>& file)
+{
+	if (file.size() < 2 || file[0] != 'P' || (file[1] != '3' && file[1] != '6'))
+	{
+		throw std::runtime_error("Unsupported PPM image, only P3 and P6 are");
+	}
+	bool binary = file[1] == '6';
+
+	ImageData image;
+	uint32_t maxValue = 0;
+	size_t position = 2;
+	if (!readPpmHeaderValue(file, position, image.width) || !readPpmHeaderValue(file, position, image.height)
+		|| !readPpmHeaderValue(file, position, maxValue) || maxValue == 0 || maxValue > 255)
+	{
+		throw std::runtime_error("Invalid PPM header");
+	}
+
+	size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+	image.pixels.resize(pixelCount * 4);
+
+	if (binary)
+	{
+		++position; // Single whitespace before the samples
+		if (file.size() < position + pixelCount * 3)
+		{
+			throw std::runtime_error("Truncated PPM image");
+		}
+		const uint8_t* samples = &file[position];
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			for (size_t channel = 0; channel < 3; ++channel)
+			{
+				image.pixels[i * 4 + channel] = static_cast<uint8_t>(samples[i * 3 + channel] * 255 / maxValue);
+			}
+			image.pixels[i * 4 + 3] = 255;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			for (size_t channel = 0; channel < 3; ++channel)
+			{
+				uint32_t sample = 0;
+				if (!readPpmHeaderValue(file, position, sample))
+				{
+					throw std::runtime_error("Truncated PPM image");
+				}
+				image.pixels[i * 4 + channel] = static_cast<uint8_t>(std::min(sample, maxValue) * 255 / maxValue);
+			}
+			image.pixels[i * 4 + 3] = 255;
+		}
+	}
+
+	return image;
+}
+//^ PPM ==========================================================
+//v TGA ==========================================================
+// 18 bytes header, then an optional image id and color map, then the pixels stored
+// BGR(A), bottom row first unless bit 5 of the descriptor is set.
+static ImageData decodeTga(const vector<uint8_t>& file)
+{
+	const size_t headerSize = 18;
+	if (file.size() < headerSize)
+	{
+		throw std::runtime_error("Truncated TGA image");
+	}
+
+	uint8_t idLength = file[0];
+	uint8_t colorMapType = file[1];
+	uint8_t imageType = file[2];
+	uint16_t colorMapLength = file[5] | file[6] << 8;
+	uint8_t colorMapEntrySize = file[7];
+	uint32_t width = file[12] | file[13] << 8;
+	uint32_t height = file[14] | file[15] << 8;
+	uint8_t bitsPerPixel = file[16];
+	bool topToBottom = (file[17] & 0x20) != 0;
+
+	// 2: true color, 3: grayscale, +8: run length encoded
+	bool rle = imageType >= 8;
+	uint8_t baseType = rle ? imageType - 8 : imageType;
+	bool grayscale = baseType == 3;
+	if ((baseType != 2 && baseType != 3)
+		|| (!grayscale && bitsPerPixel != 24 && bitsPerPixel != 32)
+		|| (grayscale && bitsPerPixel != 8))
+	{
+		throw std::runtime_error("Unsupported TGA image, only true color and grayscale are");
+	}
+
+	size_t position = headerSize + idLength + (colorMapType == 1 ? colorMapLength * ((colorMapEntrySize + 7) / 8) : 0);
+	const size_t bytesPerPixel = bitsPerPixel / 8;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	// Pixels in file order, converted to RGBA
+	vector<uint8_t> filePixels(pixelCount * 4);
+	auto readPixel = [&](uint8_t* destination)
+	{
+		if (position + bytesPerPixel > file.size())
+		{
+			throw std::runtime_error("Truncated TGA image");
+		}
+		const uint8_t* source = &file[position];
+		if (grayscale)
+		{
+			destination[0] = destination[1] = destination[2] = source[0];
+			destination[3] = 255;
+		}
+		else
+		{
+			destination[0] = source[2];
+			destination[1] = source[1];
+			destination[2] = source[0];
+			destination[3] = bytesPerPixel == 4 ? source[3] : 255;
+		}
+		position += bytesPerPixel;
+	};
+
+	size_t pixel = 0;
+	while (pixel < pixelCount)
+	{
+		if (!rle)
+		{
+			readPixel(&filePixels[pixel * 4]);
+			++pixel;
+			continue;
+		}
+
+		// Packet header: high bit set for a run of one repeated pixel, else raw pixels
+		if (position >= file.size())
+		{
+			throw std::runtime_error("Truncated TGA image");
+		}
+		uint8_t packetHeader = file[position++];
+		size_t packetCount = std::min<size_t>((packetHeader & 0x7F) + 1, pixelCount - pixel);
+		if (packetHeader & 0x80)
+		{
+			readPixel(&filePixels[pixel * 4]);
+			for (size_t i = 1; i < packetCount; ++i)
+			{
+				std::copy_n(&filePixels[pixel * 4], 4, &filePixels[(pixel + i) * 4]);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < packetCount; ++i)
+			{
+				readPixel(&filePixels[(pixel + i) * 4]);
+			}
+		}
+		pixel += packetCount;
+	}
+
+	ImageData image;
+	image.width = width;
+	image.height = height;
+	if (topToBottom)
+	{
+		image.pixels = std::move(filePixels);
+		return image;
+	}
+
+	image.pixels.resize(filePixels.size());
+	const size_t rowSize = static_cast<size_t>(width) * 4;
+	for (uint32_t row = 0; row < height; ++row)
+	{
+		std::copy_n(&filePixels[(height - 1 - row) * rowSize], rowSize, &image.pixels[row * rowSize]);
+	}
+	return image;
+}
+//^ TGA ==========================================================
+
+ImageData loadImage(const string& filename)
+{
+	string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+	vector<uint8_t> file = readBinaryFile(filename);
+
+	ImageData image;
+	if (extension == "ppm")
+	{
+		image = decodePpm(file);
+	}
+	else if (extension == "tga")
+	{
+		image = decodeTga(file);
+	}
+	else
+	{
+		throw std::runtime_error("Unsupported image format: " + filename);
+	}
+
+	if (image.width == 0 || image.height == 0)
+	{
+		throw std::runtime_error("Empty image: " + filename);
+	}
+	return image;
+}
+
+ImageData createCheckerImage(uint32_t size, uint32_t cellCount, const glm::vec4& colorA, const glm::vec4& colorB)
+{
+	ImageData image;
+	image.width = size;
+	image.height = size;
+	image.pixels.resize(static_cast<size_t>(size) * size * 4);
+
+	const glm::vec4 colors[2]{ colorA, colorB };
+	const uint32_t cellSize = std::max(size / std::max(cellCount, 1u), 1u);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const glm::vec4& color = colors[(x / cellSize + y / cellSize) % 2];
+			uint8_t* pixel = &image.pixels[(static_cast<size_t>(y) * size + x) * 4];
+			for (int channel = 0; channel < 4; ++channel)
+			{
+				pixel[channel] = static_cast<uint8_t>(glm::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	return image;
+}
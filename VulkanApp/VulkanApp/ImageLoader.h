@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+using std::vector;
+using std::string;
+
+
+/// Decoded image, 8 bits per channel RGBA, rows from top to bottom
+struct ImageData
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	vector<uint8_t> pixels;
+};
+
+/// Whole content of a file. Throws if it can't be opened.
+vector<uint8_t> readBinaryFile(const string& filename);
+
+/// Decode an image file, picking the decoder from the extension.
+/// Supported: binary and ASCII PPM (.ppm), TGA (.tga: true color or grayscale, raw or RLE).
+/// Throws if the file can't be read or decoded. Thread safe, meant to run on workers.
+ImageData loadImage(const string& filename);
+
+/// Checkerboard of cellCount x cellCount cells, handy as a default texture
+ImageData createCheckerImage(uint32_t size, uint32_t cellCount, const glm::vec4& colorA, const glm::vec4& colorB);
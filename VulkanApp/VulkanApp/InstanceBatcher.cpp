@@ -0,0 +1,100 @@
+#include "InstanceBatcher.h"
+
+
+void InstanceBatcher::addInstances(uint32_t meshId, uint32_t materialId, const InstanceData* instances, size_t count)
+{
+	uint64_t key = static_cast<uint64_t>(meshId) << 32 | materialId;
+	auto batchIndex = batchIndices.find(key);
+	if (batchIndex == batchIndices.end())
+	{
+		batchIndex = batchIndices.emplace(key, batches.size()).first;
+		batches.push_back(InstanceBatch{ meshId, materialId, {}, 0 });
+	}
+
+	vector<InstanceData>& batchInstances = batches[batchIndex->second].instances;
+	batchInstances.insert(batchInstances.end(), instances, instances + count);
+	queuedInstanceCount += count;
+}
+
+void InstanceBatcher::upload(FrameRingBuffer& frameRingBuffer, const MeshPool& meshPool)
+{
+	if (queuedInstanceCount == 0) return;
+
+	// Every instance of the frame in one allocation, bound once per recording
+	RingAllocation allocation = frameRingBuffer.allocate(sizeof(InstanceData) * queuedInstanceCount, sizeof(glm::vec4));
+	InstanceData* instanceData = static_cast<InstanceData*>(allocation.data);
+	uploadOffset = allocation.offset;
+
+	// Instances of a batch are copied next to each other: one draw covers all of them,
+	// firstInstance tells where they start in the allocation
+	uint32_t firstInstance = 0;
+	for (InstanceBatch& batch : batches)
+	{
+		batch.firstInstance = firstInstance;
+		const glm::mat4& dequantization = meshPool.getMesh(batch.meshId).dequantization;
+		for (const InstanceData& instance : batch.instances)
+		{
+			InstanceData& uploaded = instanceData[firstInstance++];
+			uploaded.model = instance.model * dequantization;
+			uploaded.color = instance.color;
+		}
+	}
+}
+
+void InstanceBatcher::bindInstances(CommandRecorder& recorder, const FrameRingBuffer& frameRingBuffer) const
+{
+	if (queuedInstanceCount == 0) return;
+
+	recorder.bindVertexBuffer(INSTANCE_BINDING, frameRingBuffer.getBuffer(), uploadOffset);
+}
+
+void InstanceBatcher::recordBatch(CommandRecorder& recorder, const MeshPool& meshPool, size_t batchIndex) const
+{
+	const InstanceBatch& batch = batches[batchIndex];
+	if (batch.instances.empty()) return;
+
+	const MeshRange& mesh = meshPool.getMesh(batch.meshId);
+	uint32_t instanceCount = static_cast<uint32_t>(batch.instances.size());
+	recorder.drawIndexed(mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, batch.firstInstance);
+}
+
+void InstanceBatcher::clear()
+{
+	for (InstanceBatch& batch : batches)
+	{
+		batch.instances.clear();
+	}
+	queuedInstanceCount = 0;
+}
+
+vk::VertexInputBindingDescription InstanceBatcher::getBindingDescription()
+{
+	vk::VertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = INSTANCE_BINDING;
+	bindingDescription.stride = sizeof(InstanceData);
+	// Move to the next element once per instance, not per vertex
+	bindingDescription.inputRate = vk::VertexInputRate::eInstance;
+
+	return bindingDescription;
+}
+
+vector<vk::VertexInputAttributeDescription> InstanceBatcher::getAttributeDescriptions()
+{
+	vector<vk::VertexInputAttributeDescription> attributeDescriptions(5);
+
+	// A mat4 attribute takes 4 locations, one per column
+	for (uint32_t column = 0; column < 4; ++column)
+	{
+		attributeDescriptions[column].binding = INSTANCE_BINDING;
+		attributeDescriptions[column].location = FIRST_INSTANCE_LOCATION + column;
+		attributeDescriptions[column].format = vk::Format::eR32G32B32A32Sfloat;
+		attributeDescriptions[column].offset = static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * column);
+	}
+
+	attributeDescriptions[4].binding = INSTANCE_BINDING;
+	attributeDescriptions[4].location = FIRST_INSTANCE_LOCATION + 4;
+	attributeDescriptions[4].format = vk::Format::eR32G32B32A32Sfloat;
+	attributeDescriptions[4].offset = offsetof(InstanceData, color);
+
+	return attributeDescriptions;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "VulkanUtilities.h"
+#include "Mesh.h"
+#include "FrameRingBuffer.h"
+#include "CommandRecorder.h"
+
+
+/// Per-instance vertex stream, read with vk::VertexInputRate::eInstance.
+/// Matches the instance attributes of instanced.vert.
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 color; // Multiplies the vertex color
+};
+
+/// Hardware instancing: gathers the instances submitted for each mesh and material during a frame,
+/// writes them to the frame ring buffer and draws every mesh and material pair with a single
+/// instanced draw, whatever the number of copies.
+class InstanceBatcher
+{
+public:
+	/// Queue instances of a mesh for the next recorded frame
+	void addInstances(uint32_t meshId, uint32_t materialId, const InstanceData* instances, size_t count);
+	void addInstances(uint32_t meshId, uint32_t materialId, const vector<InstanceData>& instances)
+	{
+		addInstances(meshId, materialId, instances.data(), instances.size());
+	}
+
+	/// Copy the queued instances to the frame ring buffer, once per frame, before recording their draws.
+	/// Model matrices get the dequantization of their mesh on the way.
+	void upload(FrameRingBuffer& frameRingBuffer, const MeshPool& meshPool);
+	/// Bind the uploaded instances, before recording batches. Once per recording: several passes of a
+	/// frame can draw them, e.g. each shadow cascade and the main pass.
+	void bindInstances(CommandRecorder& recorder, const FrameRingBuffer& frameRingBuffer) const;
+	/// Issue the instanced draw of a batch. The instances, an instanced pipeline and the mesh pool index
+	/// buffer must be bound, the material id of the batch pushed. Batches without instances draw nothing.
+	void recordBatch(CommandRecorder& recorder, const MeshPool& meshPool, size_t batchIndex) const;
+	/// Empty the queue, once the frame is recorded
+	void clear();
+
+	// Vertex input description of the instance stream, for the pipeline creation
+	static const uint32_t INSTANCE_BINDING{ 1 };
+	static const uint32_t FIRST_INSTANCE_LOCATION{ 3 };
+	static vk::VertexInputBindingDescription getBindingDescription();
+	static vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
+
+	struct InstanceBatch
+	{
+		uint32_t meshId;
+		uint32_t materialId;
+		vector<InstanceData> instances;
+		uint32_t firstInstance; // In the upload
+	};
+	/// Batches of every mesh and material queued so far, in the order recordBatch takes their index.
+	/// Some are empty: batches are kept when the queue is cleared.
+	const vector<InstanceBatch>& getBatches() const { return batches; }
+
+private:
+	size_t queuedInstanceCount{ 0 };
+	vk::DeviceSize uploadOffset{ 0 }; // In the frame ring buffer
+
+	// Queued instances, by mesh and material. Batches and their vectors are kept from
+	// one frame to the next, so that the capacity is reused.
+	vector<InstanceBatch> batches;
+	std::unordered_map<uint64_t, size_t> batchIndices; // (meshId << 32 | materialId) -> index in batches
+};
@@ -0,0 +1,107 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <memory>
+
+
+void JobSystem::init(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		// hardware_concurrency may return 0 when it does not know
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	stopping = false;
+	workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back(&JobSystem::workerLoop, this);
+	}
+}
+
+void JobSystem::clean()
+{
+	{
+		std::lock_guard<std::mutex> lock{ queueMutex };
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock{ queueMutex };
+		jobs.push_back(std::move(job));
+	}
+	queueCondition.notify_one();
+}
+
+void JobSystem::parallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0) return;
+	batchSize = std::max<size_t>(batchSize, 1);
+	const size_t batchCount = (count + batchSize - 1) / batchSize;
+
+	// Batches are claimed with an atomic counter by whoever is free, so the work balances itself.
+	// Helper jobs may start after everything is done: the shared state has to outlive this call.
+	struct ParallelForState
+	{
+		std::atomic<size_t> nextBatch{ 0 };
+		std::atomic<size_t> finishedBatches{ 0 };
+	};
+	auto state = std::make_shared<ParallelForState>();
+
+	auto runBatches = [state, count, batchSize, batchCount, &body]()
+	{
+		size_t batch;
+		while ((batch = state->nextBatch.fetch_add(1)) < batchCount)
+		{
+			size_t begin = batch * batchSize;
+			body(begin, std::min(begin + batchSize, count));
+			state->finishedBatches.fetch_add(1);
+		}
+	};
+
+	// No point in waking more workers than there are batches left for them
+	size_t helperCount = std::min<size_t>(workers.size(), batchCount - 1);
+	for (size_t i = 0; i < helperCount; ++i)
+	{
+		// body is only used while batches remain, which is before this call returns
+		submit(runBatches);
+	}
+
+	runBatches();
+
+	// The last batches may still be running on workers
+	while (state->finishedBatches.load() < batchCount)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock{ queueMutex };
+			queueCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return; // Stopping, and nothing left to do
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+using std::vector;
+
+
+/// Fixed pool of worker threads running jobs from a shared queue.
+/// Loading work (image decoding...) is submitted as independent jobs, per-frame
+/// work is split with parallelFor, in which the calling thread takes part.
+class JobSystem
+{
+public:
+	/// threadCount 0: one worker per hardware thread, minus the calling thread
+	void init(uint32_t threadCount = 0);
+	/// Finish the queued jobs and join the workers
+	void clean();
+
+	/// Run a job on a worker, whenever one is free
+	void submit(std::function<void()> job);
+
+	/// Call body(begin, end) on consecutive ranges of at most batchSize items, covering [0, count).
+	/// Ranges run in parallel on the workers and on the calling thread. Returns once all are done.
+	/// Safe to call from inside a job: the caller never waits for a job that has not started.
+	void parallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& body);
+
+	uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	vector<std::thread> workers;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition; // Signaled when a job is queued or when stopping
+	std::deque<std::function<void()>> jobs;
+	bool stopping{ false };
+
+	void workerLoop();
+};
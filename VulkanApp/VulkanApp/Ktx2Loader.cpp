@@ -0,0 +1,222 @@
+#include "Ktx2Loader.h"
+
+#include <algorithm>
+
+
+//v Formats ======================================================
+FormatBlock getFormatBlock(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Srgb:
+		return { 1, 1, 4 };
+	// 8 bytes per 4x4 block
+	case vk::Format::eBc1RgbUnormBlock:
+	case vk::Format::eBc1RgbSrgbBlock:
+	case vk::Format::eBc1RgbaUnormBlock:
+	case vk::Format::eBc1RgbaSrgbBlock:
+	case vk::Format::eBc4UnormBlock:
+	case vk::Format::eBc4SnormBlock:
+	case vk::Format::eEtc2R8G8B8UnormBlock:
+	case vk::Format::eEtc2R8G8B8SrgbBlock:
+	case vk::Format::eEacR11UnormBlock:
+		return { 4, 4, 8 };
+	// 16 bytes per 4x4 block
+	case vk::Format::eBc3UnormBlock:
+	case vk::Format::eBc3SrgbBlock:
+	case vk::Format::eBc5UnormBlock:
+	case vk::Format::eBc5SnormBlock:
+	case vk::Format::eBc7UnormBlock:
+	case vk::Format::eBc7SrgbBlock:
+	case vk::Format::eEtc2R8G8B8A8UnormBlock:
+	case vk::Format::eEtc2R8G8B8A8SrgbBlock:
+	case vk::Format::eEacR11G11UnormBlock:
+	case vk::Format::eAstc4x4UnormBlock:
+	case vk::Format::eAstc4x4SrgbBlock:
+		return { 4, 4, 16 };
+	default:
+		throw std::runtime_error("Unsupported texture format: " + vk::to_string(format));
+	}
+}
+
+bool isBlockCompressed(vk::Format format)
+{
+	return getFormatBlock(format).width > 1;
+}
+//^ Formats ======================================================
+//v KTX2 =========================================================
+// File layout: identifier, header, index, level index, then data format descriptor,
+// key/value data, supercompression global data and the levels themselves.
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header
+	{
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		// Index
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	const size_t HEADER_OFFSET{ sizeof(KTX2_IDENTIFIER) };
+	const size_t LEVEL_INDEX_OFFSET{ HEADER_OFFSET + 9 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t) };
+
+	struct Ktx2Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	const uint32_t SUPERCOMPRESSION_NONE{ 0 };
+	const uint32_t SUPERCOMPRESSION_BASIS_LZ{ 1 };
+	// Khronos data format descriptor color models
+	const uint8_t COLOR_MODEL_UASTC{ 166 };
+
+	// Reads a little endian value, like the file (and x86) stores them
+	template<typename T>
+	T readValue(const vector<uint8_t>& file, size_t offset)
+	{
+		if (offset + sizeof(T) > file.size())
+		{
+			throw std::runtime_error("Truncated KTX2 file");
+		}
+		T value;
+		memcpy(&value, &file[offset], sizeof(T));
+		return value;
+	}
+
+	Ktx2Header readHeader(const vector<uint8_t>& file)
+	{
+		if (file.size() < LEVEL_INDEX_OFFSET || memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			throw std::runtime_error("Not a KTX2 file");
+		}
+
+		Ktx2Header header;
+		size_t offset = HEADER_OFFSET;
+		header.vkFormat = readValue<uint32_t>(file, offset); offset += 4;
+		header.typeSize = readValue<uint32_t>(file, offset); offset += 4;
+		header.pixelWidth = readValue<uint32_t>(file, offset); offset += 4;
+		header.pixelHeight = readValue<uint32_t>(file, offset); offset += 4;
+		header.pixelDepth = readValue<uint32_t>(file, offset); offset += 4;
+		header.layerCount = readValue<uint32_t>(file, offset); offset += 4;
+		header.faceCount = readValue<uint32_t>(file, offset); offset += 4;
+		header.levelCount = readValue<uint32_t>(file, offset); offset += 4;
+		header.supercompressionScheme = readValue<uint32_t>(file, offset); offset += 4;
+		header.dfdByteOffset = readValue<uint32_t>(file, offset); offset += 4;
+		header.dfdByteLength = readValue<uint32_t>(file, offset); offset += 4;
+		header.kvdByteOffset = readValue<uint32_t>(file, offset); offset += 4;
+		header.kvdByteLength = readValue<uint32_t>(file, offset); offset += 4;
+		header.sgdByteOffset = readValue<uint64_t>(file, offset); offset += 8;
+		header.sgdByteLength = readValue<uint64_t>(file, offset);
+
+		if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1
+			|| header.layerCount > 1 || header.faceCount != 1)
+		{
+			throw std::runtime_error("Only 2D KTX2 textures are supported, without layers or faces");
+		}
+		return header;
+	}
+
+	Ktx2Level readLevel(const vector<uint8_t>& file, uint32_t level)
+	{
+		size_t offset = LEVEL_INDEX_OFFSET + level * 3 * sizeof(uint64_t);
+		Ktx2Level entry;
+		entry.byteOffset = readValue<uint64_t>(file, offset);
+		entry.byteLength = readValue<uint64_t>(file, offset + 8);
+		entry.uncompressedByteLength = readValue<uint64_t>(file, offset + 16);
+		return entry;
+	}
+}
+
+Ktx2Info readKtx2Info(const vector<uint8_t>& file)
+{
+	Ktx2Header header = readHeader(file);
+
+	Ktx2Info info;
+	info.format = static_cast<vk::Format>(header.vkFormat);
+	info.width = header.pixelWidth;
+	info.height = header.pixelHeight;
+	info.levelCount = header.levelCount;
+
+	if (header.supercompressionScheme == SUPERCOMPRESSION_BASIS_LZ)
+	{
+		info.encoding = Ktx2Encoding::BasisEtc1s;
+	}
+	else if (info.format == vk::Format::eUndefined)
+	{
+		// UASTC is told by the color model of the data format descriptor:
+		// total size (4 bytes), then the basic descriptor block, color model at byte 8
+		uint8_t colorModel = readValue<uint8_t>(file, header.dfdByteOffset + 4 + 8);
+		if (colorModel != COLOR_MODEL_UASTC)
+		{
+			throw std::runtime_error("KTX2 file with an undefined format that is not UASTC");
+		}
+		info.encoding = Ktx2Encoding::BasisUastc;
+	}
+	else
+	{
+		info.encoding = Ktx2Encoding::Native;
+	}
+
+	return info;
+}
+
+TextureData loadKtx2(const vector<uint8_t>& file)
+{
+	Ktx2Info info = readKtx2Info(file);
+	if (info.encoding != Ktx2Encoding::Native)
+	{
+		throw std::runtime_error("Basis Universal KTX2 files are not supported, encode them to BCn, ETC2 or ASTC");
+	}
+	if (readHeader(file).supercompressionScheme != SUPERCOMPRESSION_NONE)
+	{
+		throw std::runtime_error("Supercompressed KTX2 files are not supported");
+	}
+
+	TextureData texture;
+	texture.format = info.format;
+	texture.width = info.width;
+	texture.height = info.height;
+
+	const FormatBlock block = getFormatBlock(info.format);
+	const uint32_t levelCount = std::max(info.levelCount, 1u);
+
+	// Levels are copied largest first. Offsets stay multiples of 16 bytes, which satisfies
+	// the buffer to image copy alignment (a multiple of the block size and of 4) of every format here.
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		Ktx2Level entry = readLevel(file, level);
+
+		uint32_t levelWidth = std::max(info.width >> level, 1u);
+		uint32_t levelHeight = std::max(info.height >> level, 1u);
+		uint64_t expectedLength = static_cast<uint64_t>((levelWidth + block.width - 1) / block.width)
+			* ((levelHeight + block.height - 1) / block.height) * block.size;
+		if (entry.byteLength != expectedLength || entry.byteOffset + entry.byteLength > file.size())
+		{
+			throw std::runtime_error("Invalid KTX2 level");
+		}
+
+		vk::DeviceSize offset = (texture.data.size() + 15) & ~vk::DeviceSize(15);
+		texture.levelOffsets.push_back(offset);
+		texture.data.resize(static_cast<size_t>(offset + entry.byteLength));
+		memcpy(&texture.data[static_cast<size_t>(offset)], &file[static_cast<size_t>(entry.byteOffset)], static_cast<size_t>(entry.byteLength));
+	}
+
+	return texture;
+}
+//^ KTX2 =========================================================
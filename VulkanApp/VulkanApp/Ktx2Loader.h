@@ -0,0 +1,55 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+
+
+/// Texel data ready to be copied to an image: one or more mip levels, largest first,
+/// tightly packed in data at levelOffsets. Block compressed levels are stored as blocks.
+struct TextureData
+{
+	vk::Format format{ vk::Format::eUndefined };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	vector<vk::DeviceSize> levelOffsets; // One per level present in data
+	vector<uint8_t> data;
+
+	uint32_t getLevelCount() const { return static_cast<uint32_t>(levelOffsets.size()); }
+};
+
+/// Texel block of a format: compressed formats store 4x4 texels per block
+struct FormatBlock
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t size; // Bytes
+};
+
+/// Block of the formats textures can be loaded in. Throws for any other format.
+FormatBlock getFormatBlock(vk::Format format);
+bool isBlockCompressed(vk::Format format);
+
+/// What a KTX2 file holds
+enum class Ktx2Encoding
+{
+	Native, // Texels already in a Vulkan format: BCn, ETC2, ASTC or uncompressed
+	BasisEtc1s, // Basis Universal, BasisLZ/ETC1S supercompression. Not loadable.
+	BasisUastc // Basis Universal UASTC. Not loadable.
+};
+
+struct Ktx2Info
+{
+	Ktx2Encoding encoding;
+	vk::Format format; // eUndefined for Basis files
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount; // Levels stored in the file, 0 means "generate them"
+};
+
+/// Read the header of a KTX2 file (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html).
+/// Only 2D textures, without array layers or cube faces, are supported.
+Ktx2Info readKtx2Info(const vector<uint8_t>& file);
+
+/// Load a native KTX2 file: every level goes to TextureData, with one level per mip.
+/// Throws for Basis Universal files, which would need a transcoder this tree does not have,
+/// and for Zstandard supercompression.
+TextureData loadKtx2(const vector<uint8_t>& file);
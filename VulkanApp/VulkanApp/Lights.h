@@ -0,0 +1,20 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+
+
+/// Point light, rewritten every frame. Layout matches the std430 PointLight struct of the lighting shaders.
+struct GpuPointLight
+{
+	glm::vec4 positionRadius; // World space position, radius past which the light has no effect
+	glm::vec4 color; // rgb, premultiplied by the intensity
+};
+
+/// Spot light, rewritten every frame: a point light restricted to a cone.
+/// Layout matches the std430 SpotLight struct of the clustered shaders.
+struct GpuSpotLight
+{
+	glm::vec4 positionRadius; // World space position, radius past which the light has no effect
+	glm::vec4 color; // rgb, premultiplied by the intensity. w: cosine of the half angle where the edge falloff starts
+	glm::vec4 directionCosAngle; // World space direction of the cone axis, normalized. w: cosine of the cone half angle
+};
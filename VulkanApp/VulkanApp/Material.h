@@ -0,0 +1,13 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+
+
+/// Material parameters, stored in a storage buffer registered in the bindless set.
+/// Layout matches the std430 Material struct of shader.frag.
+struct GpuMaterial
+{
+	glm::vec4 baseColor; // Multiplies the vertex color
+	uint32_t albedoTexture; // Index in the bindless textures, BindlessDescriptors::INVALID_INDEX if none
+	uint32_t padding[3];
+};
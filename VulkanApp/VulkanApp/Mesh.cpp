@@ -0,0 +1,212 @@
+#include "Mesh.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+uint32_t MeshPool::addMesh(const MeshData& mesh)
+{
+	if (vertexBuffer)
+	{
+		throw std::runtime_error("Can't add a mesh to a mesh pool already uploaded");
+	}
+
+	MeshRange range{};
+	range.firstIndex = static_cast<uint32_t>(indices.size());
+	range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	// Mesh indices stay relative to the mesh, the draw adds the offset
+	range.vertexOffset = static_cast<int32_t>(vertices.size());
+
+	// Bounding sphere centered on the bounding box, big enough to hold every vertex
+	glm::vec3 minPosition{ std::numeric_limits<float>::max() };
+	glm::vec3 maxPosition{ -std::numeric_limits<float>::max() };
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.position);
+		maxPosition = glm::max(maxPosition, vertex.position);
+	}
+	glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+	float radius = 0.0f;
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		radius = std::max(radius, glm::length(vertex.position - center));
+	}
+	range.boundingSphere = glm::vec4(center, radius);
+
+	// Positions are spread over the whole snorm16 range along each axis of the bounding box.
+	// A flat axis keeps a non-zero extent, for the dequantization to stay invertible.
+	glm::vec3 halfExtent = glm::max((maxPosition - minPosition) * 0.5f, glm::vec3(1e-6f));
+	range.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), center), halfExtent);
+	vertices.reserve(vertices.size() + mesh.vertices.size());
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		glm::vec3 position = glm::round(glm::clamp((vertex.position - center) / halfExtent, -1.0f, 1.0f) * 32767.0f);
+		glm::vec3 color = glm::round(glm::clamp(vertex.color, 0.0f, 1.0f) * 255.0f);
+
+		QuantizedVertex quantized;
+		quantized.position = glm::i16vec4(glm::ivec3(position), 32767);
+		quantized.color = glm::u8vec4(glm::uvec3(color), 255);
+		quantized.uv = glm::u16vec2(glm::packHalf1x16(vertex.uv.x), glm::packHalf1x16(vertex.uv.y));
+		vertices.push_back(quantized);
+	}
+	indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+	// Levels of detail follow the full mesh in the index buffer, they reuse its vertices
+	range.lods[0] = MeshLodRange{ range.firstIndex, range.indexCount, 0.0f };
+	range.lodCount = 1;
+	for (const MeshLodData& lod : mesh.lods)
+	{
+		if (range.lodCount == MAX_MESH_LODS)
+		{
+			throw std::runtime_error("Too many levels of detail for a mesh");
+		}
+		range.lods[range.lodCount++] = MeshLodRange{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.indices.size()), lod.error };
+		indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+	}
+
+	// Then meshlets: the full mesh again, in other triangle ranges
+	range.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+	range.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	for (const MeshletData& meshlet : mesh.meshlets)
+	{
+		meshlets.push_back(MeshletRange{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(meshlet.indices.size()),
+			meshlet.boundingSphere, meshlet.cone });
+		indices.insert(indices.end(), meshlet.indices.begin(), meshlet.indices.end());
+	}
+	meshes.push_back(range);
+
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+void MeshPool::upload(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool)
+{
+	if (vertices.empty()) return;
+
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		vertices.data(), sizeof(QuantizedVertex) * vertices.size(), vk::BufferUsageFlagBits::eVertexBuffer,
+		&vertexBuffer, &vertexBufferMemory);
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		indices.data(), sizeof(uint32_t) * indices.size(), vk::BufferUsageFlagBits::eIndexBuffer,
+		&indexBuffer, &indexBufferMemory);
+
+	vertices = vector<QuantizedVertex>();
+	indices = vector<uint32_t>();
+}
+
+void MeshPool::clean(vk::Device device)
+{
+	device.destroyBuffer(indexBuffer);
+	device.freeMemory(indexBufferMemory);
+	device.destroyBuffer(vertexBuffer);
+	device.freeMemory(vertexBufferMemory);
+}
+
+//v Primitives ===================================================
+// Faces are wound counter-clockwise when seen from outside
+
+MeshData createCubeMesh(const glm::vec3& color)
+{
+	MeshData mesh;
+
+	// One quad per face, so that each face can be shaded differently
+	const glm::vec3 normals[6]{
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+	};
+	for (const glm::vec3& normal : normals)
+	{
+		// Two axes spanning the face, such that tangent x bitangent = normal
+		glm::vec3 tangent = normal.x != 0.0f ? glm::vec3{ 0, normal.x, 0 } : glm::vec3{ normal.y + normal.z, 0, 0 };
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		// Darken faces a bit differently so that edges are readable without lighting
+		glm::vec3 faceColor = color * (0.7f + 0.3f * glm::abs(normal.y) + 0.15f * glm::abs(normal.x));
+
+		uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+		mesh.vertices.push_back({ (normal - tangent - bitangent) * 0.5f, faceColor, { 0.0f, 1.0f } });
+		mesh.vertices.push_back({ (normal + tangent - bitangent) * 0.5f, faceColor, { 1.0f, 1.0f } });
+		mesh.vertices.push_back({ (normal + tangent + bitangent) * 0.5f, faceColor, { 1.0f, 0.0f } });
+		mesh.vertices.push_back({ (normal - tangent + bitangent) * 0.5f, faceColor, { 0.0f, 0.0f } });
+
+		mesh.indices.insert(mesh.indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+	}
+
+	return mesh;
+}
+
+MeshData createPyramidMesh(const glm::vec3& color)
+{
+	MeshData mesh;
+
+	const glm::vec3 top{ 0.0f, 0.5f, 0.0f };
+	const glm::vec3 base[4]{
+		{ -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f }
+	};
+
+	// Sides
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		glm::vec3 sideColor = color * (0.6f + 0.1f * i);
+		uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+		mesh.vertices.push_back({ base[i], sideColor, { 0.0f, 1.0f } });
+		mesh.vertices.push_back({ base[(i + 1) % 4], sideColor, { 1.0f, 1.0f } });
+		mesh.vertices.push_back({ top, sideColor, { 0.5f, 0.0f } });
+		mesh.indices.insert(mesh.indices.end(), { first, first + 1, first + 2 });
+	}
+
+	// Base, seen from below
+	uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+	for (const glm::vec3& corner : base)
+	{
+		// Base projected on the XZ plane
+		mesh.vertices.push_back({ corner, color * 0.5f, { corner.x + 0.5f, corner.z + 0.5f } });
+	}
+	mesh.indices.insert(mesh.indices.end(), { first, first + 3, first + 2, first + 2, first + 1, first });
+
+	return mesh;
+}
+
+MeshData createSphereMesh(const glm::vec3& color, uint32_t rings, uint32_t segments)
+{
+	MeshData mesh;
+
+	// A grid wrapped around the sphere. The first and last columns meet, at the same positions with different uvs.
+	const float pi = glm::pi<float>();
+	for (uint32_t ring = 0; ring <= rings; ++ring)
+	{
+		float v = static_cast<float>(ring) / rings;
+		float polar = v * pi;
+		// Exactly on the axis at the poles, their vertices share one position
+		float ringRadius = ring == 0 || ring == rings ? 0.0f : sin(polar);
+		for (uint32_t segment = 0; segment <= segments; ++segment)
+		{
+			float u = static_cast<float>(segment) / segments;
+			float azimuth = static_cast<float>(segment % segments) / segments * 2.0f * pi;
+			glm::vec3 position{ ringRadius * cos(azimuth), cos(polar), ringRadius * sin(azimuth) };
+			// Lighter on top, so that the shape is readable without lighting
+			glm::vec3 vertexColor = color * (0.5f + 0.5f * (position.y * 0.5f + 0.5f));
+			mesh.vertices.push_back({ position * 0.5f, vertexColor, { u, v } });
+		}
+	}
+
+	const uint32_t columns = segments + 1;
+	for (uint32_t ring = 0; ring < rings; ++ring)
+	{
+		for (uint32_t segment = 0; segment < segments; ++segment)
+		{
+			uint32_t topLeft = ring * columns + segment;
+			uint32_t bottomLeft = topLeft + columns;
+			// The triangles touching the poles are degenerate: all their top (bottom) corners are the pole
+			if (ring != 0)
+			{
+				mesh.indices.insert(mesh.indices.end(), { topLeft, topLeft + 1, bottomLeft });
+			}
+			if (ring != rings - 1)
+			{
+				mesh.indices.insert(mesh.indices.end(), { topLeft + 1, bottomLeft + 1, bottomLeft });
+			}
+		}
+	}
+
+	return mesh;
+}
+//^ Primitives ===================================================
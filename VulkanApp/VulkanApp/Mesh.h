@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+
+#include <glm/gtc/type_precision.hpp>
+
+#include "VulkanUtilities.h"
+
+
+// Levels of detail of a mesh, the full mesh included
+const uint32_t MAX_MESH_LODS = 4;
+// Largest meshlets: the usual mesh shader output sizes, vertices and triangles a workgroup handles at once
+const uint32_t MAX_MESHLET_VERTICES = 64;
+const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+/// Simplified version of a mesh: other triangles, made of the same vertices
+struct MeshLodData
+{
+	vector<uint32_t> indices;
+	float error{ 0.0f }; // Object space: how far these triangles may be from the full mesh
+};
+
+/// Small cluster of triangles of the full mesh, culled on its own
+struct MeshletData
+{
+	vector<uint32_t> indices; // Into the mesh vertices, at most MAX_MESHLET_VERTICES different ones
+	glm::vec4 boundingSphere; // Local space: xyz center, w radius
+	// Normal cone, xyz axis and w cutoff: every triangle faces away from a viewpoint v where
+	// dot(center - v, axis) >= cutoff * length(center - v) + radius. Cutoff 1 for a cone too wide to ever cull.
+	glm::vec4 cone;
+};
+
+/// Geometry of a mesh, on the CPU side
+struct MeshData
+{
+	vector<Vertex> vertices;
+	vector<uint32_t> indices;
+	vector<MeshLodData> lods; // Coarser and coarser, after the full mesh. Cooked by buildMeshLods.
+	vector<MeshletData> meshlets; // Same triangles as the full mesh. Cooked by buildMeshlets.
+};
+
+/// Vertex as stored on the GPU by a MeshPool: 16 bytes instead of the 32 of Vertex.
+/// The position is snorm16 inside the mesh bounding box, which MeshRange::dequantization maps back.
+struct QuantizedVertex
+{
+	glm::i16vec4 position; // vk::Format::eR16G16B16A16Snorm, w is unused
+	glm::u8vec4 color; // vk::Format::eR8G8B8A8Unorm, a is unused
+	glm::u16vec2 uv; // vk::Format::eR16G16Sfloat: half floats, to keep tiling textures past 1
+};
+
+/// Indices of a level of detail in the shared index buffer
+struct MeshLodRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // Object space, 0 for the full mesh
+};
+
+/// Indices and bounds of a meshlet in the shared index buffer
+struct MeshletRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	glm::vec4 boundingSphere; // Local space
+	glm::vec4 cone;
+};
+
+/// Where a mesh lives inside the shared vertex and index buffers of a MeshPool.
+/// Those are the values a (indirect) indexed draw needs.
+struct MeshRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	// Local space bounding sphere: xyz center, w radius
+	glm::vec4 boundingSphere;
+	// Quantized positions to local space: draws multiply it on the right of the model matrix
+	glm::mat4 dequantization;
+	// The full mesh first (same indices as above), then coarser and coarser. Same vertexOffset for all.
+	std::array<MeshLodRange, MAX_MESH_LODS> lods;
+	uint32_t lodCount;
+	// In the meshlets of the pool, none if the mesh is only drawn whole. Same vertexOffset.
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+};
+
+/// Every static mesh of the scene packed in one vertex buffer and one index buffer,
+/// so that all of them can be drawn with a single bind and a single indirect draw.
+/// Vertices are quantized to QuantizedVertex as they are added.
+class MeshPool
+{
+public:
+	/// Queue CPU data for upload and return the mesh id
+	uint32_t addMesh(const MeshData& mesh);
+
+	/// Send every added mesh to device local memory. Meshes can't be added afterwards.
+	void upload(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool);
+
+	void clean(vk::Device device);
+
+	const MeshRange& getMesh(uint32_t meshId) const { return meshes[meshId]; }
+	uint32_t getMeshCount() const { return static_cast<uint32_t>(meshes.size()); }
+	const MeshletRange& getMeshlet(uint32_t meshletId) const { return meshlets[meshletId]; }
+	uint32_t getMeshletCount() const { return static_cast<uint32_t>(meshlets.size()); }
+	vk::Buffer getVertexBuffer() const { return vertexBuffer; }
+	vk::Buffer getIndexBuffer() const { return indexBuffer; }
+
+private:
+	vector<MeshRange> meshes;
+	vector<MeshletRange> meshlets;
+
+	// CPU copies, released once uploaded
+	vector<QuantizedVertex> vertices;
+	vector<uint32_t> indices;
+
+	vk::Buffer vertexBuffer;
+	vk::DeviceMemory vertexBufferMemory;
+	vk::Buffer indexBuffer;
+	vk::DeviceMemory indexBufferMemory;
+};
+
+//v Primitives ===================================================
+MeshData createCubeMesh(const glm::vec3& color);
+MeshData createPyramidMesh(const glm::vec3& color);
+/// Radius 0.5, rings from pole to pole and segments around: 2 * (rings - 1) * segments triangles
+MeshData createSphereMesh(const glm::vec3& color, uint32_t rings, uint32_t segments);
+//^ Primitives ===================================================
@@ -0,0 +1,295 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+VertexCacheStatistics analyzeVertexCache(const vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	// Time each vertex entered the cache: it is still there while fewer than cacheSize vertices entered since
+	vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+	vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for (uint32_t index : indices)
+	{
+		if (timestamp - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = timestamp++;
+			++misses;
+		}
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			++referencedCount;
+		}
+	}
+
+	VertexCacheStatistics statistics{};
+	size_t triangleCount = indices.size() / 3;
+	statistics.acmr = triangleCount == 0 ? 0.0f : static_cast<float>(misses) / triangleCount;
+	statistics.atvr = referencedCount == 0 ? 0.0f : static_cast<float>(misses) / referencedCount;
+	return statistics;
+}
+
+//v Vertex cache =================================================
+// Scoring of Tom Forsyth's article, with its constants. Modeled cache: LRU of 32 vertices.
+static const uint32_t FORSYTH_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+/// cachePosition: -1 when not in the cache. remainingTriangles: not drawn yet, using the vertex.
+static float getVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	// Nothing left to draw with it
+	if (remainingTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// Used by the last triangle: fixed score, so that strips are not always preferred over fans
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+	// Vertices with few triangles left get them done, instead of leaving them alone and paying for them later
+	score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void optimizeVertexCache(vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// -- ADJACENCY --
+	// Triangles of each vertex, packed: vertexTriangles[vertexOffsets[v] .. + vertexRemaining[v]]
+	vector<uint32_t> vertexRemaining(vertexCount, 0);
+	for (uint32_t index : indices) ++vertexRemaining[index];
+	vector<uint32_t> vertexOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) vertexOffsets[v + 1] = vertexOffsets[v] + vertexRemaining[v];
+	vector<uint32_t> vertexTriangles(indices.size());
+	{
+		vector<uint32_t> fill(vertexOffsets.begin(), vertexOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	// -- SCORES --
+	vector<int> cachePositions(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) vertexScores[v] = getVertexScore(-1, vertexRemaining[v]);
+	vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+	vector<bool> triangleDrawn(triangleCount, false);
+
+	// -- ORDER --
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+	// The cache may hold 3 more vertices while being updated, they fall out right after
+	vector<uint32_t> cache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	vector<uint32_t> newCache;
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t linearCursor = 0; // Triangles before it are all drawn
+	int64_t bestTriangle = -1;
+	for (size_t drawn = 0; drawn < triangleCount; ++drawn)
+	{
+		if (bestTriangle < 0)
+		{
+			// Nothing in the cache is worth anything: best score of all the remaining triangles
+			float bestScore = -std::numeric_limits<float>::max();
+			while (triangleDrawn[linearCursor]) ++linearCursor;
+			for (size_t t = linearCursor; t < triangleCount; ++t)
+			{
+				if (!triangleDrawn[t] && triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = static_cast<int64_t>(t);
+				}
+			}
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		triangleDrawn[bestTriangle] = true;
+
+		// Its vertices go to the front of the cache, the others move back
+		newCache.clear();
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t v = triangle[corner];
+			newCache.push_back(v);
+			// Done with this triangle: remove it from the triangles left to the vertex
+			uint32_t* first = &vertexTriangles[vertexOffsets[v]];
+			uint32_t* last = first + vertexRemaining[v];
+			*std::find(first, last, static_cast<uint32_t>(bestTriangle)) = *(last - 1);
+			--vertexRemaining[v];
+		}
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache.push_back(v);
+		}
+		for (uint32_t v : cache) cachePositions[v] = -1;
+		std::swap(cache, newCache);
+
+		// Rescore the vertices of the cache, and the triangles around them; remember the best of those
+		float bestScore = -std::numeric_limits<float>::max();
+		bestTriangle = -1;
+		for (uint32_t position = 0; position < cache.size(); ++position)
+		{
+			uint32_t v = cache[position];
+			int cachePosition = position < FORSYTH_CACHE_SIZE ? static_cast<int>(position) : -1;
+			cachePositions[v] = cachePosition;
+			float scoreChange = getVertexScore(cachePosition, vertexRemaining[v]) - vertexScores[v];
+			vertexScores[v] += scoreChange;
+			for (uint32_t i = vertexOffsets[v]; i < vertexOffsets[v] + vertexRemaining[v]; ++i)
+			{
+				uint32_t t = vertexTriangles[i];
+				triangleScores[t] += scoreChange;
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+		if (cache.size() > FORSYTH_CACHE_SIZE) cache.resize(FORSYTH_CACHE_SIZE);
+	}
+
+	indices = std::move(result);
+}
+//^ Vertex cache =================================================
+//v Overdraw =====================================================
+void optimizeOverdraw(vector<uint32_t>& indices, const vector<Vertex>& vertices)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// -- CLUSTERS --
+	// A new cluster starts at each triangle of three cache misses: the cache was cold there already
+	const uint32_t cacheSize = 16;
+	vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+	uint32_t timestamp = cacheSize + 1;
+	vector<size_t> clusterStarts;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		uint32_t misses = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t index = indices[t * 3 + corner];
+			if (timestamp - cacheTimestamps[index] > cacheSize)
+			{
+				cacheTimestamps[index] = timestamp++;
+				++misses;
+			}
+		}
+		if (t == 0 || misses == 3) clusterStarts.push_back(t);
+	}
+	clusterStarts.push_back(triangleCount);
+	const size_t clusterCount = clusterStarts.size() - 1;
+
+	// -- SORT --
+	// Area weighted centroid and normal of each cluster, and of the mesh
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+	vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3{ 0.0f });
+	vector<glm::vec3> clusterNormals(clusterCount, glm::vec3{ 0.0f });
+	for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStarts[cluster]; t < clusterStarts[cluster + 1]; ++t)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal) * 0.5f;
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+			clusterCentroids[cluster] += centroid * area;
+			clusterNormals[cluster] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[cluster];
+		meshArea += clusterArea;
+		if (clusterArea > 0.0f) clusterCentroids[cluster] /= clusterArea;
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	// Clusters facing away from the center are on the outside of the mesh, and the most likely to hide the others
+	vector<float> sortKeys(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		float normalLength = glm::length(clusterNormals[cluster]);
+		glm::vec3 normal = normalLength > 0.0f ? clusterNormals[cluster] / normalLength : glm::vec3{ 0.0f };
+		sortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, normal);
+	}
+	vector<uint32_t> clusterOrder(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster) clusterOrder[cluster] = cluster;
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+		[&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t cluster : clusterOrder)
+	{
+		result.insert(result.end(), indices.begin() + clusterStarts[cluster] * 3, indices.begin() + clusterStarts[cluster + 1] * 3);
+	}
+	indices = std::move(result);
+}
+//^ Overdraw =====================================================
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+	const uint32_t UNUSED = 0xFFFFFFFF;
+	vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+	vector<Vertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	// The full mesh first, drawn up close: its fetches matter the most
+	auto remapIndices = [&](vector<uint32_t>& indices)
+	{
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UNUSED)
+			{
+				remap[index] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(mesh.vertices[index]);
+			}
+			index = remap[index];
+		}
+	};
+	remapIndices(mesh.indices);
+	for (MeshLodData& lod : mesh.lods)
+	{
+		remapIndices(lod.indices);
+	}
+	mesh.vertices = std::move(vertices);
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+	optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	optimizeOverdraw(mesh.indices, mesh.vertices);
+	for (MeshLodData& lod : mesh.lods)
+	{
+		optimizeVertexCache(lod.indices, mesh.vertices.size());
+		optimizeOverdraw(lod.indices, mesh.vertices);
+	}
+	optimizeVertexFetch(mesh);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Mesh.h"
+
+
+/// How well an index buffer uses the post-transform vertex cache, simulated as a FIFO of cacheSize vertices.
+/// ACMR: vertices shaded per triangle (0.5 at best on a regular grid, 3 at worst).
+/// ATVR: vertices shaded per vertex referenced (1 at best).
+struct VertexCacheStatistics
+{
+	float acmr;
+	float atvr;
+};
+VertexCacheStatistics analyzeVertexCache(const vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+/// Reorder triangles so that the vertices they share are still in the vertex cache when they come back
+/// (Tom Forsyth's linear-speed vertex cache optimisation): the next triangle is the best scored one
+/// among those using cached vertices, scored on cache position and on triangles left to their vertices.
+void optimizeVertexCache(vector<uint32_t>& indices, size_t vertexCount);
+
+/// Reorder clusters of triangles so that the outside of the mesh is drawn first and hides the rest
+/// from the depth test. Clusters start where the vertex cache is cold anyway: cache efficiency is kept.
+/// Expects cache optimized indices.
+void optimizeOverdraw(vector<uint32_t>& indices, const vector<Vertex>& vertices);
+
+/// Reorder vertices in the order the indices first use them, so that fetches go forward through memory.
+/// The vertices no index uses are dropped. Every index buffer of the mesh (levels of detail too) is remapped.
+void optimizeVertexFetch(MeshData& mesh);
+
+/// Cooking of a mesh in arbitrary triangle order: vertex cache, then overdraw, for the full mesh and each
+/// level of detail, then vertex fetch for all of them. Triangles only change order, the mesh looks the same.
+void optimizeMesh(MeshData& mesh);
@@ -0,0 +1,314 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+
+/// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix, and the total weight of the planes
+struct Quadric
+{
+	// xx xy xz xw yy yz yw zz zw ww
+	double m[10]{};
+	double weight{ 0.0 };
+
+	void addPlane(const glm::dvec3& normal, double distance, double planeWeight)
+	{
+		const double plane[4]{ normal.x, normal.y, normal.z, distance };
+		int k = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = i; j < 4; ++j)
+			{
+				m[k++] += plane[i] * plane[j] * planeWeight;
+			}
+		}
+		weight += planeWeight;
+	}
+
+	void add(const Quadric& other)
+	{
+		for (int k = 0; k < 10; ++k) m[k] += other.m[k];
+		weight += other.weight;
+	}
+
+	/// Root mean square distance of a point to the planes
+	double getError(const glm::dvec3& p) const
+	{
+		double squared = m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+			+ m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+			+ m[7] * p.z * p.z + 2.0 * m[8] * p.z
+			+ m[9];
+		return weight > 0.0 ? std::sqrt(std::max(squared, 0.0) / weight) : 0.0;
+	}
+};
+
+/// Moving the from position onto the to position, valid while neither quadric changed since
+struct Collapse
+{
+	float cost;
+	uint32_t from;
+	uint32_t to;
+	uint32_t fromVersion;
+	uint32_t toVersion;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// Borders only have triangles on one side: planes through them, perpendicular to the triangle, keep them in place.
+// Weighted more than the surface itself, open meshes would shrink otherwise.
+static const double BORDER_WEIGHT = 10.0;
+
+float simplifyMesh(const vector<Vertex>& vertices, const vector<uint32_t>& indices, size_t targetIndexCount,
+				   vector<uint32_t>& result)
+{
+	// -- POSITIONS --
+	// Vertices at the same position are the same point of the surface, whatever their attributes
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			return std::hash<float>()(p.x) ^ (std::hash<float>()(p.y) * 31) ^ (std::hash<float>()(p.z) * 131);
+		}
+	};
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> positionIds;
+	vector<uint32_t> vertexPositions(vertices.size());
+	vector<glm::dvec3> positions;
+	vector<vector<uint32_t>> positionVertices;
+	for (uint32_t i = 0; i < vertices.size(); ++i)
+	{
+		auto inserted = positionIds.emplace(vertices[i].position, static_cast<uint32_t>(positions.size()));
+		if (inserted.second)
+		{
+			positions.push_back(glm::dvec3(vertices[i].position));
+			positionVertices.emplace_back();
+		}
+		vertexPositions[i] = inserted.first->second;
+		positionVertices[inserted.first->second].push_back(i);
+	}
+	const size_t positionCount = positions.size();
+
+	// -- QUADRICS --
+	// Planes of the triangles around each position, weighted by their area
+	vector<uint32_t> triangles = indices;
+	const size_t triangleCount = triangles.size() / 3;
+	vector<Quadric> quadrics(positionCount);
+	vector<vector<uint32_t>> positionTriangles(positionCount);
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	auto getEdgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); };
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t p[3]{ vertexPositions[triangles[t * 3]], vertexPositions[triangles[t * 3 + 1]], vertexPositions[triangles[t * 3 + 2]] };
+		glm::dvec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+		double area = glm::length(normal) * 0.5;
+		if (area > 0.0) normal /= area * 2.0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			quadrics[p[corner]].addPlane(normal, -glm::dot(normal, positions[p[0]]), area);
+			positionTriangles[p[corner]].push_back(t);
+			++edgeUses[getEdgeKey(p[corner], p[(corner + 1) % 3])];
+		}
+	}
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t p[3]{ vertexPositions[triangles[t * 3]], vertexPositions[triangles[t * 3 + 1]], vertexPositions[triangles[t * 3 + 2]] };
+		glm::dvec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t a = p[corner];
+			uint32_t b = p[(corner + 1) % 3];
+			if (edgeUses[getEdgeKey(a, b)] != 1) continue;
+
+			glm::dvec3 edge = positions[b] - positions[a];
+			glm::dvec3 borderNormal = glm::cross(edge, normal);
+			double length = glm::length(borderNormal);
+			if (length == 0.0) continue;
+			borderNormal /= length;
+			double borderWeight = glm::dot(edge, edge) * BORDER_WEIGHT;
+			quadrics[a].addPlane(borderNormal, -glm::dot(borderNormal, positions[a]), borderWeight);
+			quadrics[b].addPlane(borderNormal, -glm::dot(borderNormal, positions[a]), borderWeight);
+		}
+	}
+
+	// -- COLLAPSES --
+	vector<uint32_t> versions(positionCount, 0); // Incremented each time the quadric of a position changes
+	vector<bool> positionAlive(positionCount, true);
+	vector<bool> triangleAlive(triangleCount, true);
+	std::priority_queue<Collapse, vector<Collapse>, std::greater<Collapse>> collapses;
+	auto pushCollapse = [&](uint32_t from, uint32_t to)
+	{
+		Quadric merged = quadrics[from];
+		merged.add(quadrics[to]);
+		collapses.push(Collapse{ static_cast<float>(merged.getError(positions[to])), from, to, versions[from], versions[to] });
+	};
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t a = vertexPositions[triangles[t * 3 + corner]];
+			uint32_t b = vertexPositions[triangles[t * 3 + (corner + 1) % 3]];
+			if (a == b) continue;
+			pushCollapse(a, b);
+			pushCollapse(b, a);
+		}
+	}
+
+	size_t aliveTriangleCount = triangleCount;
+	double error = 0.0;
+	while (aliveTriangleCount * 3 > targetIndexCount && !collapses.empty())
+	{
+		Collapse collapse = collapses.top();
+		collapses.pop();
+		const uint32_t from = collapse.from;
+		const uint32_t to = collapse.to;
+		if (!positionAlive[from] || !positionAlive[to]) continue;
+		if (collapse.fromVersion != versions[from] || collapse.toVersion != versions[to])
+		{
+			// Costs went up since: try again at its real cost
+			pushCollapse(from, to);
+			continue;
+		}
+
+		// Still an edge, and no triangle left around from turns over once from moves onto to
+		uint32_t edgeTriangleCount = 0;
+		bool flips = false;
+		vector<uint32_t> fromNeighbors;
+		for (uint32_t t : positionTriangles[from])
+		{
+			if (!triangleAlive[t]) continue;
+			uint32_t p[3]{ vertexPositions[triangles[t * 3]], vertexPositions[triangles[t * 3 + 1]], vertexPositions[triangles[t * 3 + 2]] };
+			fromNeighbors.insert(fromNeighbors.end(), { p[0], p[1], p[2] });
+			if (p[0] == to || p[1] == to || p[2] == to)
+			{
+				++edgeTriangleCount;
+				continue;
+			}
+			glm::dvec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			for (uint32_t& position : p)
+			{
+				if (position == from) position = to;
+			}
+			glm::dvec3 after = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			if (glm::dot(before, after) <= 0.0)
+			{
+				flips = true;
+				break;
+			}
+		}
+		if (edgeTriangleCount == 0 || flips) continue;
+
+		// Link condition: the only positions around both are the tips of the triangles along the edge.
+		// Others would be joined by two triangles stacked on each other, the surface would pinch there.
+		std::sort(fromNeighbors.begin(), fromNeighbors.end());
+		fromNeighbors.erase(std::unique(fromNeighbors.begin(), fromNeighbors.end()), fromNeighbors.end());
+		vector<uint32_t> sharedNeighbors;
+		for (uint32_t t : positionTriangles[to])
+		{
+			if (!triangleAlive[t]) continue;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t neighbor = vertexPositions[triangles[t * 3 + corner]];
+				if (neighbor != from && neighbor != to && std::binary_search(fromNeighbors.begin(), fromNeighbors.end(), neighbor))
+				{
+					sharedNeighbors.push_back(neighbor);
+				}
+			}
+		}
+		std::sort(sharedNeighbors.begin(), sharedNeighbors.end());
+		sharedNeighbors.erase(std::unique(sharedNeighbors.begin(), sharedNeighbors.end()), sharedNeighbors.end());
+		if (sharedNeighbors.size() > edgeTriangleCount) continue;
+
+		// -- COLLAPSE --
+		for (uint32_t t : positionTriangles[from])
+		{
+			if (!triangleAlive[t]) continue;
+			bool hasTo = false;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				hasTo = hasTo || vertexPositions[triangles[t * 3 + corner]] == to;
+			}
+			if (hasTo)
+			{
+				// Triangles along the edge become degenerate
+				triangleAlive[t] = false;
+				--aliveTriangleCount;
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t& index = triangles[t * 3 + corner];
+				if (vertexPositions[index] != from) continue;
+
+				// The vertex at the new position with the closest attributes, to keep seams where they were
+				const Vertex& vertex = vertices[index];
+				uint32_t closest = positionVertices[to][0];
+				float closestDistance = std::numeric_limits<float>::max();
+				for (uint32_t candidate : positionVertices[to])
+				{
+					glm::vec3 colorDifference = vertices[candidate].color - vertex.color;
+					glm::vec2 uvDifference = vertices[candidate].uv - vertex.uv;
+					float distance = glm::dot(colorDifference, colorDifference) + glm::dot(uvDifference, uvDifference);
+					if (distance < closestDistance)
+					{
+						closest = candidate;
+						closestDistance = distance;
+					}
+				}
+				index = closest;
+			}
+			positionTriangles[to].push_back(t);
+		}
+		quadrics[to].add(quadrics[from]);
+		positionAlive[from] = false;
+		++versions[to];
+		error = std::max(error, static_cast<double>(collapse.cost));
+
+		// Edges around the merged position, at their new cost
+		for (uint32_t t : positionTriangles[to])
+		{
+			if (!triangleAlive[t]) continue;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t neighbor = vertexPositions[triangles[t * 3 + corner]];
+				if (neighbor == to) continue;
+				pushCollapse(to, neighbor);
+				pushCollapse(neighbor, to);
+			}
+		}
+	}
+
+	// -- RESULT --
+	result.clear();
+	result.reserve(aliveTriangleCount * 3);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		if (!triangleAlive[t]) continue;
+		result.insert(result.end(), { triangles[t * 3], triangles[t * 3 + 1], triangles[t * 3 + 2] });
+	}
+	return static_cast<float>(error);
+}
+
+void buildMeshLods(MeshData& mesh)
+{
+	// Each LOD is simplified from the previous one: faster, and its error adds to the previous ones
+	mesh.lods.clear();
+	mesh.lods.reserve(MAX_MESH_LODS - 1);
+	float error = 0.0f;
+	for (uint32_t lod = 1; lod < MAX_MESH_LODS; ++lod)
+	{
+		const vector<uint32_t>& source = lod == 1 ? mesh.indices : mesh.lods.back().indices;
+		size_t targetIndexCount = source.size() / 3 / 4 * 3;
+		if (targetIndexCount == 0) break;
+
+		MeshLodData lodData;
+		float lodError = simplifyMesh(mesh.vertices, source, targetIndexCount, lodData.indices);
+		// A LOD barely smaller than the previous one is not worth switching to
+		if (lodData.indices.empty() || lodData.indices.size() > source.size() * 3 / 4) break;
+
+		error += lodError;
+		lodData.error = error;
+		mesh.lods.push_back(std::move(lodData));
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Mesh.h"
+
+
+/// Quadric error metric simplification (Garland-Heckbert): edges are collapsed one at a time, cheapest
+/// first, where the cost is the distance from the kept vertex to the planes of the triangles around both.
+/// Vertices sharing a position are collapsed together, so seams of normals, colors or uvs stay closed;
+/// mesh borders are held in place by extra planes. Collapses that would flip a triangle are skipped.
+/// Kept vertices are existing ones: the result only has new indices, into the same vertex array.
+/// Returns the error of the result, in object space units: how far it may be from the given triangles.
+float simplifyMesh(const vector<Vertex>& vertices, const vector<uint32_t>& indices, size_t targetIndexCount,
+				   vector<uint32_t>& result);
+
+/// Cook the LOD chain of a mesh into mesh.lods: each LOD has about a quarter of the triangles of the previous
+/// one, up to MAX_MESH_LODS levels including the full mesh. Stops early when a mesh no longer simplifies.
+void buildMeshLods(MeshData& mesh);
@@ -0,0 +1,186 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+// Narrowest normal cone never culled: its normals span about half of all directions
+static const float MIN_CONE_DOT = 0.1f;
+
+static glm::vec3 getTriangleNormal(const vector<Vertex>& vertices, const uint32_t* triangle)
+{
+	glm::vec3 normal = glm::cross(vertices[triangle[1]].position - vertices[triangle[0]].position,
+		vertices[triangle[2]].position - vertices[triangle[0]].position);
+	float length = glm::length(normal);
+	return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+void computeMeshletBounds(const vector<Vertex>& vertices, MeshletData& meshlet)
+{
+	// -- SPHERE --
+	// Centered on the bounding box, like the sphere of the mesh
+	glm::vec3 minPosition{ std::numeric_limits<float>::max() };
+	glm::vec3 maxPosition{ -std::numeric_limits<float>::max() };
+	for (uint32_t index : meshlet.indices)
+	{
+		minPosition = glm::min(minPosition, vertices[index].position);
+		maxPosition = glm::max(maxPosition, vertices[index].position);
+	}
+	glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t index : meshlet.indices)
+	{
+		radius = std::max(radius, glm::length(vertices[index].position - center));
+	}
+	meshlet.boundingSphere = glm::vec4(center, radius);
+
+	// -- CONE --
+	// Around the average normal, as wide as the normal farthest from it. Degenerate triangles face nowhere.
+	glm::vec3 axis{ 0.0f };
+	for (size_t i = 0; i + 2 < meshlet.indices.size(); i += 3)
+	{
+		axis += getTriangleNormal(vertices, &meshlet.indices[i]);
+	}
+	float axisLength = glm::length(axis);
+	float minimumDot = -1.0f;
+	if (axisLength > 0.0f)
+	{
+		axis /= axisLength;
+		minimumDot = 1.0f;
+		for (size_t i = 0; i + 2 < meshlet.indices.size(); i += 3)
+		{
+			glm::vec3 normal = getTriangleNormal(vertices, &meshlet.indices[i]);
+			if (normal != glm::vec3(0.0f))
+			{
+				minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+			}
+		}
+	}
+	// The cutoff is the sine of the cone half angle: the test then holds for the whole sphere
+	float cutoff = minimumDot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+	meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+void buildMeshlets(MeshData& mesh)
+{
+	mesh.meshlets.clear();
+	const vector<uint32_t>& indices = mesh.indices;
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	const size_t vertexCount = mesh.vertices.size();
+	const uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+	// Triangles using each vertex: those of vertex v are vertexTriangles[firstVertexTriangle[v]] up to firstVertexTriangle[v + 1]
+	vector<uint32_t> firstVertexTriangle(vertexCount + 1, 0);
+	for (uint32_t index : indices)
+	{
+		++firstVertexTriangle[index + 1];
+	}
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		firstVertexTriangle[v + 1] += firstVertexTriangle[v];
+	}
+	vector<uint32_t> vertexTriangles(indices.size());
+	vector<uint32_t> vertexTriangleEnds(firstVertexTriangle.begin(), firstVertexTriangle.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			vertexTriangles[vertexTriangleEnds[indices[t * 3 + corner]]++] = t;
+		}
+	}
+
+	vector<glm::vec3> triangleNormals(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		triangleNormals[t] = getTriangleNormal(mesh.vertices, &indices[t * 3]);
+	}
+
+	vector<bool> emitted(triangleCount, false);
+	uint32_t firstTriangleLeft = 0; // Every triangle before it is emitted
+
+	// Meshlet being built
+	MeshletData meshlet;
+	vector<uint32_t> meshletVertices;
+	vector<bool> inMeshlet(vertexCount, false);
+	glm::vec3 meshletNormal{ 0.0f }; // Sum of the triangle normals
+
+	auto finishMeshlet = [&]()
+	{
+		computeMeshletBounds(mesh.vertices, meshlet);
+		mesh.meshlets.push_back(std::move(meshlet));
+		meshlet = MeshletData{};
+		for (uint32_t vertex : meshletVertices)
+		{
+			inMeshlet[vertex] = false;
+		}
+		meshletVertices.clear();
+		meshletNormal = glm::vec3(0.0f);
+	};
+	auto getNewVertexCount = [&](uint32_t triangle)
+	{
+		uint32_t count = 0;
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			if (!inMeshlet[indices[triangle * 3 + corner]]) ++count;
+		}
+		return count;
+	};
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		// -- NEXT TRIANGLE --
+		// Among the triangles left around the meshlet vertices
+		uint32_t best = NO_TRIANGLE;
+		uint32_t bestNewVertices = 4;
+		float bestFacing = -2.0f;
+		for (uint32_t vertex : meshletVertices)
+		{
+			for (uint32_t i = firstVertexTriangle[vertex]; i < firstVertexTriangle[vertex + 1]; ++i)
+			{
+				uint32_t triangle = vertexTriangles[i];
+				if (emitted[triangle]) continue;
+
+				uint32_t newVertices = getNewVertexCount(triangle);
+				float facing = glm::dot(triangleNormals[triangle], meshletNormal);
+				if (newVertices < bestNewVertices || (newVertices == bestNewVertices && facing > bestFacing))
+				{
+					best = triangle;
+					bestNewVertices = newVertices;
+					bestFacing = facing;
+				}
+			}
+		}
+		if (best == NO_TRIANGLE)
+		{
+			while (emitted[firstTriangleLeft]) ++firstTriangleLeft;
+			best = firstTriangleLeft;
+			bestNewVertices = getNewVertexCount(best);
+		}
+
+		// -- LIMITS --
+		// The best triangle adds the fewest vertices: if it does not fit, none does
+		if (meshlet.indices.size() == MAX_MESHLET_TRIANGLES * 3 || meshletVertices.size() + bestNewVertices > MAX_MESHLET_VERTICES)
+		{
+			finishMeshlet();
+		}
+
+		// -- EMIT --
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = indices[best * 3 + corner];
+			if (!inMeshlet[vertex])
+			{
+				inMeshlet[vertex] = true;
+				meshletVertices.push_back(vertex);
+			}
+			meshlet.indices.push_back(vertex);
+		}
+		meshletNormal += triangleNormals[best];
+		emitted[best] = true;
+	}
+	if (!meshlet.indices.empty())
+	{
+		finishMeshlet();
+	}
+}
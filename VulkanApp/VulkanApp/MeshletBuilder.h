@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Mesh.h"
+
+
+/// Split the full mesh into meshlets, in mesh.meshlets. Each meshlet grows from a triangle through its neighbours:
+/// those adding the fewest vertices first, then those facing its way, so that its normal cone stays narrow.
+/// Expects cache optimized indices: a meshlet with no neighbour left continues with the first triangle left in
+/// index order, which is close to the last ones.
+void buildMeshlets(MeshData& mesh);
+
+/// Bounding sphere and normal cone of a meshlet, from its triangles
+void computeMeshletBounds(const vector<Vertex>& vertices, MeshletData& meshlet);
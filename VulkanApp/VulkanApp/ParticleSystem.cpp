@@ -0,0 +1,309 @@
+#include "ParticleSystem.h"
+
+#include <array>
+#include <cmath>
+
+
+void ParticleSystem::init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+						  vk::CommandPool transferCommandPool, uint32_t maxParticlesP, const FrameRingBuffer& frameRingBuffer,
+						  DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator, vk::RenderPass renderPass,
+						  uint32_t subpass, vk::Extent2D extent, vk::SampleCountFlagBits sampleCount)
+{
+	if (maxParticlesP == 0)
+	{
+		throw std::runtime_error("A particle system needs room for particles");
+	}
+	maxParticles = maxParticlesP;
+
+	createBuffers(physicalDevice, device, transferQueue, transferCommandPool);
+	createDescriptors(device, frameRingBuffer, layoutCache, descriptorAllocator);
+	createComputePipelines(device);
+	createDrawPipeline(device, renderPass, subpass, extent, sampleCount);
+}
+
+void ParticleSystem::clean(vk::Device device)
+{
+	device.destroyPipeline(drawPipeline);
+	device.destroyPipeline(emissionPipeline);
+	device.destroyPipeline(simulationPipeline);
+	device.destroyPipeline(preparationPipeline);
+	device.destroyPipelineLayout(pipelineLayout);
+	device.destroyBuffer(dispatchBuffer);
+	device.freeMemory(dispatchBufferMemory);
+	device.destroyBuffer(counterBuffer);
+	device.freeMemory(counterBufferMemory);
+	device.destroyBuffer(deadListBuffer);
+	device.freeMemory(deadListBufferMemory);
+	device.destroyBuffer(aliveListBuffer);
+	device.freeMemory(aliveListBufferMemory);
+	device.destroyBuffer(particleBuffer);
+	device.freeMemory(particleBufferMemory);
+}
+
+void ParticleSystem::setEmitter(const glm::vec3& position, float radius, float particlesPerSecond)
+{
+	emitterPosition = position;
+	emitterRadius = radius;
+	emissionRate = particlesPerSecond;
+}
+
+void ParticleSystem::update(FrameRingBuffer& frameRingBuffer, float deltaTime, const glm::mat4& view, const glm::mat4& projection)
+{
+	// The survivors of the last frame are simulated
+	aliveList = frameIndex == 0 ? 0 : 1 - aliveList;
+	time += deltaTime;
+
+	// Whole particles only, the rest waits for the next frame. More than there are slots would be dropped by the GPU.
+	pendingEmission += emissionRate * deltaTime;
+	float emitted = pendingEmission < static_cast<float>(maxParticles) ? std::floor(pendingEmission) : static_cast<float>(maxParticles);
+	emitCount = static_cast<uint32_t>(emitted);
+	pendingEmission -= emitted;
+
+	ParticleUbo particleUbo{};
+	particleUbo.viewProjection = projection * view;
+	// Rows of the view rotation: the camera axes in world space
+	particleUbo.cameraRight = glm::vec4(view[0][0], view[1][0], view[2][0], PARTICLE_SIZE);
+	particleUbo.cameraUp = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+	particleUbo.emitter = glm::vec4(emitterPosition, emitterRadius);
+	particleUbo.deltaTime = deltaTime;
+	particleUbo.time = time;
+	particleUbo.emitCount = emitCount;
+	particleUbo.seed = frameIndex++;
+	particleUbo.aliveList = aliveList;
+	particleUbo.maxParticles = maxParticles;
+	particleUbo.lifetime = PARTICLE_LIFETIME;
+	particleUniformOffset = frameRingBuffer.pushUniform(particleUbo);
+}
+
+void ParticleSystem::recordPreparation(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, preparationPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, particleUniformOffset);
+	// A single invocation
+	commandBuffer.dispatch(1, 1, 1);
+}
+
+void ParticleSystem::recordSimulation(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, simulationPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, particleUniformOffset);
+	// One invocation per alive particle, a count the CPU never reads
+	commandBuffer.dispatchIndirect(dispatchBuffer, 0);
+}
+
+void ParticleSystem::recordEmission(vk::CommandBuffer commandBuffer)
+{
+	if (emitCount == 0) return;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, emissionPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, particleUniformOffset);
+	// One invocation per new particle, rounded up to whole workgroups
+	commandBuffer.dispatch((emitCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+void ParticleSystem::recordDraw(CommandRecorder& recorder)
+{
+	recorder.bindPipeline(drawPipeline);
+	recorder.bindDescriptorSet(pipelineLayout, 0, descriptorSet, particleUniformOffset);
+	// The survivors and new particles, in the other list than the simulated one
+	const uint32_t drawnList = 1 - aliveList;
+	recorder.getCommandBuffer().drawIndirect(counterBuffer, sizeof(vk::DrawIndirectCommand) * drawnList, 1,
+		sizeof(vk::DrawIndirectCommand));
+}
+
+void ParticleSystem::createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+								   vk::CommandPool transferCommandPool)
+{
+	// Particles and alive lists: only meaningful once emitted, no initial content
+	createBuffer(physicalDevice, device, sizeof(GpuParticle) * maxParticles, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &particleBuffer, &particleBufferMemory);
+	createBuffer(physicalDevice, device, sizeof(uint32_t) * maxParticles * 2, vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &aliveListBuffer, &aliveListBufferMemory);
+
+	// Every slot starts free
+	vector<uint32_t> deadList(maxParticles);
+	for (uint32_t i = 0; i < maxParticles; ++i)
+	{
+		deadList[i] = i;
+	}
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		deadList.data(), sizeof(uint32_t) * maxParticles, vk::BufferUsageFlagBits::eStorageBuffer,
+		&deadListBuffer, &deadListBufferMemory);
+
+	// No particle alive. Each alive particle is an instance of a 6 vertex quad.
+	GpuParticleCounters counters{};
+	for (vk::DrawIndirectCommand& draw : counters.draws)
+	{
+		draw = vk::DrawIndirectCommand{ 6, 0, 0, 0 };
+	}
+	counters.deadCount = static_cast<int32_t>(maxParticles);
+	createDeviceLocalBuffer(physicalDevice, device, transferQueue, transferCommandPool,
+		&counters, sizeof(counters), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+		&counterBuffer, &counterBufferMemory);
+
+	// Written by the preparation before every read
+	createBuffer(physicalDevice, device, sizeof(vk::DispatchIndirectCommand),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &dispatchBuffer, &dispatchBufferMemory);
+}
+
+void ParticleSystem::createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer,
+									   DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator)
+{
+	//v Layout =======================================================
+	vector<vk::DescriptorSetLayoutBinding> bindings(6);
+	// Binding 0: camera, emitter and frame time, in the frame ring buffer
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex;
+	// Binding 1: particles, 2: alive lists, both read by the vertex shader too. 3: dead list, 4: counters, 5: dispatch.
+	for (uint32_t i = 1; i < bindings.size(); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = i <= 2 ? vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex
+			: vk::ShaderStageFlagBits::eCompute;
+	}
+
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+	//^ Layout =======================================================
+	//v Set ==========================================================
+	descriptorSet = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+	std::array<vk::DescriptorBufferInfo, 6> bufferInfos{};
+	// Offset 0 here, the dynamic offset given when binding selects the frame's ParticleUbo
+	bufferInfos[0] = vk::DescriptorBufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(ParticleUbo) };
+	bufferInfos[1] = vk::DescriptorBufferInfo{ particleBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[2] = vk::DescriptorBufferInfo{ aliveListBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[3] = vk::DescriptorBufferInfo{ deadListBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[4] = vk::DescriptorBufferInfo{ counterBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[5] = vk::DescriptorBufferInfo{ dispatchBuffer, 0, VK_WHOLE_SIZE };
+
+	std::array<vk::WriteDescriptorSet, 6> writes{};
+	for (uint32_t binding = 0; binding < writes.size(); ++binding)
+	{
+		writes[binding].dstSet = descriptorSet;
+		writes[binding].dstBinding = binding;
+		writes[binding].dstArrayElement = 0;
+		writes[binding].descriptorType = bindings[binding].descriptorType;
+		writes[binding].descriptorCount = 1;
+		writes[binding].pBufferInfo = &bufferInfos[binding];
+	}
+	device.updateDescriptorSets(writes, nullptr);
+	//^ Set ==========================================================
+}
+
+void ParticleSystem::createComputePipelines(vk::Device device)
+{
+	// Everything goes through the uniform block, no push constants
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
+
+	auto createComputePipeline = [&](const string& fileName)
+	{
+		vk::ShaderModule computeShaderModule = createShaderModule(device, readShaderFile(fileName));
+
+		vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+		pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+		pipelineCreateInfo.stage.module = computeShaderModule;
+		pipelineCreateInfo.stage.pName = "main";
+		pipelineCreateInfo.layout = pipelineLayout;
+
+		auto result = device.createComputePipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+		if (result.result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("Could not create a particle compute pipeline");
+		}
+
+		device.destroyShaderModule(computeShaderModule);
+		return result.value;
+	};
+	preparationPipeline = createComputePipeline("shaders/particleprepare.spv");
+	simulationPipeline = createComputePipeline("shaders/particlesimulate.spv");
+	emissionPipeline = createComputePipeline("shaders/particleemit.spv");
+}
+
+void ParticleSystem::createDrawPipeline(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent,
+										vk::SampleCountFlagBits sampleCount)
+{
+	vk::ShaderModule vertexShaderModule = createShaderModule(device, readShaderFile("shaders/particle.spv"));
+	vk::ShaderModule fragmentShaderModule = createShaderModule(device, readShaderFile("shaders/particlefrag.spv"));
+	std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{};
+	shaderStages[0].stage = vk::ShaderStageFlagBits::eVertex;
+	shaderStages[0].module = vertexShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].stage = vk::ShaderStageFlagBits::eFragment;
+	shaderStages[1].module = fragmentShaderModule;
+	shaderStages[1].pName = "main";
+
+	// No vertex buffer, the quad comes from gl_VertexIndex and the particle from gl_InstanceIndex
+	vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
+	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo{};
+	inputAssemblyCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
+
+	vk::Viewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+	vk::Rect2D scissor{ vk::Offset2D{ 0, 0 }, extent };
+	vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = &viewport;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = &scissor;
+
+	// Quads face the camera: no culling
+	vk::PipelineRasterizationStateCreateInfo rasterizerCreateInfo{};
+	rasterizerCreateInfo.polygonMode = vk::PolygonMode::eFill;
+	rasterizerCreateInfo.lineWidth = 1.0f;
+	rasterizerCreateInfo.cullMode = vk::CullModeFlagBits::eNone;
+
+	vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo{};
+	multisamplingCreateInfo.rasterizationSamples = sampleCount;
+
+	// Hidden by the scene, never hiding each other: no sorting needed
+	vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo{};
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+	depthStencilCreateInfo.depthCompareOp = vk::CompareOp::eLessOrEqual;
+
+	// Additive: the order particles are drawn in does not matter
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+		| vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+	colorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+	colorBlendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+	colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eZero;
+	colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+	colorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
+	vk::PipelineColorBlendStateCreateInfo colorBlendingCreateInfo{};
+	colorBlendingCreateInfo.attachmentCount = 1;
+	colorBlendingCreateInfo.pAttachments = &colorBlendAttachment;
+
+	vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineCreateInfo.pStages = shaderStages.data();
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.renderPass = renderPass;
+	pipelineCreateInfo.subpass = subpass;
+
+	auto result = device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Could not create the particle pipeline");
+	}
+	drawPipeline = result.value;
+
+	device.destroyShaderModule(fragmentShaderModule);
+	device.destroyShaderModule(vertexShaderModule);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+#include "CommandRecorder.h"
+
+
+/// Particle, only ever touched by the GPU.
+/// Layout matches the std430 Particle struct of the particle shaders.
+struct GpuParticle
+{
+	glm::vec4 position; // xyz, w remaining life in seconds
+	glm::vec4 velocity; // xyz, w random seed given at emission
+};
+
+/// Counts of the particle lists, and the draws that read them.
+/// Layout matches the std430 Counters block of the particle shaders.
+struct GpuParticleCounters
+{
+	vk::DrawIndirectCommand draws[2]; // One per alive list, instanceCount is the number of particles in it
+	int32_t deadCount; // Free slots at the front of the dead list. Emission makes it go below 0 when it runs out.
+	uint32_t padding[3];
+};
+
+/// GPU particles: emission, simulation and drawing never involve the CPU past a count of new particles.
+/// Each frame, in compute:
+/// - the preparation reads how many particles are alive and sizes the simulation dispatch from it;
+/// - the simulation moves every alive particle through a curl noise velocity field, under gravity and drag,
+///   and compacts the survivors into the other alive list. Dead ones give their slot back to the dead list;
+/// - the emission takes slots from the dead list and appends the new particles to the survivors.
+/// The survivor list is then drawn as camera facing quads, one instance per particle, by drawIndirect:
+/// its instance count is the alive count the GPU left. The two alive lists swap roles every frame.
+/// Buffers are shared by frames in flight: the caller orders each frame's passes after the previous frame's draw.
+class ParticleSystem
+{
+public:
+	/// renderPass and subpass of the pass drawing the particles, with its extent and samples.
+	/// The pass must have a single color attachment and a depth attachment.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+			  uint32_t maxParticlesP, const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+			  DescriptorAllocator& descriptorAllocator, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent,
+			  vk::SampleCountFlagBits sampleCount);
+	void clean(vk::Device device);
+
+	/// Particles leave a sphere around the position, upwards, and live PARTICLE_LIFETIME seconds: about
+	/// particlesPerSecond * PARTICLE_LIFETIME are alive at once, at most the maximum given to init.
+	/// 0 per second stops the emission.
+	void setEmitter(const glm::vec3& position, float radius, float particlesPerSecond);
+
+	/// Advance the simulation by deltaTime seconds, with the frame's camera, written in the current frame's ring region.
+	/// Once per frame, before recording its passes.
+	void update(FrameRingBuffer& frameRingBuffer, float deltaTime, const glm::mat4& view, const glm::mat4& projection);
+
+	/// Size the simulation after the alive count, reset the survivor count. Must be recorded outside of a render pass.
+	void recordPreparation(vk::CommandBuffer commandBuffer);
+	/// Simulate and compact. Reads the dispatch the preparation wrote: the caller synchronises them (the render graph does).
+	void recordSimulation(vk::CommandBuffer commandBuffer);
+	/// Emit the frame's new particles, after the simulation
+	void recordEmission(vk::CommandBuffer commandBuffer);
+	/// Draw the alive particles, blended over what is drawn, inside the pass given to init
+	void recordDraw(CommandRecorder& recorder);
+
+	/// Written by every compute pass, read by the vertex shader
+	vk::Buffer getParticleBuffer() const { return particleBuffer; }
+	vk::Buffer getAliveListBuffer() const { return aliveListBuffer; }
+	/// Only touched by the simulation and the emission
+	vk::Buffer getDeadListBuffer() const { return deadListBuffer; }
+	/// Written by every compute pass, read as draw parameters
+	vk::Buffer getCounterBuffer() const { return counterBuffer; }
+	/// Written by the preparation, read as dispatch parameters by the simulation
+	vk::Buffer getDispatchBuffer() const { return dispatchBuffer; }
+
+	static const uint32_t WORKGROUP_SIZE{ 256 }; // Must match local_size_x in particlesimulate.comp and particleemit.comp
+	/// Seconds from emission to death
+	const float PARTICLE_LIFETIME{ 4.0f };
+	/// World size of the quads
+	const float PARTICLE_SIZE{ 0.05f };
+
+private:
+	uint32_t maxParticles{ 0 };
+	uint32_t aliveList{ 0 }; // Simulated this frame, the survivors go to the other one
+	glm::vec3 emitterPosition{ 0.0f };
+	float emitterRadius{ 1.0f };
+	float emissionRate{ 0.0f };
+	float pendingEmission{ 0.0f }; // Fraction of a particle carried to the next frame
+	uint32_t emitCount{ 0 }; // This frame
+	float time{ 0.0f };
+	uint32_t frameIndex{ 0 }; // Seeds the emission
+	uint32_t particleUniformOffset{ 0 }; // Dynamic offset of this frame's ParticleUbo
+
+	// Matches the Particles uniform block of the particle shaders
+	struct ParticleUbo
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 cameraRight; // World space, w particle size
+		glm::vec4 cameraUp;
+		glm::vec4 emitter; // xyz position, w radius
+		float deltaTime;
+		float time;
+		uint32_t emitCount;
+		uint32_t seed;
+		uint32_t aliveList; // Simulated, the survivors and new particles go to the other one
+		uint32_t maxParticles;
+		float lifetime;
+	};
+
+	// -- BUFFERS --
+	vk::Buffer particleBuffer; // GpuParticle, maxParticles
+	vk::DeviceMemory particleBufferMemory;
+	vk::Buffer aliveListBuffer; // Two lists of maxParticles uint32_t indices
+	vk::DeviceMemory aliveListBufferMemory;
+	vk::Buffer deadListBuffer; // maxParticles uint32_t indices, free ones first
+	vk::DeviceMemory deadListBufferMemory;
+	vk::Buffer counterBuffer; // GpuParticleCounters
+	vk::DeviceMemory counterBufferMemory;
+	vk::Buffer dispatchBuffer; // vk::DispatchIndirectCommand of the simulation
+	vk::DeviceMemory dispatchBufferMemory;
+
+	// -- DESCRIPTORS --
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	// Per-frame data is selected by dynamic offset: one long-lived set, for compute and graphics alike
+	vk::DescriptorSet descriptorSet;
+
+	// -- PIPELINES --
+	vk::PipelineLayout pipelineLayout; // Shared by every particle shader
+	vk::Pipeline preparationPipeline;
+	vk::Pipeline simulationPipeline;
+	vk::Pipeline emissionPipeline;
+	vk::Pipeline drawPipeline;
+
+	void createBuffers(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+					   vk::CommandPool transferCommandPool);
+	void createDescriptors(vk::Device device, const FrameRingBuffer& frameRingBuffer, DescriptorLayoutCache& layoutCache,
+						   DescriptorAllocator& descriptorAllocator);
+	void createComputePipelines(vk::Device device);
+	void createDrawPipeline(vk::Device device, vk::RenderPass renderPass, uint32_t subpass, vk::Extent2D extent,
+							vk::SampleCountFlagBits sampleCount);
+};
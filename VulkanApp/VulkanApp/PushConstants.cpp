@@ -0,0 +1,211 @@
+#include "PushConstants.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+
+//v SPIR-V reflection ============================================
+// Only what is needed to size a push constant block, see the SPIR-V specification
+namespace spirv
+{
+	const uint32_t MAGIC_NUMBER{ 0x07230203 };
+	const size_t HEADER_WORD_COUNT{ 5 };
+
+	enum Op : uint32_t
+	{
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeArray = 28,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72
+	};
+
+	enum Decoration : uint32_t
+	{
+		ArrayStride = 6,
+		MatrixStride = 7,
+		Offset = 35
+	};
+
+	const uint32_t STORAGE_CLASS_PUSH_CONSTANT{ 9 };
+}
+
+namespace
+{
+	struct SpirvType
+	{
+		uint32_t opcode{ 0 };
+		vector<uint32_t> operands; // Words after the result id
+	};
+
+	struct SpirvModule
+	{
+		std::unordered_map<uint32_t, SpirvType> types;
+		std::unordered_map<uint32_t, uint32_t> constants; // Id -> 32-bit value, for array lengths
+		std::unordered_map<uint32_t, uint32_t> arrayStrides;
+		// (struct id << 32 | member) -> decoration value
+		std::unordered_map<uint64_t, uint32_t> memberOffsets;
+		std::unordered_map<uint64_t, uint32_t> memberMatrixStrides;
+		uint32_t pushConstantPointerType{ 0 };
+	};
+
+	uint64_t memberKey(uint32_t structId, uint32_t member)
+	{
+		return static_cast<uint64_t>(structId) << 32 | member;
+	}
+
+	// matrixStride: the MatrixStride decoration of the member holding this type, 0 if none
+	uint32_t getTypeSize(const SpirvModule& module, uint32_t typeId, uint32_t matrixStride)
+	{
+		const SpirvType& type = module.types.at(typeId);
+		switch (type.opcode)
+		{
+		case spirv::OpTypeInt:
+		case spirv::OpTypeFloat:
+			return type.operands[0] / 8; // Width in bits
+		case spirv::OpTypeVector:
+			return type.operands[1] * getTypeSize(module, type.operands[0], 0);
+		case spirv::OpTypeMatrix:
+		{
+			uint32_t columnSize = matrixStride != 0 ? matrixStride : getTypeSize(module, type.operands[0], 0);
+			return type.operands[1] * columnSize;
+		}
+		case spirv::OpTypeArray:
+		{
+			uint32_t length = module.constants.at(type.operands[1]);
+			auto stride = module.arrayStrides.find(typeId);
+			uint32_t elementSize = stride != module.arrayStrides.end() ? stride->second : getTypeSize(module, type.operands[0], matrixStride);
+			return length * elementSize;
+		}
+		case spirv::OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t member = 0; member < type.operands.size(); ++member)
+			{
+				auto offset = module.memberOffsets.find(memberKey(typeId, member));
+				auto stride = module.memberMatrixStrides.find(memberKey(typeId, member));
+				uint32_t memberOffset = offset != module.memberOffsets.end() ? offset->second : size;
+				uint32_t memberStride = stride != module.memberMatrixStrides.end() ? stride->second : 0;
+				size = std::max(size, memberOffset + getTypeSize(module, type.operands[member], memberStride));
+			}
+			return size;
+		}
+		}
+
+		throw std::runtime_error("Unsupported type in a push constant block");
+	}
+}
+
+vk::PushConstantRange reflectPushConstantRange(const vector<char>& spirvCode, vk::ShaderStageFlags stage)
+{
+	vk::PushConstantRange range{};
+	range.stageFlags = stage;
+
+	vector<uint32_t> words(spirvCode.size() / sizeof(uint32_t));
+	memcpy(words.data(), spirvCode.data(), words.size() * sizeof(uint32_t));
+	if (words.size() < spirv::HEADER_WORD_COUNT || words[0] != spirv::MAGIC_NUMBER)
+	{
+		throw std::runtime_error("Invalid SPIR-V code");
+	}
+
+	// Gather types and decorations. Each instruction starts with its word count and opcode.
+	SpirvModule module;
+	size_t position = spirv::HEADER_WORD_COUNT;
+	while (position < words.size())
+	{
+		uint32_t opcode = words[position] & 0xFFFF;
+		uint32_t wordCount = words[position] >> 16;
+		if (wordCount == 0 || position + wordCount > words.size())
+		{
+			throw std::runtime_error("Invalid SPIR-V instruction");
+		}
+		const uint32_t* operands = &words[position + 1];
+
+		switch (opcode)
+		{
+		case spirv::OpTypeInt:
+		case spirv::OpTypeFloat:
+		case spirv::OpTypeVector:
+		case spirv::OpTypeMatrix:
+		case spirv::OpTypeArray:
+		case spirv::OpTypeStruct:
+		case spirv::OpTypePointer:
+			module.types[operands[0]] = SpirvType{ opcode, vector<uint32_t>(operands + 1, operands + wordCount - 1) };
+			break;
+		case spirv::OpConstant:
+			module.constants[operands[1]] = operands[2];
+			break;
+		case spirv::OpVariable:
+			if (operands[2] == spirv::STORAGE_CLASS_PUSH_CONSTANT)
+			{
+				module.pushConstantPointerType = operands[0];
+			}
+			break;
+		case spirv::OpDecorate:
+			if (operands[1] == spirv::ArrayStride)
+			{
+				module.arrayStrides[operands[0]] = operands[2];
+			}
+			break;
+		case spirv::OpMemberDecorate:
+			if (operands[2] == spirv::Offset)
+			{
+				module.memberOffsets[memberKey(operands[0], operands[1])] = operands[3];
+			}
+			else if (operands[2] == spirv::MatrixStride)
+			{
+				module.memberMatrixStrides[memberKey(operands[0], operands[1])] = operands[3];
+			}
+			break;
+		}
+
+		position += wordCount;
+	}
+
+	if (module.pushConstantPointerType == 0) return range;
+
+	// The variable is a pointer to the block struct: [storage class, pointee type]
+	uint32_t blockType = module.types.at(module.pushConstantPointerType).operands[1];
+	const SpirvType& block = module.types.at(blockType);
+
+	// Blocks declared with layout(offset = X) start at their first member
+	uint32_t begin = UINT32_MAX;
+	for (uint32_t member = 0; member < block.operands.size(); ++member)
+	{
+		begin = std::min(begin, module.memberOffsets.at(memberKey(blockType, member)));
+	}
+
+	range.offset = block.operands.empty() ? 0 : begin;
+	range.size = getTypeSize(module, blockType, 0) - range.offset;
+	return range;
+}
+//^ SPIR-V reflection ============================================
+
+vk::PushConstantRange mergePushConstantRanges(const vector<vk::PushConstantRange>& ranges)
+{
+	vk::PushConstantRange merged{};
+	uint32_t begin = UINT32_MAX;
+	uint32_t end = 0;
+
+	for (const vk::PushConstantRange& range : ranges)
+	{
+		if (range.size == 0) continue;
+
+		merged.stageFlags |= range.stageFlags;
+		begin = std::min(begin, range.offset);
+		end = std::max(end, range.offset + range.size);
+	}
+
+	if (end == 0) return merged;
+
+	merged.offset = begin;
+	merged.size = end - begin;
+	return merged;
+}
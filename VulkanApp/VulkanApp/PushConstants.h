@@ -0,0 +1,62 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+#include "CommandRecorder.h"
+
+
+/// Read the push constant block of a SPIR-V module and return the bytes it uses.
+/// The range is empty (size 0) when the shader declares no push constants.
+vk::PushConstantRange reflectPushConstantRange(const vector<char>& spirvCode, vk::ShaderStageFlags stage);
+
+/// Smallest single range covering every given range, for all of their stages.
+/// Empty ranges are ignored.
+vk::PushConstantRange mergePushConstantRanges(const vector<vk::PushConstantRange>& ranges);
+
+/// Typed access to the push constants of a pipeline layout, whose range comes
+/// from the shaders (reflectPushConstantRange). T must have the same layout as the
+/// shader block: only the bytes of T covered by the range are pushed.
+template<typename T>
+class PushConstantBlock
+{
+public:
+	void init(vk::PipelineLayout layout, const vk::PushConstantRange& range)
+	{
+		if (range.offset + range.size > sizeof(T))
+		{
+			throw std::runtime_error("Shader push constants are bigger than their C++ struct");
+		}
+		pipelineLayout = layout;
+		pushRange = range;
+	}
+
+	void push(vk::CommandBuffer commandBuffer, const T& data) const
+	{
+		if (pushRange.size == 0) return;
+
+		const char* bytes = reinterpret_cast<const char*>(&data);
+		commandBuffer.pushConstants(pipelineLayout, pushRange.stageFlags, pushRange.offset, pushRange.size, bytes + pushRange.offset);
+	}
+	/// Same, dropped by the recorder if the bytes are already pushed
+	void push(CommandRecorder& recorder, const T& data) const
+	{
+		if (pushRange.size == 0) return;
+
+		const char* bytes = reinterpret_cast<const char*>(&data);
+		recorder.pushConstants(pipelineLayout, pushRange.stageFlags, pushRange.offset, pushRange.size, bytes + pushRange.offset);
+	}
+
+	const vk::PushConstantRange& getRange() const { return pushRange; }
+
+private:
+	vk::PipelineLayout pipelineLayout;
+	vk::PushConstantRange pushRange{};
+};
+
+/// Per-draw data of the graphics pipelines, same layout as the PushDraw block of the shaders.
+/// Each shader declares the members it reads, the pipeline layout range covers all of them.
+struct DrawPushConstants
+{
+	glm::mat4 model; // Transform of single mesh draws (mesh.vert)
+	uint32_t materialBuffer; // Index of the materials in the bindless storage buffers
+	uint32_t materialId; // Material of the draw, for draws that do not read it per object
+};
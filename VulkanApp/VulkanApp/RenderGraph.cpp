@@ -0,0 +1,1070 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+
+static const uint32_t NONE{ 0xFFFFFFFF };
+
+// Accesses that make memory available: only writes need it, reads only need execution ordering
+static const vk::AccessFlags WRITE_ACCESS{ vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+	| vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite };
+
+RenderGraphAccess getUsageAccess(RenderGraphUsage usage)
+{
+	using Stage = vk::PipelineStageFlagBits;
+	using Access = vk::AccessFlagBits;
+	using Layout = vk::ImageLayout;
+
+	switch (usage)
+	{
+	case RenderGraphUsage::ColorAttachment:
+		return { Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal };
+	case RenderGraphUsage::DepthStencilAttachment:
+		return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+			Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite, Layout::eDepthStencilAttachmentOptimal };
+	case RenderGraphUsage::ResolveAttachment:
+		return { Stage::eColorAttachmentOutput, Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal };
+	case RenderGraphUsage::InputAttachment:
+		return { Stage::eFragmentShader, Access::eInputAttachmentRead, Layout::eShaderReadOnlyOptimal };
+	case RenderGraphUsage::SampledFragment:
+		return { Stage::eFragmentShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal };
+	case RenderGraphUsage::SampledCompute:
+		return { Stage::eComputeShader, Access::eShaderRead, Layout::eShaderReadOnlyOptimal };
+	case RenderGraphUsage::StorageReadVertex:
+		return { Stage::eVertexShader, Access::eShaderRead, Layout::eGeneral };
+	case RenderGraphUsage::StorageReadCompute:
+		return { Stage::eComputeShader, Access::eShaderRead, Layout::eGeneral };
+	case RenderGraphUsage::StorageReadFragment:
+		return { Stage::eFragmentShader, Access::eShaderRead, Layout::eGeneral };
+	case RenderGraphUsage::StorageWriteCompute:
+		return { Stage::eComputeShader, Access::eShaderRead | Access::eShaderWrite, Layout::eGeneral };
+	case RenderGraphUsage::IndirectBuffer:
+		return { Stage::eDrawIndirect, Access::eIndirectCommandRead, Layout::eUndefined };
+	case RenderGraphUsage::TransferSrc:
+		return { Stage::eTransfer, Access::eTransferRead, Layout::eTransferSrcOptimal };
+	case RenderGraphUsage::TransferDst:
+		return { Stage::eTransfer, Access::eTransferWrite, Layout::eTransferDstOptimal };
+	}
+	throw std::runtime_error("Unknown render graph usage");
+}
+
+bool isWriteUsage(RenderGraphUsage usage)
+{
+	return static_cast<bool>(getUsageAccess(usage).access & WRITE_ACCESS);
+}
+
+bool isAttachmentUsage(RenderGraphUsage usage)
+{
+	return usage == RenderGraphUsage::ColorAttachment || usage == RenderGraphUsage::DepthStencilAttachment
+		|| usage == RenderGraphUsage::ResolveAttachment || usage == RenderGraphUsage::InputAttachment;
+}
+
+#pragma region Building
+uint32_t RenderGraph::importImage(const string& name, vk::Format format, vk::Extent2D extent, const RenderGraphAccess& initial,
+								  uint32_t arrayLayer)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.format = format;
+	resource.extent = extent;
+	resource.arrayLayer = arrayLayer;
+	resource.initial = initial;
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+uint32_t RenderGraph::importBuffer(const string& name, const RenderGraphAccess& initial)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.initial = initial;
+	resource.initial.layout = vk::ImageLayout::eUndefined;
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+uint32_t RenderGraph::createImage(const string& name, vk::Format format, vk::Extent2D extent, vk::SampleCountFlagBits samples)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.format = format;
+	resource.extent = extent;
+	resource.samples = samples;
+	resources.push_back(resource);
+	return static_cast<uint32_t>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(uint32_t resource, const RenderGraphAccess& final)
+{
+	resources[resource].output = true;
+	resources[resource].final = final;
+}
+
+uint32_t RenderGraph::addPass(const string& name, RenderGraphPassType type, std::function<void(vk::CommandBuffer)> record)
+{
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	pass.record = record;
+	passes.push_back(pass);
+	return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::read(uint32_t pass, uint32_t resource, RenderGraphUsage usage)
+{
+	addUse(pass, ResourceUse{ resource, usage, false, false, vk::ClearValue{}, NONE });
+}
+
+void RenderGraph::write(uint32_t pass, uint32_t resource, RenderGraphUsage usage)
+{
+	addUse(pass, ResourceUse{ resource, usage, true, false, vk::ClearValue{}, NONE });
+}
+
+void RenderGraph::clear(uint32_t pass, uint32_t resource, RenderGraphUsage usage, const vk::ClearValue& clearValue)
+{
+	if (!isAttachmentUsage(usage) || usage == RenderGraphUsage::ResolveAttachment || usage == RenderGraphUsage::InputAttachment)
+	{
+		throw std::runtime_error("Only attachments can be cleared by a render graph pass: " + resources[resource].name);
+	}
+	addUse(pass, ResourceUse{ resource, usage, true, true, clearValue, NONE });
+}
+
+void RenderGraph::resolve(uint32_t pass, uint32_t colorResource, uint32_t resource)
+{
+	bool colorAttachment = false;
+	for (const ResourceUse& use : passes[pass].uses)
+	{
+		colorAttachment = colorAttachment || (use.resource == colorResource && use.usage == RenderGraphUsage::ColorAttachment);
+	}
+	if (!colorAttachment)
+	{
+		throw std::runtime_error("Resolve of " + resources[colorResource].name + ", not a color attachment of pass " + passes[pass].name);
+	}
+	// Every texel is written by the resolve: like a clear, the previous content is not needed
+	addUse(pass, ResourceUse{ resource, RenderGraphUsage::ResolveAttachment, true, true, vk::ClearValue{}, colorResource });
+}
+
+void RenderGraph::addUse(uint32_t pass, const ResourceUse& use)
+{
+	if (isAttachmentUsage(use.usage) && passes[pass].type != RenderGraphPassType::Graphics)
+	{
+		throw std::runtime_error("Attachment used outside of a graphics pass: " + passes[pass].name);
+	}
+	for (const ResourceUse& other : passes[pass].uses)
+	{
+		if (other.resource == use.resource)
+		{
+			throw std::runtime_error("Resource used twice by pass " + passes[pass].name + ": " + resources[use.resource].name);
+		}
+	}
+	passes[pass].uses.push_back(use);
+}
+#pragma endregion Building
+#pragma region Compilation
+void RenderGraph::compile()
+{
+	compiledPasses.clear();
+	finalBarriers.clear();
+
+	cullPasses();
+	computeLifetimes();
+	assignAliasSlots();
+	buildBarriers();
+	chooseStoreOps();
+}
+
+uint32_t RenderGraph::getBarrierCount() const
+{
+	uint32_t count = static_cast<uint32_t>(finalBarriers.size());
+	for (const RenderGraphCompiledPass& compiledPass : compiledPasses)
+	{
+		count += static_cast<uint32_t>(compiledPass.barriers.size());
+		if (compiledPass.entrySrcStages) ++count;
+		if (compiledPass.exitDstStages) ++count;
+		count += static_cast<uint32_t>(compiledPass.subpassDependencies.size());
+	}
+	return count;
+}
+
+void RenderGraph::cullPasses()
+{
+	// From the last pass to the first: a pass is needed if it writes a resource read later
+	// (by a needed pass or after the frame). What it reads is then needed too.
+	vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		needed[i] = resources[i].output;
+	}
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		Pass& pass = passes[i];
+		bool kept = pass.sideEffects;
+		for (const ResourceUse& use : pass.uses)
+		{
+			kept = kept || (use.write && needed[use.resource]);
+		}
+		pass.culled = !kept;
+		if (!kept) continue;
+
+		// A cleared resource is overwritten: what earlier passes wrote in it is lost.
+		// Any other write may be partial and keeps the previous content.
+		for (const ResourceUse& use : pass.uses)
+		{
+			needed[use.resource] = !use.clear;
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (Resource& resource : resources)
+	{
+		resource.firstUse = NONE;
+		resource.lastUse = NONE;
+	}
+
+	for (uint32_t i = 0; i < passes.size(); ++i)
+	{
+		if (passes[i].culled) continue;
+
+		uint32_t compiledIndex = static_cast<uint32_t>(compiledPasses.size());
+		RenderGraphCompiledPass compiledPass{};
+		compiledPass.pass = i;
+		compiledPass.renderPassBegin = compiledIndex;
+
+		// Input attachments are only readable inside the render pass that wrote them
+		bool readsInputAttachments = false;
+		for (const ResourceUse& use : passes[i].uses)
+		{
+			readsInputAttachments = readsInputAttachments || use.usage == RenderGraphUsage::InputAttachment;
+		}
+		if (readsInputAttachments)
+		{
+			if (compiledPasses.empty() || passes[compiledPasses.back().pass].type != RenderGraphPassType::Graphics)
+			{
+				throw std::runtime_error("Pass " + passes[i].name + " reads input attachments but does not follow a graphics pass");
+			}
+			compiledPass.renderPassBegin = compiledPasses.back().renderPassBegin;
+			compiledPass.subpass = compiledPasses.back().subpass + 1;
+		}
+		compiledPasses.push_back(compiledPass);
+
+		for (const ResourceUse& use : passes[i].uses)
+		{
+			Resource& resource = resources[use.resource];
+			if (resource.firstUse == NONE) resource.firstUse = compiledIndex;
+			resource.lastUse = compiledIndex;
+		}
+	}
+}
+
+void RenderGraph::assignAliasSlots()
+{
+	// Interval scheduling: in order of first use, each transient image takes the first
+	// slot whose last tenant is done before it starts, or a new slot
+	vector<uint32_t> transientImages;
+	for (uint32_t i = 0; i < resources.size(); ++i)
+	{
+		resources[i].aliasSlot = NO_ALIAS_SLOT;
+		resources[i].previousTenant = NONE;
+		if (!resources[i].imported && resources[i].firstUse != NONE)
+		{
+			transientImages.push_back(i);
+		}
+	}
+	std::sort(transientImages.begin(), transientImages.end(), [this](uint32_t a, uint32_t b)
+	{
+		return resources[a].firstUse < resources[b].firstUse;
+	});
+
+	vector<uint32_t> slotTenants; // Last image of each slot
+	for (uint32_t image : transientImages)
+	{
+		Resource& resource = resources[image];
+		for (uint32_t slot = 0; slot < slotTenants.size(); ++slot)
+		{
+			if (resources[slotTenants[slot]].lastUse < resource.firstUse)
+			{
+				resource.aliasSlot = slot;
+				resource.previousTenant = slotTenants[slot];
+				slotTenants[slot] = image;
+				break;
+			}
+		}
+		if (resource.aliasSlot == NO_ALIAS_SLOT)
+		{
+			resource.aliasSlot = static_cast<uint32_t>(slotTenants.size());
+			slotTenants.push_back(image);
+		}
+	}
+	aliasSlotCount = static_cast<uint32_t>(slotTenants.size());
+}
+
+void RenderGraph::buildBarriers()
+{
+	// What the next use of each resource has to wait for
+	struct State
+	{
+		vk::ImageLayout layout;
+		vk::PipelineStageFlags writeStages; // Last write, or last layout transition
+		vk::AccessFlags writeAccess;
+		vk::PipelineStageFlags readStages; // Reads since then
+		vk::PipelineStageFlags visibleStages; // Where the last write is already visible
+		vk::AccessFlags visibleAccess;
+		bool hasContent;
+		uint32_t lastWritePass; // Compiled indices, to find the subpass to depend on
+		uint32_t lastAccessPass;
+	};
+	// Frames in flight share the transient images: the first tenant of a slot waits for
+	// every use of the slot by the previous frame
+	vector<vk::PipelineStageFlags> slotStages(aliasSlotCount);
+	vector<vk::AccessFlags> slotWriteAccess(aliasSlotCount);
+	for (const RenderGraphCompiledPass& compiledPass : compiledPasses)
+	{
+		for (const ResourceUse& use : passes[compiledPass.pass].uses)
+		{
+			const uint32_t slot = resources[use.resource].aliasSlot;
+			if (slot == NO_ALIAS_SLOT) continue;
+			const RenderGraphAccess access = getUsageAccess(use.usage);
+			slotStages[slot] |= access.stages;
+			slotWriteAccess[slot] |= access.access & WRITE_ACCESS;
+		}
+	}
+
+	vector<State> states(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		const Resource& resource = resources[i];
+		State& state = states[i];
+		state = State{};
+		state.layout = resource.isImage ? resource.initial.layout : vk::ImageLayout::eUndefined;
+		state.writeStages = (resource.initial.access & WRITE_ACCESS) ? resource.initial.stages : vk::PipelineStageFlags();
+		state.writeAccess = resource.initial.access & WRITE_ACCESS;
+		state.readStages = (resource.initial.access & WRITE_ACCESS) ? vk::PipelineStageFlags() : resource.initial.stages;
+		state.hasContent = resource.imported && (!resource.isImage || resource.initial.layout != vk::ImageLayout::eUndefined);
+		state.lastWritePass = NONE;
+		state.lastAccessPass = NONE;
+		if (resource.aliasSlot != NO_ALIAS_SLOT && resource.previousTenant == NONE)
+		{
+			state.writeStages = slotStages[resource.aliasSlot];
+			state.writeAccess = slotWriteAccess[resource.aliasSlot];
+		}
+	}
+
+	for (uint32_t c = 0; c < compiledPasses.size(); ++c)
+	{
+		RenderGraphCompiledPass& compiledPass = compiledPasses[c];
+		const Pass& pass = passes[compiledPass.pass];
+
+		for (const ResourceUse& use : pass.uses)
+		{
+			const Resource& resource = resources[use.resource];
+			State& state = states[use.resource];
+
+			// Memory shared with the previous tenant of the slot: its content is garbage, but its
+			// last uses must be done before this image is written
+			if (c == resource.firstUse && resource.previousTenant != NONE)
+			{
+				const State& previous = states[resource.previousTenant];
+				state.writeStages = previous.writeStages;
+				state.writeAccess = previous.writeAccess;
+				state.readStages = previous.readStages;
+			}
+
+			const RenderGraphAccess target = getUsageAccess(use.usage);
+			const bool attachment = isAttachmentUsage(use.usage);
+			const bool discard = use.clear || !state.hasContent;
+			const vk::ImageLayout oldLayout = discard ? vk::ImageLayout::eUndefined : state.layout;
+			const bool layoutChange = resource.isImage && target.layout != state.layout;
+
+			// -- HAZARDS --
+			// Writes and layout transitions wait for every previous use, reads only for the last write,
+			// and only if it is not visible to their stages and accesses yet
+			vk::PipelineStageFlags srcStages;
+			vk::AccessFlags srcAccess = state.writeAccess;
+			bool needed;
+			if (use.write || layoutChange)
+			{
+				srcStages = state.writeStages | state.readStages;
+				needed = srcStages || layoutChange;
+			}
+			else
+			{
+				srcStages = state.writeStages;
+				needed = srcStages && ((target.stages & ~state.visibleStages) || (target.access & ~state.visibleAccess));
+			}
+
+			// Inside a render pass, what is waited for is in an earlier subpass or outside of the render pass
+			const uint32_t srcPass = (use.write || layoutChange) ? state.lastAccessPass : state.lastWritePass;
+			const bool fromSubpass = compiledPass.subpass > 0 && srcPass != NONE && srcPass >= compiledPass.renderPassBegin;
+
+			if (needed && fromSubpass)
+			{
+				if (!attachment && layoutChange)
+				{
+					throw std::runtime_error("Layout transition of " + resource.name + " inside the render pass of " + pass.name);
+				}
+				addSubpassDependency(compiledPass, RenderGraphSubpassDependency{ compiledPasses[srcPass].subpass,
+					srcStages, srcAccess, target.stages, target.access });
+			}
+			else if (needed && attachment)
+			{
+				// The render pass transitions the attachment, after its external dependency
+				compiledPass.entrySrcStages |= srcStages;
+				compiledPass.entrySrcAccess |= srcAccess;
+				compiledPass.entryDstStages |= target.stages;
+				compiledPass.entryDstAccess |= target.access;
+			}
+			else if (needed)
+			{
+				RenderGraphBarrier barrier{};
+				barrier.resource = use.resource;
+				// Only a layout transition, nothing to wait for
+				barrier.srcStages = srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+				barrier.srcAccess = srcAccess;
+				barrier.dstStages = target.stages;
+				barrier.dstAccess = target.access;
+				barrier.oldLayout = resource.isImage ? oldLayout : vk::ImageLayout::eUndefined;
+				barrier.newLayout = resource.isImage ? target.layout : vk::ImageLayout::eUndefined;
+				compiledPasses[compiledPass.renderPassBegin].barriers.push_back(barrier);
+			}
+
+			if (attachment)
+			{
+				RenderGraphAttachment passAttachment{};
+				passAttachment.resource = use.resource;
+				passAttachment.loadOp = use.usage == RenderGraphUsage::ResolveAttachment ? vk::AttachmentLoadOp::eDontCare
+					: use.clear ? vk::AttachmentLoadOp::eClear
+					: state.hasContent ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eDontCare;
+				passAttachment.storeOp = vk::AttachmentStoreOp::eStore; // See chooseStoreOps
+				passAttachment.initialLayout = oldLayout;
+				passAttachment.layout = target.layout;
+				passAttachment.finalLayout = target.layout;
+				passAttachment.clearValue = use.clearValue;
+				passAttachment.resolveSource = use.resolveSource;
+				if (use.usage == RenderGraphUsage::DepthStencilAttachment)
+				{
+					compiledPass.hasDepthAttachment = true;
+					compiledPass.depthAttachment = passAttachment;
+				}
+				else if (use.usage == RenderGraphUsage::ResolveAttachment)
+				{
+					compiledPass.resolveAttachments.push_back(passAttachment);
+				}
+				else if (use.usage == RenderGraphUsage::InputAttachment)
+				{
+					compiledPass.inputAttachments.push_back(passAttachment);
+				}
+				else
+				{
+					compiledPass.colorAttachments.push_back(passAttachment);
+				}
+			}
+
+			// -- NEW STATE --
+			state.layout = resource.isImage ? target.layout : vk::ImageLayout::eUndefined;
+			state.lastAccessPass = c;
+			if (use.write || layoutChange) state.lastWritePass = c;
+			if (use.write)
+			{
+				state.writeStages = target.stages;
+				state.writeAccess = target.access & WRITE_ACCESS;
+				state.readStages = vk::PipelineStageFlags();
+				state.visibleStages = vk::PipelineStageFlags();
+				state.visibleAccess = vk::AccessFlags();
+				state.hasContent = true;
+			}
+			else if (layoutChange)
+			{
+				// A transition writes the image: later reads chain on the stages it was made visible to
+				state.writeStages = target.stages;
+				state.writeAccess = vk::AccessFlags();
+				state.readStages = target.stages;
+				state.visibleStages = target.stages;
+				state.visibleAccess = target.access;
+			}
+			else
+			{
+				state.readStages |= target.stages;
+				if (needed)
+				{
+					state.visibleStages |= target.stages;
+					state.visibleAccess |= target.access;
+				}
+			}
+		}
+	}
+
+	// -- FINAL STATES --
+	// Only layouts matter: memory is made visible after the frame by the semaphores and fences of the submission
+	for (uint32_t i = 0; i < resources.size(); ++i)
+	{
+		const Resource& resource = resources[i];
+		const State& state = states[i];
+		if (!resource.output || !resource.isImage || resource.final.layout == state.layout) continue;
+
+		// Last used as an attachment: the render pass does the transition
+		RenderGraphAttachment* lastAttachment = nullptr;
+		if (resource.lastUse != NONE)
+		{
+			RenderGraphCompiledPass& lastPass = compiledPasses[resource.lastUse];
+			for (RenderGraphAttachment& colorAttachment : lastPass.colorAttachments)
+			{
+				if (colorAttachment.resource == i) lastAttachment = &colorAttachment;
+			}
+			for (RenderGraphAttachment& resolveAttachment : lastPass.resolveAttachments)
+			{
+				if (resolveAttachment.resource == i) lastAttachment = &resolveAttachment;
+			}
+			for (RenderGraphAttachment& inputAttachment : lastPass.inputAttachments)
+			{
+				if (inputAttachment.resource == i) lastAttachment = &inputAttachment;
+			}
+			if (lastPass.hasDepthAttachment && lastPass.depthAttachment.resource == i)
+			{
+				lastAttachment = &lastPass.depthAttachment;
+			}
+			if (lastAttachment)
+			{
+				lastAttachment->finalLayout = resource.final.layout;
+				lastPass.exitDstStages |= resource.final.stages;
+				lastPass.exitDstAccess |= resource.final.access;
+				continue;
+			}
+		}
+
+		RenderGraphBarrier barrier{};
+		barrier.resource = i;
+		barrier.srcStages = state.writeStages | state.readStages;
+		if (!barrier.srcStages) barrier.srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+		barrier.srcAccess = state.writeAccess;
+		barrier.dstStages = resource.final.stages;
+		barrier.dstAccess = resource.final.access;
+		barrier.oldLayout = state.hasContent ? state.layout : vk::ImageLayout::eUndefined;
+		barrier.newLayout = resource.final.layout;
+		finalBarriers.push_back(barrier);
+	}
+}
+
+void RenderGraph::chooseStoreOps()
+{
+	// From the last pass to the first: an attachment is stored if a later pass reads
+	// its content, or if it is an output
+	vector<bool> readLater(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		readLater[i] = resources[i].output;
+	}
+
+	for (size_t c = compiledPasses.size(); c-- > 0;)
+	{
+		RenderGraphCompiledPass& compiledPass = compiledPasses[c];
+		auto chooseStoreOp = [&readLater](RenderGraphAttachment& attachment)
+		{
+			attachment.storeOp = readLater[attachment.resource] ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+			readLater[attachment.resource] = attachment.loadOp == vk::AttachmentLoadOp::eLoad;
+		};
+		for (RenderGraphAttachment& colorAttachment : compiledPass.colorAttachments)
+		{
+			chooseStoreOp(colorAttachment);
+		}
+		for (RenderGraphAttachment& resolveAttachment : compiledPass.resolveAttachments)
+		{
+			chooseStoreOp(resolveAttachment);
+		}
+		for (RenderGraphAttachment& inputAttachment : compiledPass.inputAttachments)
+		{
+			chooseStoreOp(inputAttachment);
+		}
+		if (compiledPass.hasDepthAttachment)
+		{
+			chooseStoreOp(compiledPass.depthAttachment);
+		}
+
+		// Any other use reads the content, or may only write part of it
+		for (const ResourceUse& use : passes[compiledPass.pass].uses)
+		{
+			if (!isAttachmentUsage(use.usage)) readLater[use.resource] = true;
+		}
+	}
+}
+
+// Stages whose work is local to a pixel: dependencies between them can be by region, and stay in tile memory
+static bool isFramebufferSpace(vk::PipelineStageFlags stages)
+{
+	const vk::PipelineStageFlags framebufferStages = vk::PipelineStageFlagBits::eFragmentShader
+		| vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests
+		| vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	return !(stages & ~framebufferStages);
+}
+
+void RenderGraph::addSubpassDependency(RenderGraphCompiledPass& compiledPass, const RenderGraphSubpassDependency& dependency)
+{
+	RenderGraphSubpassDependency* merged = nullptr;
+	for (RenderGraphSubpassDependency& other : compiledPass.subpassDependencies)
+	{
+		if (other.srcSubpass != dependency.srcSubpass) continue;
+		other.srcStages |= dependency.srcStages;
+		other.srcAccess |= dependency.srcAccess;
+		other.dstStages |= dependency.dstStages;
+		other.dstAccess |= dependency.dstAccess;
+		merged = &other;
+		break;
+	}
+	if (!merged)
+	{
+		compiledPass.subpassDependencies.push_back(dependency);
+		merged = &compiledPass.subpassDependencies.back();
+	}
+	const bool byRegion = isFramebufferSpace(merged->srcStages) && isFramebufferSpace(merged->dstStages);
+	merged->dependencyFlags = byRegion ? vk::DependencyFlags(vk::DependencyFlagBits::eByRegion) : vk::DependencyFlags();
+}
+#pragma endregion Compilation
+#pragma region Execution
+static vk::ImageAspectFlags getAspectFlags(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eD16Unorm:
+	case vk::Format::eX8D24UnormPack32:
+	case vk::Format::eD32Sfloat:
+		return vk::ImageAspectFlagBits::eDepth;
+	case vk::Format::eD16UnormS8Uint:
+	case vk::Format::eD24UnormS8Uint:
+	case vk::Format::eD32SfloatS8Uint:
+		return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+	case vk::Format::eS8Uint:
+		return vk::ImageAspectFlagBits::eStencil;
+	default:
+		return vk::ImageAspectFlagBits::eColor;
+	}
+}
+
+void RenderGraph::createRenderPasses(vk::Device device)
+{
+	renderPasses.clear();
+	renderPasses.resize(compiledPasses.size());
+
+	for (uint32_t begin = 0; begin < compiledPasses.size(); ++begin)
+	{
+		if (passes[compiledPasses[begin].pass].type != RenderGraphPassType::Graphics || compiledPasses[begin].subpass != 0) continue;
+		uint32_t end = begin + 1;
+		while (end < compiledPasses.size() && compiledPasses[end].renderPassBegin == begin) ++end;
+		RenderPassObjects& objects = renderPasses[begin];
+
+		// -- ATTACHMENTS --
+		// One description per resource, from its first use in the render pass (load, initial layout)
+		// to its last one (store, final layout)
+		vector<vk::AttachmentDescription> attachmentDescriptions;
+		auto describe = [this, &attachmentDescriptions, &objects](const RenderGraphAttachment& attachment)
+		{
+			uint32_t index = 0;
+			while (index < objects.attachments.size() && objects.attachments[index] != attachment.resource) ++index;
+			if (index == objects.attachments.size())
+			{
+				vk::AttachmentDescription description{};
+				description.format = resources[attachment.resource].format;
+				description.samples = resources[attachment.resource].samples;
+				description.loadOp = attachment.loadOp;
+				description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+				description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+				description.initialLayout = attachment.initialLayout;
+				attachmentDescriptions.push_back(description);
+				objects.attachments.push_back(attachment.resource);
+				objects.clearValues.push_back(attachment.clearValue);
+			}
+			attachmentDescriptions[index].storeOp = attachment.storeOp;
+			attachmentDescriptions[index].finalLayout = attachment.finalLayout;
+			return vk::AttachmentReference{ index, attachment.layout };
+		};
+
+		// -- SUBPASSES --
+		// Color attachments first, then resolve, then depth, then input: the order of the framebuffer views
+		const uint32_t subpassCount = end - begin;
+		vector<vector<vk::AttachmentReference>> colorReferences(subpassCount);
+		vector<vector<vk::AttachmentReference>> resolveReferences(subpassCount);
+		vector<vector<vk::AttachmentReference>> inputReferences(subpassCount);
+		vector<vk::AttachmentReference> depthReferences(subpassCount);
+		vector<vk::SubpassDescription> subpasses(subpassCount);
+		vector<vk::SubpassDependency> dependencies;
+		for (uint32_t s = 0; s < subpassCount; ++s)
+		{
+			const RenderGraphCompiledPass& compiledPass = compiledPasses[begin + s];
+
+			for (const RenderGraphAttachment& colorAttachment : compiledPass.colorAttachments)
+			{
+				colorReferences[s].push_back(describe(colorAttachment));
+			}
+			// One per color attachment, unused for those not resolved
+			if (!compiledPass.resolveAttachments.empty())
+			{
+				resolveReferences[s].assign(colorReferences[s].size(), vk::AttachmentReference{ VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined });
+			}
+			for (const RenderGraphAttachment& resolveAttachment : compiledPass.resolveAttachments)
+			{
+				vk::AttachmentReference resolveReference = describe(resolveAttachment);
+				for (size_t i = 0; i < compiledPass.colorAttachments.size(); ++i)
+				{
+					if (compiledPass.colorAttachments[i].resource == resolveAttachment.resolveSource) resolveReferences[s][i] = resolveReference;
+				}
+			}
+			if (compiledPass.hasDepthAttachment)
+			{
+				depthReferences[s] = describe(compiledPass.depthAttachment);
+			}
+			for (const RenderGraphAttachment& inputAttachment : compiledPass.inputAttachments)
+			{
+				inputReferences[s].push_back(describe(inputAttachment));
+			}
+
+			subpasses[s].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+			subpasses[s].colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+			subpasses[s].pColorAttachments = colorReferences[s].data();
+			subpasses[s].pResolveAttachments = resolveReferences[s].empty() ? nullptr : resolveReferences[s].data();
+			subpasses[s].pDepthStencilAttachment = compiledPass.hasDepthAttachment ? &depthReferences[s] : nullptr;
+			subpasses[s].inputAttachmentCount = static_cast<uint32_t>(inputReferences[s].size());
+			subpasses[s].pInputAttachments = inputReferences[s].data();
+
+			// -- DEPENDENCIES --
+			// Exactly the previous and next uses of the attachments, no dependency when there are none
+			if (compiledPass.entrySrcStages)
+			{
+				dependencies.push_back(vk::SubpassDependency{ VK_SUBPASS_EXTERNAL, s,
+					compiledPass.entrySrcStages, compiledPass.entryDstStages,
+					compiledPass.entrySrcAccess, compiledPass.entryDstAccess });
+			}
+			for (const RenderGraphSubpassDependency& subpassDependency : compiledPass.subpassDependencies)
+			{
+				dependencies.push_back(vk::SubpassDependency{ subpassDependency.srcSubpass, s,
+					subpassDependency.srcStages, subpassDependency.dstStages,
+					subpassDependency.srcAccess, subpassDependency.dstAccess, subpassDependency.dependencyFlags });
+			}
+			if (compiledPass.exitDstStages)
+			{
+				// The final layout transitions follow the last use of their attachments
+				vk::PipelineStageFlags exitSrcStages;
+				vk::AccessFlags exitSrcAccess;
+				auto addExitSource = [&exitSrcStages, &exitSrcAccess](const RenderGraphAttachment& attachment,
+					vk::PipelineStageFlags stages, vk::AccessFlags access)
+				{
+					if (attachment.finalLayout == attachment.layout) return;
+					exitSrcStages |= stages;
+					exitSrcAccess |= access;
+				};
+				for (const RenderGraphAttachment& colorAttachment : compiledPass.colorAttachments)
+				{
+					addExitSource(colorAttachment, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite);
+				}
+				// Resolves are done in the color attachment output stage too
+				for (const RenderGraphAttachment& resolveAttachment : compiledPass.resolveAttachments)
+				{
+					addExitSource(resolveAttachment, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite);
+				}
+				if (compiledPass.hasDepthAttachment)
+				{
+					addExitSource(compiledPass.depthAttachment, vk::PipelineStageFlagBits::eLateFragmentTests,
+						vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+				}
+				for (const RenderGraphAttachment& inputAttachment : compiledPass.inputAttachments)
+				{
+					addExitSource(inputAttachment, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlags());
+				}
+				dependencies.push_back(vk::SubpassDependency{ s, VK_SUBPASS_EXTERNAL,
+					exitSrcStages, compiledPass.exitDstStages, exitSrcAccess, compiledPass.exitDstAccess });
+			}
+		}
+
+		vk::RenderPassCreateInfo renderPassCreateInfo{};
+		renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+		renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+		renderPassCreateInfo.subpassCount = subpassCount;
+		renderPassCreateInfo.pSubpasses = subpasses.data();
+		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCreateInfo.pDependencies = dependencies.data();
+
+		objects.renderPass = device.createRenderPass(renderPassCreateInfo);
+	}
+}
+
+const RenderGraphCompiledPass& RenderGraph::getCompiledPass(uint32_t pass) const
+{
+	for (const RenderGraphCompiledPass& compiledPass : compiledPasses)
+	{
+		if (compiledPass.pass == pass && passes[pass].type == RenderGraphPassType::Graphics) return compiledPass;
+	}
+	throw std::runtime_error("No render pass for culled or non graphics pass " + passes[pass].name);
+}
+
+vk::RenderPass RenderGraph::getRenderPass(uint32_t pass) const
+{
+	return renderPasses[getCompiledPass(pass).renderPassBegin].renderPass;
+}
+
+uint32_t RenderGraph::getSubpass(uint32_t pass) const
+{
+	return getCompiledPass(pass).subpass;
+}
+
+vk::ImageUsageFlags RenderGraph::getImageUsage(uint32_t resource) const
+{
+	vk::ImageUsageFlags usage;
+	for (const RenderGraphCompiledPass& compiledPass : compiledPasses)
+	{
+		for (const ResourceUse& use : passes[compiledPass.pass].uses)
+		{
+			if (use.resource != resource) continue;
+			switch (use.usage)
+			{
+			case RenderGraphUsage::ColorAttachment:
+			case RenderGraphUsage::ResolveAttachment: usage |= vk::ImageUsageFlagBits::eColorAttachment; break;
+			case RenderGraphUsage::DepthStencilAttachment: usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment; break;
+			case RenderGraphUsage::SampledFragment:
+			case RenderGraphUsage::SampledCompute: usage |= vk::ImageUsageFlagBits::eSampled; break;
+			case RenderGraphUsage::StorageReadVertex:
+			case RenderGraphUsage::StorageReadCompute:
+			case RenderGraphUsage::StorageReadFragment:
+			case RenderGraphUsage::StorageWriteCompute: usage |= vk::ImageUsageFlagBits::eStorage; break;
+			case RenderGraphUsage::InputAttachment: usage |= vk::ImageUsageFlagBits::eInputAttachment; break;
+			case RenderGraphUsage::TransferSrc: usage |= vk::ImageUsageFlagBits::eTransferSrc; break;
+			case RenderGraphUsage::TransferDst: usage |= vk::ImageUsageFlagBits::eTransferDst; break;
+			case RenderGraphUsage::IndirectBuffer: throw std::runtime_error("Image used as indirect buffer: " + resources[resource].name);
+			}
+		}
+	}
+	return usage;
+}
+
+void RenderGraph::createTransientImages(vk::PhysicalDevice physicalDevice, vk::Device device)
+{
+	const vk::ImageUsageFlags attachmentUsages = vk::ImageUsageFlagBits::eColorAttachment
+		| vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment;
+	const vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+
+	// -- IMAGES --
+	// Memory requirements of every tenant of a slot: the memory must suit them all
+	vector<vk::DeviceSize> slotSizes(aliasSlotCount, 0);
+	vector<uint32_t> slotMemoryTypes(aliasSlotCount, 0xFFFFFFFF);
+	vector<bool> slotTransient(aliasSlotCount, true);
+	transientMemorySize = 0;
+	unaliasedTransientMemorySize = 0;
+	for (Resource& resource : resources)
+	{
+		if (resource.aliasSlot == NO_ALIAS_SLOT) continue;
+
+		vk::ImageUsageFlags usage = getImageUsage(static_cast<uint32_t>(&resource - resources.data()));
+		// Content never leaves the render passes: may live in tile memory only
+		const bool transient = !(usage & ~attachmentUsages);
+		if (transient) usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+
+		vk::ImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.imageType = vk::ImageType::e2D;
+		imageCreateInfo.extent = vk::Extent3D{ resource.extent.width, resource.extent.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = resource.format;
+		imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+		imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageCreateInfo.usage = usage;
+		imageCreateInfo.samples = resource.samples;
+		imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+		resource.image = device.createImage(imageCreateInfo);
+
+		const vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(resource.image);
+		// Bound at offset 0, the alignment is always satisfied
+		slotSizes[resource.aliasSlot] = std::max(slotSizes[resource.aliasSlot], memoryRequirements.size);
+		slotMemoryTypes[resource.aliasSlot] &= memoryRequirements.memoryTypeBits;
+		slotTransient[resource.aliasSlot] = slotTransient[resource.aliasSlot] && transient;
+		unaliasedTransientMemorySize += memoryRequirements.size;
+	}
+
+	// -- MEMORY --
+	aliasSlotMemories.resize(aliasSlotCount);
+	lazilyAllocatedSlotCount = 0;
+	for (uint32_t slot = 0; slot < aliasSlotCount; ++slot)
+	{
+		// Lazily allocated when possible, device local otherwise
+		const vk::MemoryPropertyFlags lazyProperties = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+		uint32_t memoryType = NONE;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && slotTransient[slot]; ++i)
+		{
+			if ((slotMemoryTypes[slot] & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & lazyProperties) == lazyProperties)
+			{
+				memoryType = i;
+				break;
+			}
+		}
+		if (memoryType != NONE)
+		{
+			++lazilyAllocatedSlotCount;
+		}
+		else
+		{
+			// Throws when the tenants have no memory type in common
+			memoryType = findMemoryTypeIndex(physicalDevice, slotMemoryTypes[slot], vk::MemoryPropertyFlagBits::eDeviceLocal);
+		}
+
+		vk::MemoryAllocateInfo memoryAllocInfo{};
+		memoryAllocInfo.allocationSize = slotSizes[slot];
+		memoryAllocInfo.memoryTypeIndex = memoryType;
+		aliasSlotMemories[slot] = device.allocateMemory(memoryAllocInfo);
+		transientMemorySize += slotSizes[slot];
+	}
+
+	for (Resource& resource : resources)
+	{
+		if (resource.aliasSlot == NO_ALIAS_SLOT) continue;
+		device.bindImageMemory(resource.image, aliasSlotMemories[resource.aliasSlot], 0);
+		resource.imageView = createImageView(device, resource.image, resource.format, getAspectFlags(resource.format), 1);
+	}
+}
+
+void RenderGraph::setImage(uint32_t resource, vk::Image image, vk::ImageView imageView)
+{
+	resources[resource].image = image;
+	resources[resource].imageView = imageView;
+}
+
+void RenderGraph::execute(vk::Device device, vk::CommandBuffer commandBuffer)
+{
+	for (size_t c = 0; c < compiledPasses.size(); ++c)
+	{
+		const RenderGraphCompiledPass& compiledPass = compiledPasses[c];
+		const Pass& pass = passes[compiledPass.pass];
+
+		if (pass.type != RenderGraphPassType::Graphics)
+		{
+			recordBarriers(commandBuffer, compiledPass.barriers);
+			pass.record(commandBuffer);
+			continue;
+		}
+
+		if (compiledPass.subpass > 0)
+		{
+			commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+		}
+		else
+		{
+			// Barriers of every subpass, none can be recorded inside the render pass
+			recordBarriers(commandBuffer, compiledPass.barriers);
+
+			// -- FRAMEBUFFER --
+			RenderPassObjects& objects = renderPasses[c];
+			vector<VkImageView> attachmentViews;
+			for (uint32_t resource : objects.attachments)
+			{
+				attachmentViews.push_back(static_cast<VkImageView>(resources[resource].imageView));
+			}
+			const vk::Extent2D extent = resources[objects.attachments[0]].extent;
+
+			vk::Framebuffer& framebuffer = objects.framebuffers[attachmentViews];
+			if (!framebuffer)
+			{
+				vector<vk::ImageView> views(attachmentViews.begin(), attachmentViews.end());
+				vk::FramebufferCreateInfo framebufferCreateInfo{};
+				framebufferCreateInfo.renderPass = objects.renderPass;
+				framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+				framebufferCreateInfo.pAttachments = views.data();
+				framebufferCreateInfo.width = extent.width;
+				framebufferCreateInfo.height = extent.height;
+				framebufferCreateInfo.layers = 1;
+				framebuffer = device.createFramebuffer(framebufferCreateInfo);
+			}
+
+			// -- RENDER PASS --
+			vk::RenderPassBeginInfo renderPassBeginInfo{};
+			renderPassBeginInfo.renderPass = objects.renderPass;
+			renderPassBeginInfo.framebuffer = framebuffer;
+			renderPassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+			renderPassBeginInfo.renderArea.extent = extent;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(objects.clearValues.size());
+			renderPassBeginInfo.pClearValues = objects.clearValues.data();
+			commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+		}
+
+		pass.record(commandBuffer);
+
+		// Last subpass
+		if (c + 1 == compiledPasses.size() || compiledPasses[c + 1].renderPassBegin != compiledPass.renderPassBegin)
+		{
+			commandBuffer.endRenderPass();
+		}
+	}
+
+	recordBarriers(commandBuffer, finalBarriers);
+}
+
+void RenderGraph::recordBarriers(vk::CommandBuffer commandBuffer, const vector<RenderGraphBarrier>& barriers) const
+{
+	if (barriers.empty()) return;
+
+	// One pipeline barrier for all: images get their own barrier for their layout,
+	// buffers share a global memory barrier, as precise in practice and cheaper
+	vk::PipelineStageFlags srcStages;
+	vk::PipelineStageFlags dstStages;
+	vector<vk::MemoryBarrier> memoryBarriers;
+	vector<vk::ImageMemoryBarrier> imageBarriers;
+	for (const RenderGraphBarrier& barrier : barriers)
+	{
+		srcStages |= barrier.srcStages;
+		dstStages |= barrier.dstStages;
+
+		const Resource& resource = resources[barrier.resource];
+		if (!resource.isImage)
+		{
+			if (memoryBarriers.empty()) memoryBarriers.push_back(vk::MemoryBarrier{});
+			memoryBarriers[0].srcAccessMask |= barrier.srcAccess;
+			memoryBarriers[0].dstAccessMask |= barrier.dstAccess;
+			continue;
+		}
+
+		vk::ImageMemoryBarrier imageBarrier{};
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = resource.image;
+		imageBarrier.subresourceRange = resource.arrayLayer == ALL_ARRAY_LAYERS
+			? vk::ImageSubresourceRange{ getAspectFlags(resource.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+			: vk::ImageSubresourceRange{ getAspectFlags(resource.format), 0, VK_REMAINING_MIP_LEVELS, resource.arrayLayer, 1 };
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarriers.push_back(imageBarrier);
+	}
+
+	commandBuffer.pipelineBarrier(srcStages, dstStages, vk::DependencyFlags(), memoryBarriers, nullptr, imageBarriers);
+}
+
+void RenderGraph::clean(vk::Device device)
+{
+	for (RenderPassObjects& objects : renderPasses)
+	{
+		for (auto& framebuffer : objects.framebuffers)
+		{
+			device.destroyFramebuffer(framebuffer.second);
+		}
+		if (objects.renderPass) device.destroyRenderPass(objects.renderPass);
+	}
+	renderPasses.clear();
+
+	for (Resource& resource : resources)
+	{
+		if (resource.imported || !resource.image) continue;
+		device.destroyImageView(resource.imageView);
+		device.destroyImage(resource.image);
+		resource.imageView = vk::ImageView();
+		resource.image = vk::Image();
+	}
+	for (vk::DeviceMemory memory : aliasSlotMemories)
+	{
+		device.freeMemory(memory);
+	}
+	aliasSlotMemories.clear();
+}
+#pragma endregion Execution
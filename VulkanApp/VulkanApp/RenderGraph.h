@@ -0,0 +1,273 @@
+#pragma once
+
+#include <functional>
+#include <map>
+
+#include "VulkanUtilities.h"
+
+
+/// How a pass uses a resource. Each usage maps to the pipeline stages, accesses
+/// and image layout that barriers are built from, see getUsageAccess.
+enum class RenderGraphUsage
+{
+	ColorAttachment,
+	DepthStencilAttachment,
+	ResolveAttachment, // Written by the resolve of a multisampled color attachment, see resolve
+	InputAttachment, // Read with subpassLoad in the fragment shader, see RenderGraphCompiledPass::subpass
+	SampledFragment,
+	SampledCompute,
+	StorageReadVertex,
+	StorageReadCompute,
+	StorageReadFragment,
+	StorageWriteCompute, // Read and written
+	IndirectBuffer,
+	TransferSrc,
+	TransferDst,
+};
+
+/// Pipeline stages and accesses of one use of a resource, and the layout images must be in
+struct RenderGraphAccess
+{
+	vk::PipelineStageFlags stages;
+	vk::AccessFlags access;
+	vk::ImageLayout layout{ vk::ImageLayout::eUndefined };
+};
+
+RenderGraphAccess getUsageAccess(RenderGraphUsage usage);
+bool isWriteUsage(RenderGraphUsage usage);
+bool isAttachmentUsage(RenderGraphUsage usage);
+
+enum class RenderGraphPassType
+{
+	Graphics, // Recorded inside a render pass made of its attachments
+	Compute,
+	Transfer,
+};
+
+/// Dependency between the previous uses of a resource and the next one. Layouts are equal for buffers.
+struct RenderGraphBarrier
+{
+	uint32_t resource;
+	vk::PipelineStageFlags srcStages;
+	vk::AccessFlags srcAccess;
+	vk::PipelineStageFlags dstStages;
+	vk::AccessFlags dstAccess;
+	vk::ImageLayout oldLayout;
+	vk::ImageLayout newLayout;
+};
+
+struct RenderGraphAttachment
+{
+	uint32_t resource;
+	vk::AttachmentLoadOp loadOp;
+	vk::AttachmentStoreOp storeOp;
+	vk::ImageLayout initialLayout; // Undefined when the previous content is not needed
+	vk::ImageLayout layout; // During the subpass
+	vk::ImageLayout finalLayout;
+	vk::ClearValue clearValue;
+	uint32_t resolveSource; // Resolve attachments: the color attachment resolved into it
+};
+
+/// Dependency from an earlier subpass of the same render pass
+struct RenderGraphSubpassDependency
+{
+	uint32_t srcSubpass;
+	vk::PipelineStageFlags srcStages;
+	vk::AccessFlags srcAccess;
+	vk::PipelineStageFlags dstStages;
+	vk::AccessFlags dstAccess;
+	vk::DependencyFlags dependencyFlags; // By region when both sides are local to a pixel, see addSubpassDependency
+};
+
+/// A pass that survived culling, with everything needed to record it
+struct RenderGraphCompiledPass
+{
+	uint32_t pass; // Index given by addPass
+	vector<RenderGraphBarrier> barriers; // Recorded before the pass, outside of any render pass
+
+	// -- GRAPHICS PASSES --
+	// A graphics pass reading input attachments is the next subpass of the render pass of the
+	// previous graphics pass: what it reads can stay in tile memory. Barriers of the later subpasses
+	// are recorded with those of the first one, before the render pass begins.
+	uint32_t renderPassBegin; // Compiled index of the first subpass of the render pass
+	uint32_t subpass{ 0 };
+
+	// Attachment layout transitions are done by the render pass, synchronised by its dependencies
+	vector<RenderGraphAttachment> colorAttachments;
+	vector<RenderGraphAttachment> resolveAttachments;
+	vector<RenderGraphAttachment> inputAttachments;
+	bool hasDepthAttachment{ false };
+	RenderGraphAttachment depthAttachment{};
+	vk::PipelineStageFlags entrySrcStages; // Previous uses of the attachments, empty if none
+	vk::AccessFlags entrySrcAccess;
+	vk::PipelineStageFlags entryDstStages;
+	vk::AccessFlags entryDstAccess;
+	vk::PipelineStageFlags exitDstStages; // Uses after the final layout transitions, empty if none
+	vk::AccessFlags exitDstAccess;
+	vector<RenderGraphSubpassDependency> subpassDependencies; // One per earlier subpass waited for
+};
+
+/// Frame described as passes reading and writing virtual resources, in submission order.
+/// Compiling it, on the CPU only:
+/// - culls the passes whose results are never used (by an output or a pass with side effects),
+/// - builds the barriers between passes from the usages: a barrier only where a hazard or a layout change is,
+///   with the exact stages and accesses of both sides, and none between reads of the same layout,
+/// - builds one render pass per graphics pass, or per chain of graphics passes joined by input attachments,
+///   with load and store ops from the resource lifetimes,
+/// - gives transient images with disjoint lifetimes the same alias slot, to share memory.
+/// Transient images are then created by the graph, one memory allocation per alias slot.
+/// Executing it records the barriers, begins the render passes and calls each pass's record function.
+class RenderGraph
+{
+public:
+	//v Building =====================================================
+	/// External image, in the initial state at the start of the frame (e.g. swapchain image: color
+	/// attachment output stage, to chain with the acquire semaphore, undefined layout).
+	/// arrayLayer: a single layer of an array image, its barriers leave the other layers alone.
+	uint32_t importImage(const string& name, vk::Format format, vk::Extent2D extent, const RenderGraphAccess& initial,
+						 uint32_t arrayLayer = ALL_ARRAY_LAYERS);
+	/// External buffer. Its initial state is its use by the previous frame.
+	uint32_t importBuffer(const string& name, const RenderGraphAccess& initial);
+	/// Image living only during the frame, created by the graph
+	uint32_t createImage(const string& name, vk::Format format, vk::Extent2D extent,
+						 vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1);
+	/// Resource used after the frame, in the final state (e.g. swapchain image: present layout)
+	void markOutput(uint32_t resource, const RenderGraphAccess& final);
+
+	uint32_t addPass(const string& name, RenderGraphPassType type, std::function<void(vk::CommandBuffer)> record);
+	void read(uint32_t pass, uint32_t resource, RenderGraphUsage usage);
+	void write(uint32_t pass, uint32_t resource, RenderGraphUsage usage);
+	/// Write an attachment, cleared first: its previous content is not needed
+	void clear(uint32_t pass, uint32_t resource, RenderGraphUsage usage, const vk::ClearValue& clearValue);
+	/// Write resource with the resolve of colorResource, a multisampled color attachment of the pass
+	/// declared before. Done by the render pass at the end of the subpass, the previous content is not needed.
+	void resolve(uint32_t pass, uint32_t colorResource, uint32_t resource);
+	/// Never culled, even if nothing reads what it writes
+	void setSideEffects(uint32_t pass) { passes[pass].sideEffects = true; }
+	//^ Building =====================================================
+	//v Compilation ==================================================
+	void compile();
+
+	const vector<RenderGraphCompiledPass>& getCompiledPasses() const { return compiledPasses; }
+	/// Transitions of the outputs to their final state, after the last pass
+	const vector<RenderGraphBarrier>& getFinalBarriers() const { return finalBarriers; }
+	bool isCulled(uint32_t pass) const { return passes[pass].culled; }
+	/// Transient images of the same slot are never used at the same time and can share memory
+	uint32_t getAliasSlot(uint32_t resource) const { return resources[resource].aliasSlot; }
+	uint32_t getAliasSlotCount() const { return aliasSlotCount; }
+	/// Barriers recorded per frame, pipeline barriers and render pass dependencies alike
+	uint32_t getBarrierCount() const;
+	//^ Compilation ==================================================
+	//v Execution ====================================================
+	/// One render pass per compiled graphics pass, or chain of subpasses. After compile.
+	void createRenderPasses(vk::Device device);
+	/// Render pass and subpass of a graphics pass, to create its pipelines with
+	vk::RenderPass getRenderPass(uint32_t pass) const;
+	uint32_t getSubpass(uint32_t pass) const;
+
+	/// Create the transient images, after compile. The images of an alias slot are bound to the same memory.
+	/// Images only used as attachments are transient attachments: when the device has lazily allocated
+	/// memory (tilers), a slot of only such images uses it and may never get more than tile memory.
+	void createTransientImages(vk::PhysicalDevice physicalDevice, vk::Device device);
+	/// Bytes allocated for the transient images, and what they would take without aliasing
+	vk::DeviceSize getTransientMemorySize() const { return transientMemorySize; }
+	vk::DeviceSize getUnaliasedTransientMemorySize() const { return unaliasedTransientMemorySize; }
+	uint32_t getLazilyAllocatedSlotCount() const { return lazilyAllocatedSlotCount; }
+
+	/// Physical image of a resource, for the next executions
+	void setImage(uint32_t resource, vk::Image image, vk::ImageView imageView);
+	/// View of a transient image, once created. E.g. to write input attachment descriptors.
+	vk::ImageView getImageView(uint32_t resource) const { return resources[resource].imageView; }
+	/// Image of a transient image, once created. E.g. to create another view of it.
+	vk::Image getImage(uint32_t resource) const { return resources[resource].image; }
+
+	/// Record the whole frame. Framebuffers are created on first use of a set of image views.
+	void execute(vk::Device device, vk::CommandBuffer commandBuffer);
+
+	/// Destroy the render passes, framebuffers and transient images
+	void clean(vk::Device device);
+	//^ Execution ====================================================
+
+	static const uint32_t NO_ALIAS_SLOT{ 0xFFFFFFFF };
+	static const uint32_t ALL_ARRAY_LAYERS{ 0xFFFFFFFF };
+
+private:
+	struct Resource
+	{
+		string name;
+		bool isImage;
+		bool imported;
+		vk::Format format{ vk::Format::eUndefined };
+		vk::Extent2D extent;
+		vk::SampleCountFlagBits samples{ vk::SampleCountFlagBits::e1 };
+		uint32_t arrayLayer{ ALL_ARRAY_LAYERS };
+		RenderGraphAccess initial;
+		bool output{ false };
+		RenderGraphAccess final;
+
+		// Compiled: lifetime in compiled passes, and memory shared with the previous tenant of the slot
+		uint32_t firstUse;
+		uint32_t lastUse;
+		uint32_t aliasSlot{ NO_ALIAS_SLOT };
+		uint32_t previousTenant;
+
+		// Execution. Transient images are owned by the graph.
+		vk::Image image;
+		vk::ImageView imageView;
+	};
+	vector<Resource> resources;
+
+	struct ResourceUse
+	{
+		uint32_t resource;
+		RenderGraphUsage usage;
+		bool write;
+		bool clear; // Previous content not needed
+		vk::ClearValue clearValue;
+		uint32_t resolveSource;
+	};
+	struct Pass
+	{
+		string name;
+		RenderGraphPassType type;
+		std::function<void(vk::CommandBuffer)> record;
+		vector<ResourceUse> uses;
+		bool sideEffects{ false };
+		bool culled{ false };
+	};
+	vector<Pass> passes;
+	void addUse(uint32_t pass, const ResourceUse& use);
+
+	vector<RenderGraphCompiledPass> compiledPasses;
+	vector<RenderGraphBarrier> finalBarriers;
+	uint32_t aliasSlotCount{ 0 };
+
+	void cullPasses();
+	void computeLifetimes();
+	void assignAliasSlots();
+	void buildBarriers();
+	void chooseStoreOps();
+	/// Merged with the dependency on the same subpass, if any
+	void addSubpassDependency(RenderGraphCompiledPass& compiledPass, const RenderGraphSubpassDependency& dependency);
+
+	// One per alias slot, shared by its tenants
+	vector<vk::DeviceMemory> aliasSlotMemories;
+	vk::DeviceSize transientMemorySize{ 0 };
+	vk::DeviceSize unaliasedTransientMemorySize{ 0 };
+	uint32_t lazilyAllocatedSlotCount{ 0 };
+	/// Usage flags of an image, from its uses by the compiled passes
+	vk::ImageUsageFlags getImageUsage(uint32_t resource) const;
+
+	const RenderGraphCompiledPass& getCompiledPass(uint32_t pass) const;
+
+	// One per compiled pass, only created for the first subpass of each render pass
+	struct RenderPassObjects
+	{
+		vk::RenderPass renderPass;
+		vector<uint32_t> attachments; // Resources, in the order of the attachment descriptions
+		vector<vk::ClearValue> clearValues;
+		std::map<vector<VkImageView>, vk::Framebuffer> framebuffers; // Keyed by the attachment views
+	};
+	vector<RenderPassObjects> renderPasses;
+	void recordBarriers(vk::CommandBuffer commandBuffer, const vector<RenderGraphBarrier>& barriers) const;
+};
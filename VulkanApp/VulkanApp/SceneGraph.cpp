@@ -0,0 +1,168 @@
+#include "SceneGraph.h"
+
+#include <stdexcept>
+
+
+uint32_t SceneGraph::addNode(const glm::mat4& localTransform, uint32_t parent)
+{
+	uint32_t depth = 0;
+	uint32_t parentIndex = NO_PARENT;
+	if (parent != NO_PARENT)
+	{
+		if (parent >= nodeIndices.size())
+		{
+			throw std::runtime_error("The parent of a scene graph node must be added first");
+		}
+		parentIndex = nodeIndices[parent];
+		depth = depths[parentIndex] + 1;
+	}
+
+	// Appended: still in depth order at the deepest level, or one deeper (its parent is never deeper)
+	uint32_t index = static_cast<uint32_t>(parents.size());
+	uint32_t depthCount = getDepthCount();
+	if (sorted && depth == depthCount)
+	{
+		depthStarts.push_back(index + 1);
+	}
+	else if (sorted && depth + 1 == depthCount)
+	{
+		depthStarts.back() = index + 1;
+	}
+	else
+	{
+		sorted = false;
+	}
+
+	uint32_t id = static_cast<uint32_t>(nodeIndices.size());
+	localTransforms.push_back(localTransform);
+	worldTransforms.push_back(localTransform);
+	parents.push_back(parentIndex);
+	depths.push_back(depth);
+	flags.push_back(LOCAL_CHANGED);
+	nodeIds.push_back(id);
+	nodeIndices.push_back(index);
+
+	return id;
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	uint32_t index = nodeIndices[node];
+	localTransforms[index] = localTransform;
+	flags[index] |= LOCAL_CHANGED;
+}
+
+void SceneGraph::updateWorldTransforms()
+{
+	if (!sorted) sortByDepth();
+
+	updateRange(0, size());
+}
+
+void SceneGraph::updateWorldTransforms(JobSystem& jobSystem)
+{
+	if (!sorted) sortByDepth();
+
+	// A depth only starts once the previous one is done: parallelFor returns when all its batches are
+	for (uint32_t depth = 0; depth < getDepthCount(); ++depth)
+	{
+		size_t begin = depthStarts[depth];
+		size_t end = depthStarts[depth + 1];
+		jobSystem.parallelFor(end - begin, UPDATE_BATCH_SIZE, [this, begin](size_t batchBegin, size_t batchEnd)
+		{
+			updateRange(begin + batchBegin, begin + batchEnd);
+		});
+	}
+}
+
+void SceneGraph::reserve(size_t count)
+{
+	localTransforms.reserve(count);
+	worldTransforms.reserve(count);
+	parents.reserve(count);
+	depths.reserve(count);
+	flags.reserve(count);
+	nodeIds.reserve(count);
+	nodeIndices.reserve(count);
+}
+
+void SceneGraph::clear()
+{
+	localTransforms.clear();
+	worldTransforms.clear();
+	parents.clear();
+	depths.clear();
+	flags.clear();
+	nodeIds.clear();
+	nodeIndices.clear();
+	depthStarts.assign(1, 0);
+	sorted = true;
+}
+
+void SceneGraph::sortByDepth()
+{
+	// -- DEPTH RANGES --
+	uint32_t depthCount = 0;
+	for (uint32_t depth : depths)
+	{
+		depthCount = depth + 1 > depthCount ? depth + 1 : depthCount;
+	}
+	depthStarts.assign(depthCount + 1, 0);
+	for (uint32_t depth : depths)
+	{
+		++depthStarts[depth + 1];
+	}
+	for (uint32_t depth = 0; depth < depthCount; ++depth)
+	{
+		depthStarts[depth + 1] += depthStarts[depth];
+	}
+
+	// -- NEW ORDER --
+	// Nodes keep their relative order inside a depth
+	vector<uint32_t> newIndices(size());
+	vector<uint32_t> depthEnds(depthStarts.begin(), depthStarts.end() - 1);
+	for (size_t index = 0; index < size(); ++index)
+	{
+		newIndices[index] = depthEnds[depths[index]]++;
+	}
+
+	auto reorder = [&](auto& values)
+	{
+		auto sortedValues = values;
+		for (size_t index = 0; index < size(); ++index)
+		{
+			sortedValues[newIndices[index]] = values[index];
+		}
+		values.swap(sortedValues);
+	};
+	reorder(localTransforms);
+	reorder(worldTransforms);
+	reorder(parents);
+	reorder(depths);
+	reorder(flags);
+	reorder(nodeIds);
+	for (uint32_t& parent : parents)
+	{
+		if (parent != NO_PARENT) parent = newIndices[parent];
+	}
+	for (size_t index = 0; index < size(); ++index)
+	{
+		nodeIndices[nodeIds[index]] = static_cast<uint32_t>(index);
+	}
+
+	sorted = true;
+}
+
+void SceneGraph::updateRange(size_t begin, size_t end)
+{
+	for (size_t index = begin; index < end; ++index)
+	{
+		// The parent is at a smaller index: its flags and world transform are already those of this update
+		uint32_t parent = parents[index];
+		bool changed = (flags[index] & LOCAL_CHANGED) != 0 || (parent != NO_PARENT && (flags[parent] & WORLD_CHANGED) != 0);
+		flags[index] = changed ? WORLD_CHANGED : 0;
+		if (!changed) continue;
+
+		worldTransforms[index] = parent == NO_PARENT ? localTransforms[index] : worldTransforms[parent] * localTransforms[index];
+	}
+}
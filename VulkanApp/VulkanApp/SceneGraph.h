@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+using std::vector;
+
+
+/// Transform hierarchy, stored structure-of-arrays with the nodes sorted by depth: roots first, then their
+/// children, then the grandchildren... A parent always comes before its children, so every world transform
+/// is computed in one forward pass, from the world transform of a node already done. Each depth only reads
+/// the previous one: the parallel update splits a depth at a time between the workers.
+/// Only nodes whose local transform changed, and their descendants, get a new world transform:
+/// a static subtree costs a flag test per node.
+class SceneGraph
+{
+public:
+	/// Returns the id of the new node. Ids stay valid when nodes are sorted, indices do not.
+	/// The parent must already exist, NO_PARENT for a root.
+	uint32_t addNode(const glm::mat4& localTransform, uint32_t parent = NO_PARENT);
+	void setLocalTransform(uint32_t node, const glm::mat4& localTransform);
+	const glm::mat4& getLocalTransform(uint32_t node) const { return localTransforms[nodeIndices[node]]; }
+	/// As of the last update
+	const glm::mat4& getWorldTransform(uint32_t node) const { return worldTransforms[nodeIndices[node]]; }
+	/// Whether the last update gave the node a new world transform, e.g. to upload only those
+	bool hasWorldTransformChanged(uint32_t node) const { return (flags[nodeIndices[node]] & WORLD_CHANGED) != 0; }
+
+	/// World transforms of the changed nodes and their descendants, in a single pass over the arrays
+	void updateWorldTransforms();
+	/// Same, with each depth split into batches of UPDATE_BATCH_SIZE nodes run in parallel
+	void updateWorldTransforms(JobSystem& jobSystem);
+
+	void reserve(size_t count);
+	void clear();
+	size_t size() const { return parents.size(); }
+	/// Levels of the hierarchy, once sorted: after an update, or while nodes are added in depth order
+	uint32_t getDepthCount() const { return static_cast<uint32_t>(depthStarts.size()) - 1; }
+
+	static const uint32_t NO_PARENT{ 0xFFFFFFFF };
+	static const size_t UPDATE_BATCH_SIZE{ 4096 };
+
+private:
+	enum Flags : uint8_t
+	{
+		LOCAL_CHANGED = 1, // Set by setLocalTransform, until the next update
+		WORLD_CHANGED = 2, // Set by the last update
+	};
+
+	// -- NODES --
+	// Indexed by position in depth order
+	vector<glm::mat4> localTransforms;
+	vector<glm::mat4> worldTransforms;
+	vector<uint32_t> parents; // Index of the parent, NO_PARENT for roots
+	vector<uint32_t> depths;
+	vector<uint8_t> flags;
+	vector<uint32_t> nodeIds;
+
+	vector<uint32_t> nodeIndices; // By id
+	// First index of each depth, then the node count. Kept while nodes are added in depth order.
+	vector<uint32_t> depthStarts{ 0 };
+	bool sorted{ true };
+
+	/// Stable counting sort of the nodes by depth
+	void sortByDepth();
+	void updateRange(size_t begin, size_t end);
+};
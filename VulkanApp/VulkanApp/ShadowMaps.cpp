@@ -0,0 +1,263 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+
+void ShadowMaps::init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+					  vk::CommandPool transferCommandPool, DescriptorLayoutCache& layoutCache)
+{
+	createImages(physicalDevice, device, transferQueue, transferCommandPool);
+	createSampler(physicalDevice, device);
+	createDescriptorSetLayout(device, layoutCache);
+}
+
+void ShadowMaps::clean(vk::Device device)
+{
+	device.destroySampler(sampler);
+	device.destroyImageView(cacheView);
+	device.destroyImage(cacheImage);
+	device.freeMemory(cacheImageMemory);
+	device.destroyImageView(arrayView);
+	for (vk::ImageView layerView : layerViews)
+	{
+		device.destroyImageView(layerView);
+	}
+	device.destroyImage(shadowImage);
+	device.freeMemory(shadowImageMemory);
+}
+
+void ShadowMaps::update(FrameRingBuffer& frameRingBuffer, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar,
+						const glm::vec3& lightDirection, const glm::vec3& lightColor)
+{
+	const glm::vec3 direction = glm::normalize(lightDirection);
+
+	// Corners of the camera frustum on its near and far planes, in world space
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	std::array<glm::vec3, 4> nearCorners;
+	std::array<glm::vec3, 4> farCorners;
+	for (int i = 0; i < 4; ++i)
+	{
+		glm::vec2 ndc{ i % 2 == 0 ? -1.0f : 1.0f, i / 2 == 0 ? -1.0f : 1.0f };
+		glm::vec4 nearCorner = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+		glm::vec4 farCorner = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+	}
+
+	ShadowUbo shadowUbo{};
+	const float shadowDistance = SHADOW_DISTANCE < zFar ? SHADOW_DISTANCE : zFar;
+	float sliceStart = zNear;
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+	{
+		// -- SPLIT --
+		// Logarithmic splits match the perspective texel density, uniform ones keep the near cascades from being tiny
+		float fraction = static_cast<float>(cascade + 1) / static_cast<float>(CASCADE_COUNT);
+		float logarithmicSplit = zNear * std::pow(shadowDistance / zNear, fraction);
+		float uniformSplit = zNear + (shadowDistance - zNear) * fraction;
+		float sliceEnd = SPLIT_LAMBDA * logarithmicSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+
+		// -- BOUNDING SPHERE --
+		// The view depth is linear along each corner ray
+		std::array<glm::vec3, 8> corners;
+		glm::vec3 center{ 0.0f };
+		for (int i = 0; i < 4; ++i)
+		{
+			corners[i] = glm::mix(nearCorners[i], farCorners[i], (sliceStart - zNear) / (zFar - zNear));
+			corners[i + 4] = glm::mix(nearCorners[i], farCorners[i], (sliceEnd - zNear) / (zFar - zNear));
+			center += corners[i] + corners[i + 4];
+		}
+		center /= 8.0f;
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+		{
+			radius = std::max(radius, glm::length(corner - center));
+		}
+		// Rounded up, so that rounding errors never change the cascade size
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// -- FIT --
+		// The cached cascade moves by large steps: it is made larger by a step to still cover its slice
+		float coverage = cascade == CACHED_CASCADE ? radius * (1.0f + CACHE_SNAP_FRACTION) : radius;
+		float texelSize = 2.0f * coverage / static_cast<float>(SHADOW_MAP_SIZE);
+		float snap = cascade == CACHED_CASCADE ? texelSize * std::max(1.0f, std::floor(CACHE_SNAP_FRACTION * radius / texelSize)) : texelSize;
+		fitCascade(cascade, center, coverage, snap, direction);
+
+		shadowUbo.cascadeViewProjections[cascade] = cascadeProjections[cascade] * cascadeViews[cascade];
+		shadowUbo.splitDistances[cascade] = sliceEnd;
+		sliceStart = sliceEnd;
+	}
+
+	// Same matrix, same static shadows: the cache is still valid
+	if (shadowUbo.cascadeViewProjections[CACHED_CASCADE] != cachedViewProjection)
+	{
+		cachedViewProjection = shadowUbo.cascadeViewProjections[CACHED_CASCADE];
+		staticCacheDirty = true;
+	}
+
+	shadowUbo.lightDirection = glm::vec4(direction, 0.0f);
+	shadowUbo.lightColor = glm::vec4(lightColor, 0.0f);
+	shadowUniformOffset = frameRingBuffer.pushUniform(shadowUbo);
+}
+
+void ShadowMaps::fitCascade(uint32_t cascade, const glm::vec3& center, float radius, float snap, const glm::vec3& lightDirection)
+{
+	// Light space rotation only: moving the center by whole steps in it moves the shadow map by whole texels
+	glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+	glm::vec3 lightCenter{ lightRotation * glm::vec4(center, 1.0f) };
+	lightCenter = glm::floor(lightCenter / snap + 0.5f) * snap;
+	glm::vec3 snappedCenter{ glm::inverse(lightRotation) * glm::vec4(lightCenter, 1.0f) };
+
+	// Looks at the sphere from outside of it, far enough to catch the casters between it and the light
+	cascadeViews[cascade] = glm::lookAt(snappedCenter - lightDirection * (radius + CASTER_DISTANCE), snappedCenter, up);
+	cascadeProjections[cascade] = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + CASTER_DISTANCE);
+	// Same Y flip as the camera: triangles keep their winding, texture rows go down like framebuffer rows
+	cascadeProjections[cascade][1][1] *= -1;
+}
+
+void ShadowMaps::recordCacheCopy(vk::CommandBuffer commandBuffer)
+{
+	vk::ImageCopy region{};
+	region.srcSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eDepth, 0, 0, 1 };
+	region.dstSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eDepth, 0, CACHED_CASCADE, 1 };
+	region.extent = vk::Extent3D{ SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+	commandBuffer.copyImage(cacheImage, vk::ImageLayout::eTransferSrcOptimal, shadowImage, vk::ImageLayout::eTransferDstOptimal, region);
+}
+
+void ShadowMaps::bindShadows(vk::CommandBuffer commandBuffer, vk::PipelineLayout forwardPipelineLayout, uint32_t setIndex)
+{
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, forwardPipelineLayout, setIndex, descriptorSet, shadowUniformOffset);
+}
+
+void ShadowMaps::createImages(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue,
+							  vk::CommandPool transferCommandPool)
+{
+	//v Array ========================================================
+	// Drawn by the cascade passes, the cached layer is also a copy destination
+	vk::ImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.imageType = vk::ImageType::e2D;
+	imageCreateInfo.extent = vk::Extent3D{ SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = CASCADE_COUNT;
+	imageCreateInfo.format = SHADOW_FORMAT;
+	imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+	imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+	imageCreateInfo.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled
+		| vk::ImageUsageFlagBits::eTransferDst;
+	imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+	imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+	shadowImage = device.createImage(imageCreateInfo);
+
+	vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(shadowImage);
+	vk::MemoryAllocateInfo memoryAllocInfo{};
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,
+		vk::MemoryPropertyFlagBits::eDeviceLocal);
+	shadowImageMemory = device.allocateMemory(memoryAllocInfo);
+	device.bindImageMemory(shadowImage, shadowImageMemory, 0);
+
+	vk::ImageViewCreateInfo viewCreateInfo{};
+	viewCreateInfo.image = shadowImage;
+	viewCreateInfo.format = SHADOW_FORMAT;
+	viewCreateInfo.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, 1, 0, CASCADE_COUNT };
+	viewCreateInfo.viewType = vk::ImageViewType::e2DArray;
+	arrayView = device.createImageView(viewCreateInfo);
+	viewCreateInfo.viewType = vk::ImageViewType::e2D;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+	{
+		viewCreateInfo.subresourceRange.baseArrayLayer = cascade;
+		layerViews[cascade] = device.createImageView(viewCreateInfo);
+	}
+	//^ Array ========================================================
+	//v Cache ========================================================
+	createImage(physicalDevice, device, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1, SHADOW_FORMAT, vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &cacheImage, &cacheImageMemory);
+	cacheView = createImageView(device, cacheImage, SHADOW_FORMAT, vk::ImageAspectFlagBits::eDepth, 1);
+	//^ Cache ========================================================
+
+	// The render graph expects both in the state they are left in at the end of a frame:
+	// cascades sampled by the main pass, cache copied from
+	vk::CommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+	std::array<vk::ImageMemoryBarrier, 2> barriers{};
+	barriers[0].newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	barriers[0].image = shadowImage;
+	barriers[1].newLayout = vk::ImageLayout::eTransferSrcOptimal;
+	barriers[1].image = cacheImage;
+	for (vk::ImageMemoryBarrier& barrier : barriers)
+	{
+		barrier.oldLayout = vk::ImageLayout::eUndefined;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS };
+	}
+	// The submission is waited for: nothing to make visible
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eBottomOfPipe,
+		vk::DependencyFlags(), nullptr, nullptr, barriers);
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, commandBuffer);
+}
+
+void ShadowMaps::createSampler(vk::PhysicalDevice physicalDevice, vk::Device device)
+{
+	// Linear filtering of a comparison is a free 2x2 PCF, where the format supports it
+	vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(SHADOW_FORMAT);
+	bool linear = static_cast<bool>(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+
+	vk::SamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.magFilter = linear ? vk::Filter::eLinear : vk::Filter::eNearest;
+	samplerCreateInfo.minFilter = samplerCreateInfo.magFilter;
+	samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+	// Outside of a cascade is lit: the border is the far plane
+	samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eClampToBorder;
+	samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eClampToBorder;
+	samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eClampToBorder;
+	samplerCreateInfo.borderColor = vk::BorderColor::eFloatOpaqueWhite;
+	// Returns the fraction of texels whose depth is not in front of the compared one
+	samplerCreateInfo.compareEnable = VK_TRUE;
+	samplerCreateInfo.compareOp = vk::CompareOp::eLessOrEqual;
+	samplerCreateInfo.maxLod = 0.0f;
+	sampler = device.createSampler(samplerCreateInfo);
+}
+
+void ShadowMaps::createDescriptorSetLayout(vk::Device device, DescriptorLayoutCache& layoutCache)
+{
+	vector<vk::DescriptorSetLayoutBinding> bindings(2);
+	// Binding 0: cascades and light, in the frame ring buffer
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eFragment;
+	// Binding 1: every cascade, with the comparison sampler
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+	descriptorSetLayout = layoutCache.createLayout(device, bindings);
+}
+
+void ShadowMaps::createDescriptorSet(vk::Device device, const FrameRingBuffer& frameRingBuffer, DescriptorAllocator& descriptorAllocator)
+{
+	descriptorSet = descriptorAllocator.allocate(device, descriptorSetLayout);
+
+	// Offset 0 here, the dynamic offset given when binding selects the frame's ShadowUbo
+	vk::DescriptorBufferInfo bufferInfo{ frameRingBuffer.getBuffer(), 0, sizeof(ShadowUbo) };
+	vk::DescriptorImageInfo imageInfo{ sampler, arrayView, vk::ImageLayout::eShaderReadOnlyOptimal };
+
+	std::array<vk::WriteDescriptorSet, 2> writes{};
+	writes[0].dstSet = descriptorSet;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	writes[0].descriptorCount = 1;
+	writes[0].pBufferInfo = &bufferInfo;
+	writes[1].dstSet = descriptorSet;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	writes[1].descriptorCount = 1;
+	writes[1].pImageInfo = &imageInfo;
+	device.updateDescriptorSets(writes, nullptr);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+
+#include "VulkanUtilities.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+
+
+/// Cascaded shadow maps of the directional light: the camera frustum, up to SHADOW_DISTANCE, is split
+/// in CASCADE_COUNT slices, each drawn from the light in a layer of one depth array image.
+/// Cascades are stable: each covers the bounding sphere of its slice, whose size does not change when
+/// the camera turns, and moves in whole texels, so shadow edges do not shimmer.
+/// The last cascade is the most expensive (widest area, most casters) and changes the least: its
+/// static casters are drawn in a cache image, re-rendered only when its light matrix changes (the light
+/// moves, or the camera moved far enough for the coarsely snapped cascade to follow). Each frame the
+/// cache is copied into its layer, and only dynamic casters are drawn on top.
+class ShadowMaps
+{
+public:
+	/// Images, views, sampler and set layout. The set layout is needed by the forward pipeline layout,
+	/// before the descriptor allocators exist: the set itself is created by createDescriptorSet.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+			  DescriptorLayoutCache& layoutCache);
+	void createDescriptorSet(vk::Device device, const FrameRingBuffer& frameRingBuffer, DescriptorAllocator& descriptorAllocator);
+	void clean(vk::Device device);
+
+	/// Fit the cascades to the camera and write them, with the light, in the current frame's ring region.
+	/// zNear and zFar must be those of the projection, lightDirection is where the light goes.
+	void update(FrameRingBuffer& frameRingBuffer, const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar,
+				const glm::vec3& lightDirection, const glm::vec3& lightColor);
+	/// Light view and projection of a cascade, for this frame's casters and their culling
+	const glm::mat4& getCascadeView(uint32_t cascade) const { return cascadeViews[cascade]; }
+	const glm::mat4& getCascadeProjection(uint32_t cascade) const { return cascadeProjections[cascade]; }
+
+	/// Whether the static casters of the cached cascade must be drawn again in the cache this frame
+	bool isStaticCacheDirty() const { return staticCacheDirty; }
+	void markStaticCacheRendered() { staticCacheDirty = false; ++staticCacheUpdateCount; }
+	/// Times the cache was drawn, against the frames it was reused in
+	uint32_t getStaticCacheUpdateCount() const { return staticCacheUpdateCount; }
+	/// Copy the cache into the layer of the cached cascade. Cache in transfer source layout, layer in transfer destination.
+	void recordCacheCopy(vk::CommandBuffer commandBuffer);
+	/// Bind the shadow maps and the light for the forward pipelines, at setIndex of their layout
+	void bindShadows(vk::CommandBuffer commandBuffer, vk::PipelineLayout forwardPipelineLayout, uint32_t setIndex);
+
+	vk::DescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+	/// For the render graph: the array image is imported one layer at a time, each drawn by its own pass
+	vk::Image getImage() const { return shadowImage; }
+	vk::ImageView getLayerView(uint32_t cascade) const { return layerViews[cascade]; }
+	vk::Image getCacheImage() const { return cacheImage; }
+	vk::ImageView getCacheView() const { return cacheView; }
+
+	// Must match clustered.frag
+	static const uint32_t CASCADE_COUNT{ 4 };
+	static const uint32_t CACHED_CASCADE{ CASCADE_COUNT - 1 };
+	static const uint32_t SHADOW_MAP_SIZE{ 2048 };
+	/// Always supported as a sampled depth attachment, and half the bandwidth of 32 bit depth
+	static const vk::Format SHADOW_FORMAT{ vk::Format::eD16Unorm };
+
+private:
+	const float SHADOW_DISTANCE{ 120.0f }; // From the camera, no shadows past it
+	const float SPLIT_LAMBDA{ 0.8f }; // Blend of logarithmic (1) and uniform (0) splits
+	const float CASTER_DISTANCE{ 50.0f }; // Casters this far behind a cascade, towards the light, still cast in it
+	const float CACHE_SNAP_FRACTION{ 0.25f }; // Of the cached cascade radius: it only moves by such steps
+
+	// Matches the Shadows uniform block of clustered.frag
+	struct ShadowUbo
+	{
+		glm::mat4 cascadeViewProjections[CASCADE_COUNT];
+		glm::vec4 splitDistances; // View space distance where each cascade ends
+		glm::vec4 lightDirection;
+		glm::vec4 lightColor;
+	};
+	uint32_t shadowUniformOffset{ 0 }; // Dynamic offset of this frame's data
+
+	std::array<glm::mat4, CASCADE_COUNT> cascadeViews;
+	std::array<glm::mat4, CASCADE_COUNT> cascadeProjections;
+	glm::mat4 cachedViewProjection{ 0.0f }; // Of the static cache content
+	bool staticCacheDirty{ true };
+	uint32_t staticCacheUpdateCount{ 0 };
+
+	// -- IMAGES --
+	vk::Image shadowImage; // One layer per cascade
+	vk::DeviceMemory shadowImageMemory;
+	std::array<vk::ImageView, CASCADE_COUNT> layerViews; // Depth attachments
+	vk::ImageView arrayView; // Sampled
+	vk::Image cacheImage; // Static casters of the cached cascade
+	vk::DeviceMemory cacheImageMemory;
+	vk::ImageView cacheView;
+	vk::Sampler sampler; // Depth comparison
+
+	// -- DESCRIPTORS --
+	vk::DescriptorSetLayout descriptorSetLayout; // Owned by the layout cache
+	vk::DescriptorSet descriptorSet;
+
+	void createImages(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool);
+	void createSampler(vk::PhysicalDevice physicalDevice, vk::Device device);
+	void createDescriptorSetLayout(vk::Device device, DescriptorLayoutCache& layoutCache);
+	/// Light view and projection covering a sphere, its center moved by whole snap steps in light space
+	void fitCascade(uint32_t cascade, const glm::vec3& center, float radius, float snap, const glm::vec3& lightDirection);
+};
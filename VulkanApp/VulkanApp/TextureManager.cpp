@@ -0,0 +1,360 @@
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <exception>
+#include <cctype>
+
+
+void TextureManager::init(vk::PhysicalDevice physicalDeviceP, vk::Device deviceP, vk::Queue transferQueueP, vk::CommandPool transferCommandPoolP,
+						  JobSystem& jobSystemP, BindlessDescriptors& bindlessDescriptorsP, float maxSamplerAnisotropyP)
+{
+	physicalDevice = physicalDeviceP;
+	device = deviceP;
+	transferQueue = transferQueueP;
+	transferCommandPool = transferCommandPoolP;
+	jobSystem = &jobSystemP;
+	bindlessDescriptors = &bindlessDescriptorsP;
+	maxSamplerAnisotropy = maxSamplerAnisotropyP;
+}
+
+void TextureManager::clean()
+{
+	for (Texture& texture : textures)
+	{
+		bindlessDescriptors->releaseTexture(texture.bindlessIndex);
+		device.destroyImageView(texture.imageView);
+		device.destroyImage(texture.image);
+		device.freeMemory(texture.imageMemory);
+	}
+	textures.clear();
+
+	for (auto& sampler : samplers)
+	{
+		device.destroySampler(sampler.second);
+	}
+	samplers.clear();
+}
+
+vector<uint32_t> TextureManager::loadTextures(const vector<string>& filenames, const SamplerDescription& samplerDescription)
+{
+	// Decoding is the slow part and only touches CPU memory: one file per job.
+	// Exceptions can't cross threads, keep the first one and throw it here.
+	vector<TextureData> textureData(filenames.size());
+	std::exception_ptr decodeError;
+	std::mutex errorMutex;
+	jobSystem->parallelFor(filenames.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			try
+			{
+				textureData[i] = decodeFile(filenames[i]);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock{ errorMutex };
+				if (!decodeError) decodeError = std::current_exception();
+			}
+		}
+	});
+	if (decodeError)
+	{
+		std::rethrow_exception(decodeError);
+	}
+
+	return createTextures(textureData, samplerDescription);
+}
+
+vector<uint32_t> TextureManager::createTextures(const vector<ImageData>& images, const SamplerDescription& samplerDescription)
+{
+	vector<TextureData> textureData(images.size());
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		textureData[i].format = IMAGE_FORMAT;
+		textureData[i].width = images[i].width;
+		textureData[i].height = images[i].height;
+		textureData[i].levelOffsets.push_back(0);
+		textureData[i].data = images[i].pixels;
+	}
+
+	return createTextures(textureData, samplerDescription);
+}
+
+vector<uint32_t> TextureManager::createTextures(const vector<TextureData>& textureData, const SamplerDescription& samplerDescription)
+{
+	vector<uint32_t> textureIds;
+	if (textureData.empty()) return textureIds;
+
+	for (const TextureData& data : textureData)
+	{
+		if (!isFormatSupported(data.format))
+		{
+			throw std::runtime_error("Texture format not supported by the device: " + vk::to_string(data.format));
+		}
+	}
+
+	//v Staging ======================================================
+	// Every texture of the batch goes in one staging buffer, one after the other. Offsets
+	// of buffer to image copies must be multiples of the block size: keep them 16 bytes aligned.
+	vk::DeviceSize stagingSize = 0;
+	vector<vk::DeviceSize> stagingOffsets;
+	for (const TextureData& data : textureData)
+	{
+		stagingSize = (stagingSize + 15) & ~vk::DeviceSize(15);
+		stagingOffsets.push_back(stagingSize);
+		stagingSize += data.data.size();
+	}
+
+	vk::Buffer stagingBuffer;
+	vk::DeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		&stagingBuffer, &stagingBufferMemory);
+
+	uint8_t* stagingData = static_cast<uint8_t*>(device.mapMemory(stagingBufferMemory, 0, stagingSize));
+	for (size_t i = 0; i < textureData.size(); ++i)
+	{
+		memcpy(stagingData + stagingOffsets[i], textureData[i].data.data(), textureData[i].data.size());
+	}
+	device.unmapMemory(stagingBufferMemory);
+	//^ Staging ======================================================
+	//v Images =======================================================
+	vk::Sampler sampler = getSampler(samplerDescription);
+	vk::CommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	for (size_t i = 0; i < textureData.size(); ++i)
+	{
+		const TextureData& data = textureData[i];
+
+		Texture texture{};
+		texture.format = data.format;
+		texture.width = data.width;
+		texture.height = data.height;
+		// A single level gets the others generated, if the format can be blitted
+		bool generateMips = data.getLevelCount() == 1 && isLinearBlitSupported(data.format);
+		texture.mipLevels = generateMips ? getMipLevelCount(texture.width, texture.height) : data.getLevelCount();
+		texture.sampler = sampler;
+
+		// Every level is a blit destination, all but the last one are also blit sources
+		createImage(physicalDevice, device, texture.width, texture.height, texture.mipLevels, texture.format,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled,
+			vk::MemoryPropertyFlagBits::eDeviceLocal, &texture.image, &texture.imageMemory);
+
+		recordUpload(commandBuffer, stagingBuffer, stagingOffsets[i], data, texture);
+
+		texture.imageView = createImageView(device, texture.image, texture.format, vk::ImageAspectFlagBits::eColor, texture.mipLevels);
+		texture.bindlessIndex = bindlessDescriptors->registerTexture(device, texture.imageView, texture.sampler);
+
+		textureIds.push_back(static_cast<uint32_t>(textures.size()));
+		textures.push_back(texture);
+	}
+
+	// One submission for the whole batch
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, commandBuffer);
+	//^ Images =======================================================
+
+	device.destroyBuffer(stagingBuffer);
+	device.freeMemory(stagingBufferMemory);
+
+	return textureIds;
+}
+
+uint32_t TextureManager::getMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levelCount = 1;
+	uint32_t size = std::max(width, height);
+	while (size > 1)
+	{
+		size /= 2;
+		++levelCount;
+	}
+	return levelCount;
+}
+
+bool TextureManager::isFormatSupported(vk::Format format) const
+{
+	// Block compressed formats only report features when their textureCompression feature is supported,
+	// and the renderer enables every supported one
+	vk::FormatFeatureFlags samplingFeatures = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(format);
+	return (formatProperties.optimalTilingFeatures & samplingFeatures) == samplingFeatures;
+}
+
+bool TextureManager::isLinearBlitSupported(vk::Format format) const
+{
+	// Mips are blitted from the level above, with linear filtering: the format must allow all three
+	vk::FormatFeatureFlags blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst
+		| vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(format);
+	return (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+}
+
+TextureData TextureManager::decodeFile(const string& filename) const
+{
+	string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	if (extension != "ktx2")
+	{
+		ImageData image = loadImage(filename);
+
+		TextureData data;
+		data.format = IMAGE_FORMAT;
+		data.width = image.width;
+		data.height = image.height;
+		data.levelOffsets.push_back(0);
+		data.data = std::move(image.pixels);
+		return data;
+	}
+
+	// Native formats only: Basis Universal files throw
+	return loadKtx2(readBinaryFile(filename));
+}
+
+void TextureManager::recordUpload(vk::CommandBuffer commandBuffer, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset,
+								  const TextureData& textureData, const Texture& texture)
+{
+	// -- UNDEFINED TO TRANSFER DESTINATION, EVERY LEVEL --
+	vk::ImageMemoryBarrier transferBarrier{};
+	transferBarrier.oldLayout = vk::ImageLayout::eUndefined; // Previous content does not matter
+	transferBarrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+	transferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transferBarrier.image = texture.image;
+	transferBarrier.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, texture.mipLevels, 0, 1 };
+	transferBarrier.srcAccessMask = vk::AccessFlags();
+	transferBarrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(), nullptr, nullptr, transferBarrier);
+
+	// -- COPY THE LEVELS OF THE DATA --
+	// One region per level, in a single copy command
+	vector<vk::BufferImageCopy> copyRegions(textureData.getLevelCount());
+	for (uint32_t level = 0; level < textureData.getLevelCount(); ++level)
+	{
+		copyRegions[level].bufferOffset = stagingOffset + textureData.levelOffsets[level];
+		copyRegions[level].bufferRowLength = 0; // 0: tightly packed
+		copyRegions[level].bufferImageHeight = 0;
+		copyRegions[level].imageSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, level, 0, 1 };
+		copyRegions[level].imageOffset = vk::Offset3D{ 0, 0, 0 };
+		// Size in texels, even when the last blocks of a compressed level are only partly covered
+		copyRegions[level].imageExtent = vk::Extent3D{ std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+	}
+	commandBuffer.copyBufferToImage(stagingBuffer, texture.image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+	if (texture.mipLevels > textureData.getLevelCount())
+	{
+		recordMipGeneration(commandBuffer, texture);
+		return;
+	}
+
+	// -- EVERY LEVEL TO SHADER READ ONLY --
+	vk::ImageMemoryBarrier readBarrier = transferBarrier;
+	readBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	readBarrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	readBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	readBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+		vk::DependencyFlags(), nullptr, nullptr, readBarrier);
+}
+
+void TextureManager::recordMipGeneration(vk::CommandBuffer commandBuffer, const Texture& texture)
+{
+	// Each level goes through: transfer destination (written) -> transfer source (read by the next level)
+	// -> shader read only. The last level is never read by a blit.
+	vk::ImageMemoryBarrier barrier{};
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture.image;
+	barrier.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+
+	int32_t levelWidth = static_cast<int32_t>(texture.width);
+	int32_t levelHeight = static_cast<int32_t>(texture.height);
+
+	for (uint32_t level = 1; level < texture.mipLevels; ++level)
+	{
+		// Previous level is complete, read it
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		// Half the size, down to 1 pixel
+		int32_t nextWidth = std::max(levelWidth / 2, 1);
+		int32_t nextHeight = std::max(levelHeight / 2, 1);
+
+		vk::ImageBlit blit{};
+		blit.srcSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, level - 1, 0, 1 };
+		blit.srcOffsets[0] = vk::Offset3D{ 0, 0, 0 };
+		blit.srcOffsets[1] = vk::Offset3D{ levelWidth, levelHeight, 1 };
+		blit.dstSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, level, 0, 1 };
+		blit.dstOffsets[0] = vk::Offset3D{ 0, 0, 0 };
+		blit.dstOffsets[1] = vk::Offset3D{ nextWidth, nextHeight, 1 };
+		commandBuffer.blitImage(texture.image, vk::ImageLayout::eTransferSrcOptimal,
+			texture.image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+		// Previous level is done, hand it to the shaders
+		barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+
+	// Last level was only written
+	barrier.subresourceRange.baseMipLevel = texture.mipLevels - 1;
+	barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+		vk::DependencyFlags(), nullptr, nullptr, barrier);
+}
+
+//v Sampler cache ================================================
+vk::Sampler TextureManager::getSampler(const SamplerDescription& description)
+{
+	auto cachedSampler = samplers.find(description);
+	if (cachedSampler != samplers.end())
+	{
+		return cachedSampler->second;
+	}
+
+	vk::SamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.magFilter = description.filter;
+	samplerCreateInfo.minFilter = description.filter;
+	samplerCreateInfo.mipmapMode = description.mipmapMode;
+	samplerCreateInfo.addressModeU = description.addressMode;
+	samplerCreateInfo.addressModeV = description.addressMode;
+	samplerCreateInfo.addressModeW = description.addressMode;
+	samplerCreateInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	// Every level of any texture: one sampler serves textures of any size
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+	float anisotropy = std::min(description.maxAnisotropy, maxSamplerAnisotropy);
+	samplerCreateInfo.anisotropyEnable = anisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = std::max(anisotropy, 1.0f);
+
+	vk::Sampler sampler = device.createSampler(samplerCreateInfo);
+	samplers[description] = sampler;
+	return sampler;
+}
+
+size_t TextureManager::SamplerDescriptionHash::operator()(const SamplerDescription& description) const
+{
+	size_t hash = std::hash<uint32_t>()(static_cast<uint32_t>(description.filter));
+	hash ^= std::hash<uint32_t>()(static_cast<uint32_t>(description.mipmapMode)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<uint32_t>()(static_cast<uint32_t>(description.addressMode)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<float>()(description.maxAnisotropy) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+//^ Sampler cache ================================================
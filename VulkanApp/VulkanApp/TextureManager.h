@@ -0,0 +1,109 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "VulkanUtilities.h"
+#include "ImageLoader.h"
+#include "Ktx2Loader.h"
+#include "JobSystem.h"
+#include "BindlessDescriptors.h"
+
+
+/// Sampler parameters. Textures asking for the same description share one vk::Sampler.
+struct SamplerDescription
+{
+	vk::Filter filter{ vk::Filter::eLinear }; // Magnification and minification
+	vk::SamplerMipmapMode mipmapMode{ vk::SamplerMipmapMode::eLinear };
+	vk::SamplerAddressMode addressMode{ vk::SamplerAddressMode::eRepeat };
+	float maxAnisotropy{ 16.0f }; // Clamped to the device limit, 1 or less disables anisotropic filtering
+
+	bool operator==(const SamplerDescription& other) const
+	{
+		return filter == other.filter && mipmapMode == other.mipmapMode
+			&& addressMode == other.addressMode && maxAnisotropy == other.maxAnisotropy;
+	}
+};
+
+struct Texture
+{
+	vk::Image image;
+	vk::DeviceMemory imageMemory;
+	vk::ImageView imageView; // Every mip level
+	vk::Sampler sampler; // Owned by the TextureManager sampler cache
+	vk::Format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	uint32_t bindlessIndex; // Index in the bindless textures array
+};
+
+/// Loads images into sampled textures: files are decoded in parallel on the job system,
+/// uploaded through one staging buffer and one submission per batch, with one copy per mip
+/// level. KTX2 files bring their own levels, block compressed (BCn, ETC2, ASTC) or not.
+/// Other images get their full mip chain generated on the GPU by successive linear blits.
+/// Every texture is registered in the bindless set.
+class TextureManager
+{
+public:
+	/// maxSamplerAnisotropy: 0 when the samplerAnisotropy feature is not enabled
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+			  JobSystem& jobSystem, BindlessDescriptors& bindlessDescriptors, float maxSamplerAnisotropy);
+	void clean();
+
+	/// Decode the files on worker threads, then upload them all at once. Returns the texture ids, in order.
+	/// Supported: .ktx2 (see Ktx2Loader.h) and what loadImage reads.
+	vector<uint32_t> loadTextures(const vector<string>& filenames, const SamplerDescription& samplerDescription = SamplerDescription{});
+	uint32_t loadTexture(const string& filename, const SamplerDescription& samplerDescription = SamplerDescription{})
+	{
+		return loadTextures({ filename }, samplerDescription)[0];
+	}
+	/// Upload images already in memory
+	vector<uint32_t> createTextures(const vector<ImageData>& images, const SamplerDescription& samplerDescription = SamplerDescription{});
+	vector<uint32_t> createTextures(const vector<TextureData>& textureData, const SamplerDescription& samplerDescription = SamplerDescription{});
+
+	/// Whether the device can sample and linearly filter images of this format
+	bool isFormatSupported(vk::Format format) const;
+	/// Shared sampler for the description, created on first use
+	vk::Sampler getSampler(const SamplerDescription& description);
+
+	const Texture& getTexture(uint32_t textureId) const { return textures[textureId]; }
+	uint32_t getTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+	uint32_t getSamplerCount() const { return static_cast<uint32_t>(samplers.size()); }
+
+	/// Format of decoded images. Unorm, like the swapchain: colors are stored and displayed as they are.
+	static const vk::Format IMAGE_FORMAT{ vk::Format::eR8G8B8A8Unorm };
+
+	/// Levels down to 1x1: floor(log2(max(width, height))) + 1
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+private:
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	vk::Queue transferQueue;
+	vk::CommandPool transferCommandPool;
+	JobSystem* jobSystem{ nullptr };
+	BindlessDescriptors* bindlessDescriptors{ nullptr };
+
+	float maxSamplerAnisotropy{ 0.0f };
+
+	/// Decode any supported file, on a worker
+	TextureData decodeFile(const string& filename) const;
+	/// Blits with linear filtering need format support, without it textures keep their levels
+	bool isLinearBlitSupported(vk::Format format) const;
+
+	vector<Texture> textures;
+
+	//v Sampler cache ================================================
+	struct SamplerDescriptionHash
+	{
+		size_t operator()(const SamplerDescription& description) const;
+	};
+	std::unordered_map<SamplerDescription, vk::Sampler, SamplerDescriptionHash> samplers;
+	//^ Sampler cache ================================================
+
+	/// Transition every level to transfer destination, copy the levels present in the data,
+	/// blit the missing ones, then leave every level in shader read only layout
+	void recordUpload(vk::CommandBuffer commandBuffer, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset,
+					  const TextureData& textureData, const Texture& texture);
+	void recordMipGeneration(vk::CommandBuffer commandBuffer, const Texture& texture);
+};
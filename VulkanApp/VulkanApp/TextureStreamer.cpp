@@ -0,0 +1,407 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/// Bytes of one level, block compressed or not
+static vk::DeviceSize getLevelSize(const TextureData& data, uint32_t level)
+{
+	const FormatBlock block = getFormatBlock(data.format);
+	uint32_t levelWidth = std::max(data.width >> level, 1u);
+	uint32_t levelHeight = std::max(data.height >> level, 1u);
+	return static_cast<vk::DeviceSize>((levelWidth + block.width - 1) / block.width)
+		* ((levelHeight + block.height - 1) / block.height) * block.size;
+}
+
+/// Append every level down to 1x1 to single level RGBA8 data, each the 2x2 box filtered previous one
+static void generateMipChain(TextureData& data)
+{
+	uint32_t width = data.width;
+	uint32_t height = data.height;
+	while (width > 1 || height > 1)
+	{
+		uint32_t nextWidth = std::max(width / 2, 1u);
+		uint32_t nextHeight = std::max(height / 2, 1u);
+
+		size_t previousOffset = static_cast<size_t>(data.levelOffsets.back());
+		size_t offset = static_cast<size_t>(alignUp(data.data.size(), 16));
+		data.levelOffsets.push_back(offset);
+		data.data.resize(offset + static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+		const uint8_t* source = &data.data[previousOffset];
+		uint8_t* destination = &data.data[offset];
+		for (uint32_t y = 0; y < nextHeight; ++y)
+		{
+			// Odd sizes: the last row or column is averaged with itself
+			uint32_t y0 = std::min(y * 2, height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < nextWidth; ++x)
+			{
+				uint32_t x0 = std::min(x * 2, width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					uint32_t sum = source[(y0 * width + x0) * 4 + channel] + source[(y0 * width + x1) * 4 + channel]
+						+ source[(y1 * width + x0) * 4 + channel] + source[(y1 * width + x1) * 4 + channel];
+					destination[(y * nextWidth + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+void TextureStreamer::init(vk::PhysicalDevice physicalDeviceP, vk::Device deviceP, BindlessDescriptors& bindlessDescriptorsP,
+						   uint32_t framesInFlightP, vk::DeviceSize budgetP, vk::DeviceSize stagingSizeP, bool memoryBudgetSupportedP)
+{
+	physicalDevice = physicalDeviceP;
+	device = deviceP;
+	bindlessDescriptors = &bindlessDescriptorsP;
+	framesInFlight = framesInFlightP;
+	budget = budgetP;
+	stagingSize = stagingSizeP;
+	memoryBudgetSupported = memoryBudgetSupportedP;
+
+	// Images are device local: the budget is read from the largest device local heap
+	vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+	vk::DeviceSize largestHeapSize = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		const vk::MemoryHeap& heap = memoryProperties.memoryHeaps[i];
+		if ((heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) && heap.size > largestHeapSize)
+		{
+			largestHeapSize = heap.size;
+			deviceLocalHeap = i;
+		}
+	}
+
+	createBuffer(physicalDevice, device, stagingSize * framesInFlight, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		&stagingBuffer, &stagingBufferMemory);
+	stagingData = static_cast<uint8_t*>(device.mapMemory(stagingBufferMemory, 0, stagingSize * framesInFlight));
+}
+
+void TextureStreamer::clean()
+{
+	releaseRetiredImages(true);
+
+	for (StreamedTexture& texture : textures)
+	{
+		if (texture.bindlessIndex == BindlessDescriptors::INVALID_INDEX) continue;
+
+		bindlessDescriptors->releaseTexture(texture.bindlessIndex);
+		device.destroyImageView(texture.imageView);
+		device.destroyImage(texture.image);
+		device.freeMemory(texture.imageMemory);
+	}
+	textures.clear();
+	residentSize = 0;
+
+	device.unmapMemory(stagingBufferMemory);
+	device.destroyBuffer(stagingBuffer);
+	device.freeMemory(stagingBufferMemory);
+}
+
+uint32_t TextureStreamer::addTexture(TextureData data, vk::Sampler sampler)
+{
+	bool rgba8 = data.format == vk::Format::eR8G8B8A8Unorm || data.format == vk::Format::eR8G8B8A8Srgb;
+	if (data.getLevelCount() == 1 && rgba8)
+	{
+		generateMipChain(data);
+	}
+
+	StreamedTexture texture;
+	texture.source = std::move(data);
+	texture.sampler = sampler;
+
+	// Smallest levels are always resident: they cost little and there is always something to sample
+	uint32_t levelCount = texture.source.getLevelCount();
+	texture.tailLevel = 0;
+	while (texture.tailLevel + 1 < levelCount
+		&& std::max(texture.source.width >> texture.tailLevel, texture.source.height >> texture.tailLevel) > TAIL_SIZE)
+	{
+		++texture.tailLevel;
+	}
+	texture.residentLevel = levelCount;
+	texture.requestedLevel = levelCount;
+
+	textures.push_back(std::move(texture));
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void TextureStreamer::requestSize(uint32_t textureId, float screenSize)
+{
+	StreamedTexture& texture = textures[textureId];
+
+	// One texel per pixel: each level above that one is wasted at this size
+	float texelsPerPixel = static_cast<float>(std::max(texture.source.width, texture.source.height)) / std::max(screenSize, 1.0f);
+	uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+	level = std::min(level, texture.source.getLevelCount() - 1);
+
+	texture.requestedLevel = std::min(texture.requestedLevel, level);
+	texture.lastRequestFrame = frameCount + 1; // Frame of the next update
+}
+
+void TextureStreamer::update(vk::CommandBuffer commandBuffer, uint32_t frame)
+{
+	++frameCount;
+	releaseRetiredImages(false);
+
+	stagingBegin = frame * stagingSize;
+	stagingHead = stagingBegin;
+
+	//v Planning =====================================================
+	// Target level of every texture: requested levels are loaded, never less than the tail.
+	// Textures that were not requested keep their levels, until the budget needs them.
+	vector<uint32_t> targetLevels(textures.size());
+	vector<uint32_t> loads;
+	vk::DeviceSize plannedSize = 0;
+	for (uint32_t i = 0; i < textures.size(); ++i)
+	{
+		const StreamedTexture& texture = textures[i];
+		targetLevels[i] = texture.residentLevel;
+		plannedSize += getResidencySize(texture, texture.residentLevel);
+		if (std::min(texture.requestedLevel, texture.tailLevel) < texture.residentLevel)
+		{
+			loads.push_back(i);
+		}
+	}
+
+	// Missing tails first, then the most recently requested textures, then the ones missing the most levels
+	std::sort(loads.begin(), loads.end(), [this](uint32_t a, uint32_t b)
+	{
+		const StreamedTexture& textureA = textures[a];
+		const StreamedTexture& textureB = textures[b];
+		bool tailMissingA = textureA.residentLevel > textureA.tailLevel;
+		bool tailMissingB = textureB.residentLevel > textureB.tailLevel;
+		if (tailMissingA != tailMissingB) return tailMissingA;
+		if (textureA.lastRequestFrame != textureB.lastRequestFrame) return textureA.lastRequestFrame > textureB.lastRequestFrame;
+		return textureA.residentLevel - std::min(textureA.requestedLevel, textureA.tailLevel)
+			> textureB.residentLevel - std::min(textureB.requestedLevel, textureB.tailLevel);
+	});
+
+	const vk::DeviceSize available = getBudget();
+	vk::DeviceSize stagingLeft = stagingSize;
+	for (uint32_t i : loads)
+	{
+		StreamedTexture& texture = textures[i];
+		uint32_t level = std::min(texture.requestedLevel, texture.tailLevel);
+
+		// What does not fit in this frame's staging region comes in a later frame, largest levels last
+		while (level < texture.residentLevel && getUploadSize(texture, level, texture.residentLevel) > stagingLeft)
+		{
+			++level;
+		}
+
+		// Make room by dropping the largest level of the least recently requested texture.
+		// The tail is always loaded, even over budget.
+		while (level < texture.tailLevel
+			&& plannedSize - getResidencySize(texture, targetLevels[i]) + getResidencySize(texture, level) > available)
+		{
+			uint32_t victim = static_cast<uint32_t>(textures.size());
+			for (uint32_t j = 0; j < textures.size(); ++j)
+			{
+				bool evictable = j != i && targetLevels[j] < textures[j].tailLevel && textures[j].lastRequestFrame < frameCount;
+				if (evictable && (victim == textures.size() || textures[j].lastRequestFrame < textures[victim].lastRequestFrame))
+				{
+					victim = j;
+				}
+			}
+
+			if (victim == textures.size())
+			{
+				++level; // Nothing left to evict, load less
+				continue;
+			}
+			plannedSize -= getResidencySize(textures[victim], targetLevels[victim]) - getResidencySize(textures[victim], targetLevels[victim] + 1);
+			++targetLevels[victim];
+		}
+
+		if (level < targetLevels[i])
+		{
+			plannedSize += getResidencySize(texture, level) - getResidencySize(texture, targetLevels[i]);
+			stagingLeft -= getUploadSize(texture, level, texture.residentLevel);
+			targetLevels[i] = level;
+		}
+	}
+	//^ Planning =====================================================
+
+	// Evictions and loads alike: a new image with the target levels
+	for (uint32_t i = 0; i < textures.size(); ++i)
+	{
+		if (targetLevels[i] != textures[i].residentLevel)
+		{
+			recordResidencyChange(commandBuffer, textures[i], targetLevels[i]);
+		}
+		textures[i].requestedLevel = textures[i].source.getLevelCount();
+	}
+}
+
+vk::DeviceSize TextureStreamer::getBudget() const
+{
+	if (!memoryBudgetSupported) return budget;
+
+	// The heap usage includes the resident levels: what the heap has left, plus what is already ours.
+	// The budget of the heap moves with the other applications and the OS, read it every time.
+	auto memoryProperties = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& memoryBudget = memoryProperties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	vk::DeviceSize heapBudget = memoryBudget.heapBudget[deviceLocalHeap];
+	vk::DeviceSize heapUsage = memoryBudget.heapUsage[deviceLocalHeap];
+	vk::DeviceSize heapLeft = heapBudget > heapUsage ? heapBudget - heapUsage : 0;
+
+	return std::min(budget, residentSize + heapLeft);
+}
+
+void TextureStreamer::releaseRetiredImages(bool all)
+{
+	// An image retired during frame N may be read by the frames submitted before it,
+	// which are all done once framesInFlight more frames have waited on their fence
+	size_t kept = 0;
+	for (RetiredImage& retired : retiredImages)
+	{
+		if (!all && retired.retireFrame + framesInFlight > frameCount)
+		{
+			retiredImages[kept++] = retired;
+			continue;
+		}
+
+		bindlessDescriptors->releaseTexture(retired.bindlessIndex);
+		device.destroyImageView(retired.imageView);
+		device.destroyImage(retired.image);
+		device.freeMemory(retired.imageMemory);
+	}
+	retiredImages.resize(kept);
+}
+
+vk::DeviceSize TextureStreamer::getResidencySize(const StreamedTexture& texture, uint32_t level) const
+{
+	vk::DeviceSize size = 0;
+	for (uint32_t i = level; i < texture.source.getLevelCount(); ++i)
+	{
+		size += getLevelSize(texture.source, i);
+	}
+	return size;
+}
+
+vk::DeviceSize TextureStreamer::getUploadSize(const StreamedTexture& texture, uint32_t level, uint32_t end) const
+{
+	// Each level starts 16 bytes aligned in the staging buffer
+	vk::DeviceSize size = 0;
+	for (uint32_t i = level; i < std::min(end, texture.source.getLevelCount()); ++i)
+	{
+		size += alignUp(getLevelSize(texture.source, i), 16);
+	}
+	return size;
+}
+
+void TextureStreamer::recordResidencyChange(vk::CommandBuffer commandBuffer, StreamedTexture& texture, uint32_t level)
+{
+	const TextureData& source = texture.source;
+	const uint32_t levelCount = source.getLevelCount();
+	const uint32_t imageLevels = levelCount - level;
+	const bool hasImage = texture.residentLevel < levelCount;
+	// Levels both images have: copied on the GPU. Levels above them: uploaded.
+	const uint32_t firstKeptLevel = std::max(level, texture.residentLevel);
+
+	vk::Image image;
+	vk::DeviceMemory imageMemory;
+	createImage(physicalDevice, device, std::max(source.width >> level, 1u), std::max(source.height >> level, 1u), imageLevels,
+		source.format, vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, &image, &imageMemory);
+
+	// -- NEW IMAGE TO TRANSFER DESTINATION, KEPT LEVELS OF THE OLD ONE TO TRANSFER SOURCE --
+	vector<vk::ImageMemoryBarrier> transferBarriers(1);
+	transferBarriers[0].oldLayout = vk::ImageLayout::eUndefined;
+	transferBarriers[0].newLayout = vk::ImageLayout::eTransferDstOptimal;
+	transferBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transferBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	transferBarriers[0].image = image;
+	transferBarriers[0].subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, imageLevels, 0, 1 };
+	transferBarriers[0].srcAccessMask = vk::AccessFlags();
+	transferBarriers[0].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+	if (hasImage)
+	{
+		// Previous frames may still be sampling it: wait for their fragment shaders
+		vk::ImageMemoryBarrier sourceBarrier = transferBarriers[0];
+		sourceBarrier.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		sourceBarrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		sourceBarrier.image = texture.image;
+		sourceBarrier.subresourceRange = vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor,
+			firstKeptLevel - texture.residentLevel, levelCount - firstKeptLevel, 0, 1 };
+		sourceBarrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		sourceBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+		transferBarriers.push_back(sourceBarrier);
+	}
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(), nullptr, nullptr, transferBarriers);
+
+	// -- COPY THE KEPT LEVELS --
+	if (hasImage)
+	{
+		vector<vk::ImageCopy> copyRegions;
+		for (uint32_t i = firstKeptLevel; i < levelCount; ++i)
+		{
+			vk::ImageCopy copyRegion{};
+			copyRegion.srcSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, i - texture.residentLevel, 0, 1 };
+			copyRegion.dstSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, i - level, 0, 1 };
+			copyRegion.extent = vk::Extent3D{ std::max(source.width >> i, 1u), std::max(source.height >> i, 1u), 1 };
+			copyRegions.push_back(copyRegion);
+		}
+		commandBuffer.copyImage(texture.image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+	}
+
+	// -- UPLOAD THE NEW LEVELS --
+	if (level < texture.residentLevel)
+	{
+		vector<vk::BufferImageCopy> uploadRegions;
+		for (uint32_t i = level; i < firstKeptLevel; ++i)
+		{
+			vk::DeviceSize levelSize = getLevelSize(source, i);
+			stagingHead = alignUp(stagingHead, 16);
+			memcpy(stagingData + stagingHead, &source.data[static_cast<size_t>(source.levelOffsets[i])], static_cast<size_t>(levelSize));
+
+			vk::BufferImageCopy uploadRegion{};
+			uploadRegion.bufferOffset = stagingHead;
+			uploadRegion.imageSubresource = vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, i - level, 0, 1 };
+			uploadRegion.imageExtent = vk::Extent3D{ std::max(source.width >> i, 1u), std::max(source.height >> i, 1u), 1 };
+			uploadRegions.push_back(uploadRegion);
+
+			stagingHead += levelSize;
+		}
+		commandBuffer.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, uploadRegions);
+	}
+
+	// -- NEW IMAGE TO SHADER READ ONLY --
+	vk::ImageMemoryBarrier readBarrier = transferBarriers[0];
+	readBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	readBarrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	readBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	readBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+		vk::DependencyFlags(), nullptr, nullptr, readBarrier);
+
+	// The old image is destroyed later, its memory still counts until then
+	if (hasImage)
+	{
+		retiredImages.push_back(RetiredImage{ texture.image, texture.imageMemory, texture.imageView, texture.bindlessIndex, frameCount });
+		residentSize -= texture.imageSize;
+	}
+
+	texture.image = image;
+	texture.imageMemory = imageMemory;
+	texture.imageSize = device.getImageMemoryRequirements(image).size;
+	texture.imageView = createImageView(device, image, source.format, vk::ImageAspectFlagBits::eColor, imageLevels);
+	// A new slot: frames in flight keep sampling the old image through the old one
+	texture.bindlessIndex = bindlessDescriptors->registerTexture(device, texture.imageView, texture.sampler);
+	texture.residentLevel = level;
+	residentSize += texture.imageSize;
+}
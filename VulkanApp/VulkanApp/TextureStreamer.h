@@ -0,0 +1,112 @@
+#pragma once
+
+#include "VulkanUtilities.h"
+#include "Ktx2Loader.h"
+#include "BindlessDescriptors.h"
+
+
+/// Keeps large textures partially resident on the GPU. The whole mip chain stays in system memory,
+/// the GPU image only holds the levels from residentLevel down to 1x1:
+/// - The tail (levels of at most TAIL_SIZE texels) is always resident.
+/// - Higher levels are loaded when a draw asks for them, from the size the texture covers on screen.
+/// - When the budget would be exceeded, levels of the least recently requested textures are dropped.
+/// Changing the resident levels creates a new image: the kept levels are copied from the old one on
+/// the GPU, the new ones from a per-frame staging region. Everything is recorded in the frame's
+/// command buffer, nothing waits. The new image gets a new bindless index, the old one is destroyed
+/// once no frame in flight can use it.
+class TextureStreamer
+{
+public:
+	/// budget: bytes of device memory for the resident levels. With VK_EXT_memory_budget, also
+	/// kept under what the heap has left. stagingSize: bytes uploaded per frame at most.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, BindlessDescriptors& bindlessDescriptors,
+			  uint32_t framesInFlight, vk::DeviceSize budget, vk::DeviceSize stagingSize, bool memoryBudgetSupported);
+	/// The GPU must be done with every frame
+	void clean();
+
+	/// Stream a texture. Single level RGBA8 data gets its mip chain computed on the CPU,
+	/// other formats must bring their levels. Only the tail is loaded, on the next update.
+	uint32_t addTexture(TextureData data, vk::Sampler sampler);
+
+	/// Ask for the levels needed to draw the texture over screenSize pixels (along its largest side)
+	/// this frame. The largest request since the last update wins.
+	void requestSize(uint32_t textureId, float screenSize);
+
+	/// Release retired images, then load the requested levels and evict over budget ones.
+	/// Records the copies in the commandBuffer, before any render pass. The frame's fence must have been waited on.
+	void update(vk::CommandBuffer commandBuffer, uint32_t frame);
+
+	/// Index in the bindless textures, BindlessDescriptors::INVALID_INDEX until the tail is loaded.
+	/// Changes when the resident levels do: read it again each frame.
+	uint32_t getBindlessIndex(uint32_t textureId) const { return textures[textureId].bindlessIndex; }
+	/// Highest resolution level on the GPU, getLevelCount() when none is
+	uint32_t getResidentLevel(uint32_t textureId) const { return textures[textureId].residentLevel; }
+	uint32_t getLevelCount(uint32_t textureId) const { return textures[textureId].source.getLevelCount(); }
+
+	void setBudget(vk::DeviceSize budgetP) { budget = budgetP; }
+	/// Configured budget, lowered to what the heap has left when VK_EXT_memory_budget is supported
+	vk::DeviceSize getBudget() const;
+	vk::DeviceSize getResidentSize() const { return residentSize; }
+
+	/// Levels of at most this many texels per side are always resident
+	static const uint32_t TAIL_SIZE{ 64 };
+
+private:
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	BindlessDescriptors* bindlessDescriptors{ nullptr };
+	uint32_t framesInFlight{ 0 };
+
+	vk::DeviceSize budget{ 0 };
+	bool memoryBudgetSupported{ false };
+	uint32_t deviceLocalHeap{ 0 }; // Largest device local heap, where images go
+
+	struct StreamedTexture
+	{
+		TextureData source; // Every level, in system memory
+		vk::Sampler sampler;
+		uint32_t tailLevel; // First always resident level
+
+		vk::Image image;
+		vk::DeviceMemory imageMemory;
+		vk::ImageView imageView;
+		vk::DeviceSize imageSize{ 0 };
+		uint32_t residentLevel; // Level 0 of the image is this level of the source
+		uint32_t bindlessIndex{ BindlessDescriptors::INVALID_INDEX };
+
+		uint32_t requestedLevel; // Since the last update
+		uint64_t lastRequestFrame{ 0 };
+	};
+	vector<StreamedTexture> textures;
+	vk::DeviceSize residentSize{ 0 };
+	uint64_t frameCount{ 0 };
+
+	/// Images replaced by an update, destroyed once the frames that could use them are done
+	struct RetiredImage
+	{
+		vk::Image image;
+		vk::DeviceMemory imageMemory;
+		vk::ImageView imageView;
+		uint32_t bindlessIndex;
+		uint64_t retireFrame;
+	};
+	vector<RetiredImage> retiredImages;
+	void releaseRetiredImages(bool all);
+
+	//v Staging ======================================================
+	// One region per frame in flight, persistently mapped, filled by the uploads of that frame
+	vk::Buffer stagingBuffer;
+	vk::DeviceMemory stagingBufferMemory;
+	uint8_t* stagingData{ nullptr };
+	vk::DeviceSize stagingSize{ 0 };
+	vk::DeviceSize stagingBegin{ 0 };
+	vk::DeviceSize stagingHead{ 0 };
+	//^ Staging ======================================================
+
+	/// Bytes of the levels from level down to 1x1, as stored in the image
+	vk::DeviceSize getResidencySize(const StreamedTexture& texture, uint32_t level) const;
+	/// Bytes of the levels [level, end), uploaded from the staging buffer
+	vk::DeviceSize getUploadSize(const StreamedTexture& texture, uint32_t level, uint32_t end) const;
+	/// Replace the image of the texture by one starting at level
+	void recordResidencyChange(vk::CommandBuffer commandBuffer, StreamedTexture& texture, uint32_t level);
+};
@@ -1,6 +1,7 @@
 #include "VulkanRenderer.h"
 
 #include <set>
+#include <chrono>
 
 using std::vector;
 using std::set;
@@ -29,13 +30,58 @@ int VulkanRenderer::init(GLFWwindow* windowP)
 		getPhysicalDevice();
 		createLogicalDevice();
 		createSwapchain();
-		createRenderPass();
-		createGraphicPipeline();
-		createFramebuffers();
 		createGraphicsCommandPool();
+		// Imported by the graph, outlives frames
+		depthPyramid.init(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, swapchainExtent);
+		if (renderPath == RenderPath::Clustered)
+		{
+			// Their set layouts are part of the pipeline layout, the shadow maps are graph resources
+			clusteredLighting.init(mainDevice.physicalDevice, mainDevice.logicalDevice, descriptorLayoutCache);
+			shadowMaps.init(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, descriptorLayoutCache);
+		}
+		createRenderGraph();
+		createDescriptorSetLayout();
+		createBindlessDescriptors();
+		createGraphicPipeline();
 		createGraphicsCommandBuffers(); // <--- Don't needed because of the pool (?)
-		recordCommands();
+		createUniformBuffers();
+		createDescriptorAllocators();
+		depthPyramid.createDescriptors(mainDevice.logicalDevice, descriptorLayoutCache, descriptorAllocator,
+			renderGraph.getImage(depthResource), depthFormat, sampleCount);
+		if (renderPath == RenderPath::Deferred)
+		{
+			deferredLighting.init(mainDevice.logicalDevice, renderGraph.getRenderPass(lightingPass), renderGraph.getSubpass(lightingPass),
+				swapchainExtent, frameRingBuffer, descriptorLayoutCache, descriptorAllocator,
+				renderGraph.getImageView(gbufferAlbedoResource), renderGraph.getImageView(gbufferNormalResource),
+				renderGraph.getImageView(depthResource));
+		}
+		if (renderPath == RenderPath::Clustered)
+		{
+			clusteredLighting.createDescriptorSet(mainDevice.logicalDevice, frameRingBuffer, descriptorAllocator);
+			shadowMaps.createDescriptorSet(mainDevice.logicalDevice, frameRingBuffer, descriptorAllocator);
+		}
+		if (renderPath != RenderPath::Deferred)
+		{
+			particleSystem.init(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, MAX_PARTICLES,
+				frameRingBuffer, descriptorLayoutCache, descriptorAllocator, renderPass, renderGraph.getSubpass(mainPass),
+				swapchainExtent, sampleCount);
+			lastParticleTime = glfwGetTime();
+		}
+		jobSystem.init();
+		textureManager.init(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
+			jobSystem, bindlessDescriptors, maxSamplerAnisotropy);
+		textureStreamer.init(mainDevice.physicalDevice, mainDevice.logicalDevice, bindlessDescriptors, MAX_FRAME_DRAWS,
+			TEXTURE_STREAMING_BUDGET, TEXTURE_STREAMING_STAGING_SIZE, memoryBudgetSupported);
+		createScene();
+		createDescriptorSets();
 		createSynchronisation();
+
+		// Default camera, looking at the scene from above
+		uboViewProjection.projection = glm::perspective(glm::radians(45.0f),
+			(float)swapchainExtent.width / (float)swapchainExtent.height, CAMERA_NEAR, CAMERA_FAR);
+		// GLM was made for OpenGL, where the Y axis of the clip space points up. In Vulkan it points down.
+		uboViewProjection.projection[1][1] *= -1;
+		setCamera(glm::vec3(0.0f, 30.0f, 60.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 	}
 	catch (const std::runtime_error& e)
 	{
@@ -87,6 +133,11 @@ void VulkanRenderer::draw()
 
 	// 1. Get next available image to draw and set a semaphore to signal when we're finished with the image.
 	uint32_t imageToBeDrawnIndex = (mainDevice.logicalDevice.acquireNextImageKHR(swapchain,	std::numeric_limits<uint32_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE)).value;
+
+	// The fence guarantees the GPU is done with this frame's uniform buffers, descriptor sets and command buffer
+	frameDescriptorAllocators[currentFrame].reset(mainDevice.logicalDevice);
+	updateUniformBuffers();
+	recordCommands(imageToBeDrawnIndex);
 	
 	// 2. Submit command buffer to queue for execution, make sure it waits for the image to be signaled as available before drawing, 
 	// and signals when it has finished rendering.
@@ -99,7 +150,7 @@ void VulkanRenderer::draw()
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	// Command buffer to submit
-	submitInfo.pCommandBuffers = &commandBuffers[imageToBeDrawnIndex];
+	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 	// Semaphores to signal when command buffer finishes
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];
@@ -121,13 +172,87 @@ void VulkanRenderer::draw()
 	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
 }
 
+void VulkanRenderer::setCamera(const glm::vec3& position, const glm::vec3& target)
+{
+	cameraPosition = position;
+	uboViewProjection.view = glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void VulkanRenderer::drawInstances(uint32_t meshId, uint32_t materialId, const InstanceData* instances, size_t count)
+{
+	instanceBatcher.addInstances(meshId, materialId, instances, count);
+}
+
+void VulkanRenderer::addPointLight(const glm::vec3& position, float radius, const glm::vec3& color)
+{
+	pointLights.push_back(GpuPointLight{ glm::vec4(position, radius), glm::vec4(color, 0.0f) });
+}
+
+void VulkanRenderer::addSpotLight(const glm::vec3& position, const glm::vec3& direction, float radius, float coneAngle,
+								  const glm::vec3& color)
+{
+	spotLights.push_back(GpuSpotLight{ glm::vec4(position, radius), glm::vec4(color, std::cos(coneAngle * 0.8f)),
+		glm::vec4(glm::normalize(direction), std::cos(coneAngle)) });
+}
+
+void VulkanRenderer::drawMesh(uint32_t meshId, uint32_t materialId, const glm::mat4& model)
+{
+	meshDraws.push_back(MeshDraw{ meshId, materialId, model });
+
+	// Screen size feedback for streamed textures: the projected diameter of the bounding sphere, in pixels.
+	// Each face of the primitives maps the whole texture, which covers about as much.
+	uint32_t streamedTexture = materialStreamedTextures[materialId];
+	if (streamedTexture != BindlessDescriptors::INVALID_INDEX)
+	{
+		const glm::vec4& boundingSphere = meshPool.getMesh(meshId).boundingSphere;
+		glm::vec3 center{ model * glm::vec4(glm::vec3(boundingSphere), 1.0f) };
+		float scale = glm::length(glm::vec3(model[0]));
+		float distance = std::max(glm::length(center - cameraPosition), 0.01f);
+		float screenSize = 2.0f * boundingSphere.w * scale / distance
+			* std::abs(uboViewProjection.projection[1][1]) * 0.5f * static_cast<float>(swapchainExtent.height);
+		textureStreamer.requestSize(streamedTexture, screenSize);
+	}
+}
+
 void VulkanRenderer::clean()
 {
 	mainDevice.logicalDevice.waitIdle();
 
-	for (vk::Framebuffer& framebuffer : swapchainFramebuffers) {
-		mainDevice.logicalDevice.destroyFramebuffer(framebuffer);
+	if (renderPath == RenderPath::Deferred)
+	{
+		deferredLighting.clean(mainDevice.logicalDevice);
+	}
+	if (renderPath == RenderPath::Clustered)
+	{
+		clusteredLighting.clean(mainDevice.logicalDevice);
+		shadowMaps.clean(mainDevice.logicalDevice);
+	}
+	if (renderPath != RenderPath::Deferred)
+	{
+		particleSystem.clean(mainDevice.logicalDevice);
+	}
+	gpuCulling.clean(mainDevice.logicalDevice);
+	depthPyramid.clean(mainDevice.logicalDevice);
+	meshPool.clean(mainDevice.logicalDevice);
+	for (size_t i = 0; i < materialBuffers.size(); ++i)
+	{
+		mainDevice.logicalDevice.unmapMemory(materialBufferMemories[i]);
+		mainDevice.logicalDevice.destroyBuffer(materialBuffers[i]);
+		mainDevice.logicalDevice.freeMemory(materialBufferMemories[i]);
+	}
+	textureStreamer.clean();
+	textureManager.clean();
+	jobSystem.clean();
+
+	bindlessDescriptors.clean(mainDevice.logicalDevice);
+
+	for (DescriptorAllocator& frameDescriptorAllocator : frameDescriptorAllocators)
+	{
+		frameDescriptorAllocator.clean(mainDevice.logicalDevice);
 	}
+	descriptorAllocator.clean(mainDevice.logicalDevice);
+	descriptorLayoutCache.clean(mainDevice.logicalDevice);
+	frameRingBuffer.clean(mainDevice.logicalDevice);
 
 	for (size_t i = 0; i < MAX_FRAME_DRAWS; ++i)
 	{
@@ -137,9 +262,15 @@ void VulkanRenderer::clean()
 	}	
 
 	mainDevice.logicalDevice.destroyCommandPool(graphicsCommandPool);
+	mainDevice.logicalDevice.destroyPipeline(depthPrepassPipeline);
+	mainDevice.logicalDevice.destroyPipeline(shadowMeshPipeline);
+	mainDevice.logicalDevice.destroyPipeline(shadowInstancedPipeline);
+	mainDevice.logicalDevice.destroyPipeline(shadowPipeline);
+	mainDevice.logicalDevice.destroyPipeline(meshPipeline);
+	mainDevice.logicalDevice.destroyPipeline(instancedPipeline);
 	mainDevice.logicalDevice.destroyPipeline(graphicsPipeline);
 	mainDevice.logicalDevice.destroyPipelineLayout(pipelineLayout);
-	mainDevice.logicalDevice.destroyRenderPass(renderPass);
+	renderGraph.clean(mainDevice.logicalDevice);
 
 	for (SwapchainImage& image : swapchainImages)
 	{
@@ -170,7 +301,7 @@ void VulkanRenderer::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0); // Version of the application
 	appInfo.pEngineName = "No Engine"; // Custom engine name
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0); // Custom engine version
-	appInfo.apiVersion = VK_API_VERSION_1_1; // Vulkan version (here 1.1)
+	appInfo.apiVersion = VK_API_VERSION_1_2; // Vulkan version (here 1.2, for drawIndexedIndirectCount)
 	
 	//^ App informations =============================================
 	//v Create informations ==========================================
@@ -487,6 +618,39 @@ bool VulkanRenderer::checkInstanceExtensionSupport(const std::vector<const char*
 	return true;
 }
 
+bool VulkanRenderer::isDeviceExtensionSupported(vk::PhysicalDevice device, const char* extensionName)
+{
+	for (const auto& extension : device.enumerateDeviceExtensionProperties())
+	{
+		if (strcmp(extensionName, extension.extensionName) == 0) return true;
+	}
+	return false;
+}
+
+vk::Format VulkanRenderer::chooseSupportedFormat(const vector<vk::Format>& formats, vk::FormatFeatureFlags features)
+{
+	for (vk::Format format : formats)
+	{
+		vk::FormatProperties properties = mainDevice.physicalDevice.getFormatProperties(format);
+		if ((properties.optimalTilingFeatures & features) == features) return format;
+	}
+	throw std::runtime_error("Failed to find a supported format");
+}
+
+vk::SampleCountFlagBits VulkanRenderer::chooseSampleCount()
+{
+	vk::PhysicalDeviceLimits limits = mainDevice.physicalDevice.getProperties().limits;
+	vk::SampleCountFlags supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+	const std::array<vk::SampleCountFlagBits, 4> counts{
+		vk::SampleCountFlagBits::e8, vk::SampleCountFlagBits::e4, vk::SampleCountFlagBits::e2, vk::SampleCountFlagBits::e1 };
+	for (vk::SampleCountFlagBits count : counts)
+	{
+		if (static_cast<uint32_t>(count) <= requestedSampleCount && (supported & count)) return count;
+	}
+	return vk::SampleCountFlagBits::e1;
+}
+
 bool VulkanRenderer::checkDeviceExtensionSupport(vk::PhysicalDevice device)
 {
 	vector<vk::ExtensionProperties> extensions = device.enumerateDeviceExtensionProperties();
@@ -530,6 +694,13 @@ void VulkanRenderer::getPhysicalDevice()
 			break;
 		}
 	}
+
+	// Indirect draws and bindless descriptors are not optional
+	if (!mainDevice.physicalDevice)
+	{
+		throw std::runtime_error("Can't find any GPU that supports the required features "
+			"(multi draw indirect, first instance, descriptor indexing)");
+	}
 }
 
 bool VulkanRenderer::checkDeviceSuitable(vk::PhysicalDevice device)
@@ -551,7 +722,26 @@ bool VulkanRenderer::checkDeviceSuitable(vk::PhysicalDevice device)
 		swapchainValid = !swapchainDetails.presentationModes.empty() && !swapchainDetails.formats.empty();
 	}
 
-	return indices.isValid() && extensionSupported && swapchainValid;
+	// GPU-driven rendering: several draws per indirect call, object index passed as first instance
+	bool indirectSupported = deviceFeatures.multiDrawIndirect && deviceFeatures.drawIndirectFirstInstance;
+
+	return indices.isValid() && extensionSupported && swapchainValid && indirectSupported && checkBindlessSupport(device);
+}
+
+bool VulkanRenderer::checkBindlessSupport(vk::PhysicalDevice device)
+{
+	// Descriptor indexing is core since Vulkan 1.2, its features are in PhysicalDeviceVulkan12Features
+	if (device.getProperties().apiVersion < VK_API_VERSION_1_2) return false;
+
+	auto supportedFeatures = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+	const vk::PhysicalDeviceVulkan12Features& vulkan12Features = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>();
+
+	return vulkan12Features.runtimeDescriptorArray
+		&& vulkan12Features.descriptorBindingPartiallyBound
+		&& vulkan12Features.descriptorBindingUpdateUnusedWhilePending
+		&& vulkan12Features.descriptorBindingSampledImageUpdateAfterBind
+		&& vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind
+		&& vulkan12Features.shaderSampledImageArrayNonUniformIndexing;
 }
 
 QueueFamilyIndices VulkanRenderer::getQueueFamilies(vk::PhysicalDevice device)
@@ -612,14 +802,51 @@ void VulkanRenderer::createLogicalDevice()
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	// Extensions info
 	// Device extensions, different from instance extensions
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	vector<const char*> enabledExtensions = deviceExtensions;
+	// Heap budgets and usage, read by the texture streamer, optional
+	memoryBudgetSupported = isDeviceExtensionSupported(mainDevice.physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported)
+	{
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	// -- Validation layers are deprecated since Vulkan 1.1
 	// Features
-	// For now, no device features (tessellation etc.)
 	vk::PhysicalDeviceFeatures deviceFeatures{};
+	// Required by GPU-driven rendering, checked in checkDeviceSuitable
+	deviceFeatures.multiDrawIndirect = VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	vk::PhysicalDeviceFeatures supportedDeviceFeatures = mainDevice.physicalDevice.getFeatures();
+	// Anisotropic filtering keeps textures sharp at grazing angles, optional
+	if (supportedDeviceFeatures.samplerAnisotropy)
+	{
+		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		maxSamplerAnisotropy = mainDevice.physicalDevice.getProperties().limits.maxSamplerAnisotropy;
+	}
+	// Block compressed texture families: desktop GPUs have BC, mobile ones ETC2 and ASTC.
+	// Every supported one is enabled, the texture manager checks formats one by one.
+	deviceFeatures.textureCompressionBC = supportedDeviceFeatures.textureCompressionBC;
+	deviceFeatures.textureCompressionETC2 = supportedDeviceFeatures.textureCompressionETC2;
+	deviceFeatures.textureCompressionASTC_LDR = supportedDeviceFeatures.textureCompressionASTC_LDR;
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
+	// Vulkan 1.2 features, chained to the create info. The device is at least 1.2, see checkBindlessSupport.
+	vk::PhysicalDeviceVulkan12Features vulkan12Features{};
+	auto supportedFeatures = mainDevice.physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+	// drawIndirectCount lets the GPU decide how many indirect draws to execute
+	drawIndirectCountSupported = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+	vulkan12Features.drawIndirectCount = drawIndirectCountSupported;
+	// Descriptor indexing, for the bindless set: large arrays indexed in the shaders,
+	// partially filled and updated while bound. Only the features checkBindlessSupport checked.
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	deviceCreateInfo.pNext = &vulkan12Features;
+
 	// Create the logical device for the given physical device
 	mainDevice.logicalDevice = mainDevice.physicalDevice.createDevice(deviceCreateInfo);
 
@@ -652,94 +879,277 @@ bool VulkanRenderer::checkValidationLayerSupport()
 
 #pragma region Graphic Pipeline
 
-void VulkanRenderer::createRenderPass()
+void VulkanRenderer::createRenderGraph()
 {
-	vk::RenderPassCreateInfo renderPassCreateInfo{};
-
-	// Attachement description : describe color buffer output, depth buffer output...
-	// e.g. (location = 0) in the fragment shader is the first attachment
-	vk::AttachmentDescription colorAttachment{};
-	// Format to use for attachment
-	colorAttachment.format = swapchainImageFormat;
-	// Number of samples to write for multisampling
-	colorAttachment.samples = vk::SampleCountFlagBits::e1;
-	// What to do with attachement before renderer. 
-	colorAttachment.loadOp = vk::AttachmentLoadOp::eClear; // <--- Here, clear when we start the render pass.
-	// What to do with attachement after renderer.
-	colorAttachment.storeOp = vk::AttachmentStoreOp::eStore; // <--- Here, store the render pass.
-	// What to do with stencil before renderer. 
-	colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare; // <--- Here, don't care, we don't use stencil.
-	// What to do with stencil after renderer. 
-	colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare; // <--- Here, don't care, we don't use stencil.
-
-	// Framebuffer images will be stored as an image, but image can have different layouts to give optimal use for certain operations
-	// Image data layout before render pass starts
-	colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-	// Image data layout after render pass
-	colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pAttachments = &colorAttachment;
-
-	// Attachment reference uses an attachment index that refers to index in the attachement list passed to renderPassCreateInfo
-	vk::AttachmentReference colorAttachmentReference{};
-	colorAttachmentReference.attachment = 0;
-	// Layout of the subpass (between initial and final layout)
-	colorAttachmentReference.layout = vk::ImageLayout::eColorAttachmentOptimal;
-
-	// Subpass description, will reference attachements
-	vk::SubpassDescription subpass{};
-	// Pipeline type the subpass will be bound to.
-	// Could be compute pipeline, or nvidia raytracing...
-	subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentReference;
-
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-
-	// Subpass dependencies: transitions between subpasses + from the last subpass to what happens after
-	// Need to determine when layout transitions occur using subpass dependencies.
-	// Will define implicitly layout transitions.
-	std::array<vk::SubpassDependency, 2> subpassDependencies;
-	// -- From layout undefined to color attachment optimal
-	// ---- Transition must happens after
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL; // External: from outside the subpasses
-	// Which stage of the pipeline has to happen before
-	subpassDependencies[0].srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-	subpassDependencies[0].srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-	// ---- But must happens before
-	// Conversion should happen before the first subpass starts
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-	// ...and before the color attachment attempts to read or write
-	subpassDependencies[0].dstAccessMask =
-		vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
-	subpassDependencies[0].dependencyFlags = vk::DependencyFlags(); // No dependency flag
-
-	// -- From layout color attachment optimal to image layout present
-	// ---- Transition must happens after	
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-	subpassDependencies[1].srcAccessMask =
-		vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
-	// ---- But must happens before
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-	subpassDependencies[1].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-	subpassDependencies[1].dependencyFlags = vk::DependencyFlags();
-
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
-
-	renderPass = mainDevice.logicalDevice.createRenderPass(renderPassCreateInfo);
+	// -- RESOURCES --
+	// Acquired image: the acquire semaphore waits at color attachment output, its content is not needed
+	swapchainResource = renderGraph.importImage("Swapchain", swapchainImageFormat, swapchainExtent,
+		RenderGraphAccess{ vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlags(), vk::ImageLayout::eUndefined });
+	// Presented after the frame, the render finished semaphore is signaled after every stage
+	renderGraph.markOutput(swapchainResource,
+		RenderGraphAccess{ vk::PipelineStageFlagBits::eBottomOfPipe, vk::AccessFlags(), vk::ImageLayout::ePresentSrcKHR });
+	// Culling output, shared by frames in flight: last read by the draws of the previous frame
+	drawCommandsResource = renderGraph.importBuffer("Draw commands", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+	drawCountResource = renderGraph.importBuffer("Draw count", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+	// Last read by the late culling of the previous frame
+	occlusionCandidatesResource = renderGraph.importBuffer("Occlusion candidates", getUsageAccess(RenderGraphUsage::StorageReadCompute));
+	// Last used by the meshlet culling and draws of the previous frame
+	meshletDispatchResource = renderGraph.importBuffer("Meshlet dispatch", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+	meshletObjectsResource = renderGraph.importBuffer("Meshlet objects", getUsageAccess(RenderGraphUsage::StorageReadCompute));
+	meshletDrawCommandsResource = renderGraph.importBuffer("Meshlet draw commands", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+	if (renderPath != RenderPath::Deferred)
+	{
+		// Last used by the previous frame: drawn by its main pass, the dead list read by its emission
+		particleResource = renderGraph.importBuffer("Particles", getUsageAccess(RenderGraphUsage::StorageReadVertex));
+		particleAliveListResource = renderGraph.importBuffer("Particle alive lists", getUsageAccess(RenderGraphUsage::StorageReadVertex));
+		particleDeadListResource = renderGraph.importBuffer("Particle dead list", getUsageAccess(RenderGraphUsage::StorageReadCompute));
+		particleCounterResource = renderGraph.importBuffer("Particle counters", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+		particleDispatchResource = renderGraph.importBuffer("Particle dispatch", getUsageAccess(RenderGraphUsage::IndirectBuffer));
+	}
+	depthPyramidResource = renderGraph.importImage("Depth pyramid", DepthPyramid::PYRAMID_FORMAT, depthPyramid.getExtent(),
+		getUsageAccess(RenderGraphUsage::StorageReadCompute));
+	if (renderPath == RenderPath::Clustered)
+	{
+		// Light lists, last read by the fragment shaders of the previous frame
+		clusterCountResource = renderGraph.importBuffer("Cluster light counts", getUsageAccess(RenderGraphUsage::StorageReadFragment));
+		clusterLightResource = renderGraph.importBuffer("Cluster lights", getUsageAccess(RenderGraphUsage::StorageReadFragment));
+
+		// Cascades, last sampled by the previous frame. Each layer is its own resource: the passes drawing
+		// the other layers do not wait for it.
+		vk::Extent2D shadowExtent{ ShadowMaps::SHADOW_MAP_SIZE, ShadowMaps::SHADOW_MAP_SIZE };
+		for (uint32_t cascade = 0; cascade < ShadowMaps::CASCADE_COUNT; ++cascade)
+		{
+			shadowCascadeResources[cascade] = renderGraph.importImage("Shadow cascade " + std::to_string(cascade), ShadowMaps::SHADOW_FORMAT,
+				shadowExtent, getUsageAccess(RenderGraphUsage::SampledFragment), cascade);
+		}
+		// Static casters of the cached cascade, kept from frame to frame, last copied from
+		shadowCacheResource = renderGraph.importImage("Shadow cache", ShadowMaps::SHADOW_FORMAT, shadowExtent,
+			getUsageAccess(RenderGraphUsage::TransferSrc));
+	}
+	// Only live during the frame: transient, never stored.
+	// Input attachments are read per sample: the deferred path does not multisample.
+	// Sampled by the depth pyramid build, without its stencil aspect if it has one.
+	sampleCount = renderPath == RenderPath::Deferred ? vk::SampleCountFlagBits::e1 : chooseSampleCount();
+	depthFormat = chooseSupportedFormat({ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
+		vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage);
+	depthResource = renderGraph.createImage("Depth", depthFormat, swapchainExtent, sampleCount);
+	if (sampleCount != vk::SampleCountFlagBits::e1)
+	{
+		msaaColorResource = renderGraph.createImage("MSAA color", swapchainImageFormat, swapchainExtent, sampleCount);
+	}
+
+	// -- PASSES --
+	uint32_t resetPass = renderGraph.addPass("Culling reset", RenderGraphPassType::Transfer,
+		[this](vk::CommandBuffer commandBuffer) { gpuCulling.recordReset(commandBuffer); });
+	renderGraph.write(resetPass, drawCommandsResource, RenderGraphUsage::TransferDst);
+	renderGraph.write(resetPass, drawCountResource, RenderGraphUsage::TransferDst);
+	renderGraph.write(resetPass, meshletDispatchResource, RenderGraphUsage::TransferDst);
+	renderGraph.write(resetPass, meshletDrawCommandsResource, RenderGraphUsage::TransferDst);
+
+	// Early culling: frustums, and the camera's occlusion against the previous frame's depth pyramid
+	uint32_t cullingPass = renderGraph.addPass("Culling", RenderGraphPassType::Compute,
+		[this](vk::CommandBuffer commandBuffer) { gpuCulling.recordCulling(commandBuffer); });
+	renderGraph.write(cullingPass, drawCommandsResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(cullingPass, drawCountResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.read(cullingPass, depthPyramidResource, RenderGraphUsage::StorageReadCompute);
+	renderGraph.write(cullingPass, occlusionCandidatesResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(cullingPass, meshletDispatchResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(cullingPass, meshletObjectsResource, RenderGraphUsage::StorageWriteCompute);
+
+	if (renderPath == RenderPath::Clustered)
+	{
+		// Independent of the culling: both are compute, no barrier between them
+		uint32_t binningPass = renderGraph.addPass("Light binning", RenderGraphPassType::Compute,
+			[this](vk::CommandBuffer commandBuffer) { clusteredLighting.recordBinning(commandBuffer); });
+		renderGraph.write(binningPass, clusterCountResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(binningPass, clusterLightResource, RenderGraphUsage::StorageWriteCompute);
+
+		// -- SHADOWS --
+		vk::ClearValue shadowClearValue{};
+		shadowClearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+		// Loaded, not cleared: most frames keep the cache and draw nothing in it
+		uint32_t cachePass = renderGraph.addPass("Shadow cache", RenderGraphPassType::Graphics,
+			[this](vk::CommandBuffer commandBuffer)
+			{
+				if (!shadowMaps.isStaticCacheDirty()) return;
+				vk::ClearAttachment clearAttachment{ vk::ImageAspectFlagBits::eDepth, 0, vk::ClearValue{} };
+				clearAttachment.clearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+				vk::ClearRect clearRect{ vk::Rect2D{ vk::Offset2D{ 0, 0 },
+					vk::Extent2D{ ShadowMaps::SHADOW_MAP_SIZE, ShadowMaps::SHADOW_MAP_SIZE } }, 0, 1 };
+				commandBuffer.clearAttachments(clearAttachment, clearRect);
+				recordShadowCasters(commandBuffer, ShadowMaps::CACHED_CASCADE, true, false);
+				shadowMaps.markStaticCacheRendered();
+			});
+		renderGraph.read(cachePass, drawCommandsResource, RenderGraphUsage::IndirectBuffer);
+		renderGraph.read(cachePass, drawCountResource, RenderGraphUsage::IndirectBuffer);
+		renderGraph.write(cachePass, shadowCacheResource, RenderGraphUsage::DepthStencilAttachment);
+
+		uint32_t cacheCopyPass = renderGraph.addPass("Shadow cache copy", RenderGraphPassType::Transfer,
+			[this](vk::CommandBuffer commandBuffer) { shadowMaps.recordCacheCopy(commandBuffer); });
+		renderGraph.read(cacheCopyPass, shadowCacheResource, RenderGraphUsage::TransferSrc);
+		renderGraph.write(cacheCopyPass, shadowCascadeResources[ShadowMaps::CACHED_CASCADE], RenderGraphUsage::TransferDst);
+
+		// The cached cascade only gets the dynamic casters, on top of the copy
+		for (uint32_t cascade = 0; cascade < ShadowMaps::CASCADE_COUNT; ++cascade)
+		{
+			bool cached = cascade == ShadowMaps::CACHED_CASCADE;
+			uint32_t cascadePass = renderGraph.addPass("Shadow cascade " + std::to_string(cascade), RenderGraphPassType::Graphics,
+				[this, cascade, cached](vk::CommandBuffer commandBuffer) { recordShadowCasters(commandBuffer, cascade, !cached, true); });
+			if (cascade == 0) shadowCascadePass = cascadePass;
+			renderGraph.read(cascadePass, drawCommandsResource, RenderGraphUsage::IndirectBuffer);
+			renderGraph.read(cascadePass, drawCountResource, RenderGraphUsage::IndirectBuffer);
+			if (cached)
+			{
+				renderGraph.write(cascadePass, shadowCascadeResources[cascade], RenderGraphUsage::DepthStencilAttachment);
+			}
+			else
+			{
+				renderGraph.clear(cascadePass, shadowCascadeResources[cascade], RenderGraphUsage::DepthStencilAttachment, shadowClearValue);
+			}
+		}
+	}
+
+	// -- OCCLUSION --
+	vk::ClearValue depthClearValue{};
+	depthClearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+	// What was visible last frame is most likely visible now: its depth occludes the rest
+	depthPrepass = renderGraph.addPass("Depth prepass", RenderGraphPassType::Graphics,
+		[this](vk::CommandBuffer commandBuffer) { recordDepthPrepass(commandBuffer); });
+	renderGraph.read(depthPrepass, drawCommandsResource, RenderGraphUsage::IndirectBuffer);
+	renderGraph.read(depthPrepass, drawCountResource, RenderGraphUsage::IndirectBuffer);
+	renderGraph.clear(depthPrepass, depthResource, RenderGraphUsage::DepthStencilAttachment, depthClearValue);
+
+	uint32_t pyramidPass = renderGraph.addPass("Depth pyramid", RenderGraphPassType::Compute,
+		[this](vk::CommandBuffer commandBuffer) { depthPyramid.recordBuild(commandBuffer); });
+	renderGraph.read(pyramidPass, depthResource, RenderGraphUsage::SampledCompute);
+	renderGraph.write(pyramidPass, depthPyramidResource, RenderGraphUsage::StorageWriteCompute);
+
+	// Late culling: what the early culling occluded, against this frame's depth. Appended to the camera's draws.
+	uint32_t lateCullingPass = renderGraph.addPass("Late culling", RenderGraphPassType::Compute,
+		[this](vk::CommandBuffer commandBuffer) { gpuCulling.recordLateCulling(commandBuffer); });
+	renderGraph.read(lateCullingPass, depthPyramidResource, RenderGraphUsage::StorageReadCompute);
+	renderGraph.read(lateCullingPass, occlusionCandidatesResource, RenderGraphUsage::StorageReadCompute);
+	renderGraph.write(lateCullingPass, drawCommandsResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(lateCullingPass, drawCountResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(lateCullingPass, meshletDispatchResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(lateCullingPass, meshletObjectsResource, RenderGraphUsage::StorageWriteCompute);
+
+	// Meshlets of the objects both phases listed: frustum, normal cone and this frame's depth pyramid
+	uint32_t meshletCullingPass = renderGraph.addPass("Meshlet culling", RenderGraphPassType::Compute,
+		[this](vk::CommandBuffer commandBuffer) { gpuCulling.recordMeshletCulling(commandBuffer); });
+	renderGraph.read(meshletCullingPass, meshletDispatchResource, RenderGraphUsage::IndirectBuffer);
+	renderGraph.read(meshletCullingPass, meshletObjectsResource, RenderGraphUsage::StorageReadCompute);
+	renderGraph.read(meshletCullingPass, depthPyramidResource, RenderGraphUsage::StorageReadCompute);
+	renderGraph.write(meshletCullingPass, meshletDrawCommandsResource, RenderGraphUsage::StorageWriteCompute);
+	renderGraph.write(meshletCullingPass, drawCountResource, RenderGraphUsage::StorageWriteCompute);
+
+	if (renderPath != RenderPath::Deferred)
+	{
+		// -- PARTICLES --
+		// Counts stay on the GPU: the preparation sizes the simulation, the main pass draws what the emission leaves
+		uint32_t particlePreparationPass = renderGraph.addPass("Particle preparation", RenderGraphPassType::Compute,
+			[this](vk::CommandBuffer commandBuffer) { particleSystem.recordPreparation(commandBuffer); });
+		renderGraph.write(particlePreparationPass, particleCounterResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particlePreparationPass, particleDispatchResource, RenderGraphUsage::StorageWriteCompute);
+
+		uint32_t particleSimulationPass = renderGraph.addPass("Particle simulation", RenderGraphPassType::Compute,
+			[this](vk::CommandBuffer commandBuffer) { particleSystem.recordSimulation(commandBuffer); });
+		renderGraph.read(particleSimulationPass, particleDispatchResource, RenderGraphUsage::IndirectBuffer);
+		renderGraph.write(particleSimulationPass, particleResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particleSimulationPass, particleAliveListResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particleSimulationPass, particleDeadListResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particleSimulationPass, particleCounterResource, RenderGraphUsage::StorageWriteCompute);
+
+		uint32_t particleEmissionPass = renderGraph.addPass("Particle emission", RenderGraphPassType::Compute,
+			[this](vk::CommandBuffer commandBuffer) { particleSystem.recordEmission(commandBuffer); });
+		renderGraph.read(particleEmissionPass, particleDeadListResource, RenderGraphUsage::StorageReadCompute);
+		renderGraph.write(particleEmissionPass, particleResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particleEmissionPass, particleAliveListResource, RenderGraphUsage::StorageWriteCompute);
+		renderGraph.write(particleEmissionPass, particleCounterResource, RenderGraphUsage::StorageWriteCompute);
+	}
+
+	mainPass = renderGraph.addPass("Main", RenderGraphPassType::Graphics,
+		[this](vk::CommandBuffer commandBuffer) { recordMainPass(commandBuffer); });
+	renderGraph.read(mainPass, drawCommandsResource, RenderGraphUsage::IndirectBuffer);
+	renderGraph.read(mainPass, drawCountResource, RenderGraphUsage::IndirectBuffer);
+	renderGraph.read(mainPass, meshletDrawCommandsResource, RenderGraphUsage::IndirectBuffer);
+	if (renderPath == RenderPath::Clustered)
+	{
+		renderGraph.read(mainPass, clusterCountResource, RenderGraphUsage::StorageReadFragment);
+		renderGraph.read(mainPass, clusterLightResource, RenderGraphUsage::StorageReadFragment);
+		for (uint32_t shadowCascadeResource : shadowCascadeResources)
+		{
+			renderGraph.read(mainPass, shadowCascadeResource, RenderGraphUsage::SampledFragment);
+		}
+	}
+	if (renderPath != RenderPath::Deferred)
+	{
+		renderGraph.read(mainPass, particleResource, RenderGraphUsage::StorageReadVertex);
+		renderGraph.read(mainPass, particleAliveListResource, RenderGraphUsage::StorageReadVertex);
+		renderGraph.read(mainPass, particleCounterResource, RenderGraphUsage::IndirectBuffer);
+	}
+	vk::ClearValue clearValue{};
+	std::array<float, 4> colors{ 0.6f, 0.65f, 0.4f, 1.0f };
+	clearValue.color = vk::ClearColorValue{ colors };
+	if (renderPath == RenderPath::Deferred)
+	{
+		// Lit per pixel from the G-buffer, in the next subpass: the G-buffer never leaves tile memory on tilers
+		gbufferAlbedoResource = renderGraph.createImage("G-buffer albedo", vk::Format::eR8G8B8A8Unorm, swapchainExtent);
+		gbufferNormalResource = renderGraph.createImage("G-buffer normal", vk::Format::eA2B10G10R10UnormPack32, swapchainExtent);
+		renderGraph.clear(mainPass, gbufferAlbedoResource, RenderGraphUsage::ColorAttachment, clearValue);
+		renderGraph.clear(mainPass, gbufferNormalResource, RenderGraphUsage::ColorAttachment, vk::ClearValue{});
+
+		lightingPass = renderGraph.addPass("Lighting", RenderGraphPassType::Graphics,
+			[this](vk::CommandBuffer commandBuffer)
+			{
+				// Its own pipeline and sets, recorded directly
+				deferredLighting.recordLighting(commandBuffer);
+				commandRecorder.invalidate();
+			});
+		renderGraph.read(lightingPass, gbufferAlbedoResource, RenderGraphUsage::InputAttachment);
+		renderGraph.read(lightingPass, gbufferNormalResource, RenderGraphUsage::InputAttachment);
+		renderGraph.read(lightingPass, depthResource, RenderGraphUsage::InputAttachment);
+		renderGraph.clear(lightingPass, swapchainResource, RenderGraphUsage::ColorAttachment, clearValue);
+	}
+	else if (sampleCount != vk::SampleCountFlagBits::e1)
+	{
+		// Drawn multisampled, resolved by the render pass at the end of the subpass: no extra pass
+		renderGraph.clear(mainPass, msaaColorResource, RenderGraphUsage::ColorAttachment, clearValue);
+		renderGraph.resolve(mainPass, msaaColorResource, swapchainResource);
+	}
+	else
+	{
+		renderGraph.clear(mainPass, swapchainResource, RenderGraphUsage::ColorAttachment, clearValue);
+	}
+	// Loaded: the depth prepass already holds the closest occluders
+	renderGraph.write(mainPass, depthResource, RenderGraphUsage::DepthStencilAttachment);
+
+	renderGraph.compile();
+	renderGraph.createRenderPasses(mainDevice.logicalDevice);
+	renderGraph.createTransientImages(mainDevice.physicalDevice, mainDevice.logicalDevice);
+	renderPass = renderGraph.getRenderPass(mainPass);
+	if (renderPath == RenderPath::Clustered)
+	{
+		// Never change: set once
+		for (uint32_t cascade = 0; cascade < ShadowMaps::CASCADE_COUNT; ++cascade)
+		{
+			renderGraph.setImage(shadowCascadeResources[cascade], shadowMaps.getImage(), shadowMaps.getLayerView(cascade));
+		}
+		renderGraph.setImage(shadowCacheResource, shadowMaps.getCacheImage(), shadowMaps.getCacheView());
+	}
 }
 
 void VulkanRenderer::createGraphicPipeline()
 {
 	// Read shader code and format it through a shader module
 	auto vertexShaderCode = readShaderFile("shaders/vert.spv");
-	auto fragmentShaderCode = readShaderFile("shaders/frag.spv");
+	// The deferred path writes the G-buffer instead of the final color, the clustered path lights what it draws
+	string fragmentShaderFile = "shaders/frag.spv";
+	if (renderPath == RenderPath::Deferred) fragmentShaderFile = "shaders/gbuffer.spv";
+	if (renderPath == RenderPath::Clustered) fragmentShaderFile = "shaders/clustered.spv";
+	auto fragmentShaderCode = readShaderFile(fragmentShaderFile);
+	auto instancedShaderCode = readShaderFile("shaders/instanced.spv");
+	auto meshShaderCode = readShaderFile("shaders/mesh.spv");
 	vk::ShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
 	vk::ShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
 
@@ -763,14 +1173,41 @@ void VulkanRenderer::createGraphicPipeline()
 
 	//v Create Pipeline ==============================================	
 	// -- VERTEX INPUT STAGE --
-	// TODO: Put in vertex description when resources created
+	// How the data for a single vertex is as a whole
+	vk::VertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0; // Can bind multiple streams of data, this defines which one
+	bindingDescription.stride = sizeof(QuantizedVertex); // Size of a single vertex object
+	// How to move between data after each vertex.
+	// eVertex: move on to the next vertex. eInstance: move to a vertex for the next instance.
+	bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+
+	// How the data for an attribute is defined within a vertex
+	std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions;
+	// Position attribute
+	attributeDescriptions[0].binding = 0; // Which binding the data is at (should be same as above)
+	attributeDescriptions[0].location = 0; // Location in shader where data will be read from
+	// Format the data will take (also helps define size of data). Quantized formats are converted to float
+	// before the shader reads them: vec3 inputs take the first three components.
+	attributeDescriptions[0].format = vk::Format::eR16G16B16A16Snorm;
+	attributeDescriptions[0].offset = offsetof(QuantizedVertex, position); // Where this attribute is defined in the data for a single vertex
+	// Color attribute
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = vk::Format::eR8G8B8A8Unorm;
+	attributeDescriptions[1].offset = offsetof(QuantizedVertex, color);
+	// Texture coordinates attribute
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = vk::Format::eR16G16Sfloat;
+	attributeDescriptions[2].offset = offsetof(QuantizedVertex, uv);
+
 	vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
 	// List of vertex binding desc. (data spacing, stride...)
-	vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
+	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	// List of vertex attribute desc. (data format and where to bind to/from)
-	vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;
+	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	// -- INPUT ASSEMBLY --
 	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo{};
@@ -826,8 +1263,9 @@ void VulkanRenderer::createGraphicPipeline()
 	rasterizerCreateInfo.lineWidth = 1.0f;
 	// Culling. Do not draw back of polygons
 	rasterizerCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
-	// Widing to know the front face of a polygon
-	rasterizerCreateInfo.frontFace = vk::FrontFace::eClockwise;
+	// Widing to know the front face of a polygon.
+	// Meshes are counter-clockwise, the projection Y flip keeps them counter-clockwise in framebuffer space.
+	rasterizerCreateInfo.frontFace = vk::FrontFace::eCounterClockwise;
 	// Whether to add a depth offset to fragments. Good for stopping "shadow acne" in shadow mapping.
 	// Is set, need to set 3 other values.
 	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
@@ -837,8 +1275,8 @@ void VulkanRenderer::createGraphicPipeline()
 	vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo{};
 	// Enable multisample shading or not
 	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
-	// Number of samples to use per fragment
-	multisamplingCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
+	// Number of samples to use per fragment, those of the main pass attachments
+	multisamplingCreateInfo.rasterizationSamples = sampleCount;
 
 	// -- BLENDING --
 	// How to blend a new color being written to the fragment, with the old value
@@ -861,23 +1299,62 @@ void VulkanRenderer::createGraphicPipeline()
 	colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
 	colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
 	colorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
-	colorBlendingCreateInfo.attachmentCount = 1;
-	colorBlendingCreateInfo.pAttachments = &colorBlendAttachment;
+	// The G-buffer is written as is, one state per attachment
+	std::array<vk::PipelineColorBlendAttachmentState, 2> gbufferBlendAttachments{ colorBlendAttachment, colorBlendAttachment };
+	gbufferBlendAttachments[0].blendEnable = VK_FALSE;
+	gbufferBlendAttachments[1].blendEnable = VK_FALSE;
+	if (renderPath == RenderPath::Deferred)
+	{
+		colorBlendingCreateInfo.attachmentCount = static_cast<uint32_t>(gbufferBlendAttachments.size());
+		colorBlendingCreateInfo.pAttachments = gbufferBlendAttachments.data();
+	}
+	else
+	{
+		colorBlendingCreateInfo.attachmentCount = 1;
+		colorBlendingCreateInfo.pAttachments = &colorBlendAttachment;
+	}
 	//^ Blending equation ===================
 
 	// -- PIPELINE LAYOUT --
-	// TODO: apply future descriptorset layout
+	// Set 0: frame uniforms and objects, set 1: bindless resources.
+	// Clustered path, set 2: light lists, set 3: shadow maps.
+	vector<vk::DescriptorSetLayout> setLayouts{ descriptorSetLayout, bindlessDescriptors.getDescriptorSetLayout() };
+	if (renderPath == RenderPath::Clustered)
+	{
+		setLayouts.push_back(clusteredLighting.getDescriptorSetLayout());
+		setLayouts.push_back(shadowMaps.getDescriptorSetLayout());
+	}
+	// Push constants: every pipeline shares this layout, so the range covers what any of their shaders reads.
+	// One range for all stages, pushes then always give every stage.
+	vk::PushConstantRange pushConstantRange = mergePushConstantRanges({
+		reflectPushConstantRange(vertexShaderCode, vk::ShaderStageFlagBits::eVertex),
+		reflectPushConstantRange(instancedShaderCode, vk::ShaderStageFlagBits::eVertex),
+		reflectPushConstantRange(meshShaderCode, vk::ShaderStageFlagBits::eVertex),
+		reflectPushConstantRange(fragmentShaderCode, vk::ShaderStageFlagBits::eFragment) });
+	if (pushConstantRange.size > mainDevice.physicalDevice.getProperties().limits.maxPushConstantsSize)
+	{
+		throw std::runtime_error("Push constants do not fit in the device limit");
+	}
+
 	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-	pipelineLayoutCreateInfo.setLayoutCount = 0;
-	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = pushConstantRange.size > 0 ? 1 : 0;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	// Create pipeline layout
 	pipelineLayout = mainDevice.logicalDevice.createPipelineLayout(pipelineLayoutCreateInfo);
+	drawPushBlock.init(pipelineLayout, pushConstantRange);
 
 	// -- DEPTH STENCIL TESTING --
-	// TODO: Set up depth stencil testing
+	vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo{};
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
+	// Closer fragments win, the depth buffer is cleared to 1.
+	// Or equal: objects of the depth prepass are drawn again at the depth they already wrote.
+	depthStencilCreateInfo.depthCompareOp = vk::CompareOp::eLessOrEqual;
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
 	
 	// -- PASSES --
 	// Passes are composed of a sequence of subpasses that can pass data from one to another
@@ -893,13 +1370,13 @@ void VulkanRenderer::createGraphicPipeline()
 	graphicsPipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
 	graphicsPipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
 	graphicsPipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
-	graphicsPipelineCreateInfo.pDepthStencilState = nullptr;
+	graphicsPipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
 	graphicsPipelineCreateInfo.layout = pipelineLayout;
 	// Renderpass description the pipeline is compatible with.
 	// This pipeline will be used by the render pass.
 	graphicsPipelineCreateInfo.renderPass = renderPass;
 	// Subpass of render pass to use with pipeline. Usually one pipeline by subpass.
-	graphicsPipelineCreateInfo.subpass = 0;
+	graphicsPipelineCreateInfo.subpass = renderGraph.getSubpass(mainPass);
 	// When you want to derivate a pipeline from an other pipeline OR
 	graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	// Index of pipeline being created to derive from (in case of creating multiple at once)
@@ -913,6 +1390,64 @@ void VulkanRenderer::createGraphicPipeline()
 		throw std::runtime_error("Cound not create a graphics pipeline");
 	}
 	graphicsPipeline = result.value;
+	depthPrepassPipeline = createDepthOnlyPipeline(graphicsPipelineCreateInfo, depthPrepass, false);
+	if (renderPath == RenderPath::Clustered)
+	{
+		shadowPipeline = createDepthOnlyPipeline(graphicsPipelineCreateInfo, shadowCascadePass, true);
+	}
+
+	// -- INSTANCED PIPELINE --
+	// Same states, but the vertex shader also reads a per-instance stream
+	vk::ShaderModule instancedShaderModule = createShaderModule(instancedShaderCode);
+	shaderStages[0].module = instancedShaderModule;
+
+	// Binding 0 advances per vertex, binding 1 per instance
+	std::array<vk::VertexInputBindingDescription, 2> instancedBindingDescriptions{
+		bindingDescription, InstanceBatcher::getBindingDescription() };
+	vector<vk::VertexInputAttributeDescription> instancedAttributeDescriptions(
+		attributeDescriptions.begin(), attributeDescriptions.end());
+	vector<vk::VertexInputAttributeDescription> instanceAttributeDescriptions = InstanceBatcher::getAttributeDescriptions();
+	instancedAttributeDescriptions.insert(instancedAttributeDescriptions.end(),
+		instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
+
+	vk::PipelineVertexInputStateCreateInfo instancedVertexInputCreateInfo{};
+	instancedVertexInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedBindingDescriptions.size());
+	instancedVertexInputCreateInfo.pVertexBindingDescriptions = instancedBindingDescriptions.data();
+	instancedVertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributeDescriptions.size());
+	instancedVertexInputCreateInfo.pVertexAttributeDescriptions = instancedAttributeDescriptions.data();
+	graphicsPipelineCreateInfo.pVertexInputState = &instancedVertexInputCreateInfo;
+
+	result = mainDevice.logicalDevice.createGraphicsPipeline(VK_NULL_HANDLE, graphicsPipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Cound not create the instanced graphics pipeline");
+	}
+	instancedPipeline = result.value;
+	if (renderPath == RenderPath::Clustered)
+	{
+		shadowInstancedPipeline = createDepthOnlyPipeline(graphicsPipelineCreateInfo, shadowCascadePass, true);
+	}
+
+	mainDevice.logicalDevice.destroyShaderModule(instancedShaderModule);
+
+	// -- MESH PIPELINE --
+	// Same states and vertex input as the graphics pipeline, the model matrix is pushed per draw
+	vk::ShaderModule meshShaderModule = createShaderModule(meshShaderCode);
+	shaderStages[0].module = meshShaderModule;
+	graphicsPipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+
+	result = mainDevice.logicalDevice.createGraphicsPipeline(VK_NULL_HANDLE, graphicsPipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Cound not create the mesh graphics pipeline");
+	}
+	meshPipeline = result.value;
+	if (renderPath == RenderPath::Clustered)
+	{
+		shadowMeshPipeline = createDepthOnlyPipeline(graphicsPipelineCreateInfo, shadowCascadePass, true);
+	}
+
+	mainDevice.logicalDevice.destroyShaderModule(meshShaderModule);
 	//^ Create Pipeline ==============================================
 
 	// Destroy shader modules
@@ -920,6 +1455,48 @@ void VulkanRenderer::createGraphicPipeline()
 	mainDevice.logicalDevice.destroyShaderModule(vertexShaderModule);
 }
 
+vk::Pipeline VulkanRenderer::createDepthOnlyPipeline(vk::GraphicsPipelineCreateInfo pipelineCreateInfo, uint32_t pass, bool shadowCaster)
+{
+	// Depth only: the vertex stage comes first, no fragment shader runs
+	pipelineCreateInfo.stageCount = 1;
+	vk::PipelineColorBlendStateCreateInfo colorBlendingCreateInfo{};
+	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
+	// Every cascade pass and the cache pass have the same single depth attachment: compatible render passes
+	pipelineCreateInfo.renderPass = renderGraph.getRenderPass(pass);
+	pipelineCreateInfo.subpass = renderGraph.getSubpass(pass);
+
+	// Declared here, the create info points to them until the pipeline is created
+	vk::Viewport viewport{ 0.0f, 0.0f, static_cast<float>(ShadowMaps::SHADOW_MAP_SIZE), static_cast<float>(ShadowMaps::SHADOW_MAP_SIZE), 0.0f, 1.0f };
+	vk::Rect2D scissor{ vk::Offset2D{ 0, 0 }, vk::Extent2D{ ShadowMaps::SHADOW_MAP_SIZE, ShadowMaps::SHADOW_MAP_SIZE } };
+	vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.pViewports = &viewport;
+	viewportStateCreateInfo.scissorCount = 1;
+	viewportStateCreateInfo.pScissors = &scissor;
+	vk::PipelineRasterizationStateCreateInfo rasterizerCreateInfo = *pipelineCreateInfo.pRasterizationState;
+	vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo{};
+	if (shadowCaster)
+	{
+		pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+
+		// Depth pushed away from the light, against shadow acne. More on slopes, where a texel covers more depth.
+		rasterizerCreateInfo.depthBiasEnable = VK_TRUE;
+		rasterizerCreateInfo.depthBiasConstantFactor = 1.25f;
+		rasterizerCreateInfo.depthBiasSlopeFactor = 1.75f;
+		pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+
+		multisamplingCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
+		pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	}
+
+	auto result = mainDevice.logicalDevice.createGraphicsPipeline(VK_NULL_HANDLE, pipelineCreateInfo);
+	if (result.result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Cound not create a depth-only pipeline");
+	}
+	return result.value;
+}
+
 VkShaderModule VulkanRenderer::createShaderModule(const vector<char>& code) {
 	vk::ShaderModuleCreateInfo shaderModuleCreateInfo{};
 	shaderModuleCreateInfo.codeSize = code.size();
@@ -932,90 +1509,206 @@ VkShaderModule VulkanRenderer::createShaderModule(const vector<char>& code) {
 	return shaderModule;
 }
 
-void VulkanRenderer::createFramebuffers()
-{
-	// Create one framebuffer for each swapchain image
-	swapchainFramebuffers.resize(swapchainImages.size());
-	for (size_t i = 0; i < swapchainFramebuffers.size(); ++i)
-	{
-		// Setup attachments
-		std::array<vk::ImageView, 1> attachments{ swapchainImages[i].imageView };
-
-		// Create info
-		vk::FramebufferCreateInfo framebufferCreateInfo{};
-		// Render pass layout the framebuffer will be used with
-		framebufferCreateInfo.renderPass = renderPass;
-		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		// List of attachments (1:1 with render pass, thanks to variable i)
-		framebufferCreateInfo.pAttachments = attachments.data();
-		framebufferCreateInfo.width = swapchainExtent.width;
-		framebufferCreateInfo.height = swapchainExtent.height;
-		// Framebuffer layers
-		framebufferCreateInfo.layers = 1;
-
-		swapchainFramebuffers[i] = mainDevice.logicalDevice.createFramebuffer(framebufferCreateInfo);
-	}
-}
-
 void VulkanRenderer::createGraphicsCommandPool()
 {
 	QueueFamilyIndices queueFamilyIndices = getQueueFamilies(mainDevice.physicalDevice);
 
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	// Command buffers are re-recorded every frame, so they must be individually resettable
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	// Queue family type that buffers from this command pool will use
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
 
 	graphicsCommandPool = mainDevice.logicalDevice.createCommandPool(poolInfo);
 }
 
-void VulkanRenderer::recordCommands() {
+void VulkanRenderer::recordCommands(uint32_t currentImage) {
+	auto recordStart = std::chrono::high_resolution_clock::now();
+
 	// How to begin each command buffer
 	vk::CommandBufferBeginInfo commandBufferBeginInfo{};
-	// Buffer can be resubmited when it has already been submited
-	// commandBufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-
-	// Information about how to being a render pass (only for graphical apps)
-	vk::RenderPassBeginInfo renderPassBeginInfo{};
-	// Render pass to begin
-	renderPassBeginInfo.renderPass = renderPass;
-	// Start point of render pass in pixel
-	renderPassBeginInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-	// Size of region to run render pass on
-	renderPassBeginInfo.renderArea.extent = swapchainExtent;
-
-	vk::ClearValue clearValues{};
-	std::array<float, 4> colors{ 0.6f, 0.65f, 0.4f, 1.0f };
-	clearValues.color = vk::ClearColorValue{ colors };
-	renderPassBeginInfo.pClearValues = &clearValues;
-	renderPassBeginInfo.clearValueCount = 1;
-
-	for (size_t i = 0; i < commandBuffers.size(); ++i)
-	{
-		// Because 1-to-1 relationship
-		renderPassBeginInfo.framebuffer = swapchainFramebuffers[i];
-		// Start recording commands to command buffer
-		commandBuffers[i].begin(commandBufferBeginInfo);
-		// Begin render pass
-		// All draw commands inline (no secondary command buffers)
-		commandBuffers[i].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
-		// Bind pipeline to be used in render pass, you could switch pipelines for different subpasses
-		commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-		// Execute pipeline
-		// Draw 3 vertices, 1 instance, with no offset. Instance allow you
-		// to draw several instances with one draw call.
-		commandBuffers[i].draw(3, 1, 0, 0);
-		// End render pass
-		commandBuffers[i].endRenderPass();
-		// Stop recordind to command buffer
-		commandBuffers[i].end();
+	// Recorded again for every frame
+	commandBufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+	vk::CommandBuffer commandBuffer = commandBuffers[currentFrame];
+	// Start recording commands to command buffer, this resets what was recorded before
+	commandBuffer.begin(commandBufferBeginInfo);
+	// Draws go through the recorder, which knows nothing bound yet
+	commandRecorder.begin(commandBuffer);
+
+	// Streamed texture levels asked for by the last draws, copied before anything samples them.
+	// Bindless indices of the changed textures move, the materials follow.
+	textureStreamer.update(commandBuffer, currentFrame);
+	updateMaterials();
+
+	// Instances are drawn by several passes (shadow cascades, main pass), from one upload, in one order
+	instanceBatcher.upload(frameRingBuffer, meshPool);
+	sortDraws();
+
+	// Culling then drawing to the acquired image, with the barriers and render pass of the graph
+	renderGraph.setImage(swapchainResource, swapchainImages[currentImage].image, swapchainImages[currentImage].imageView);
+	renderGraph.execute(mainDevice.logicalDevice, commandBuffer);
+
+	instanceBatcher.clear();
+	meshDraws.clear();
+
+	// Stop recordind to command buffer
+	commandBuffer.end();
+
+	auto recordEnd = std::chrono::high_resolution_clock::now();
+	recordStatistics.commands = commandRecorder.getStatistics();
+	recordStatistics.recordMilliseconds = std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+}
+
+void VulkanRenderer::recordMainPass(vk::CommandBuffer commandBuffer)
+{
+	// Compute passes since the last draws pushed their own constants
+	commandRecorder.invalidatePushConstants();
+
+	// Bind pipeline to be used in render pass, you could switch pipelines for different subpasses
+	commandRecorder.bindPipeline(graphicsPipeline);
+
+	// Every mesh lives in the same buffers, bound by the first pass that draws and kept by the others
+	commandRecorder.bindVertexBuffer(0, meshPool.getVertexBuffer(), 0);
+	commandRecorder.bindIndexBuffer(meshPool.getIndexBuffer(), 0, vk::IndexType::eUint32);
+	commandRecorder.bindDescriptorSet(pipelineLayout, 0, descriptorSet, viewProjectionOffset);
+	// Every texture and buffer of the scene, for every draw of the frame
+	commandRecorder.bindDescriptorSet(pipelineLayout, 1, bindlessDescriptors.getDescriptorSet());
+	if (renderPath == RenderPath::Clustered)
+	{
+		// Same layout: the sets bound through the recorder stay bound
+		clusteredLighting.bindLighting(commandBuffer, pipelineLayout, 2);
+		shadowMaps.bindShadows(commandBuffer, pipelineLayout, 3);
+	}
+
+	// Execute pipeline: one indirect draw for every visible object, then for every visible meshlet.
+	// Objects carry their own material id, only the material buffer is pushed.
+	drawPushBlock.push(commandRecorder, drawPushConstants);
+	gpuCulling.recordDraws(commandBuffer);
+	gpuCulling.recordMeshletDraws(commandBuffer);
+
+	// Instanced meshes, one draw per mesh and material, and single meshes, their transform pushed.
+	// Mesh buffers and descriptor sets stay bound, the pipelines have the same layout.
+	recordSortedDraws(instancedPipeline, meshPipeline);
+
+	// Blended over the opaque draws, testing their depth
+	if (renderPath != RenderPath::Deferred)
+	{
+		particleSystem.recordDraw(commandRecorder);
+	}
+}
+
+void VulkanRenderer::recordDepthPrepass(vk::CommandBuffer commandBuffer)
+{
+	commandRecorder.invalidatePushConstants();
+
+	// Only the GPU culled objects: the others are not part of the occlusion culling
+	commandRecorder.bindPipeline(depthPrepassPipeline);
+	commandRecorder.bindVertexBuffer(0, meshPool.getVertexBuffer(), 0);
+	commandRecorder.bindIndexBuffer(meshPool.getIndexBuffer(), 0, vk::IndexType::eUint32);
+	commandRecorder.bindDescriptorSet(pipelineLayout, 0, descriptorSet, viewProjectionOffset);
+	drawPushBlock.push(commandRecorder, drawPushConstants);
+	gpuCulling.recordDraws(commandBuffer);
+}
+
+void VulkanRenderer::sortDraws()
+{
+	// Pipeline field of the keys. Instances first: the instanced pipeline is bound once for all the batches.
+	const uint32_t instancePipelineKey = 0;
+	const uint32_t singleMeshPipelineKey = 1;
+
+	const vector<InstanceBatcher::InstanceBatch>& batches = instanceBatcher.getBatches();
+	sortedDraws.clear();
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		const InstanceBatcher::InstanceBatch& batch = batches[i];
+		if (batch.instances.empty()) continue;
+
+		// A batch is spread over the scene: its first instance stands for all of them
+		float distance = glm::length(glm::vec3(batch.instances[0].model[3]) - cameraPosition);
+		uint64_t key = makeDrawKey(0, instancePipelineKey, batch.materialId, batch.meshId, distance / CAMERA_FAR);
+		sortedDraws.push_back(SortedDraw{ key, static_cast<uint32_t>(i) });
+	}
+	for (size_t i = 0; i < meshDraws.size(); ++i)
+	{
+		const MeshDraw& meshDraw = meshDraws[i];
+		float distance = glm::length(glm::vec3(meshDraw.model[3]) - cameraPosition);
+		uint64_t key = makeDrawKey(0, singleMeshPipelineKey, meshDraw.materialId, meshDraw.meshId, distance / CAMERA_FAR);
+		sortedDraws.push_back(SortedDraw{ key, static_cast<uint32_t>(batches.size() + i) });
+	}
+
+	// Unsorted, draws are recorded in submission order
+	if (!drawSortingEnabled) return;
+	if (sortedDraws.size() >= DRAW_SORT_PARALLEL_THRESHOLD)
+	{
+		radixSortDraws(sortedDraws, sortedDrawScratch, jobSystem);
+	}
+	else
+	{
+		radixSortDraws(sortedDraws, sortedDrawScratch);
+	}
+}
+
+void VulkanRenderer::recordSortedDraws(vk::Pipeline instancePipeline, vk::Pipeline singleMeshPipeline)
+{
+	if (sortedDraws.empty()) return;
+
+	instanceBatcher.bindInstances(commandRecorder, frameRingBuffer);
+
+	// The recorder drops the pipeline binds and material pushes that repeat the previous draw's
+	const size_t batchCount = instanceBatcher.getBatches().size();
+	DrawPushConstants pushConstants = drawPushConstants;
+	for (const SortedDraw& sortedDraw : sortedDraws)
+	{
+		if (sortedDraw.draw < batchCount)
+		{
+			// Instances carry their transforms, only the material can change
+			commandRecorder.bindPipeline(instancePipeline);
+			pushConstants.materialId = instanceBatcher.getBatches()[sortedDraw.draw].materialId;
+			drawPushBlock.push(commandRecorder, pushConstants);
+			instanceBatcher.recordBatch(commandRecorder, meshPool, sortedDraw.draw);
+		}
+		else
+		{
+			// Each single mesh pushes its own transform
+			const MeshDraw& meshDraw = meshDraws[sortedDraw.draw - batchCount];
+			const MeshRange& mesh = meshPool.getMesh(meshDraw.meshId);
+			commandRecorder.bindPipeline(singleMeshPipeline);
+			pushConstants.model = meshDraw.model * mesh.dequantization;
+			pushConstants.materialId = meshDraw.materialId;
+			drawPushBlock.push(commandRecorder, pushConstants);
+			commandRecorder.drawIndexed(mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, 0);
+		}
+	}
+}
+
+void VulkanRenderer::recordShadowCasters(vk::CommandBuffer commandBuffer, uint32_t cascade, bool staticCasters, bool dynamicCasters)
+{
+	commandRecorder.invalidatePushConstants();
+
+	// Same vertex shaders and layout as the main pass: only the camera of set 0 changes, to the cascade's
+	commandRecorder.bindVertexBuffer(0, meshPool.getVertexBuffer(), 0);
+	commandRecorder.bindIndexBuffer(meshPool.getIndexBuffer(), 0, vk::IndexType::eUint32);
+	commandRecorder.bindDescriptorSet(pipelineLayout, 0, descriptorSet, shadowViewProjectionOffsets[cascade]);
+
+	if (staticCasters)
+	{
+		// Culled for this cascade by the same dispatch as the camera, view 0 is the camera
+		commandRecorder.bindPipeline(shadowPipeline);
+		drawPushBlock.push(commandRecorder, drawPushConstants);
+		gpuCulling.recordDraws(commandBuffer, 1 + cascade);
+	}
+	if (dynamicCasters)
+	{
+		recordSortedDraws(shadowInstancedPipeline, shadowMeshPipeline);
 	}
 }
 
 void VulkanRenderer::createGraphicsCommandBuffers()
 {
-	// Create one command buffer for each framebuffer
-	commandBuffers.resize(swapchainFramebuffers.size());
+	// Create one command buffer for each frame in flight. Its fence tells when it can be recorded again.
+	commandBuffers.resize(MAX_FRAME_DRAWS);
 
 	vk::CommandBufferAllocateInfo commandBufferAllocInfo{};		// We are using a pool
 	commandBufferAllocInfo.commandPool = graphicsCommandPool;
@@ -1029,6 +1722,274 @@ void VulkanRenderer::createGraphicsCommandBuffers()
 }
 
 #pragma endregion Graphic Pipeline
+#pragma region Descriptors
+
+void VulkanRenderer::createDescriptorSetLayout()
+{
+	// View projection uniform buffer
+	vk::DescriptorSetLayoutBinding viewProjectionLayoutBinding{};
+	viewProjectionLayoutBinding.binding = 0; // Binding point in shader
+	// Dynamic: the offset in the frame ring buffer is given when binding the set
+	viewProjectionLayoutBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	viewProjectionLayoutBinding.descriptorCount = 1; // Number of descriptors for binding
+	viewProjectionLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex; // Shader stage to bind to
+	viewProjectionLayoutBinding.pImmutableSamplers = nullptr; // For textures
+
+	// Objects storage buffer, model matrices indexed with gl_InstanceIndex
+	vk::DescriptorSetLayoutBinding objectsLayoutBinding{};
+	objectsLayoutBinding.binding = 1;
+	objectsLayoutBinding.descriptorType = vk::DescriptorType::eStorageBuffer;
+	objectsLayoutBinding.descriptorCount = 1;
+	objectsLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+	objectsLayoutBinding.pImmutableSamplers = nullptr;
+
+	vector<vk::DescriptorSetLayoutBinding> layoutBindings{ viewProjectionLayoutBinding, objectsLayoutBinding };
+
+	descriptorSetLayout = descriptorLayoutCache.createLayout(mainDevice.logicalDevice, layoutBindings);
+}
+
+void VulkanRenderer::createUniformBuffers()
+{
+	// One region per frame in flight, so that we never write data the GPU is reading
+	frameRingBuffer.init(mainDevice.physicalDevice, mainDevice.logicalDevice, FRAME_RING_BUFFER_SIZE, MAX_FRAME_DRAWS);
+}
+
+void VulkanRenderer::updateUniformBuffers()
+{
+	// The frame's fence was waited on: its region of the ring buffer is free again
+	frameRingBuffer.beginFrame(currentFrame);
+
+	// Per-frame uniforms are a pointer bump and a memcpy
+	viewProjectionOffset = frameRingBuffer.pushUniform(uboViewProjection);
+
+	// GPU culling tests objects against the same camera, and against the shadow cascades
+	const glm::mat4 viewProjection = uboViewProjection.projection * uboViewProjection.view;
+	vector<Frustum> cullingFrustums{ Frustum::fromMatrix(viewProjection) };
+	if (renderPath == RenderPath::Clustered)
+	{
+		shadowMaps.update(frameRingBuffer, uboViewProjection.view, uboViewProjection.projection, CAMERA_NEAR, CAMERA_FAR,
+			sunDirection, sunColor);
+		for (uint32_t cascade = 0; cascade < ShadowMaps::CASCADE_COUNT; ++cascade)
+		{
+			UboViewProjection cascadeViewProjection{ shadowMaps.getCascadeProjection(cascade), shadowMaps.getCascadeView(cascade) };
+			shadowViewProjectionOffsets[cascade] = frameRingBuffer.pushUniform(cascadeViewProjection);
+			cullingFrustums.push_back(Frustum::fromMatrix(cascadeViewProjection.projection * cascadeViewProjection.view));
+		}
+	}
+	gpuCulling.updateViews(frameRingBuffer, cullingFrustums, uboViewProjection.view, uboViewProjection.projection,
+		static_cast<float>(swapchainExtent.height));
+
+	if (renderPath == RenderPath::Deferred)
+	{
+		deferredLighting.update(frameRingBuffer, pointLights, viewProjection, AMBIENT_LIGHT);
+	}
+	else if (renderPath == RenderPath::Clustered)
+	{
+		clusteredLighting.update(frameRingBuffer, pointLights, spotLights, uboViewProjection.view, uboViewProjection.projection,
+			swapchainExtent, CAMERA_NEAR, CAMERA_FAR, AMBIENT_LIGHT);
+	}
+	pointLights.clear();
+	spotLights.clear();
+
+	if (renderPath != RenderPath::Deferred)
+	{
+		// Simulated with the real frame time, capped so that a stall does not throw particles across the scene
+		double now = glfwGetTime();
+		float deltaTime = std::min(static_cast<float>(now - lastParticleTime), 0.1f);
+		lastParticleTime = now;
+		particleSystem.update(frameRingBuffer, deltaTime, uboViewProjection.view, uboViewProjection.projection);
+	}
+}
+
+void VulkanRenderer::createDescriptorAllocators()
+{
+	// Descriptors of each type per set, on average. Pools are sized from these ratios.
+	vector<PoolSizeRatio> poolRatios{
+		{ vk::DescriptorType::eUniformBuffer, 1.0f },
+		{ vk::DescriptorType::eUniformBufferDynamic, 1.0f },
+		{ vk::DescriptorType::eStorageBuffer, 2.0f },
+		{ vk::DescriptorType::eCombinedImageSampler, 2.0f },
+		{ vk::DescriptorType::eStorageBufferDynamic, 0.5f },
+		{ vk::DescriptorType::eInputAttachment, 0.5f },
+		{ vk::DescriptorType::eStorageImage, 0.5f }
+	};
+
+	descriptorAllocator.init(mainDevice.logicalDevice, 16, poolRatios);
+
+	frameDescriptorAllocators.resize(MAX_FRAME_DRAWS);
+	for (DescriptorAllocator& frameDescriptorAllocator : frameDescriptorAllocators)
+	{
+		frameDescriptorAllocator.init(mainDevice.logicalDevice, 64, poolRatios);
+	}
+}
+
+vk::DescriptorSet VulkanRenderer::allocateFrameDescriptorSet(vk::DescriptorSetLayout layout)
+{
+	return frameDescriptorAllocators[currentFrame].allocate(mainDevice.logicalDevice, layout);
+}
+
+void VulkanRenderer::createBindlessDescriptors()
+{
+	bindlessDescriptors.init(mainDevice.physicalDevice, mainDevice.logicalDevice,
+		MAX_BINDLESS_TEXTURES, MAX_BINDLESS_STORAGE_BUFFERS);
+}
+
+void VulkanRenderer::createDescriptorSets()
+{
+	// Long-lived: buffers never change, the dynamic offset selects the frame's uniform
+	descriptorSet = descriptorAllocator.allocate(mainDevice.logicalDevice, descriptorSetLayout);
+
+	// Buffer info and data offset info
+	vk::DescriptorBufferInfo viewProjectionBufferInfo{};
+	viewProjectionBufferInfo.buffer = frameRingBuffer.getBuffer(); // Buffer to get data from
+	viewProjectionBufferInfo.offset = 0; // Position of start of data, the dynamic offset is added to it
+	viewProjectionBufferInfo.range = sizeof(UboViewProjection); // Size of data
+
+	vk::DescriptorBufferInfo objectsBufferInfo{};
+	objectsBufferInfo.buffer = gpuCulling.getObjectBuffer();
+	objectsBufferInfo.offset = 0;
+	objectsBufferInfo.range = gpuCulling.getObjectBufferSize();
+
+	// Data about connection between binding and buffer
+	std::array<vk::WriteDescriptorSet, 2> setWrites{};
+	setWrites[0].dstSet = descriptorSet; // Descriptor set to update
+	setWrites[0].dstBinding = 0; // Binding to update (matches with binding on layout/shader)
+	setWrites[0].dstArrayElement = 0; // Index in array to update
+	setWrites[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+	setWrites[0].descriptorCount = 1; // Amount to update
+	setWrites[0].pBufferInfo = &viewProjectionBufferInfo; // Information about buffer data to bind
+
+	setWrites[1].dstSet = descriptorSet;
+	setWrites[1].dstBinding = 1;
+	setWrites[1].dstArrayElement = 0;
+	setWrites[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+	setWrites[1].descriptorCount = 1;
+	setWrites[1].pBufferInfo = &objectsBufferInfo;
+
+	mainDevice.logicalDevice.updateDescriptorSets(setWrites, nullptr);
+}
+
+#pragma endregion Descriptors
+#pragma region Scene
+
+void VulkanRenderer::createScene()
+{
+	// -- MESHES --
+	sceneMeshes.cube = meshPool.addMesh(createCubeMesh(glm::vec3(0.9f, 0.5f, 0.2f)));
+	sceneMeshes.pyramid = meshPool.addMesh(createPyramidMesh(glm::vec3(0.3f, 0.6f, 0.9f)));
+	// 16 thousand triangles, far too many once a few pixels wide: simplified while loading.
+	// Then every level is reordered for the vertex cache, overdraw and vertex fetch.
+	// Close enough for the full mesh, it is culled by meshlets: the back half never reaches the rasterizer.
+	MeshData sphere = createSphereMesh(glm::vec3(0.4f, 0.8f, 0.4f), 64, 128);
+	buildMeshLods(sphere);
+	optimizeMesh(sphere);
+	buildMeshlets(sphere);
+	sceneMeshes.sphere = meshPool.addMesh(sphere);
+	meshPool.upload(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool);
+
+	// -- TEXTURES --
+	ImageData checker = createCheckerImage(256, 8, glm::vec4(1.0f), glm::vec4(0.55f, 0.55f, 0.6f, 1.0f));
+	uint32_t checkerTexture = textureManager.createTextures({ checker })[0];
+
+	// 2048x2048, 21 MB with its mips: streamed, only resident at full size when seen from close
+	ImageData showcase = createCheckerImage(2048, 64, glm::vec4(1.0f, 0.9f, 0.5f, 1.0f), glm::vec4(0.2f, 0.3f, 0.6f, 1.0f));
+	TextureData showcaseData;
+	showcaseData.format = TextureManager::IMAGE_FORMAT;
+	showcaseData.width = showcase.width;
+	showcaseData.height = showcase.height;
+	showcaseData.levelOffsets.push_back(0);
+	showcaseData.data = std::move(showcase.pixels);
+	uint32_t showcaseTexture = textureStreamer.addTexture(std::move(showcaseData), textureManager.getSampler(SamplerDescription{}));
+
+	// -- MATERIALS --
+	// The material id is the index in this array
+	materials.resize(4);
+	materialStreamedTextures.assign(materials.size(), BindlessDescriptors::INVALID_INDEX);
+	sceneMaterials.ground = 0;
+	materials[sceneMaterials.ground].baseColor = glm::vec4(1.0f);
+	sceneMaterials.highlight = 1;
+	materials[sceneMaterials.highlight].baseColor = glm::vec4(1.0f, 0.6f, 0.6f, 1.0f);
+	sceneMaterials.debris = 2;
+	materials[sceneMaterials.debris].baseColor = glm::vec4(0.9f, 0.9f, 1.0f, 1.0f);
+	sceneMaterials.showcase = 3;
+	materials[sceneMaterials.showcase].baseColor = glm::vec4(1.0f);
+	for (GpuMaterial& material : materials)
+	{
+		material.albedoTexture = BindlessDescriptors::INVALID_INDEX;
+	}
+	materials[sceneMaterials.ground].albedoTexture = textureManager.getTexture(checkerTexture).bindlessIndex;
+	materialStreamedTextures[sceneMaterials.showcase] = showcaseTexture;
+
+	// Host visible and written each frame, like the ring buffer: a few bytes per material
+	vk::DeviceSize materialBufferSize = sizeof(GpuMaterial) * materials.size();
+	materialBuffers.resize(MAX_FRAME_DRAWS);
+	materialBufferMemories.resize(MAX_FRAME_DRAWS);
+	mappedMaterials.resize(MAX_FRAME_DRAWS);
+	materialBufferIndices.resize(MAX_FRAME_DRAWS);
+	for (int i = 0; i < MAX_FRAME_DRAWS; ++i)
+	{
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, materialBufferSize, vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			&materialBuffers[i], &materialBufferMemories[i]);
+		mappedMaterials[i] = static_cast<GpuMaterial*>(mainDevice.logicalDevice.mapMemory(materialBufferMemories[i], 0, materialBufferSize));
+		materialBufferIndices[i] = bindlessDescriptors.registerStorageBuffer(mainDevice.logicalDevice, materialBuffers[i]);
+	}
+
+	// -- OBJECTS --
+	// A grid of objects on the XZ plane, wide enough for the camera to only see part of it
+	const int gridSize = 64;
+	const float spacing = 3.0f;
+	vector<GpuObject> objects;
+	objects.reserve(gridSize * gridSize);
+	for (int x = 0; x < gridSize; ++x)
+	{
+		for (int z = 0; z < gridSize; ++z)
+		{
+			uint32_t meshId = (x + z) % 2 == 0 ? sceneMeshes.cube : (x + z) % 4 == 1 ? sceneMeshes.sphere : sceneMeshes.pyramid;
+			const MeshRange& mesh = meshPool.getMesh(meshId);
+
+			glm::vec3 position{ (x - gridSize / 2) * spacing, 0.0f, (z - gridSize / 2) * spacing };
+			float scale = 1.0f + 0.5f * ((x * 7 + z * 13) % 3);
+
+			GpuObject object{};
+			object.model = glm::translate(glm::mat4(1.0f), position);
+			object.model = glm::rotate(object.model, glm::radians(float((x * 31 + z * 17) % 360)), glm::vec3(0.0f, 1.0f, 0.0f));
+			object.model = glm::scale(object.model, glm::vec3(scale));
+			// Rotation and uniform scale: the world sphere is the local one, moved and scaled
+			object.boundingSphere = glm::vec4(glm::vec3(object.model * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f)),
+				mesh.boundingSphere.w * scale);
+			// The vertex shader reads quantized positions
+			object.model = object.model * mesh.dequantization;
+			object.meshId = meshId;
+			// One object in ten stands out
+			object.materialId = (x * 3 + z * 5) % 10 == 0 ? sceneMaterials.highlight : sceneMaterials.ground;
+
+			objects.push_back(object);
+		}
+	}
+
+	// The camera, and each shadow cascade
+	uint32_t cullingViewCount = renderPath == RenderPath::Clustered ? 1 + ShadowMaps::CASCADE_COUNT : 1;
+	gpuCulling.init(mainDevice.physicalDevice, mainDevice.logicalDevice, static_cast<uint32_t>(objects.size()), cullingViewCount,
+		frameRingBuffer, descriptorLayoutCache, descriptorAllocator, drawIndirectCountSupported, depthPyramid);
+	gpuCulling.setMeshes(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, meshPool);
+	gpuCulling.setObjects(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, objects);
+}
+
+void VulkanRenderer::updateMaterials()
+{
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		if (materialStreamedTextures[i] != BindlessDescriptors::INVALID_INDEX)
+		{
+			materials[i].albedoTexture = textureStreamer.getBindlessIndex(materialStreamedTextures[i]);
+		}
+	}
+	memcpy(mappedMaterials[currentFrame], materials.data(), sizeof(GpuMaterial) * materials.size());
+	drawPushConstants.materialBuffer = materialBufferIndices[currentFrame];
+}
+
+#pragma endregion Scene
 
 void VulkanRenderer::createSynchronisation() {
 	imageAvailable.resize(MAX_FRAME_DRAWS);
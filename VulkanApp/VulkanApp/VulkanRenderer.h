@@ -5,7 +5,39 @@
 #include <stdexcept>
 
 #include "VulkanUtilities.h"
+#include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "GpuCulling.h"
+#include "InstanceBatcher.h"
+#include "DrawSorting.h"
+#include "CommandRecorder.h"
+#include "FrameRingBuffer.h"
+#include "DescriptorAllocator.h"
+#include "BindlessDescriptors.h"
+#include "Material.h"
+#include "PushConstants.h"
+#include "JobSystem.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "RenderGraph.h"
+#include "DeferredLighting.h"
+#include "ClusteredLighting.h"
+#include "ShadowMaps.h"
+#include "DepthPyramid.h"
+#include "ParticleSystem.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
+
+/// How the main pass shades what it draws
+enum class RenderPath
+{
+	Forward, // Unlit, in one subpass, multisampled
+	Deferred, // G-buffer subpass, then a lighting subpass reading it as input attachments. Not multisampled.
+	Clustered, // Lit while drawn, from per-cluster light lists built by a compute pass, and shadowed. Multisampled.
+};
 
 struct 
 {
@@ -26,6 +58,83 @@ public:
 
 	void draw(); // <------------------------------------------------- DRAW 
 
+	/// Place the camera, used both for rendering and for GPU culling
+	void setCamera(const glm::vec3& position, const glm::vec3& target);
+
+	/// Draw copies of a mesh during the next frame, with one instanced draw per mesh and material
+	void drawInstances(uint32_t meshId, uint32_t materialId, const InstanceData* instances, size_t count);
+	/// Draw a single mesh during the next frame. The transform and material go through push constants,
+	/// no buffer is written.
+	void drawMesh(uint32_t meshId, uint32_t materialId, const glm::mat4& model);
+	/// Light the next frame. Only the lit paths use lights.
+	void addPointLight(const glm::vec3& position, float radius, const glm::vec3& color);
+	/// Light the next frame inside a cone along direction, of the given half angle in radians, fading out over
+	/// its outer fifth. Only the clustered path uses spot lights.
+	void addSpotLight(const glm::vec3& position, const glm::vec3& direction, float radius, float coneAngle, const glm::vec3& color);
+	/// Directional light, casting shadows in the clustered path. direction is where the light goes.
+	void setSunLight(const glm::vec3& direction, const glm::vec3& color) { sunDirection = direction; sunColor = color; }
+	/// Emit GPU particles from a sphere, see ParticleSystem::setEmitter. Drawn by the forward and clustered paths only.
+	void setParticleEmitter(const glm::vec3& position, float radius, float particlesPerSecond)
+	{
+		particleSystem.setEmitter(position, radius, particlesPerSecond);
+	}
+	/// Times the static shadows of the far cascade were drawn again, since init
+	uint32_t getShadowCacheUpdateCount() const { return shadowMaps.getStaticCacheUpdateCount(); }
+	/// Skip the objects hidden behind closer ones, from the depth of the previous and current frames. On by default.
+	void setOcclusionCulling(bool enabled) { gpuCulling.setOcclusionCulling(enabled); }
+	/// Largest error on screen, in pixels, of the levels of detail of culled objects. 0 always draws full meshes.
+	void setLodErrorThreshold(float pixels) { gpuCulling.setLodErrorThreshold(pixels); }
+	/// Draw the dense meshes close to the camera by their meshlets left after culling, instead of whole. On by default.
+	void setMeshletCulling(bool enabled) { gpuCulling.setMeshletCulling(enabled); }
+	/// Record the draws of drawInstances and drawMesh sorted by pipeline, material and mesh, then front to back,
+	/// so that each pipeline and material is set once per pass. On by default.
+	void setDrawSorting(bool enabled) { drawSortingEnabled = enabled; }
+
+	/// State and draw commands of the last frame's draws, issued or dropped as redundant by the recorder,
+	/// and the CPU time taken to record the whole frame
+	struct RecordStatistics {
+		CommandRecorder::Statistics commands;
+		double recordMilliseconds;
+	};
+	const RecordStatistics& getRecordStatistics() const { return recordStatistics; }
+
+	// Mesh ids of the meshes created with the scene
+	struct SceneMeshes {
+		uint32_t cube;
+		uint32_t pyramid;
+		uint32_t sphere; // Dense, with levels of detail
+	};
+	const SceneMeshes& getSceneMeshes() const { return sceneMeshes; }
+
+	// Material ids of the materials created with the scene
+	struct SceneMaterials {
+		uint32_t ground;
+		uint32_t highlight;
+		uint32_t debris;
+		uint32_t showcase; // Large streamed texture
+	};
+	const SceneMaterials& getSceneMaterials() const { return sceneMaterials; }
+
+	/// Descriptor pools held by the current frame's allocator. Stays flat once it has grown to the frame's needs.
+	uint32_t getFrameDescriptorPoolCount() const { return frameDescriptorAllocators[currentFrame].getPoolCount(); }
+	uint32_t getFrameDescriptorSetCount() const { return frameDescriptorAllocators[currentFrame].getAllocatedSetCount(); }
+
+	/// Worker threads shared by the renderer and the application
+	JobSystem& getJobSystem() { return jobSystem; }
+
+	/// Device memory budget of the streamed textures
+	void setTextureStreamingBudget(vk::DeviceSize budget) { textureStreamer.setBudget(budget); }
+	vk::DeviceSize getStreamedTextureSize() const { return textureStreamer.getResidentSize(); }
+	/// Before init
+	void setRenderPath(RenderPath path) { renderPath = path; }
+	RenderPath getRenderPath() const { return renderPath; }
+	/// MSAA samples asked for: 1, 2, 4 or 8. Lowered to what the device supports for color and depth. Before init.
+	void setRequestedSampleCount(uint32_t count) { requestedSampleCount = count; }
+	vk::SampleCountFlagBits getSampleCount() const { return sampleCount; }
+	/// Memory of the render targets created by the render graph, with and without aliasing
+	vk::DeviceSize getTransientMemorySize() const { return renderGraph.getTransientMemorySize(); }
+	vk::DeviceSize getUnaliasedTransientMemorySize() const { return renderGraph.getUnaliasedTransientMemorySize(); }
+
 	void clean(); // <------------------------------------------------ CLEAN 
 
 #ifdef NODEBUG
@@ -44,6 +153,8 @@ private:
 	vk::Queue graphicsQueue;
 	vk::Queue presentationQueue;
 
+	JobSystem jobSystem;
+
 	int currentFrame{ 0 };
 	const int MAX_FRAME_DRAWS{ 2 }; // <--- Should be less than the nb of swapchain images, which is 3
 	std::vector<vk::Fence> drawFences;
@@ -94,34 +205,220 @@ private:
 	/// Check if the devices are suitable for future uses by gathering the info about the physical device
 	/// and getting its queue family indices. If they are valid, it returns true
 	bool checkDeviceSuitable(vk::PhysicalDevice device);
+	/// Descriptor indexing features used by the bindless set (Vulkan 1.2)
+	bool checkBindlessSupport(vk::PhysicalDevice device);
+	// Device limit if the samplerAnisotropy feature is enabled, 0 otherwise
+	float maxSamplerAnisotropy{ 0.0f };
+	// VK_EXT_memory_budget, optional: real heap budgets for texture streaming
+	bool memoryBudgetSupported{ false };
+	bool isDeviceExtensionSupported(vk::PhysicalDevice device, const char* extensionName);
+	uint32_t requestedSampleCount{ 4 };
+	vk::SampleCountFlagBits sampleCount{ vk::SampleCountFlagBits::e1 };
+	/// Highest sample count up to the requested one, usable by both color and depth framebuffer attachments
+	vk::SampleCountFlagBits chooseSampleCount();
+	/// First format of the list usable with optimal tiling for the features
+	vk::Format chooseSupportedFormat(const vector<vk::Format>& formats, vk::FormatFeatureFlags features);
 	bool checkValidationLayerSupport();
 	//^ Various checks ===============================================
 
 	//v Graphic Pipeline =============================================
+	// -- RENDER GRAPH --
+	// The frame's passes and the resources they share: barriers and render passes come from it
+	RenderGraph renderGraph;
+	uint32_t swapchainResource{ 0 };
+	uint32_t depthResource{ 0 }; // Transient, created by the graph
+	// Multisampled color, transient: resolved into the swapchain image by the main render pass
+	uint32_t msaaColorResource{ 0 };
+	vk::Format depthFormat{ vk::Format::eUndefined };
+	uint32_t drawCommandsResource{ 0 };
+	uint32_t drawCountResource{ 0 };
+	uint32_t mainPass{ 0 };
+
+	// -- OCCLUSION CULLING --
+	// Depth of the objects the early culling kept, drawn before anything else. The depth pyramid is built from
+	// it, the late culling tests the other objects against it. Outlives frames: the next early culling reads it.
+	DepthPyramid depthPyramid;
+	uint32_t depthPyramidResource{ 0 };
+	uint32_t occlusionCandidatesResource{ 0 };
+	uint32_t depthPrepass{ 0 };
+	// Objects both culling phases hand to the meshlet culling, and the meshlet draws it writes
+	uint32_t meshletDispatchResource{ 0 };
+	uint32_t meshletObjectsResource{ 0 };
+	uint32_t meshletDrawCommandsResource{ 0 };
+	void recordDepthPrepass(vk::CommandBuffer commandBuffer);
+	RenderPath renderPath{ RenderPath::Forward };
+
+	// -- DEFERRED PATH --
+	// G-buffer, transient: written by the main pass, read by the lighting pass in the same render pass
+	uint32_t gbufferAlbedoResource{ 0 };
+	uint32_t gbufferNormalResource{ 0 };
+	uint32_t lightingPass{ 0 };
+	DeferredLighting deferredLighting;
+	const glm::vec3 AMBIENT_LIGHT{ 0.15f, 0.15f, 0.2f }; // Of the lit paths
+
+	// -- CLUSTERED PATH --
+	// Light lists, shared by frames in flight: written by the binning pass, read by the main pass
+	uint32_t clusterCountResource{ 0 };
+	uint32_t clusterLightResource{ 0 };
+	ClusteredLighting clusteredLighting;
+	// Cascades, one layer each, drawn before the main pass. The static cache outlives frames.
+	ShadowMaps shadowMaps;
+	std::array<uint32_t, ShadowMaps::CASCADE_COUNT> shadowCascadeResources{};
+	uint32_t shadowCacheResource{ 0 };
+	uint32_t shadowCascadePass{ 0 }; // Of the first cascade, the shadow pipelines are created with its render pass
+	std::array<uint32_t, ShadowMaps::CASCADE_COUNT> shadowViewProjectionOffsets{}; // Dynamic offsets, cascade cameras
+
+	// -- PARTICLES --
+	// Simulated by compute passes and drawn at the end of the main pass: not in the deferred path, whose main
+	// subpass writes the G-buffer. Shared by frames in flight.
+	ParticleSystem particleSystem;
+	const uint32_t MAX_PARTICLES{ 1u << 20 };
+	double lastParticleTime{ 0.0 }; // glfwGetTime of the last update
+	uint32_t particleResource{ 0 };
+	uint32_t particleAliveListResource{ 0 };
+	uint32_t particleDeadListResource{ 0 };
+	uint32_t particleCounterResource{ 0 };
+	uint32_t particleDispatchResource{ 0 };
+	glm::vec3 sunDirection{ -0.4f, -1.0f, -0.3f };
+	glm::vec3 sunColor{ 0.9f, 0.85f, 0.7f };
+	/// Static casters (culled for the cascade on the GPU), dynamic ones (instances and single meshes), or both
+	void recordShadowCasters(vk::CommandBuffer commandBuffer, uint32_t cascade, bool staticCasters, bool dynamicCasters);
+	void createRenderGraph();
+	/// Render pass of the main pass, the pipelines are created with it
 	vk::RenderPass renderPass;
-	void createRenderPass();
 	
 	vk::PipelineLayout pipelineLayout;
 
 	// -- GRAPHICS PIPELINE --
 	vk::Pipeline graphicsPipeline;
+	// Same as the graphics pipeline, with a per-instance vertex stream
+	vk::Pipeline instancedPipeline;
+	// Same as the graphics pipeline, with the model matrix in push constants
+	vk::Pipeline meshPipeline;
+	// Depth-only variants of the three, for the shadow cascades
+	vk::Pipeline shadowPipeline;
+	vk::Pipeline shadowInstancedPipeline;
+	vk::Pipeline shadowMeshPipeline;
+	// Depth-only variant of the graphics pipeline, for the depth prepass
+	vk::Pipeline depthPrepassPipeline;
+	/// Same vertex stage and layout as the given pipeline, no fragment stage, drawn in the given pass.
+	/// Shadow casters are drawn in a shadow map, single sampled and with a depth bias; otherwise the
+	/// viewport and multisampling of the given pipeline are kept.
+	vk::Pipeline createDepthOnlyPipeline(vk::GraphicsPipelineCreateInfo pipelineCreateInfo, uint32_t pass, bool shadowCaster);
+	// Push constant range of pipelineLayout, reflected from the shaders
+	PushConstantBlock<DrawPushConstants> drawPushBlock;
 	void createGraphicPipeline();
 	VkShaderModule createShaderModule(const vector<char>& code);
 
-	// -- FRAMEBUFFER --
-	std::vector<vk::Framebuffer> swapchainFramebuffers;
-	void createFramebuffers();
-
 	// -- COMMAND POOL --
 	vk::CommandPool graphicsCommandPool;
 	void createGraphicsCommandPool();
 
 	// -- COMMAND BUFFER --
-	void recordCommands();
-	std::vector<vk::CommandBuffer> commandBuffers;
+	/// Record the frame's commands in commandBuffers[currentFrame], drawing to the given swapchain image
+	void recordCommands(uint32_t currentImage);
+	std::vector<vk::CommandBuffer> commandBuffers; // One per frame in flight, re-recorded each frame
+	// Graphics state of the current frame's command buffer, set by the draws. Work recorded directly
+	// (compute passes, lighting...) does not go through it.
+	CommandRecorder commandRecorder;
+	/// Draws of the main pass, inside its render pass
+	void recordMainPass(vk::CommandBuffer commandBuffer);
+	/// Draws of drawInstances and drawMesh in sorted order, with the given pipelines, through the recorder: each
+	/// pipeline is bound and each material pushed only when it changes. The mesh pool buffers and the descriptor
+	/// sets must be bound.
+	void recordSortedDraws(vk::Pipeline instancePipeline, vk::Pipeline singleMeshPipeline);
 	void createGraphicsCommandBuffers();
 
 	//^ Graphic Pipeline =============================================
+	//v Descriptors ==================================================
+	// View and projection, same layout as the ViewProjection block of shader.vert
+	struct UboViewProjection {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uboViewProjection;
+	// Depth range of the projection, the clusters are sliced in it
+	const float CAMERA_NEAR{ 0.1f };
+	const float CAMERA_FAR{ 200.0f };
+
+	// Per-frame data (uniforms, instances) is bump allocated in a persistently mapped ring buffer
+	FrameRingBuffer frameRingBuffer;
+	const vk::DeviceSize FRAME_RING_BUFFER_SIZE{ 8 * 1024 * 1024 }; // Per frame in flight
+	uint32_t viewProjectionOffset{ 0 }; // Dynamic offset of this frame's UboViewProjection
+	void createUniformBuffers();
+	void updateUniformBuffers();
+
+	// Layouts are deduplicated by the cache, which owns them
+	DescriptorLayoutCache descriptorLayoutCache;
+	vk::DescriptorSetLayout descriptorSetLayout;
+	void createDescriptorSetLayout();
+
+	// Long-lived sets, never reset
+	DescriptorAllocator descriptorAllocator;
+	// Transient sets, one allocator per frame in flight, reset when the frame starts again
+	std::vector<DescriptorAllocator> frameDescriptorAllocators;
+	void createDescriptorAllocators();
+	/// Descriptor set valid until the end of the current frame
+	vk::DescriptorSet allocateFrameDescriptorSet(vk::DescriptorSetLayout layout);
+
+	// Uniforms use dynamic offsets, so the same set serves every frame
+	vk::DescriptorSet descriptorSet;
+	void createDescriptorSets();
+
+	// Set 1 of the graphics pipelines: every texture and storage buffer, bound once per frame
+	BindlessDescriptors bindlessDescriptors;
+	const uint32_t MAX_BINDLESS_TEXTURES{ 4096 };
+	const uint32_t MAX_BINDLESS_STORAGE_BUFFERS{ 1024 };
+	void createBindlessDescriptors();
+	//^ Descriptors ==================================================
+	//v Scene ========================================================
+	MeshPool meshPool;
+	SceneMeshes sceneMeshes;
+
+	// Textures are registered in the bindless set, materials refer to them by bindless index
+	TextureManager textureManager;
+	// Large textures: only the levels drawn at their current size are resident
+	TextureStreamer textureStreamer;
+	const vk::DeviceSize TEXTURE_STREAMING_BUDGET{ 256 * 1024 * 1024 };
+	const vk::DeviceSize TEXTURE_STREAMING_STAGING_SIZE{ 8 * 1024 * 1024 }; // Uploaded per frame at most
+	glm::vec3 cameraPosition;
+
+	// Every material in one storage buffer, indexed by material id in the shaders.
+	// One buffer per frame in flight: bindless indices of streamed textures change between frames.
+	vector<GpuMaterial> materials;
+	vector<uint32_t> materialStreamedTextures; // Streamed albedo of each material, INVALID_INDEX if none
+	vector<vk::Buffer> materialBuffers;
+	vector<vk::DeviceMemory> materialBufferMemories;
+	vector<GpuMaterial*> mappedMaterials;
+	vector<uint32_t> materialBufferIndices; // Bindless index of each frame's buffer
+	SceneMaterials sceneMaterials;
+	DrawPushConstants drawPushConstants{}; // materialBuffer is set each frame
+	/// Write the materials in the current frame's buffer, with the current streamed textures
+	void updateMaterials();
+
+	// Meshes submitted by drawMesh
+	struct MeshDraw {
+		uint32_t meshId;
+		uint32_t materialId;
+		glm::mat4 model;
+	};
+	vector<MeshDraw> meshDraws;
+	// Instance batches, then mesh draws after the last batch: draw indices of sortedDraws
+	vector<SortedDraw> sortedDraws;
+	vector<SortedDraw> sortedDrawScratch; // Kept to reuse its capacity
+	bool drawSortingEnabled{ true };
+	RecordStatistics recordStatistics{};
+	/// Key the draws of the frame and sort them, once per frame after the instance upload.
+	/// Every pass records the same order: shadow cascades bind the depth-only variants of the same pipelines.
+	void sortDraws();
+	vector<GpuPointLight> pointLights; // Of the next frame
+	vector<GpuSpotLight> spotLights;
+	// Objects are culled on the GPU and drawn with a single indirect draw
+	GpuCulling gpuCulling;
+	bool drawIndirectCountSupported{ false };
+	// Instances submitted by drawInstances
+	InstanceBatcher instanceBatcher;
+	void createScene();
+	//^ Scene ========================================================
 
 	//v Synchronisation ==============================================
 	std::vector<vk::Semaphore> imageAvailable;
@@ -7,6 +7,10 @@
 #include <fstream>
 #include <string>
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
 using std::vector;
 using std::string;
 
@@ -22,6 +26,14 @@ struct QueueFamilyIndices {
 	}
 };
 
+// Vertex data representation, should match the vertex shader inputs
+struct Vertex
+{
+	glm::vec3 position; // Vertex position (x, y, z)
+	glm::vec3 color; // Vertex color (r, g, b)
+	glm::vec2 uv; // Texture coordinates (u, v)
+};
+
 // Extensions to support
 const std::vector<const char*> deviceExtensions
 {
@@ -79,4 +91,186 @@ static vector<char> readShaderFile(const string& filename)
 	file.close();
 
 	return fileBuffer;
-}
\ No newline at end of file
+}
+
+static vk::ShaderModule createShaderModule(vk::Device device, const vector<char>& code)
+{
+	vk::ShaderModuleCreateInfo shaderModuleCreateInfo{};
+	shaderModuleCreateInfo.codeSize = code.size();
+	// Conversion between pointer types with reinterpret_cast
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	return device.createShaderModule(shaderModuleCreateInfo);
+}
+
+/// Find the index of a memory type allowed by the resource (allowedTypes bits)
+/// and having all the requested properties
+static uint32_t findMemoryTypeIndex(vk::PhysicalDevice physicalDevice, uint32_t allowedTypes, vk::MemoryPropertyFlags properties)
+{
+	vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		// Index of memory type must match corresponding bit in allowedTypes
+		// and desired property bit flags are part of the memory type's property flags
+		if ((allowedTypes & (1 << i))
+			&& (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+static void createBuffer(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize bufferSize,
+						 vk::BufferUsageFlags bufferUsage, vk::MemoryPropertyFlags bufferProperties,
+						 vk::Buffer* buffer, vk::DeviceMemory* bufferMemory)
+{
+	// Buffer info, it does not include the memory
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.size = bufferSize;
+	bufferInfo.usage = bufferUsage; // Multiple types of buffer possible, e.g. vertex buffer
+	bufferInfo.sharingMode = vk::SharingMode::eExclusive; // Like for swapchain images, can share buffers
+
+	*buffer = device.createBuffer(bufferInfo);
+
+	// Get buffer memory requirements
+	vk::MemoryRequirements memoryRequirements = device.getBufferMemoryRequirements(*buffer);
+
+	// Allocate memory to buffer
+	vk::MemoryAllocateInfo memoryAllocInfo{};
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, bufferProperties);
+
+	*bufferMemory = device.allocateMemory(memoryAllocInfo);
+
+	// Bind memory to the given buffer
+	device.bindBufferMemory(*buffer, *bufferMemory, 0);
+}
+
+/// Allocate and begin a command buffer meant to be submitted once
+static vk::CommandBuffer beginCommandBuffer(vk::Device device, vk::CommandPool commandPool)
+{
+	vk::CommandBufferAllocateInfo allocInfo{};
+	allocInfo.level = vk::CommandBufferLevel::ePrimary;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	vk::CommandBuffer commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+
+	// We are only using the command buffer once
+	vk::CommandBufferBeginInfo beginInfo{};
+	beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+	commandBuffer.begin(beginInfo);
+
+	return commandBuffer;
+}
+
+/// End, submit and wait for a command buffer from beginCommandBuffer, then free it
+static void endAndSubmitCommandBuffer(vk::Device device, vk::CommandPool commandPool, vk::Queue queue, vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.end();
+
+	vk::SubmitInfo submitInfo{};
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	// Transfers are rare (loading), so simply wait for the queue to be done
+	queue.submit(submitInfo, nullptr);
+	queue.waitIdle();
+
+	device.freeCommandBuffers(commandPool, commandBuffer);
+}
+
+static void copyBuffer(vk::Device device, vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+					   vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize bufferSize)
+{
+	vk::CommandBuffer transferCommandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	// Region of data to copy from and to
+	vk::BufferCopy bufferCopyRegion{};
+	bufferCopyRegion.srcOffset = 0;
+	bufferCopyRegion.dstOffset = 0;
+	bufferCopyRegion.size = bufferSize;
+	transferCommandBuffer.copyBuffer(srcBuffer, dstBuffer, bufferCopyRegion);
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
+}
+
+/// Create a device local buffer and fill it with data through a temporary host visible staging buffer
+static void createDeviceLocalBuffer(vk::PhysicalDevice physicalDevice, vk::Device device,
+									vk::Queue transferQueue, vk::CommandPool transferCommandPool,
+									const void* data, vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsage,
+									vk::Buffer* buffer, vk::DeviceMemory* bufferMemory)
+{
+	// Staging buffer, visible by the CPU to put data in it
+	vk::Buffer stagingBuffer;
+	vk::DeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* mappedData = device.mapMemory(stagingBufferMemory, 0, bufferSize);
+	memcpy(mappedData, data, static_cast<size_t>(bufferSize));
+	device.unmapMemory(stagingBufferMemory);
+
+	// Destination buffer, only visible by the GPU
+	createBuffer(physicalDevice, device, bufferSize, vk::BufferUsageFlagBits::eTransferDst | bufferUsage,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, buffer, bufferMemory);
+
+	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, *buffer, bufferSize);
+
+	device.destroyBuffer(stagingBuffer);
+	device.freeMemory(stagingBufferMemory);
+}
+
+/// Create a 2D image with its own device memory
+static void createImage(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t width, uint32_t height,
+						uint32_t mipLevels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
+						vk::MemoryPropertyFlags properties, vk::Image* image, vk::DeviceMemory* imageMemory)
+{
+	vk::ImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.imageType = vk::ImageType::e2D;
+	imageCreateInfo.extent = vk::Extent3D{ width, height, 1 };
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = format;
+	imageCreateInfo.tiling = tiling; // Optimal: arranged by the driver for fast access, not readable by the CPU
+	imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+	imageCreateInfo.usage = usage;
+	imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+	imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+	*image = device.createImage(imageCreateInfo);
+
+	vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(*image);
+
+	vk::MemoryAllocateInfo memoryAllocInfo{};
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, properties);
+
+	*imageMemory = device.allocateMemory(memoryAllocInfo);
+	device.bindImageMemory(*image, *imageMemory, 0);
+}
+
+/// View on every mip level of a 2D image
+static vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format,
+									 vk::ImageAspectFlags aspectFlags, uint32_t mipLevels)
+{
+	vk::ImageViewCreateInfo viewCreateInfo{};
+	viewCreateInfo.image = image;
+	viewCreateInfo.viewType = vk::ImageViewType::e2D;
+	viewCreateInfo.format = format;
+	viewCreateInfo.components.r = vk::ComponentSwizzle::eIdentity;
+	viewCreateInfo.components.g = vk::ComponentSwizzle::eIdentity;
+	viewCreateInfo.components.b = vk::ComponentSwizzle::eIdentity;
+	viewCreateInfo.components.a = vk::ComponentSwizzle::eIdentity;
+	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	return device.createImageView(viewCreateInfo);
+}
@@ -4,6 +4,8 @@
 #include <stdexcept>
 
 #include "VulkanRenderer.h"
+#include "SceneGraph.h"
+#include "Benchmarks.h"
 
 GLFWwindow* window = nullptr;
 VulkanRenderer vulkanRenderer;
@@ -27,14 +29,139 @@ void clean()
 	glfwTerminate();
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+	// CPU benchmarks only, no window nor device needed
+	if (argc > 1 && string(argv[1]) == "--benchmark")
+	{
+		runBenchmarks();
+		return 0;
+	}
+
+	// Lit scene, shaded per pixel from the G-buffer
+	if (argc > 1 && string(argv[1]) == "--deferred")
+	{
+		vulkanRenderer.setRenderPath(RenderPath::Deferred);
+	}
+	// Light benchmark: ten thousand lights, lit through the per-cluster light lists
+	bool clusteredBenchmark = argc > 1 && string(argv[1]) == "--clustered";
+	if (clusteredBenchmark)
+	{
+		vulkanRenderer.setRenderPath(RenderPath::Clustered);
+	}
+	// Every object in the frustum is drawn, or drawn at full detail, or in submission order, to compare frame times
+	for (int i = 1; i < argc; ++i)
+	{
+		if (string(argv[i]) == "--no-occlusion") vulkanRenderer.setOcclusionCulling(false);
+		if (string(argv[i]) == "--no-lod") vulkanRenderer.setLodErrorThreshold(0.0f);
+		if (string(argv[i]) == "--no-meshlets") vulkanRenderer.setMeshletCulling(false);
+		if (string(argv[i]) == "--unsorted-draws") vulkanRenderer.setDrawSorting(false);
+	}
+
 	initWindow();
 	if (vulkanRenderer.init(window) == EXIT_FAILURE) return EXIT_FAILURE;
 
+	// A fountain of close to a million GPU particles under the spinning cube, swirling in curl noise
+	vulkanRenderer.setParticleEmitter(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 250000.0f);
+
+	// Camera orbits around the scene, so that culling has something to do
+	float angle = 0.0f;
+	double lastTime = glfwGetTime();
+
+	// Debris circling above the scene, drawn with instancing. They hang from a ring node of the scene graph:
+	// turning the ring moves all of them, their own transforms never change.
+	const size_t debrisCount = 2000;
+	SceneGraph sceneGraph;
+	uint32_t debrisRing = sceneGraph.addNode(glm::mat4(1.0f));
+	vector<uint32_t> debrisNodes(debrisCount);
+	vector<InstanceData> debris(debrisCount);
+	for (size_t i = 0; i < debrisCount; ++i)
+	{
+		float debrisAngle = static_cast<float>(i) * 0.1f;
+		float radius = 10.0f + static_cast<float>(i % 50) * 0.4f;
+		glm::vec3 position{ radius * cos(debrisAngle), 8.0f + static_cast<float>(i % 7), radius * sin(debrisAngle) };
+		glm::mat4 localTransform = glm::translate(glm::mat4(1.0f), position);
+		localTransform = glm::rotate(localTransform, debrisAngle * 3.0f, glm::vec3(1.0f, 1.0f, 0.0f));
+		localTransform = glm::scale(localTransform, glm::vec3(0.3f));
+		debrisNodes[i] = sceneGraph.addNode(localTransform, debrisRing);
+		debris[i].color = glm::vec4(0.5f + 0.5f * static_cast<float>(i % 3) / 2.0f, 0.8f, 1.0f, 1.0f);
+	}
+
+	// Frame times of the clustered benchmark, printed every few hundred frames
+	const int benchmarkFrames = 300;
+	int frameCount = 0;
+	double frameTimeSum = 0.0;
+	double frameTimeMax = 0.0;
+
 	while (!glfwWindowShouldClose(window))
 	{
 		glfwPollEvents();
+
+		double now = glfwGetTime();
+		double frameTime = now - lastTime;
+		angle += static_cast<float>(frameTime) * glm::radians(10.0f);
+		lastTime = now;
+		vulkanRenderer.setCamera(glm::vec3(40.0f * cos(angle), 15.0f, 40.0f * sin(angle)), glm::vec3(0.0f, 0.0f, 0.0f));
+
+		// Half a radian per second around the vertical axis
+		sceneGraph.setLocalTransform(debrisRing,
+			glm::rotate(glm::mat4(1.0f), -static_cast<float>(now) * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)));
+		sceneGraph.updateWorldTransforms();
+		for (size_t i = 0; i < debrisCount; ++i)
+		{
+			debris[i].model = sceneGraph.getWorldTransform(debrisNodes[i]);
+		}
+		vulkanRenderer.drawInstances(vulkanRenderer.getSceneMeshes().pyramid, vulkanRenderer.getSceneMaterials().debris,
+			debris.data(), debris.size());
+
+		// A single cube spinning in the middle, its transform goes through push constants.
+		// Its texture is streamed: seen from the orbit, only its small levels are resident.
+		glm::mat4 centerModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 6.0f, 0.0f));
+		centerModel = glm::rotate(centerModel, static_cast<float>(now), glm::vec3(0.0f, 1.0f, 0.0f));
+		centerModel = glm::scale(centerModel, glm::vec3(2.0f));
+		vulkanRenderer.drawMesh(vulkanRenderer.getSceneMeshes().cube, vulkanRenderer.getSceneMaterials().showcase, centerModel);
+
+		if (clusteredBenchmark)
+		{
+			frameTimeSum += frameTime;
+			frameTimeMax = frameTime > frameTimeMax ? frameTime : frameTimeMax;
+			if (++frameCount == benchmarkFrames)
+			{
+				printf("Clustered lighting: %.3f ms average, %.3f ms max over %d frames, shadow cache drawn %u times so far\n",
+					frameTimeSum * 1000.0 / frameCount, frameTimeMax * 1000.0, frameCount, vulkanRenderer.getShadowCacheUpdateCount());
+				const VulkanRenderer::RecordStatistics& recordStatistics = vulkanRenderer.getRecordStatistics();
+				const CommandRecorder::Statistics& commands = recordStatistics.commands;
+				printf("Last frame recorded in %.3f ms: %u commands issued, %u elided (%u draws, %u pipeline binds, %u push constants)\n",
+					recordStatistics.recordMilliseconds, commands.issuedCommands, commands.elidedCommands, commands.draws,
+					commands.pipelineBinds, commands.pushConstants);
+				frameCount = 0;
+				frameTimeSum = 0.0;
+				frameTimeMax = 0.0;
+			}
+		}
+
+		// Hundreds of small colored lights wandering over the ground, or thousands of tiny ones for the benchmark
+		const int lightCount = clusteredBenchmark ? 10000 : 256;
+		const float lightRange = clusteredBenchmark ? 2.0f : 6.0f;
+		for (int i = 0; i < lightCount; ++i)
+		{
+			float lightAngle = static_cast<float>(i) * 2.4f + static_cast<float>(now) * (0.2f + 0.1f * static_cast<float>(i % 5));
+			float lightRadius = 4.0f + static_cast<float>(i % 32);
+			glm::vec3 position{ lightRadius * cos(lightAngle), 1.0f + static_cast<float>(i % 4), lightRadius * sin(lightAngle) };
+			glm::vec3 color{ static_cast<float>(i % 3 == 0), static_cast<float>(i % 3 == 1), static_cast<float>(i % 3 == 2) };
+			vulkanRenderer.addPointLight(position, lightRange, color + glm::vec3(0.2f));
+		}
+		// Spot lights overhead, sweeping the ground. Only the clustered path draws them.
+		const int spotLightCount = clusteredBenchmark ? 1000 : 8;
+		for (int i = 0; i < spotLightCount; ++i)
+		{
+			float spotAngle = static_cast<float>(i) * 0.7f + static_cast<float>(now) * 0.3f;
+			float spotRadius = 6.0f + static_cast<float>(i % 24);
+			glm::vec3 position{ spotRadius * cos(spotAngle), 10.0f, spotRadius * sin(spotAngle) };
+			glm::vec3 direction{ 0.3f * cos(static_cast<float>(now) + static_cast<float>(i)), -1.0f, 0.3f * sin(static_cast<float>(now)) };
+			vulkanRenderer.addSpotLight(position, direction, 16.0f, glm::radians(20.0f), glm::vec3(1.0f, 0.9f, 0.7f));
+		}
+
 		vulkanRenderer.draw();
 	}
 
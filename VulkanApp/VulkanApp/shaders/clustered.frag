@@ -0,0 +1,158 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Same inputs as shader.frag
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterialId;
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) in vec3 fragWorldPosition;
+layout(location = 0) out vec4 outColor;
+
+// Same layout as GpuMaterial on the CPU side
+struct Material {
+	vec4 baseColor;
+	uint albedoTexture;
+};
+
+const uint INVALID_INDEX = 0xFFFFFFFF;
+
+// Bindless set (BindlessDescriptors): every texture and storage buffer, indexed by handle
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+layout(std430, set = 1, binding = 1) readonly buffer Materials {
+	Material materials[];
+} materialBuffers[];
+
+// Clustered lighting set, the one cluster.comp fills
+layout(set = 2, binding = 0) uniform Clusters {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 ambient;
+	vec2 screenSize;
+	vec2 clusterSize;
+	float zNear;
+	float zFar;
+	uint lightCount;
+	uint spotLightCount;
+} clusters;
+
+struct PointLight {
+	vec4 positionRadius;
+	vec4 color;
+};
+
+struct SpotLight {
+	vec4 positionRadius;
+	vec4 color; // w: cosine of the half angle where the edge falloff starts
+	vec4 directionCosAngle; // w: cosine of the cone half angle
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer PointLights {
+	PointLight lights[];
+};
+layout(std430, set = 2, binding = 4) readonly buffer SpotLights {
+	SpotLight spotLights[];
+};
+layout(std430, set = 2, binding = 2) readonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+layout(std430, set = 2, binding = 3) readonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+const uvec3 CLUSTER_COUNT = uvec3(16, 9, 24); // ClusteredLighting::CLUSTER_X, Y, Z
+const uint MAX_LIGHTS_PER_CLUSTER = 256;
+
+// Directional light and its cascaded shadow maps (ShadowMaps)
+const uint CASCADE_COUNT = 4; // ShadowMaps::CASCADE_COUNT
+const float SHADOW_MAP_SIZE = 2048.0; // ShadowMaps::SHADOW_MAP_SIZE
+
+layout(set = 3, binding = 0) uniform Shadows {
+	mat4 cascadeViewProjections[CASCADE_COUNT];
+	vec4 splitDistances; // View space distance where each cascade ends
+	vec4 lightDirection;
+	vec4 lightColor;
+} shadows;
+layout(set = 3, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+// Members of DrawPushConstants read here, at their offset in the CPU side struct
+layout(push_constant) uniform PushDraw {
+	layout(offset = 64) uint materialBuffer;
+} pushDraw;
+
+// Fraction of the light reaching a point, 3x3 comparisons around it
+float getShadow(vec3 worldPosition, float viewDistance) {
+	uint cascade = 0;
+	while (cascade < CASCADE_COUNT && viewDistance > shadows.splitDistances[cascade]) ++cascade;
+	if (cascade == CASCADE_COUNT) return 1.0;
+
+	vec4 lightPosition = shadows.cascadeViewProjections[cascade] * vec4(worldPosition, 1.0);
+	vec2 uv = lightPosition.xy * 0.5 + 0.5;
+	float shadow = 0.0;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			shadow += texture(shadowMap, vec4(uv + vec2(x, y) / SHADOW_MAP_SIZE, float(cascade), lightPosition.z));
+		}
+	}
+	return shadow / 9.0;
+}
+
+void main() {
+	Material material = materialBuffers[pushDraw.materialBuffer].materials[fragMaterialId];
+	vec3 albedo = fragColor * material.baseColor.rgb;
+	if (material.albedoTexture != INVALID_INDEX)
+	{
+		albedo *= texture(textures[nonuniformEXT(material.albedoTexture)], fragUV).rgb;
+	}
+
+	// Flat normal, the vertices have none (see gbuffer.frag)
+	vec3 normal = normalize(cross(dFdy(fragWorldPosition), dFdx(fragWorldPosition)));
+
+	// Cluster of the fragment: screen tile, and depth slice from the view space distance
+	float viewDistance = -(clusters.view * vec4(fragWorldPosition, 1.0)).z;
+	uint slice = uint(log(viewDistance / clusters.zNear) / log(clusters.zFar / clusters.zNear) * float(CLUSTER_COUNT.z));
+	uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy / clusters.clusterSize), slice), CLUSTER_COUNT - 1);
+	uint clusterIndex = cluster.x + cluster.y * CLUSTER_COUNT.x + cluster.z * CLUSTER_COUNT.x * CLUSTER_COUNT.y;
+
+	// Directional light, shadowed
+	vec3 color = albedo * clusters.ambient.rgb;
+	float sunLight = max(dot(normal, -shadows.lightDirection.xyz), 0.0);
+	if (sunLight > 0.0)
+	{
+		color += albedo * shadows.lightColor.rgb * sunLight * getShadow(fragWorldPosition, viewDistance);
+	}
+
+	// Only the lights reaching the cluster: point lights, then spot lights past lightCount
+	uint count = clusterCounts[clusterIndex];
+	for (uint i = 0; i < count; ++i)
+	{
+		uint lightIndex = clusterLights[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i];
+		vec4 positionRadius;
+		vec3 lightColor;
+		float coneFalloff = 1.0;
+		if (lightIndex < clusters.lightCount)
+		{
+			positionRadius = lights[lightIndex].positionRadius;
+			lightColor = lights[lightIndex].color.rgb;
+		}
+		else
+		{
+			SpotLight light = spotLights[lightIndex - clusters.lightCount];
+			positionRadius = light.positionRadius;
+			lightColor = light.color.rgb;
+			// Full inside the inner cone, fading to 0 at the edge
+			float cosAngle = dot(normalize(fragWorldPosition - light.positionRadius.xyz), light.directionCosAngle.xyz);
+			coneFalloff = smoothstep(light.directionCosAngle.w, light.color.w, cosAngle);
+		}
+		vec3 toLight = positionRadius.xyz - fragWorldPosition;
+		float lightDistance = length(toLight);
+		float radius = positionRadius.w;
+		if (lightDistance >= radius || coneFalloff <= 0.0) continue;
+
+		float attenuation = 1.0 - lightDistance / radius;
+		attenuation *= attenuation * coneFalloff;
+		color += albedo * lightColor * max(dot(normal, toLight / lightDistance), 0.0) * attenuation;
+	}
+	outColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -1,2 +1,18 @@
 C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V shader.vert
-C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V shader.frag
\ No newline at end of file
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V cull.comp -o cull.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V instanced.vert -o instanced.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V mesh.vert -o mesh.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V gbuffer.frag -o gbuffer.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V fullscreen.vert -o fullscreen.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V lighting.frag -o lighting.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V cluster.comp -o cluster.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V clustered.frag -o clustered.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V depthpyramid.comp -o depthpyramid.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V -DMULTISAMPLED depthpyramid.comp -o depthpyramid_ms.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V meshletcull.comp -o meshletcull.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V particleprepare.comp -o particleprepare.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V particlesimulate.comp -o particlesimulate.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V particleemit.comp -o particleemit.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V particle.vert -o particle.spv
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe -V particle.frag -o particlefrag.spv
\ No newline at end of file
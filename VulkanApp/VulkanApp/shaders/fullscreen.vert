@@ -0,0 +1,9 @@
+#version 450
+
+// One triangle covering the screen, from the vertex index alone: no vertex buffer
+layout(location = 0) out vec2 fragUV;
+
+void main() {
+	fragUV = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(fragUV * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
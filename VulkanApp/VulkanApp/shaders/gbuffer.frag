@@ -0,0 +1,46 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Same inputs as shader.frag, lighting is done by lighting.frag
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterialId;
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) in vec3 fragWorldPosition;
+
+// G-buffer, read back as input attachments by the lighting subpass
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal; // World space, remapped to [0, 1]
+
+// Same layout as GpuMaterial on the CPU side
+struct Material {
+	vec4 baseColor;
+	uint albedoTexture;
+};
+
+const uint INVALID_INDEX = 0xFFFFFFFF;
+
+// Bindless set (BindlessDescriptors): every texture and storage buffer, indexed by handle
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+layout(std430, set = 1, binding = 1) readonly buffer Materials {
+	Material materials[];
+} materialBuffers[];
+
+// Members of DrawPushConstants read here, at their offset in the CPU side struct
+layout(push_constant) uniform PushDraw {
+	layout(offset = 64) uint materialBuffer;
+} pushDraw;
+
+void main() {
+	Material material = materialBuffers[pushDraw.materialBuffer].materials[fragMaterialId];
+	vec3 albedo = fragColor * material.baseColor.rgb;
+	if (material.albedoTexture != INVALID_INDEX)
+	{
+		albedo *= texture(textures[nonuniformEXT(material.albedoTexture)], fragUV).rgb;
+	}
+	outAlbedo = vec4(albedo, 1.0);
+
+	// Vertices have no normal: flat normal of the triangle, from the screen space derivatives of the
+	// position. Screen y points down, so dFdy comes first to face the camera.
+	vec3 normal = normalize(cross(dFdy(fragWorldPosition), dFdx(fragWorldPosition)));
+	outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+}
\ No newline at end of file
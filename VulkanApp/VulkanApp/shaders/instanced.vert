@@ -0,0 +1,36 @@
+#version 450
+
+// Vertex data, from the mesh pool vertex buffer. The position is quantized inside the mesh bounding box:
+// the model matrix includes its dequantization.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 uv;
+
+// Instance data, advances once per instance (InstanceBatcher)
+layout(location = 3) in mat4 instanceModel; // Takes locations 3 to 6
+layout(location = 7) in vec4 instanceColor;
+
+layout(set = 0, binding = 0) uniform ViewProjection {
+	mat4 projection;
+	mat4 view;
+} uboViewProjection;
+
+// Members of DrawPushConstants read here, at their offset in the CPU side struct
+layout(push_constant) uniform PushDraw {
+	layout(offset = 68) uint materialId;
+} pushDraw;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterialId;
+layout(location = 2) out vec2 fragUV;
+// For the G-buffer normal, unused by the forward fragment shader
+layout(location = 3) out vec3 fragWorldPosition;
+
+void main() {
+	vec4 worldPosition = instanceModel * vec4(position, 1.0);
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * worldPosition;
+	fragUV = uv;
+	fragColor = color * instanceColor.rgb;
+	fragMaterialId = pushDraw.materialId;
+	fragWorldPosition = worldPosition.xyz;
+}
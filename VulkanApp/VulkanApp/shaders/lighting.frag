@@ -0,0 +1,58 @@
+#version 450
+
+// Where the pixel is on screen, [0, 1] from the top left
+layout(location = 0) in vec2 fragUV;
+layout(location = 0) out vec4 outColor;
+
+// G-buffer written by the previous subpass, only readable at this pixel
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput gbufferDepth;
+
+// Same layout as LightingUbo on the CPU side
+layout(set = 0, binding = 3) uniform Lighting {
+	mat4 inverseViewProjection;
+	vec4 ambient;
+	uint lightCount;
+} lighting;
+
+// Same layout as GpuPointLight on the CPU side
+struct PointLight {
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer PointLights {
+	PointLight lights[];
+};
+
+void main() {
+	vec3 albedo = subpassLoad(gbufferAlbedo).rgb;
+	float depth = subpassLoad(gbufferDepth).r;
+	// Nothing drawn: the clear color
+	if (depth >= 1.0)
+	{
+		outColor = vec4(albedo, 1.0);
+		return;
+	}
+	vec3 normal = normalize(subpassLoad(gbufferNormal).xyz * 2.0 - 1.0);
+
+	// Back to world space. Clip space y points down in Vulkan, like fragUV.
+	vec4 world = lighting.inverseViewProjection * vec4(fragUV * 2.0 - 1.0, depth, 1.0);
+	vec3 position = world.xyz / world.w;
+
+	vec3 color = albedo * lighting.ambient.rgb;
+	for (uint i = 0; i < lighting.lightCount; ++i)
+	{
+		vec3 toLight = lights[i].positionRadius.xyz - position;
+		float distance = length(toLight);
+		float radius = lights[i].positionRadius.w;
+		if (distance >= radius) continue;
+
+		// Smooth falloff, reaching 0 at the radius
+		float attenuation = 1.0 - distance / radius;
+		attenuation *= attenuation;
+		color += albedo * lights[i].color.rgb * max(dot(normal, toLight / distance), 0.0) * attenuation;
+	}
+	outColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 450
+
+// Vertex data, from the mesh pool vertex buffer. The position is quantized inside the mesh bounding box:
+// the model matrix includes its dequantization.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 uv;
+
+layout(set = 0, binding = 0) uniform ViewProjection {
+	mat4 projection;
+	mat4 view;
+} uboViewProjection;
+
+// Same layout as DrawPushConstants on the CPU side, pushed before each draw
+layout(push_constant) uniform PushDraw {
+	mat4 model;
+	uint materialBuffer;
+	uint materialId;
+} pushDraw;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterialId;
+layout(location = 2) out vec2 fragUV;
+// For the G-buffer normal, unused by the forward fragment shader
+layout(location = 3) out vec3 fragWorldPosition;
+
+void main() {
+	vec4 worldPosition = pushDraw.model * vec4(position, 1.0);
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * worldPosition;
+	fragUV = uv;
+	fragColor = color;
+	fragMaterialId = pushDraw.materialId;
+	fragWorldPosition = worldPosition.xyz;
+}
\ No newline at end of file
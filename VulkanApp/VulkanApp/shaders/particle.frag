@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec2 fragCorner;
+layout(location = 1) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+// Soft round dot, blended additively
+void main() {
+	float falloff = 1.0 - clamp(dot(fragCorner, fragCorner), 0.0, 1.0);
+	if (falloff <= 0.0) discard;
+	outColor = vec4(fragColor * falloff * falloff, 0.0);
+}
\ No newline at end of file
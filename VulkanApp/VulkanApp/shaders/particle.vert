@@ -0,0 +1,57 @@
+#version 450
+
+// One instance per alive particle, one camera facing quad each: no vertex buffer
+const vec2 CORNERS[6] = vec2[](
+	vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+	vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+layout(set = 0, binding = 0) uniform Particles {
+	mat4 viewProjection;
+	vec4 cameraRight; // World space, w particle size
+	vec4 cameraUp;
+	vec4 emitter; // xyz position, w radius
+	float deltaTime;
+	float time;
+	uint emitCount;
+	uint seed;
+	uint aliveList; // Simulated, the survivors and new particles go to the other one
+	uint maxParticles;
+	float lifetime;
+} particles;
+
+// Same layout as GpuParticle on the CPU side
+struct Particle {
+	vec4 position; // xyz, w remaining life in seconds
+	vec4 velocity; // xyz, w random seed given at emission
+};
+
+layout(set = 0, binding = 1) readonly buffer ParticleBuffer {
+	Particle values[];
+} particleBuffer;
+
+// Two lists of maxParticles indices
+layout(set = 0, binding = 2) readonly buffer AliveLists {
+	uint indices[];
+} aliveLists;
+
+layout(location = 0) out vec2 fragCorner;
+layout(location = 1) out vec3 fragColor;
+
+void main() {
+	// The list the simulation and the emission filled this frame
+	uint drawnList = 1 - particles.aliveList;
+	uint index = aliveLists.indices[drawnList * particles.maxParticles + gl_InstanceIndex];
+	Particle particle = particleBuffer.values[index];
+
+	vec2 corner = CORNERS[gl_VertexIndex];
+	float size = particles.cameraRight.w;
+	vec3 position = particle.position.xyz
+		+ (particles.cameraRight.xyz * corner.x + particles.cameraUp.xyz * corner.y) * size;
+	gl_Position = particles.viewProjection * vec4(position, 1.0);
+
+	// Hot when emitted, cooling and fading out with age
+	float life = clamp(particle.position.w / particles.lifetime, 0.0, 1.0);
+	vec3 tint = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.6, 0.2), particle.velocity.w);
+	fragColor = mix(vec3(0.05, 0.02, 0.02), tint, life) * life;
+	fragCorner = corner;
+}
\ No newline at end of file
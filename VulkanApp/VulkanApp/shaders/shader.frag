@@ -1,11 +1,41 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 // Connects to the output of vertex shader.
 // Interpolated color from vertex shader.
 layout(location = 0) in vec3 fragColor;
+// Material of the draw, or of the object for indirect draws
+layout(location = 1) flat in uint fragMaterialId;
+layout(location = 2) in vec2 fragUV;
 // Final output color, must have location
 layout(location = 0) out vec4 outColor;
 
+// Same layout as GpuMaterial on the CPU side
+struct Material {
+	vec4 baseColor;
+	uint albedoTexture;
+};
+
+const uint INVALID_INDEX = 0xFFFFFFFF;
+
+// Bindless set (BindlessDescriptors): every texture and storage buffer, indexed by handle
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+layout(std430, set = 1, binding = 1) readonly buffer Materials {
+	Material materials[];
+} materialBuffers[];
+
+// Members of DrawPushConstants read here, at their offset in the CPU side struct
+layout(push_constant) uniform PushDraw {
+	layout(offset = 64) uint materialBuffer;
+} pushDraw;
+
 void main() {
-	outColor = vec4(fragColor, 1.0);
+	Material material = materialBuffers[pushDraw.materialBuffer].materials[fragMaterialId];
+	vec3 albedo = fragColor * material.baseColor.rgb;
+	if (material.albedoTexture != INVALID_INDEX)
+	{
+		// The index comes from a per-object material: it may differ inside a draw
+		albedo *= texture(textures[nonuniformEXT(material.albedoTexture)], fragUV).rgb;
+	}
+	outColor = vec4(albedo, 1.0);
 }
\ No newline at end of file
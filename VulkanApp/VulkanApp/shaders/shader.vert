@@ -1,24 +1,44 @@
 #version 450
 
-// Output colors for vertex shader
-layout(location = 0) out vec3 fragColor;
+// Vertex data, from the mesh pool vertex buffer. The position is quantized inside the mesh bounding box:
+// the model matrix includes its dequantization.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 uv;
+
+layout(set = 0, binding = 0) uniform ViewProjection {
+	mat4 projection;
+	mat4 view;
+} uboViewProjection;
 
-// Triangle vertex positions
-// (will be put to vertex buffer later)
-vec3 positions[3] = vec3[](
-	vec3(0.0, -0.4, 0.0),
-	vec3(0.4, 0.4, 0.0),
-	vec3(-0.4, 0.4, 0.0)
-);
+// Same layout as GpuObject on the CPU side
+struct Object {
+	mat4 model;
+	vec4 boundingSphere;
+	uint meshId;
+	uint materialId;
+	uint padding0;
+	uint padding1;
+};
 
-// Colors
-vec3 colors[3] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+layout(std430, set = 0, binding = 1) readonly buffer Objects {
+	Object objects[];
+};
+
+// Output colors for vertex shader
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterialId;
+layout(location = 2) out vec2 fragUV;
+// For the G-buffer normal, unused by the forward fragment shader
+layout(location = 3) out vec3 fragWorldPosition;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 1.0);
-	fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+	// Indirect draws put the object index in firstInstance, which gl_InstanceIndex includes
+	mat4 model = objects[gl_InstanceIndex].model;
+	vec4 worldPosition = model * vec4(position, 1.0);
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * worldPosition;
+	fragUV = uv;
+	fragColor = color;
+	fragMaterialId = objects[gl_InstanceIndex].materialId;
+	fragWorldPosition = worldPosition.xyz;
+}